@@ -189,15 +189,157 @@ bgp_adj_out_lookup (struct peer *peer, struct bgp_node *rn,
 }
 
 
+/* Live Adj-RIB-In entries over all peers, for "show bgp memory".  */
+static unsigned long bgp_adj_in_total;
+
+unsigned long
+bgp_adj_in_count (void)
+{
+  return bgp_adj_in_total;
+}
+
+static void
+bgp_adj_in_chunk_add (struct bgp_adj_in_chunk **head,
+                      struct bgp_adj_in_chunk *chunk)
+{
+  chunk->prev = NULL;
+  chunk->next = *head;
+  if (*head)
+    (*head)->prev = chunk;
+  *head = chunk;
+}
+
+static void
+bgp_adj_in_chunk_del (struct bgp_adj_in_chunk **head,
+                      struct bgp_adj_in_chunk *chunk)
+{
+  if (chunk->next)
+    chunk->next->prev = chunk->prev;
+  if (chunk->prev)
+    chunk->prev->next = chunk->next;
+  else
+    *head = chunk->next;
+}
+
+static struct bgp_adj_in *
+bgp_adj_in_alloc (struct peer *peer, afi_t afi, safi_t safi)
+{
+  struct bgp_adj_in_pool *pool;
+  struct bgp_adj_in_chunk *chunk;
+  struct bgp_adj_in *adj;
+
+  pool = peer->adj_in_pool[afi][safi];
+  if (! pool)
+    {
+      pool = XCALLOC (MTYPE_BGP_ADJ_IN_POOL, sizeof (struct bgp_adj_in_pool));
+      pool->peer = peer_lock (peer); /* adj_in peer reference */
+      peer->adj_in_pool[afi][safi] = pool;
+    }
+
+  chunk = pool->avail;
+  if (! chunk)
+    {
+      chunk = XMALLOC (MTYPE_BGP_ADJ_IN, sizeof (struct bgp_adj_in_chunk));
+      chunk->pool = pool;
+      chunk->free = NULL;
+      chunk->used = 0;
+      chunk->live = 0;
+      bgp_adj_in_chunk_add (&pool->avail, chunk);
+    }
+
+  if (chunk->free)
+    {
+      adj = chunk->free;
+      chunk->free = adj->next;
+    }
+  else
+    {
+      adj = &chunk->entries[chunk->used];
+      adj->slot = chunk->used++;
+    }
+
+  if (++chunk->live == BGP_ADJ_IN_CHUNK_ENTRIES)
+    {
+      bgp_adj_in_chunk_del (&pool->avail, chunk);
+      bgp_adj_in_chunk_add (&pool->full, chunk);
+    }
+
+  pool->count++;
+  bgp_adj_in_total++;
+  return adj;
+}
+
+/* Free the empty chunks of a pool, and the pool once it has no entries
+   left, unless it is being walked.  */
+static void
+bgp_adj_in_pool_gc (struct bgp_adj_in_pool *pool, afi_t afi, safi_t safi)
+{
+  struct bgp_adj_in_chunk *chunk;
+  struct bgp_adj_in_chunk *next;
+  struct peer *peer = pool->peer;
+
+  if (pool->walking)
+    return;
+
+  for (chunk = pool->avail; chunk; chunk = next)
+    {
+      next = chunk->next;
+      if (chunk->live == 0)
+	{
+	  bgp_adj_in_chunk_del (&pool->avail, chunk);
+	  XFREE (MTYPE_BGP_ADJ_IN, chunk);
+	}
+    }
+
+  if (pool->count)
+    return;
+
+  peer->adj_in_pool[afi][safi] = NULL;
+  XFREE (MTYPE_BGP_ADJ_IN_POOL, pool);
+  peer_unlock (peer); /* adj_in peer reference */
+}
+
+/* Drop an entry from its node and return it to its chunk, freeing the
+   chunk if that was its last entry.  */
+static void
+bgp_adj_in_release (struct bgp_node *rn, struct bgp_adj_in *bai)
+{
+  struct bgp_adj_in_chunk *chunk = BGP_ADJ_IN_CHUNK (bai);
+  struct bgp_adj_in_pool *pool = chunk->pool;
+
+  BGP_ADJ_IN_DEL (rn, bai);
+  bgp_attr_unintern (&bai->attr);
+  bai->attr = NULL;
+  bai->rn = NULL;
+
+  bai->next = chunk->free;
+  chunk->free = bai;
+
+  if (chunk->live-- == BGP_ADJ_IN_CHUNK_ENTRIES)
+    {
+      bgp_adj_in_chunk_del (&pool->full, chunk);
+      bgp_adj_in_chunk_add (&pool->avail, chunk);
+    }
+  else if (chunk->live == 0 && ! pool->walking)
+    {
+      bgp_adj_in_chunk_del (&pool->avail, chunk);
+      XFREE (MTYPE_BGP_ADJ_IN, chunk);
+    }
+
+  pool->count--;
+  bgp_adj_in_total--;
+}
+
 void
 bgp_adj_in_set (struct bgp_node *rn, struct peer *peer, struct attr *attr,
                 u_int32_t addpath_id)
 {
   struct bgp_adj_in *adj;
+  struct bgp_table *table;
 
   for (adj = rn->adj_in; adj; adj = adj->next)
     {
-      if (adj->peer == peer && adj->addpath_rx_id == addpath_id)
+      if (BGP_ADJ_IN_PEER (adj) == peer && adj->addpath_rx_id == addpath_id)
 	{
 	  if (adj->attr != attr)
 	    {
@@ -207,8 +349,9 @@ bgp_adj_in_set (struct bgp_node *rn, struct peer *peer, struct attr *attr,
 	  return;
 	}
     }
-  adj = XCALLOC (MTYPE_BGP_ADJ_IN, sizeof (struct bgp_adj_in));
-  adj->peer = peer_lock (peer); /* adj_in peer reference */
+  table = bgp_node_table (rn);
+  adj = bgp_adj_in_alloc (peer, table->afi, table->safi);
+  adj->rn = rn;
   adj->attr = bgp_attr_intern (attr);
   adj->addpath_rx_id = addpath_id;
   BGP_ADJ_IN_ADD (rn, adj);
@@ -218,10 +361,12 @@ bgp_adj_in_set (struct bgp_node *rn, struct peer *peer, struct attr *attr,
 void
 bgp_adj_in_remove (struct bgp_node *rn, struct bgp_adj_in *bai)
 {
-  bgp_attr_unintern (&bai->attr);
-  BGP_ADJ_IN_DEL (rn, bai);
-  peer_unlock (bai->peer); /* adj_in peer reference */
-  XFREE (MTYPE_BGP_ADJ_IN, bai);
+  struct bgp_table *table = bgp_node_table (rn);
+  struct bgp_adj_in_pool *pool = BGP_ADJ_IN_CHUNK (bai)->pool;
+
+  bgp_adj_in_release (rn, bai);
+  if (pool->count == 0)
+    bgp_adj_in_pool_gc (pool, table->afi, table->safi);
 }
 
 int
@@ -240,7 +385,7 @@ bgp_adj_in_unset (struct bgp_node *rn, struct peer *peer,
     {
       adj_next = adj->next;
 
-      if (adj->peer == peer && adj->addpath_rx_id == addpath_id)
+      if (BGP_ADJ_IN_PEER (adj) == peer && adj->addpath_rx_id == addpath_id)
         {
           bgp_adj_in_remove (rn, adj);
           bgp_unlock_node (rn);
@@ -252,6 +397,152 @@ bgp_adj_in_unset (struct bgp_node *rn, struct peer *peer,
   return 1;
 }
 
+static void
+bgp_adj_in_chunk_clear (struct bgp_adj_in_chunk *chunk)
+{
+  struct bgp_adj_in *adj;
+  struct bgp_node *rn;
+  unsigned int i;
+
+  for (i = 0; i < chunk->used && chunk->live; i++)
+    {
+      adj = &chunk->entries[i];
+      if (! adj->attr)
+	continue;
+      rn = adj->rn;
+      bgp_adj_in_release (rn, adj);
+      bgp_unlock_node (rn);
+    }
+}
+
+/* Remove every Adj-RIB-In entry of a peer for an afi/safi, including
+   those in per-RD tables.  Only the peer's own entries are visited.  */
+void
+bgp_adj_in_clear (struct peer *peer, afi_t afi, safi_t safi)
+{
+  struct bgp_adj_in_pool *pool;
+  struct bgp_adj_in_chunk *chunk;
+
+  pool = peer->adj_in_pool[afi][safi];
+  if (! pool)
+    return;
+
+  /* Clearing a full chunk moves it onto avail.  */
+  pool->walking++;
+  while (pool->full)
+    bgp_adj_in_chunk_clear (pool->full);
+  for (chunk = pool->avail; chunk; chunk = chunk->next)
+    bgp_adj_in_chunk_clear (chunk);
+  pool->walking--;
+
+  bgp_adj_in_pool_gc (pool, afi, safi);
+}
+
+/* Order of two prefixes in a table walk: a prefix comes before those
+   it covers, and the 0 branch before the 1 branch.  As node prefixes
+   are masked, that is the order of their addresses, then lengths.  */
+static int
+bgp_adj_in_prefix_cmp (const struct prefix *p1, const struct prefix *p2)
+{
+  int ret;
+
+  ret = memcmp (&p1->u.prefix, &p2->u.prefix,
+                PSIZE (MAX (p1->prefixlen, p2->prefixlen)));
+  if (ret)
+    return ret;
+  return (int) p1->prefixlen - (int) p2->prefixlen;
+}
+
+static int
+bgp_adj_in_walk_cmp (const void *v1, const void *v2)
+{
+  const struct bgp_node *rn1 = (*(struct bgp_adj_in * const *) v1)->rn;
+  const struct bgp_node *rn2 = (*(struct bgp_adj_in * const *) v2)->rn;
+  int ret;
+
+  /* Per-RD tables hang off the RD's node.  */
+  if (rn1->prn != rn2->prn && rn1->prn && rn2->prn)
+    {
+      ret = bgp_adj_in_prefix_cmp (&rn1->prn->p, &rn2->prn->p);
+      if (ret)
+	return ret;
+    }
+
+  ret = bgp_adj_in_prefix_cmp (&rn1->p, &rn2->p);
+  if (ret)
+    return ret;
+  return rn1 < rn2 ? -1 : rn1 != rn2;
+}
+
+static void
+bgp_adj_in_walk_add (struct bgp_adj_in_chunk *chunk, struct bgp_adj_in **walk,
+                     unsigned long *count)
+{
+  unsigned int i;
+
+  for (i = 0; i < chunk->used; i++)
+    if (chunk->entries[i].attr)
+      walk[(*count)++] = &chunk->entries[i];
+}
+
+/* Start a walk of a peer's Adj-RIB-In for an afi/safi.  Returns its
+   entries in table order, and their number in *countp, or NULL if it is
+   empty.  Until bgp_adj_in_walk_end, entries may be removed from under
+   the walk, which then finds them with a NULL attr, but none are
+   freed.  */
+struct bgp_adj_in **
+bgp_adj_in_walk_start (struct peer *peer, afi_t afi, safi_t safi,
+                       unsigned long *countp)
+{
+  struct bgp_adj_in_pool *pool;
+  struct bgp_adj_in_chunk *chunk;
+  struct bgp_adj_in **walk;
+  unsigned long count = 0;
+  unsigned long i;
+
+  *countp = 0;
+  pool = peer->adj_in_pool[afi][safi];
+  if (! pool || ! pool->count)
+    return NULL;
+
+  walk = XMALLOC (MTYPE_TMP, pool->count * sizeof (struct bgp_adj_in *));
+
+  /* Oldest chunks first: entries of a table that came in in order
+     then need no sorting.  */
+  for (chunk = pool->full; chunk && chunk->next; chunk = chunk->next)
+    ;
+  for (; chunk; chunk = chunk->prev)
+    bgp_adj_in_walk_add (chunk, walk, &count);
+  for (chunk = pool->avail; chunk; chunk = chunk->next)
+    bgp_adj_in_walk_add (chunk, walk, &count);
+
+  for (i = 1; i < count; i++)
+    if (bgp_adj_in_walk_cmp (&walk[i - 1], &walk[i]) > 0)
+      {
+	qsort (walk, count, sizeof (struct bgp_adj_in *), bgp_adj_in_walk_cmp);
+	break;
+      }
+
+  pool->walking++;
+  *countp = count;
+  return walk;
+}
+
+void
+bgp_adj_in_walk_end (struct peer *peer, afi_t afi, safi_t safi,
+                     struct bgp_adj_in **walk)
+{
+  struct bgp_adj_in_pool *pool;
+
+  if (! walk)
+    return;
+
+  pool = peer->adj_in_pool[afi][safi];
+  pool->walking--;
+  bgp_adj_in_pool_gc (pool, afi, safi);
+  XFREE (MTYPE_TMP, walk);
+}
+
 void
 bgp_sync_init (struct peer *peer)
 {
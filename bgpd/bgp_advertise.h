@@ -44,6 +44,9 @@ struct bgp_advertise_attr
 
   /* Attribute pointer to be announced.  */
   struct attr *attr;
+
+  /* Encoded length of the attributes, once an UPDATE carried them.  */
+  bgp_size_t attr_len;
 };
 
 struct bgp_advertise
@@ -93,23 +96,75 @@ struct bgp_adj_out
   struct bgp_advertise *adv;
 };
 
-/* BGP adjacency in. */
+/* BGP adjacency in.  Entries are carved out of per peer/afi/safi
+   chunks (struct bgp_adj_in_pool) rather than allocated one by one, so
+   soft reconfiguration and clearing can visit a peer's Adj-RIB-In
+   without walking the whole table.  The peer is found through the
+   chunk, see BGP_ADJ_IN_PEER.  */
 struct bgp_adj_in
 {
-  /* Linked list pointer.  */
+  /* Linked list pointer, on rn->adj_in.  next also links free entries
+     of a chunk.  */
   struct bgp_adj_in *next;
   struct bgp_adj_in *prev;
 
-  /* Received peer.  */
-  struct peer *peer;
+  /* Prefix this entry belongs to.  */
+  struct bgp_node *rn;
 
-  /* Received attribute.  */
+  /* Received attribute, NULL while the entry is free.  */
   struct attr *attr;
 
   /* Addpath identifier */
   u_int32_t addpath_rx_id;
+
+  /* Index in the chunk's entries.  */
+  u_int16_t slot;
+};
+
+#define BGP_ADJ_IN_CHUNK_ENTRIES	128
+
+struct bgp_adj_in_chunk
+{
+  /* On the pool's avail or full list.  */
+  struct bgp_adj_in_chunk *next;
+  struct bgp_adj_in_chunk *prev;
+
+  struct bgp_adj_in_pool *pool;
+
+  /* Entries released since the chunk was allocated.  */
+  struct bgp_adj_in *free;
+
+  /* Entries handed out from the chunk so far, and those still live.  */
+  u_int16_t used;
+  u_int16_t live;
+
+  struct bgp_adj_in entries[BGP_ADJ_IN_CHUNK_ENTRIES];
+};
+
+/* Adj-RIB-In storage of one peer for one afi/safi.  Chunks with room
+   are on avail, new entries are taken from its first chunk, and a chunk
+   is freed as soon as its last entry is.  The pool holds a single peer
+   reference for as long as it has live entries.  */
+struct bgp_adj_in_pool
+{
+  struct peer *peer;
+  struct bgp_adj_in_chunk *avail;
+  struct bgp_adj_in_chunk *full;
+
+  /* Live entries.  */
+  unsigned long count;
+
+  /* While non-zero, empty chunks and the pool itself are kept, so that
+     entries being walked stay valid.  */
+  unsigned int walking;
 };
 
+#define BGP_ADJ_IN_CHUNK(A)                                           \
+  ((struct bgp_adj_in_chunk *)                                        \
+   ((char *) ((A) - (A)->slot) - offsetof (struct bgp_adj_in_chunk, entries)))
+
+#define BGP_ADJ_IN_PEER(A)	(BGP_ADJ_IN_CHUNK (A)->pool->peer)
+
 /* BGP advertisement list.  */
 struct bgp_synchronize
 {
@@ -176,6 +231,12 @@ extern int bgp_adj_out_lookup (struct peer *, struct bgp_node *, u_int32_t);
 extern void bgp_adj_in_set (struct bgp_node *, struct peer *, struct attr *, u_int32_t);
 extern int bgp_adj_in_unset (struct bgp_node *, struct peer *, u_int32_t);
 extern void bgp_adj_in_remove (struct bgp_node *, struct bgp_adj_in *);
+extern void bgp_adj_in_clear (struct peer *, afi_t, safi_t);
+extern struct bgp_adj_in **bgp_adj_in_walk_start (struct peer *, afi_t, safi_t,
+                                                  unsigned long *);
+extern void bgp_adj_in_walk_end (struct peer *, afi_t, safi_t,
+                                 struct bgp_adj_in **);
+extern unsigned long bgp_adj_in_count (void);
 
 extern void bgp_sync_init (struct peer *);
 extern void bgp_sync_delete (struct peer *);
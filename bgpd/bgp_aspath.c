@@ -36,6 +36,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_aspath.h"
 #include "bgpd/bgp_debug.h"
 #include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_filter.h"
 
 /* Attr. Flags and Attr. Type Code. */
 #define AS_HEADER_SIZE        2	 
@@ -348,6 +349,8 @@ aspath_free (struct aspath *aspath)
       json_object_free(aspath->json);
       aspath->json = NULL;
     }
+  if (aspath->filter_memo)
+    as_list_memo_free (aspath->filter_memo);
 
   XFREE (MTYPE_AS_PATH, aspath);
 }
@@ -528,31 +531,24 @@ aspath_has_as4 (struct aspath *aspath)
   return 0;
 }
 
-/* Convert aspath structure to string expression. */
-static void
-aspath_make_str_count (struct aspath *as)
+/* Convert aspath structure to string expression.  Returns NULL for a
+   path with an unknown segment type, otherwise a string allocated from
+   MTYPE_AS_STR whose length is stored in *LEN. */
+static char *
+aspath_make_str (struct aspath *as, unsigned short *lenp)
 {
   struct assegment *seg;
   int str_size;
   int len = 0;
   char *str_buf;
-  json_object *jaspath_segments = NULL;
-  json_object *jseg = NULL;
-  json_object *jseg_list = NULL;
-
-  as->json = json_object_new_object();
-  jaspath_segments = json_object_new_array();
 
   /* Empty aspath. */
   if (!as->segments)
     {
-      json_object_string_add(as->json, "string", "Local");
-      json_object_object_add(as->json, "segments", jaspath_segments);
-      json_object_int_add(as->json, "length", 0);
-      as->str = XMALLOC (MTYPE_AS_STR, 1);
-      as->str[0] = '\0';
-      as->str_len = 0;
-      return;
+      str_buf = XMALLOC (MTYPE_AS_STR, 1);
+      str_buf[0] = '\0';
+      *lenp = 0;
+      return str_buf;
     }
   
   seg = as->segments;
@@ -589,11 +585,8 @@ aspath_make_str_count (struct aspath *as)
             break;
           default:
             XFREE (MTYPE_AS_STR, str_buf);
-            as->str = NULL;
-            as->str_len = 0;
-            json_object_free(as->json);
-            as->json = NULL;
-            return;
+            *lenp = 0;
+            return NULL;
         }
       
       /* We might need to increase str_buf, particularly if path has
@@ -618,24 +611,15 @@ aspath_make_str_count (struct aspath *as)
         len += snprintf (str_buf + len, str_size - len, 
 			 "%c", 
                          aspath_delimiter_char (seg->type, AS_SEG_START));
-
-      jseg_list = json_object_new_array();
       
       /* write out the ASNs, with their seperators, bar the last one*/
       for (i = 0; i < seg->length; i++)
         {
-          json_object_array_add(jseg_list, json_object_new_int(seg->as[i]));
-
           len += snprintf (str_buf + len, str_size - len, "%u", seg->as[i]);
           
           if (i < (seg->length - 1))
             len += snprintf (str_buf + len, str_size - len, "%c", seperator);
         }
-
-      jseg = json_object_new_object();
-      json_object_string_add(jseg, "type", aspath_segment_type_str[seg->type]);
-      json_object_object_add(jseg, "list", jseg_list);
-      json_object_array_add(jaspath_segments, jseg);
       
       if (seg->type != AS_SEQUENCE)
         len += snprintf (str_buf + len, str_size - len, "%c", 
@@ -649,28 +633,73 @@ aspath_make_str_count (struct aspath *as)
   assert (len < str_size);
   
   str_buf[len] = '\0';
-  as->str = str_buf;
-  as->str_len = len;
+  *lenp = len;
+  return str_buf;
+}
 
-  json_object_string_add(as->json, "string", str_buf);
-  json_object_object_add(as->json, "segments", jaspath_segments);
-  json_object_int_add(as->json, "length", aspath_count_hops (as));
-  return;
+/* Build the json object for an AS path.  Returns NULL for a path with
+   an unknown segment type. */
+static json_object *
+aspath_make_json (struct aspath *as)
+{
+  struct assegment *seg;
+  const char *str;
+  json_object *json;
+  json_object *jaspath_segments;
+  json_object *jseg;
+  json_object *jseg_list;
+  int i;
+
+  /* Empty aspath. */
+  if (!as->segments)
+    {
+      json = json_object_new_object();
+      json_object_string_add(json, "string", "Local");
+      json_object_object_add(json, "segments", json_object_new_array());
+      json_object_int_add(json, "length", 0);
+      return json;
+    }
+
+  str = aspath_print (as);
+  if (!str)
+    return NULL;
+
+  json = json_object_new_object();
+  jaspath_segments = json_object_new_array();
+
+  for (seg = as->segments; seg; seg = seg->next)
+    {
+      jseg_list = json_object_new_array();
+      for (i = 0; i < seg->length; i++)
+        json_object_array_add(jseg_list, json_object_new_int(seg->as[i]));
+
+      jseg = json_object_new_object();
+      json_object_string_add(jseg, "type", aspath_segment_type_str[seg->type]);
+      json_object_object_add(jseg, "list", jseg_list);
+      json_object_array_add(jaspath_segments, jseg);
+    }
+
+  json_object_string_add(json, "string", str);
+  json_object_object_add(json, "segments", jaspath_segments);
+  json_object_int_add(json, "length", aspath_count_hops (as));
+  return json;
 }
 
+/* Drop the cached string and json renderings of an AS path after its
+   segments changed.  They are rebuilt on demand by aspath_print() and
+   aspath_json(). */
 static void
 aspath_str_update (struct aspath *as)
 {
   if (as->str)
     XFREE (MTYPE_AS_STR, as->str);
+  as->str_len = 0;
 
   if (as->json)
     {
       json_object_free(as->json);
       as->json = NULL;
     }
-
-  aspath_make_str_count (as);
 }
 
 /* Intern allocated AS path. */
@@ -679,10 +708,8 @@ aspath_intern (struct aspath *aspath)
 {
   struct aspath *find;
 
-  /* Assert this AS path structure is not interned and has the string
-     representation built. */
+  /* Assert this AS path structure is not interned. */
   assert (aspath->refcnt == 0);
-  assert (aspath->str);
 
   /* Check AS path hash. */
   find = hash_get (ashash, aspath, hash_alloc_intern);
@@ -699,27 +726,13 @@ aspath_intern (struct aspath *aspath)
 struct aspath *
 aspath_dup (struct aspath *aspath)
 {
-  unsigned short buflen = aspath->str_len + 1;
   struct aspath *new;
 
   new = XCALLOC (MTYPE_AS_PATH, sizeof (struct aspath));
-  new->json = NULL;
 
   if (aspath->segments)
     new->segments = assegment_dup_all (aspath->segments);
 
-  if (!aspath->str)
-    return new;
-
-  new->str = XMALLOC (MTYPE_AS_STR, buflen);
-  new->str_len = aspath->str_len;
-
-  /* copy the string data */
-  if (aspath->str_len > 0)
-    memcpy (new->str, aspath->str, buflen);
-  else
-    new->str[0] = '\0';
-
   return new;
 }
 
@@ -729,18 +742,16 @@ aspath_hash_alloc (void *arg)
   const struct aspath *aspath = arg;
   struct aspath *new;
 
-  /* Malformed AS path value. */
-  assert (aspath->str);
-
   /* New aspath structure is needed. */
   new = XMALLOC (MTYPE_AS_PATH, sizeof (struct aspath));
 
-  /* Reuse segments and string representation */
+  /* Reuse segments and any cached rendering */
   new->refcnt = 0;
   new->segments = aspath->segments;
   new->str = aspath->str;
   new->str_len = aspath->str_len;
   new->json = aspath->json;
+  new->filter_memo = NULL;
 
   return new;
 }
@@ -877,13 +888,6 @@ aspath_parse (struct stream *s, size_t length, int use32bit)
   if (find->refcnt)
     {
       assegment_free_all (as.segments);
-      /* aspath_key_make() always updates the string */
-      XFREE (MTYPE_AS_STR, as.str);
-      if (as.json)
-	{
-	  json_object_free(as.json);
-	  as.json = NULL;
-	}
     }
 
   find->refcnt++;
@@ -1739,7 +1743,7 @@ aspath_reconcile_as4 ( struct aspath *aspath, struct aspath *as4path)
   
   if ( BGP_DEBUG(as4, AS4))
     zlog_debug("[AS4] got AS_PATH %s and AS4_PATH %s synthesizing now",
-               aspath->str, as4path->str);
+               aspath_print (aspath), aspath_print (as4path));
 
   while (seg && hops > 0)
     {
@@ -1798,7 +1802,7 @@ aspath_reconcile_as4 ( struct aspath *aspath, struct aspath *as4path)
   
   if ( BGP_DEBUG(as4, AS4))
     zlog_debug ("[AS4] result of synthesizing is %s",
-                mergedpath->str);
+                aspath_print (mergedpath));
   
   return mergedpath;
 }
@@ -1927,7 +1931,6 @@ aspath_empty_get (void)
   struct aspath *aspath;
 
   aspath = aspath_new ();
-  aspath_make_str_count (aspath);
   return aspath;
 }
 
@@ -2086,8 +2089,6 @@ aspath_str2aspath (const char *str)
 	}
     }
 
-  aspath_make_str_count (aspath);
-
   return aspath;
 }
 
@@ -2096,12 +2097,14 @@ unsigned int
 aspath_key_make (void *p)
 {
   struct aspath *aspath = (struct aspath *) p;
-  unsigned int key = 0;
-
-  if (!aspath->str)
-    aspath_str_update (aspath);
+  struct assegment *seg;
+  unsigned int key = 2334325;
 
-  key = jhash (aspath->str, aspath->str_len, 2334325);
+  /* Hash the segments themselves, consistent with aspath_cmp, so that
+     no string has to be rendered to intern a path. */
+  for (seg = aspath->segments; seg; seg = seg->next)
+    key = jhash2 (seg->as, seg->length,
+                  jhash_2words (seg->type, seg->length, key));
 
   return key;
 }
@@ -2153,9 +2156,35 @@ aspath_finish (void)
 const char *
 aspath_print (struct aspath *as)
 {
-  return (as ? as->str : NULL);
+  if (!as)
+    return NULL;
+
+  if (!as->str)
+    as->str = aspath_make_str (as, &as->str_len);
+
+  return as->str;
 }
 
+/* return the json object of an as path, built on first use */
+json_object *
+aspath_json (struct aspath *as)
+{
+  if (!as->json)
+    as->json = aspath_make_json (as);
+
+  return as->json;
+}
+
+/* Render the string form of an AS path without caching it on the
+   path, for one-off users such as regular expression matching.  The
+   caller frees the result with XFREE (MTYPE_AS_STR, ...). */
+char *
+aspath_str_render (struct aspath *as)
+{
+  unsigned short len;
+
+  return aspath_make_str (as, &len);
+}
 /* Printing functions */
 /* Feed the AS_PATH to the vty; the suffix string follows it only in case
  * AS_PATH wasn't empty.
@@ -2164,7 +2193,7 @@ void
 aspath_print_vty (struct vty *vty, const char *format, struct aspath *as, const char * suffix)
 {
   assert (format);
-  vty_out (vty, format, as->str);
+  vty_out (vty, format, aspath_print (as));
   if (as->str_len && strlen (suffix))
     vty_out (vty, "%s", suffix);
 }
@@ -2177,7 +2206,7 @@ aspath_show_all_iterator (struct hash_backet *backet, struct vty *vty)
   as = (struct aspath *) backet->data;
 
   vty_out (vty, "[%p:%u] (%ld) ", (void *)backet, backet->key, as->refcnt);
-  vty_out (vty, "%s%s", as->str, VTY_NEWLINE);
+  vty_out (vty, "%s%s", aspath_print (as), VTY_NEWLINE);
 }
 
 /* Print all aspath and hash information.  This function is used from
@@ -65,13 +65,16 @@ struct aspath
   /* segment data */
   struct assegment *segments;
   
-  /* AS path as a json object */
+  /* AS path as a json object, built on demand by aspath_json() */
   json_object *json;
 
-  /* String expression of AS path.  This string is used by vty output
-     and AS path regular expression match.  */
+  /* String expression of AS path, built on demand by aspath_print().
+     This string is used by vty output.  */
   char *str;
   unsigned short str_len;
+
+  /* Remembered as-path access-list results, see as_list_apply() */
+  struct as_list_memo *filter_memo;
 };
 
 #define ASPATH_STR_DEFAULT_LEN 32
@@ -98,6 +101,8 @@ extern void aspath_free (struct aspath *);
 extern struct aspath *aspath_intern (struct aspath *);
 extern void aspath_unintern (struct aspath **);
 extern const char *aspath_print (struct aspath *);
+extern char *aspath_str_render (struct aspath *);
+extern json_object *aspath_json (struct aspath *);
 extern void aspath_print_vty (struct vty *, const char *, struct aspath *, const char *);
 extern void aspath_print_all_vty (struct vty *);
 extern unsigned int aspath_key_make (void *);
@@ -2204,6 +2204,228 @@ bgp_attr_check (struct peer *peer, struct attr *attr)
   return BGP_ATTR_PARSE_PROCEED;
 }
 
+/* Split a raw attribute section into the spans that make up its cache
+   key, leaving out the length field and the NLRI of MP_REACH_NLRI.
+   Sections carrying MP_UNREACH_NLRI, or that would not survive
+   bgp_attr_parse(), are not cached.  */
+static int
+bgp_attr_cache_scan (u_char *raw, bgp_size_t size,
+		     u_char *span[], bgp_size_t len[])
+{
+  u_char *p = raw;
+  u_char *end = raw + size;
+  u_char *mp = NULL;
+  u_char *nlri = NULL;
+  bgp_size_t nlri_len = 0;
+
+  while (p < end)
+    {
+      bgp_size_t hdr, length, nhlen;
+
+      if (end - p < BGP_ATTR_MIN_LEN)
+	return -1;
+      hdr = CHECK_FLAG (p[0], BGP_ATTR_FLAG_EXTLEN) ? 4 : 3;
+      if (end - p < hdr)
+	return -1;
+      length = (hdr == 4) ? ((p[2] << 8) | p[3]) : p[2];
+      if (end - p - hdr < length)
+	return -1;
+
+      switch (p[1])
+	{
+	case BGP_ATTR_MP_UNREACH_NLRI:
+	  return -1;
+	case BGP_ATTR_MP_REACH_NLRI:
+	  /* AFI (2), SAFI (1), nexthop length (1), nexthop, reserved (1),
+	     then at least one byte of NLRI. */
+	  if (mp || length < 5)
+	    return -1;
+	  nhlen = p[hdr + 3];
+	  if (length <= 5 + nhlen)
+	    return -1;
+	  mp = p + 2;
+	  nlri = p + hdr + 5 + nhlen;
+	  nlri_len = length - 5 - nhlen;
+	  break;
+	}
+      p += hdr + length;
+    }
+
+  span[0] = raw;
+  if (! mp)
+    {
+      len[0] = size;
+      span[1] = span[2] = end;
+      len[1] = len[2] = 0;
+      return 0;
+    }
+  len[0] = mp - raw;
+  span[1] = mp + (CHECK_FLAG (mp[-2], BGP_ATTR_FLAG_EXTLEN) ? 2 : 1);
+  len[1] = nlri - span[1];
+  span[2] = nlri + nlri_len;
+  len[2] = end - span[2];
+  return 0;
+}
+
+static u_int32_t
+bgp_attr_cache_key (u_char *span[], bgp_size_t len[])
+{
+  u_int32_t key = 0;
+  int i;
+
+  for (i = 0; i < BGP_ATTR_CACHE_SPANS; i++)
+    key = jhash (span[i], len[i], key);
+  return key;
+}
+
+/* Peer state which bgp_attr_parse() takes into account beyond the raw
+   bytes; see bgp_attr_aspath_check().  */
+static u_int32_t
+bgp_attr_cache_context (struct peer *peer)
+{
+  u_int32_t context = peer->sort;
+
+  if (peer->bgp && bgp_flag_check (peer->bgp, BGP_FLAG_ENFORCE_FIRST_AS))
+    context |= (1 << 8);
+  if (CHECK_FLAG (peer->flags, PEER_FLAG_LOCAL_AS_NO_PREPEND))
+    context |= (1 << 9);
+  return context;
+}
+
+static void
+bgp_attr_cache_entry_free (struct bgp_attr_cache_entry *entry)
+{
+  if (entry->attr)
+    bgp_attr_unintern (&entry->attr);
+  if (entry->data)
+    XFREE (MTYPE_BGP_ATTR_CACHE_DATA, entry->data);
+  memset (entry, 0, sizeof (struct bgp_attr_cache_entry));
+}
+
+/* Look up the attribute section of size bytes at the peer's input
+   pointer.  On a hit, fill in attr (which must point to caller owned
+   extra storage) holding references to its interned parts exactly as
+   bgp_attr_parse() would, point mp_update at the MP_REACH_NLRI, skip the
+   section and return 1.  Otherwise return 0 and leave the stream alone. */
+int
+bgp_attr_cache_get (struct peer *peer, bgp_size_t size, struct attr *attr,
+		    struct bgp_nlri *mp_update)
+{
+  struct bgp_attr_cache *cache;
+  struct bgp_attr_cache_entry *entry;
+  struct attr_extra *extra = attr->extra;
+  u_char *span[BGP_ATTR_CACHE_SPANS];
+  bgp_size_t len[BGP_ATTR_CACHE_SPANS];
+  u_char *data;
+  u_int32_t key;
+  int i;
+
+  if (! peer->attr_cache)
+    peer->attr_cache = XCALLOC (MTYPE_BGP_ATTR_CACHE,
+				sizeof (struct bgp_attr_cache));
+  cache = peer->attr_cache;
+
+  if (bgp_attr_cache_scan (BGP_INPUT_PNT (peer), size, span, len) < 0)
+    goto miss;
+
+  key = bgp_attr_cache_key (span, len);
+  entry = &cache->entries[key % BGP_ATTR_CACHE_SIZE];
+  if (! entry->attr
+      || entry->key != key
+      || entry->context != bgp_attr_cache_context (peer)
+      || entry->change_local_as != peer->change_local_as)
+    goto miss;
+
+  for (i = 0, data = entry->data; i < BGP_ATTR_CACHE_SPANS; data += len[i++])
+    if (entry->span[i] != len[i] || memcmp (data, span[i], len[i]))
+      goto miss;
+
+  *attr = *entry->attr;
+  if (entry->attr->extra)
+    *extra = *entry->attr->extra;
+  else
+    memset (extra, 0, sizeof (struct attr_extra));
+  attr->extra = extra;
+  bgp_attr_refcount (attr);
+  attr->refcnt = 0;
+
+  if (len[1])
+    {
+      mp_update->afi = entry->afi;
+      mp_update->safi = entry->safi;
+      mp_update->nlri = span[1] + len[1];
+      mp_update->length = span[2] - mp_update->nlri;
+    }
+
+  stream_forward_getp (BGP_INPUT (peer), size);
+  cache->hits++;
+  return 1;
+
+ miss:
+  cache->misses++;
+  return 0;
+}
+
+/* Remember the result of successfully parsing the attribute section of
+   size bytes at raw.  */
+void
+bgp_attr_cache_put (struct peer *peer, u_char *raw, bgp_size_t size,
+		    struct attr *attr, struct bgp_nlri *mp_update)
+{
+  struct bgp_attr_cache_entry *entry;
+  u_char *span[BGP_ATTR_CACHE_SPANS];
+  bgp_size_t len[BGP_ATTR_CACHE_SPANS];
+  u_char *data;
+  u_int32_t key;
+  int i;
+
+  if (! peer->attr_cache)
+    return;
+  if (bgp_attr_cache_scan (raw, size, span, len) < 0)
+    return;
+
+  key = bgp_attr_cache_key (span, len);
+  entry = &peer->attr_cache->entries[key % BGP_ATTR_CACHE_SIZE];
+  bgp_attr_cache_entry_free (entry);
+
+  entry->key = key;
+  entry->data = XMALLOC (MTYPE_BGP_ATTR_CACHE_DATA,
+			 len[0] + len[1] + len[2]);
+  for (i = 0, data = entry->data; i < BGP_ATTR_CACHE_SPANS; data += len[i++])
+    {
+      entry->span[i] = len[i];
+      memcpy (data, span[i], len[i]);
+    }
+  entry->context = bgp_attr_cache_context (peer);
+  entry->change_local_as = peer->change_local_as;
+  entry->afi = mp_update->afi;
+  entry->safi = mp_update->safi;
+  entry->attr = bgp_attr_intern (attr);
+}
+
+/* Drop all cached attribute sections, e.g. when the session goes down
+   and the negotiated capabilities they were parsed under go with it. */
+void
+bgp_attr_cache_flush (struct peer *peer)
+{
+  int i;
+
+  if (! peer->attr_cache)
+    return;
+  for (i = 0; i < BGP_ATTR_CACHE_SIZE; i++)
+    bgp_attr_cache_entry_free (&peer->attr_cache->entries[i]);
+}
+
+void
+bgp_attr_cache_free (struct peer *peer)
+{
+  if (! peer->attr_cache)
+    return;
+  bgp_attr_cache_flush (peer);
+  XFREE (MTYPE_BGP_ATTR_CACHE, peer->attr_cache);
+  peer->attr_cache = NULL;
+}
+
 /* Read attribute of update packet.  This function is called from
    bgp_update_receive() in bgp_packet.c.  */
 bgp_attr_parse_ret_t
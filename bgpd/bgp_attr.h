@@ -200,6 +200,42 @@ typedef enum {
  BGP_ATTR_PARSE_ERROR_NOTIFYPLS = -3,
 } bgp_attr_parse_ret_t;
 
+/* Per-peer cache of received path attribute sections.  A peer usually
+   sends the same attribute bytes again and again with only the NLRI
+   changing, so the raw section (minus the NLRI carried inside
+   MP_REACH_NLRI and that attribute's length field) is hashed and mapped
+   straight to the interned attribute that parsing it produced last time. */
+#define BGP_ATTR_CACHE_SIZE 64
+
+/* The raw section is kept as up to three spans: everything before the
+   MP_REACH_NLRI length field, the MP_REACH_NLRI header up to its NLRI,
+   and everything after the NLRI. */
+#define BGP_ATTR_CACHE_SPANS 3
+
+struct bgp_attr_cache_entry
+{
+  u_int32_t key;
+  bgp_size_t span[BGP_ATTR_CACHE_SPANS];
+  u_char *data;
+
+  /* Peer state that bgp_attr_parse() consulted. */
+  u_int32_t context;
+  as_t change_local_as;
+
+  /* AFI/SAFI of the MP_REACH_NLRI, if any. */
+  afi_t afi;
+  safi_t safi;
+
+  struct attr *attr;
+};
+
+struct bgp_attr_cache
+{
+  unsigned long hits;
+  unsigned long misses;
+  struct bgp_attr_cache_entry entries[BGP_ATTR_CACHE_SIZE];
+};
+
 struct bpacket_attr_vec_arr;
 
 /* Prototypes. */
@@ -208,6 +244,12 @@ extern void bgp_attr_finish (void);
 extern bgp_attr_parse_ret_t bgp_attr_parse (struct peer *, struct attr *,
                                            bgp_size_t, struct bgp_nlri *,
                                            struct bgp_nlri *);
+extern int bgp_attr_cache_get (struct peer *, bgp_size_t, struct attr *,
+                               struct bgp_nlri *);
+extern void bgp_attr_cache_put (struct peer *, u_char *, bgp_size_t,
+                                struct attr *, struct bgp_nlri *);
+extern void bgp_attr_cache_flush (struct peer *);
+extern void bgp_attr_cache_free (struct peer *);
 extern struct attr_extra *bgp_attr_extra_get (struct attr *);
 extern void bgp_attr_extra_free (struct attr *);
 extern void bgp_attr_dup (struct attr *, struct attr *);
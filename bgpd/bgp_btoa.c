@@ -56,22 +56,6 @@ struct zebra_privs_t bgpd_privs =
   .cap_num_i = 0,
 };
 
-enum MRT_MSG_TYPES {
-   MSG_NULL,
-   MSG_START,                   /* sender is starting up */
-   MSG_DIE,                     /* receiver should shut down */
-   MSG_I_AM_DEAD,               /* sender is shutting down */
-   MSG_PEER_DOWN,               /* sender's peer is down */
-   MSG_PROTOCOL_BGP,            /* msg is a BGP packet */
-   MSG_PROTOCOL_RIP,            /* msg is a RIP packet */
-   MSG_PROTOCOL_IDRP,           /* msg is an IDRP packet */
-   MSG_PROTOCOL_RIPNG,          /* msg is a RIPNG packet */
-   MSG_PROTOCOL_BGP4PLUS,       /* msg is a BGP4+ packet */
-   MSG_PROTOCOL_BGP4PLUS_01,    /* msg is a BGP4+ (draft 01) packet */
-   MSG_PROTOCOL_OSPF,           /* msg is an OSPF packet */
-   MSG_TABLE_DUMP               /* routing table dump */
-};
-
 static int
 attr_parse (struct stream *s, u_int16_t len)
 {
@@ -112,7 +96,7 @@ attr_parse (struct stream *s, u_int16_t len)
 	    struct aspath *aspath;
 
 	    aspath = aspath_parse (s, length, 1);
-	    printf ("ASPATH: %s\n", aspath->str);
+	    printf ("ASPATH: %s\n", aspath_print (aspath));
 	    aspath_free(aspath);
 	  }
 	  break;
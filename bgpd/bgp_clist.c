@@ -25,6 +25,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "memory.h"
 #include "queue.h"
 #include "filter.h"
+#include "jhash.h"
 
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_community.h"
@@ -93,6 +94,59 @@ community_list_new (void)
   return XCALLOC (MTYPE_COMMUNITY_LIST, sizeof (struct community_list));
 }
 
+/* Standard community-lists are matched through a table from community
+   value to the positions of the entries naming it, so each community of
+   a route is looked up once instead of being compared with every entry.
+   Expanded community-lists remember their verdict for recently matched
+   communities, saving the regular expressions.  */
+struct community_list_value
+{
+  u_int32_t val;		/* As stored in com->val.  */
+  u_int32_t first;		/* Entry positions are pos[first...].  */
+  u_int32_t count;		/* 0 for an empty slot.  */
+};
+
+struct community_list_hit
+{
+  unsigned int gen;
+  int count;
+};
+
+/* Two-way associative, most recently used first.  */
+#define COMMUNITY_LIST_VERDICTS 4096
+
+/* Lists with no more entries before any catch-all are simply walked.  */
+#define COMMUNITY_LIST_WALK_MAX 4
+
+struct community_list_verdict
+{
+  struct community *com;	/* Private copy.  */
+  unsigned int key;
+  int match;
+};
+
+struct community_list_cache
+{
+  u_char style;
+
+  /* Entries by position, and the first one matching any community.  */
+  int nentries;
+  struct community_entry **entries;
+  int any;
+
+  /* Standard lists: open addressed value table and, per value, the
+     ascending positions of the entries including it.  */
+  u_int32_t mask;
+  struct community_list_value *values;
+  u_int32_t *pos;
+  struct community_list_hit *hits;
+  unsigned int gen;
+
+  /* Expanded lists.  */
+  int null_match;
+  struct community_list_verdict *verdicts;
+};
+
 /* Free community-list.  */
 static void
 community_list_free (struct community_list *list)
@@ -102,6 +156,34 @@ community_list_free (struct community_list *list)
   XFREE (MTYPE_COMMUNITY_LIST, list);
 }
 
+static void
+community_list_cache_free (struct community_list *list)
+{
+  struct community_list_cache *cache = list->cache;
+  int i;
+
+  if (! cache)
+    return;
+
+  if (cache->verdicts)
+    {
+      for (i = 0; i < COMMUNITY_LIST_VERDICTS; i++)
+	if (cache->verdicts[i].com)
+	  community_free (cache->verdicts[i].com);
+      XFREE (MTYPE_COMMUNITY_LIST_CACHE, cache->verdicts);
+    }
+  if (cache->values)
+    XFREE (MTYPE_COMMUNITY_LIST_CACHE, cache->values);
+  if (cache->pos)
+    XFREE (MTYPE_COMMUNITY_LIST_CACHE, cache->pos);
+  if (cache->hits)
+    XFREE (MTYPE_COMMUNITY_LIST_CACHE, cache->hits);
+  if (cache->entries)
+    XFREE (MTYPE_COMMUNITY_LIST_CACHE, cache->entries);
+  XFREE (MTYPE_COMMUNITY_LIST_CACHE, cache);
+  list->cache = NULL;
+}
+
 static struct community_list *
 community_list_insert (struct community_list_handler *ch,
 		       const char *name, int master)
@@ -238,6 +320,8 @@ community_list_delete (struct community_list *list)
   struct community_list_list *clist;
   struct community_entry *entry, *next;
 
+  community_list_cache_free (list);
+
   for (entry = list->head; entry; entry = next)
     {
       next = entry->next;
@@ -270,6 +354,8 @@ static void
 community_list_entry_add (struct community_list *list,
                           struct community_entry *entry)
 {
+  community_list_cache_free (list);
+
   entry->next = NULL;
   entry->prev = list->tail;
 
@@ -285,6 +371,8 @@ static void
 community_list_entry_delete (struct community_list *list,
                              struct community_entry *entry, int style)
 {
+  community_list_cache_free (list);
+
   if (entry->next)
     entry->next->prev = entry->prev;
   else
@@ -517,32 +605,275 @@ community_regexp_delete (struct community *com, regex_t * reg)
 }
 #endif
 
-/* When given community attribute matches to the community-list return
-   1 else return 0.  */
-int
-community_list_match (struct community *com, struct community_list *list)
+struct community_list_pair
+{
+  u_int32_t val;
+  u_int32_t pos;
+};
+
+static int
+community_list_pair_cmp (const void *p1, const void *p2)
 {
+  const struct community_list_pair *a = p1;
+  const struct community_list_pair *b = p2;
+
+  if (a->val != b->val)
+    return a->val < b->val ? -1 : 1;
+  return a->pos < b->pos ? -1 : (a->pos > b->pos);
+}
+
+static struct community_list_value *
+community_list_value_lookup (struct community_list_cache *cache,
+			     u_int32_t val)
+{
+  struct community_list_value *v;
+  u_int32_t i;
+
+  for (i = jhash_1word (val, 0) & cache->mask; ; i = (i + 1) & cache->mask)
+    {
+      v = &cache->values[i];
+      if (v->count == 0)
+	return NULL;
+      if (v->val == val)
+	return v;
+    }
+}
+
+static void
+community_list_cache_values (struct community_list_cache *cache)
+{
+  struct community_list_pair *pairs;
+  struct community_list_value *v;
+  struct community *ecom;
+  int npairs = 0, nvalues = 0;
+  int i, j;
+
+  /* Entries from the first one matching anything on need no lookup.  */
+  for (i = 0; i < cache->any; i++)
+    npairs += cache->entries[i]->u.com->size;
+
+  pairs = XMALLOC (MTYPE_COMMUNITY_LIST_CACHE,
+		   (npairs + 1) * sizeof (struct community_list_pair));
+  for (npairs = 0, i = 0; i < cache->any; i++)
+    {
+      ecom = cache->entries[i]->u.com;
+      for (j = 0; j < ecom->size; j++)
+	{
+	  memcpy (&pairs[npairs].val, com_nthval (ecom, j), sizeof (u_int32_t));
+	  pairs[npairs++].pos = i;
+	}
+    }
+  qsort (pairs, npairs, sizeof (struct community_list_pair),
+	 community_list_pair_cmp);
+
+  for (i = 0; i < npairs; i++)
+    if (i == 0 || pairs[i].val != pairs[i - 1].val)
+      nvalues++;
+
+  for (cache->mask = 1; cache->mask < 2 * (u_int32_t) nvalues; )
+    cache->mask <<= 1;
+  cache->values = XCALLOC (MTYPE_COMMUNITY_LIST_CACHE,
+			   cache->mask * sizeof (struct community_list_value));
+  cache->mask--;
+  cache->pos = XMALLOC (MTYPE_COMMUNITY_LIST_CACHE,
+			(npairs + 1) * sizeof (u_int32_t));
+
+  for (i = 0; i < npairs; i = j)
+    {
+      for (j = jhash_1word (pairs[i].val, 0) & cache->mask;
+	   cache->values[j].count;
+	   j = (j + 1) & cache->mask)
+	;
+      v = &cache->values[j];
+      v->val = pairs[i].val;
+      v->first = i;
+      for (j = i; j < npairs && pairs[j].val == v->val; j++)
+	cache->pos[j] = pairs[j].pos;
+      v->count = j - i;
+    }
+
+  XFREE (MTYPE_COMMUNITY_LIST_CACHE, pairs);
+}
+
+static struct community_list_cache *
+community_list_cache_get (struct community_list *list)
+{
+  struct community_list_cache *cache;
   struct community_entry *entry;
+  int i;
+
+  if (list->cache)
+    return list->cache;
+
+  cache = XCALLOC (MTYPE_COMMUNITY_LIST_CACHE,
+		   sizeof (struct community_list_cache));
+  cache->style = list->head->style;
 
   for (entry = list->head; entry; entry = entry->next)
+    cache->nentries++;
+  cache->entries = XCALLOC (MTYPE_COMMUNITY_LIST_CACHE,
+			    cache->nentries * sizeof (struct community_entry *));
+  cache->any = cache->nentries;
+  for (i = 0, entry = list->head; entry; i++, entry = entry->next)
     {
-      if (entry->any)
-        return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
+      cache->entries[i] = entry;
+      if (cache->any == cache->nentries
+	  && (entry->any
+	      || (entry->style == COMMUNITY_LIST_STANDARD
+		  && community_include (entry->u.com, COMMUNITY_INTERNET))))
+	cache->any = i;
+    }
 
-      if (entry->style == COMMUNITY_LIST_STANDARD)
-        {
-          if (community_include (entry->u.com, COMMUNITY_INTERNET))
-            return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
+  if (cache->style == COMMUNITY_LIST_STANDARD)
+    {
+      community_list_cache_values (cache);
+      cache->hits = XCALLOC (MTYPE_COMMUNITY_LIST_CACHE,
+			     cache->nentries
+			     * sizeof (struct community_list_hit));
+    }
+  else
+    {
+      cache->null_match = -1;
+      cache->verdicts = XCALLOC (MTYPE_COMMUNITY_LIST_CACHE,
+				 COMMUNITY_LIST_VERDICTS
+				 * sizeof (struct community_list_verdict));
+    }
 
-          if (community_match (com, entry->u.com))
-            return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
-        }
-      else if (entry->style == COMMUNITY_LIST_EXPANDED)
-        {
-          if (community_regexp_match (com, entry->reg))
-            return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
-        }
+  list->cache = cache;
+  return cache;
+}
+
+/* First entry of a standard community-list including all of com's
+   values, or equal to com when exact, NULL if none.  Relies on com
+   being sorted and unique, as interned communities are.  */
+static struct community_entry *
+community_list_standard_lookup (struct community_list_cache *cache,
+				struct community *com, int exact)
+{
+  struct community_list_value *v;
+  struct community_list_hit *hit;
+  u_int32_t val, prev = 0;
+  u_int32_t n;
+  int best = cache->any;
+  int i, size;
+
+  if (best <= COMMUNITY_LIST_WALK_MAX)
+    {
+      for (i = 0; i < best; i++)
+	if (exact ? community_cmp (com, cache->entries[i]->u.com)
+		  : community_match (com, cache->entries[i]->u.com))
+	  return cache->entries[i];
+    }
+  else if (com && com->size)
+    {
+      if (++cache->gen == 0)
+	{
+	  memset (cache->hits, 0,
+		  cache->nentries * sizeof (struct community_list_hit));
+	  cache->gen = 1;
+	}
+
+      for (i = 0; i < com->size; i++)
+	{
+	  memcpy (&val, com_nthval (com, i), sizeof (u_int32_t));
+	  if (i && val == prev)
+	    continue;
+	  prev = val;
+
+	  v = community_list_value_lookup (cache, val);
+	  if (! v)
+	    continue;
+
+	  for (n = v->first; n < v->first + v->count; n++)
+	    {
+	      if ((int) cache->pos[n] >= best)
+		break;
+
+	      hit = &cache->hits[cache->pos[n]];
+	      if (hit->gen != cache->gen)
+		{
+		  hit->gen = cache->gen;
+		  hit->count = 0;
+		}
+
+	      size = cache->entries[cache->pos[n]]->u.com->size;
+	      if (++hit->count == size && (! exact || com->size == size))
+		best = cache->pos[n];
+	    }
+	}
+    }
+
+  return best < cache->nentries ? cache->entries[best] : NULL;
+}
+
+/* Matching against an expanded community-list, exact or not.  */
+static int
+community_list_expanded_match (struct community_list_cache *cache,
+			       struct community *com)
+{
+  struct community_list_verdict *verdict = NULL;
+  struct community_list_verdict tmp;
+  unsigned int key = 0;
+  int i, match = 0;
+
+  if (com && com->size)
+    {
+      key = community_hash_make (com);
+      verdict = &cache->verdicts[key % (COMMUNITY_LIST_VERDICTS / 2) * 2];
+      for (i = 0; i < 2; i++)
+	if (verdict[i].com && verdict[i].key == key
+	    && community_cmp (verdict[i].com, com))
+	  {
+	    if (i)
+	      {
+		tmp = verdict[0];
+		verdict[0] = verdict[1];
+		verdict[1] = tmp;
+	      }
+	    return verdict[0].match;
+	  }
+    }
+  else if (cache->null_match >= 0)
+    return cache->null_match;
+
+  for (i = 0; i < cache->nentries; i++)
+    if (cache->entries[i]->any
+	|| community_regexp_match (com, cache->entries[i]->reg))
+      {
+	match = cache->entries[i]->direct == COMMUNITY_PERMIT ? 1 : 0;
+	break;
+      }
+
+  if (com && com->size)
+    {
+      if (verdict[1].com)
+	community_free (verdict[1].com);
+      verdict[1] = verdict[0];
+      verdict->com = community_dup (com);
+      verdict->key = key;
+      verdict->match = match;
     }
+  else
+    cache->null_match = match;
+
+  return match;
+}
+
+/* When given community attribute matches to the community-list return
+   1 else return 0.  */
+int
+community_list_match (struct community *com, struct community_list *list)
+{
+  struct community_list_cache *cache;
+  struct community_entry *entry;
+
+  cache = community_list_cache_get (list);
+  if (cache->style == COMMUNITY_LIST_EXPANDED)
+    return community_list_expanded_match (cache, com);
+
+  entry = community_list_standard_lookup (cache, com, 0);
+  if (entry)
+    return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
   return 0;
 }
 
@@ -576,27 +907,16 @@ int
 community_list_exact_match (struct community *com,
                             struct community_list *list)
 {
+  struct community_list_cache *cache;
   struct community_entry *entry;
 
-  for (entry = list->head; entry; entry = entry->next)
-    {
-      if (entry->any)
-        return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
-
-      if (entry->style == COMMUNITY_LIST_STANDARD)
-        {
-          if (community_include (entry->u.com, COMMUNITY_INTERNET))
-            return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
+  cache = community_list_cache_get (list);
+  if (cache->style == COMMUNITY_LIST_EXPANDED)
+    return community_list_expanded_match (cache, com);
 
-          if (community_cmp (com, entry->u.com))
-            return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
-        }
-      else if (entry->style == COMMUNITY_LIST_EXPANDED)
-        {
-          if (community_regexp_match (com, entry->reg))
-            return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
-        }
-    }
+  entry = community_list_standard_lookup (cache, com, 1);
+  if (entry)
+    return entry->direct == COMMUNITY_PERMIT ? 1 : 0;
   return 0;
 }
 
@@ -605,11 +925,15 @@ struct community *
 community_list_match_delete (struct community *com,
                              struct community_list *list)
 {
+  struct community_list_cache *cache;
+  struct community_list_value *v;
   struct community_entry *entry;
   u_int32_t val;
   u_int32_t com_index_to_delete[com->size];
   int delete_index = 0;
-  int i;
+  int i, n;
+
+  cache = community_list_cache_get (list);
 
   /* Loop over each community value and evaluate each against the
    * community-list.  If we need to delete a community value add its index to
@@ -617,6 +941,20 @@ community_list_match_delete (struct community *com,
    */
   for (i = 0; i < com->size; i++)
     {
+      /* The first standard entry including the value decides.  */
+      if (cache->style == COMMUNITY_LIST_STANDARD)
+        {
+          memcpy (&val, com_nthval (com, i), sizeof (u_int32_t));
+          v = community_list_value_lookup (cache, val);
+          n = cache->any;
+          if (v && (int) cache->pos[v->first] < n)
+            n = cache->pos[v->first];
+          if (n < cache->nentries
+              && cache->entries[n]->direct == COMMUNITY_PERMIT)
+            com_index_to_delete[delete_index++] = i;
+          continue;
+        }
+
       val = community_val_get (com, i);
 
       for (entry = list->head; entry; entry = entry->next)
@@ -58,6 +58,10 @@ struct community_list
   /* Community-list entry in this community-list.  */
   struct community_entry *head;
   struct community_entry *tail;
+
+  /* Lookup structures built from the entries on first match, dropped
+     whenever an entry is added or deleted.  */
+  struct community_list_cache *cache;
 };
 
 /* Each entry in community-list.  */
@@ -36,62 +36,73 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "bgpd/bgp_attr.h" 
 #include "bgpd/bgp_advertise.h"
 
-/* Global variable to access damping configuration */
-struct bgp_damp_config bgp_damp_cfg;
-static struct bgp_damp_config *damp = &bgp_damp_cfg;
-
 /* Utility macro to add and delete BGP dampening information to no
    used list.  */
 #define BGP_DAMP_LIST_ADD(N,A)  BGP_INFO_ADD(N,A,no_reuse_list)
 #define BGP_DAMP_LIST_DEL(N,A)  BGP_INFO_DEL(N,A,no_reuse_list)
 
-/* Calculate reuse list index by penalty value.  */
+static int bgp_reuse_timer (struct thread *);
+
+/* Calculate reuse list index by penalty value: the slot of the reuse
+   timer tick at which the penalty will have decayed to the reuse
+   limit.  */
 static int
-bgp_reuse_index (int penalty)
+bgp_reuse_index (struct bgp_damp_config *bdc, unsigned int penalty)
 {
-  unsigned int i;
-  int index;
+  unsigned int i = 0;
 
-  i = (int)(((double) penalty / damp->reuse_limit - 1.0) * damp->scale_factor);
-  
-  if ( i >= damp->reuse_index_size )
-    i = damp->reuse_index_size - 1;
+  if (penalty > bdc->reuse_limit)
+    i = (unsigned int) ((double) bdc->half_life / DELTA_REUSE
+			* log2 ((double) penalty / bdc->reuse_limit));
 
-  index = damp->reuse_index[i] - damp->reuse_index[0];
+  if (i >= bdc->reuse_list_size)
+    i = bdc->reuse_list_size - 1;
 
-  return (damp->reuse_offset + index) % damp->reuse_list_size;  
+  return (bdc->reuse_offset + i) % bdc->reuse_list_size;
 }
 
 /* Add BGP dampening information to reuse list.  */
 static void 
 bgp_reuse_list_add (struct bgp_damp_info *bdi)
 {
+  struct bgp_damp_config *bdc = bdi->config;
   int index;
 
-  index = bdi->index = bgp_reuse_index (bdi->penalty);
+  index = bdi->index = bgp_reuse_index (bdc, bdi->penalty);
 
   bdi->prev = NULL;
-  bdi->next = damp->reuse_list[index];
-  if (damp->reuse_list[index])
-    damp->reuse_list[index]->prev = bdi;
-  damp->reuse_list[index] = bdi;
+  bdi->next = bdc->reuse_list[index];
+  if (bdc->reuse_list[index])
+    bdc->reuse_list[index]->prev = bdi;
+  bdc->reuse_list[index] = bdi;
+  bdc->reuse_count++;
+
+  /* The reuse timer only runs while there is something to reuse.  */
+  if (! bdc->t_reuse)
+    bdc->t_reuse =
+      thread_add_timer (bm->master, bgp_reuse_timer, bdc, DELTA_REUSE);
 }
 
 /* Delete BGP dampening information from reuse list.  */
 static void
 bgp_reuse_list_delete (struct bgp_damp_info *bdi)
 {
+  struct bgp_damp_config *bdc = bdi->config;
+
   if (bdi->next)
     bdi->next->prev = bdi->prev;
   if (bdi->prev)
     bdi->prev->next = bdi->next;
   else
-    damp->reuse_list[bdi->index] = bdi->next;
+    bdc->reuse_list[bdi->index] = bdi->next;
+
+  if (bdi->index != (int) bdc->reuse_list_size)
+    bdc->reuse_count--;
 }   
 
 /* Return decayed penalty value.  */
 int 
-bgp_damp_decay (time_t tdiff, int penalty)
+bgp_damp_decay (time_t tdiff, int penalty, struct bgp_damp_config *bdc)
 {
   unsigned int i;
 
@@ -100,54 +111,48 @@ bgp_damp_decay (time_t tdiff, int penalty)
   if (i == 0)
     return penalty; 
   
-  if (i >= damp->decay_array_size)
+  if (i >= bdc->decay_array_size)
     return 0;
 
-  return (int) (penalty * damp->decay_array[i]);
+  return (int) (penalty * bdc->decay_array[i]);
 }
 
-/* Handler of reuse timer event.  Each route in the current reuse-list
-   is evaluated.  RFC2439 Section 4.8.7.  */
+/* Reuse a batch of the routes which have come due.  Each one is
+   evaluated as in RFC2439 Section 4.8.7, at most BGP_DAMP_REUSE_BATCH
+   at a time so that a flap storm coming due does not hold up the
+   rest of bgpd.  */
 static int
-bgp_reuse_timer (struct thread *t)
+bgp_reuse_batch (struct thread *t)
 {
+  struct bgp_damp_config *bdc = THREAD_ARG (t);
+  struct bgp *bgp = bdc->bgp;
   struct bgp_damp_info *bdi;
-  struct bgp_damp_info *next;
   time_t t_now, t_diff;
-    
-  damp->t_reuse = NULL;
-  damp->t_reuse =
-    thread_add_timer (bm->master, bgp_reuse_timer, NULL, DELTA_REUSE);
+  unsigned int count;
 
-  t_now = bgp_clock ();
-
-  /* 1.  save a pointer to the current zeroth queue head and zero the
-     list head entry.  */
-  bdi = damp->reuse_list[damp->reuse_offset];
-  damp->reuse_list[damp->reuse_offset] = NULL;
+  bdc->t_reuse_batch = NULL;
 
-  /* 2.  set offset = modulo reuse-list-size ( offset + 1 ), thereby
-     rotating the circular queue of list-heads.  */
-  damp->reuse_offset = (damp->reuse_offset + 1) % damp->reuse_list_size;
+  t_now = bgp_clock ();
 
-  /* 3. if ( the saved list head pointer is non-empty ) */
-  for (; bdi; bdi = next)
+  for (count = 0; count < BGP_DAMP_REUSE_BATCH; count++)
     {
-      struct bgp *bgp = bdi->binfo->peer->bgp;
-      
-      next = bdi->next;
+      bdi = bdc->reuse_list[bdc->reuse_list_size];
+      if (! bdi)
+	break;
+
+      bgp_reuse_list_delete (bdi);
 
       /* Set t-diff = t-now - t-updated.  */
       t_diff = t_now - bdi->t_updated;
 
       /* Set figure-of-merit = figure-of-merit * decay-array-ok [t-diff] */
-      bdi->penalty = bgp_damp_decay (t_diff, bdi->penalty);   
+      bdi->penalty = bgp_damp_decay (t_diff, bdi->penalty, bdc);
 
       /* Set t-updated = t-now.  */
       bdi->t_updated = t_now;
 
       /* if (figure-of-merit < reuse).  */
-      if (bdi->penalty < damp->reuse_limit)
+      if (bdi->penalty < bdc->reuse_limit)
 	{
 	  /* Reuse the route.  */
 	  bgp_info_unset_flag (bdi->rn, bdi->binfo, BGP_INFO_DAMPED);
@@ -161,16 +166,77 @@ bgp_reuse_timer (struct thread *t)
 	      bgp_process (bgp, bdi->rn, bdi->afi, bdi->safi);
 	    }
 
-	  if (bdi->penalty <= damp->reuse_limit / 2.0)
+	  if (bdi->penalty <= bdc->reuse_limit / 2.0)
 	    bgp_damp_info_free (bdi, 1);
 	  else
-	    BGP_DAMP_LIST_ADD (damp, bdi);
+	    BGP_DAMP_LIST_ADD (bdc, bdi);
 	}
       else
 	/* Re-insert into another list (See RFC2439 Section 4.8.6).  */
 	bgp_reuse_list_add (bdi);
     }
 
+  if (bdc->reuse_list[bdc->reuse_list_size])
+    bdc->t_reuse_batch =
+      thread_add_background (bm->master, bgp_reuse_batch, bdc, 0);
+
+  return 0;
+}
+
+/* Rotate the reuse lists by one slot, moving the routes in the
+   current one to the pending list worked through by bgp_reuse_batch.  */
+void
+bgp_damp_reuse_tick (struct bgp_damp_config *bdc)
+{
+  struct bgp_damp_info *head, *bdi, *last = NULL;
+  struct bgp_damp_info **pending;
+
+  pending = &bdc->reuse_list[bdc->reuse_list_size];
+
+  /* 1.  save a pointer to the current zeroth queue head and zero the
+     list head entry.  */
+  head = bdc->reuse_list[bdc->reuse_offset];
+  bdc->reuse_list[bdc->reuse_offset] = NULL;
+
+  /* 2.  set offset = modulo reuse-list-size ( offset + 1 ), thereby
+     rotating the circular queue of list-heads.  */
+  bdc->reuse_offset = (bdc->reuse_offset + 1) % bdc->reuse_list_size;
+
+  /* 3. if ( the saved list head pointer is non-empty ), queue it.  */
+  if (! head)
+    return;
+
+  for (bdi = head; bdi; bdi = bdi->next)
+    {
+      bdi->index = bdc->reuse_list_size;
+      bdc->reuse_count--;
+      last = bdi;
+    }
+
+  last->next = *pending;
+  if (*pending)
+    (*pending)->prev = last;
+  *pending = head;
+
+  if (! bdc->t_reuse_batch)
+    bdc->t_reuse_batch =
+      thread_add_background (bm->master, bgp_reuse_batch, bdc, 0);
+}
+
+/* Handler of reuse timer event.  */
+static int
+bgp_reuse_timer (struct thread *t)
+{
+  struct bgp_damp_config *bdc = THREAD_ARG (t);
+
+  bdc->t_reuse = NULL;
+
+  bgp_damp_reuse_tick (bdc);
+
+  if (bdc->reuse_count)
+    bdc->t_reuse =
+      thread_add_timer (bm->master, bgp_reuse_timer, bdc, DELTA_REUSE);
+
   return 0;
 }
 
@@ -180,6 +246,7 @@ bgp_damp_withdraw (struct bgp_info *binfo, struct bgp_node *rn,
 		   afi_t afi, safi_t safi, int attr_change)
 {
   time_t t_now;
+  struct bgp_damp_config *bdc = binfo->peer->bgp->damp[afi][safi];
   struct bgp_damp_info *bdi = NULL;
   double last_penalty = 0;
   
@@ -208,8 +275,9 @@ bgp_damp_withdraw (struct bgp_info *binfo, struct bgp_node *rn,
       bdi->index = -1;
       bdi->afi = afi;
       bdi->safi = safi;
+      bdi->config = bdc;
       (bgp_info_extra_get (binfo))->damp_info = bdi;
-      BGP_DAMP_LIST_ADD (damp, bdi);
+      BGP_DAMP_LIST_ADD (bdc, bdi);
     }
   else
     {
@@ -217,11 +285,11 @@ bgp_damp_withdraw (struct bgp_info *binfo, struct bgp_node *rn,
 
       /* 1. Set t-diff = t-now - t-updated.  */
       bdi->penalty = 
-	(bgp_damp_decay (t_now - bdi->t_updated, bdi->penalty) 
+	(bgp_damp_decay (t_now - bdi->t_updated, bdi->penalty, bdc) 
 	 + (attr_change ? DEFAULT_PENALTY / 2 : DEFAULT_PENALTY));
 
-      if (bdi->penalty > damp->ceiling)
-	bdi->penalty = damp->ceiling;
+      if (bdi->penalty > bdc->ceiling)
+	bdi->penalty = bdc->ceiling;
 
       bdi->flap++;
     }
@@ -248,11 +316,11 @@ bgp_damp_withdraw (struct bgp_info *binfo, struct bgp_node *rn,
 
   /* If not suppressed before, do annonunce this withdraw and
      insert into reuse_list.  */
-  if (bdi->penalty >= damp->suppress_value)
+  if (bdi->penalty >= bdc->suppress_value)
     {
       bgp_info_set_flag (rn, binfo, BGP_INFO_DAMPED);
       bdi->suppress_time = t_now;
-      BGP_DAMP_LIST_DEL (damp, bdi);
+      BGP_DAMP_LIST_DEL (bdc, bdi);
       bgp_reuse_list_add (bdi);
     }
 
@@ -264,34 +332,37 @@ bgp_damp_update (struct bgp_info *binfo, struct bgp_node *rn,
 		 afi_t afi, safi_t safi)
 {
   time_t t_now;
+  struct bgp_damp_config *bdc;
   struct bgp_damp_info *bdi;
   int status;
 
   if (!binfo->extra || !((bdi = binfo->extra->damp_info)))
     return BGP_DAMP_USED;
 
+  bdc = bdi->config;
+
   t_now = bgp_clock ();
   bgp_info_unset_flag (rn, binfo, BGP_INFO_HISTORY);
 
   bdi->lastrecord = BGP_RECORD_UPDATE;
-  bdi->penalty = bgp_damp_decay (t_now - bdi->t_updated, bdi->penalty);
+  bdi->penalty = bgp_damp_decay (t_now - bdi->t_updated, bdi->penalty, bdc);
 
   if (! CHECK_FLAG (bdi->binfo->flags, BGP_INFO_DAMPED)
-      && (bdi->penalty < damp->suppress_value))
+      && (bdi->penalty < bdc->suppress_value))
     status = BGP_DAMP_USED;
   else if (CHECK_FLAG (bdi->binfo->flags, BGP_INFO_DAMPED)
-	   && (bdi->penalty < damp->reuse_limit) )
+	   && (bdi->penalty < bdc->reuse_limit) )
     {
       bgp_info_unset_flag (rn, binfo, BGP_INFO_DAMPED);
       bgp_reuse_list_delete (bdi);
-      BGP_DAMP_LIST_ADD (damp, bdi);
+      BGP_DAMP_LIST_ADD (bdc, bdi);
       bdi->suppress_time = 0;
       status = BGP_DAMP_USED;
     }
   else
     status = BGP_DAMP_SUPPRESSED;  
 
-  if (bdi->penalty > damp->reuse_limit / 2.0)
+  if (bdi->penalty > bdc->reuse_limit / 2.0)
     bdi->t_updated = t_now;
   else
     bgp_damp_info_free (bdi, 0);
@@ -304,23 +375,25 @@ int
 bgp_damp_scan (struct bgp_info *binfo, afi_t afi, safi_t safi)
 {
   time_t t_now, t_diff;
+  struct bgp_damp_config *bdc;
   struct bgp_damp_info *bdi;
   
   assert (binfo->extra && binfo->extra->damp_info);
   
   t_now = bgp_clock ();
   bdi = binfo->extra->damp_info;
+  bdc = bdi->config;
  
   if (CHECK_FLAG (binfo->flags, BGP_INFO_DAMPED))
     {
       t_diff = t_now - bdi->suppress_time;
 
-      if (t_diff >= damp->max_suppress_time)
+      if (t_diff >= bdc->max_suppress_time)
         {
           bgp_info_unset_flag (bdi->rn, binfo, BGP_INFO_DAMPED);
           bgp_reuse_list_delete (bdi);
-	  BGP_DAMP_LIST_ADD (damp, bdi);
-          bdi->penalty = damp->reuse_limit;
+	  BGP_DAMP_LIST_ADD (bdc, bdi);
+          bdi->penalty = bdc->reuse_limit;
           bdi->suppress_time = 0;
           bdi->t_updated = t_now;
           
@@ -334,9 +407,9 @@ bgp_damp_scan (struct bgp_info *binfo, afi_t afi, safi_t safi)
   else
     {
       t_diff = t_now - bdi->t_updated;
-      bdi->penalty = bgp_damp_decay (t_diff, bdi->penalty);
+      bdi->penalty = bgp_damp_decay (t_diff, bdi->penalty, bdc);
 
-      if (bdi->penalty <= damp->reuse_limit / 2.0)
+      if (bdi->penalty <= bdc->reuse_limit / 2.0)
         {
           /* release the bdi, bdi->binfo. */  
           bgp_damp_info_free (bdi, 1);
@@ -351,18 +424,20 @@ bgp_damp_scan (struct bgp_info *binfo, afi_t afi, safi_t safi)
 void
 bgp_damp_info_free (struct bgp_damp_info *bdi, int withdraw)
 {
+  struct bgp_damp_config *bdc;
   struct bgp_info *binfo;
 
   if (! bdi)
     return;
 
+  bdc = bdi->config;
   binfo = bdi->binfo;
   binfo->extra->damp_info = NULL;
 
   if (CHECK_FLAG (binfo->flags, BGP_INFO_DAMPED))
     bgp_reuse_list_delete (bdi);
   else
-    BGP_DAMP_LIST_DEL (damp, bdi);
+    BGP_DAMP_LIST_DEL (bdc, bdi);
 
   bgp_info_unset_flag (bdi->rn, binfo, BGP_INFO_HISTORY|BGP_INFO_DAMPED);
 
@@ -373,189 +448,181 @@ bgp_damp_info_free (struct bgp_damp_info *bdi, int withdraw)
 }
 
 static void
-bgp_damp_parameter_set (int hlife, int reuse, int sup, int maxsup)
+bgp_damp_parameter_set (struct bgp_damp_config *bdc, int hlife, int reuse,
+			int sup, int maxsup)
 {
-  double reuse_max_ratio;
   unsigned int i;
-  double j;
 	
-  damp->suppress_value = sup;
-  damp->half_life = hlife;
-  damp->reuse_limit = reuse;
-  damp->max_suppress_time = maxsup;
+  bdc->suppress_value = sup;
+  bdc->half_life = hlife;
+  bdc->reuse_limit = reuse;
+  bdc->max_suppress_time = maxsup;
 
-  /* Initialize params per bgp_damp_config. */
-  damp->reuse_index_size = REUSE_ARRAY_SIZE;
-
-  damp->ceiling = (int)(damp->reuse_limit * (pow(2, (double)damp->max_suppress_time/damp->half_life))); 
+  bdc->ceiling = (int)(bdc->reuse_limit * (pow(2, (double)bdc->max_suppress_time/bdc->half_life))); 
 
   /* Decay-array computations */
-  damp->decay_array_size = ceil ((double) damp->max_suppress_time / DELTA_T);
-  damp->decay_array = XMALLOC (MTYPE_BGP_DAMP_ARRAY,
-			       sizeof(double) * (damp->decay_array_size));
-  damp->decay_array[0] = 1.0;
-  damp->decay_array[1] = exp ((1.0/((double)damp->half_life/DELTA_T)) * log(0.5));
+  bdc->decay_array_size = ceil ((double) bdc->max_suppress_time / DELTA_T);
+  bdc->decay_array = XMALLOC (MTYPE_BGP_DAMP_ARRAY,
+			      sizeof(double) * (bdc->decay_array_size));
+  bdc->decay_array[0] = 1.0;
+  bdc->decay_array[1] = exp ((1.0/((double)bdc->half_life/DELTA_T)) * log(0.5));
 
   /* Calculate decay values for all possible times */
-  for (i = 2; i < damp->decay_array_size; i++)
-    damp->decay_array[i] = damp->decay_array[i-1] * damp->decay_array[1];
+  for (i = 2; i < bdc->decay_array_size; i++)
+    bdc->decay_array[i] = bdc->decay_array[i-1] * bdc->decay_array[1];
 	
-  /* Reuse-list computations */
-  i = ceil ((double)damp->max_suppress_time / DELTA_REUSE) + 1;
+  /* Reuse-list computations, plus the pending list at the end. */
+  i = ceil ((double)bdc->max_suppress_time / DELTA_REUSE) + 1;
   if (i > REUSE_LIST_SIZE || i == 0)
     i = REUSE_LIST_SIZE;
-  damp->reuse_list_size = i; 
-
-  damp->reuse_list = XCALLOC (MTYPE_BGP_DAMP_ARRAY, 
-			      damp->reuse_list_size 
-			      * sizeof (struct bgp_reuse_node *));
-
-  /* Reuse-array computations */
-  damp->reuse_index = XCALLOC (MTYPE_BGP_DAMP_ARRAY,
-			       sizeof(int) * damp->reuse_index_size);
-
-  reuse_max_ratio = (double)damp->ceiling/damp->reuse_limit;
-  j = (exp((double)damp->max_suppress_time/damp->half_life) * log10(2.0));
-  if ( reuse_max_ratio > j && j != 0 )
-    reuse_max_ratio = j;
+  bdc->reuse_list_size = i; 
 
-  damp->scale_factor = (double)damp->reuse_index_size/(reuse_max_ratio - 1);
-
-  for (i = 0; i < damp->reuse_index_size; i++)
-    {
-      damp->reuse_index[i] = 
-	(int)(((double)damp->half_life / DELTA_REUSE)
-	      * log10 (1.0 / (damp->reuse_limit * ( 1.0 + ((double)i/damp->scale_factor)))) / log10(0.5));
-    }
+  bdc->reuse_list = XCALLOC (MTYPE_BGP_DAMP_ARRAY, 
+			     (bdc->reuse_list_size + 1)
+			     * sizeof (struct bgp_damp_info *));
 }
 
 int
 bgp_damp_enable (struct bgp *bgp, afi_t afi, safi_t safi, time_t half,
 		 unsigned int reuse, unsigned int suppress, time_t max)
 {
+  struct bgp_damp_config *bdc;
+
   if (CHECK_FLAG (bgp->af_flags[afi][safi], BGP_CONFIG_DAMPENING))
     {
-      if (damp->half_life == half
-	  && damp->reuse_limit == reuse
-	  && damp->suppress_value == suppress
-	  && damp->max_suppress_time == max)
+      bdc = bgp->damp[afi][safi];
+      if (bdc->half_life == half
+	  && bdc->reuse_limit == reuse
+	  && bdc->suppress_value == suppress
+	  && bdc->max_suppress_time == max)
 	return 0;
       bgp_damp_disable (bgp, afi, safi);
     }
 
-  SET_FLAG (bgp->af_flags[afi][safi], BGP_CONFIG_DAMPENING);
-  bgp_damp_parameter_set (half, reuse, suppress, max);
+  bdc = XCALLOC (MTYPE_BGP_DAMP_CONFIG, sizeof (struct bgp_damp_config));
+  bdc->bgp = bgp;
+  bdc->afi = afi;
+  bdc->safi = safi;
+  bgp_damp_parameter_set (bdc, half, reuse, suppress, max);
 
-  /* Register reuse timer.  */
-  if (! damp->t_reuse)
-    damp->t_reuse = 
-      thread_add_timer (bm->master, bgp_reuse_timer, NULL, DELTA_REUSE);
+  bgp->damp[afi][safi] = bdc;
+  SET_FLAG (bgp->af_flags[afi][safi], BGP_CONFIG_DAMPENING);
 
   return 0;
 }
 
 static void
-bgp_damp_config_clean (struct bgp_damp_config *damp)
+bgp_damp_config_clean (struct bgp_damp_config *bdc)
 {
   /* Free decay array */
-  XFREE (MTYPE_BGP_DAMP_ARRAY, damp->decay_array);
-
-  /* Free reuse index array */
-  XFREE (MTYPE_BGP_DAMP_ARRAY, damp->reuse_index);
+  XFREE (MTYPE_BGP_DAMP_ARRAY, bdc->decay_array);
 
   /* Free reuse list array. */
-  XFREE (MTYPE_BGP_DAMP_ARRAY, damp->reuse_list);
+  XFREE (MTYPE_BGP_DAMP_ARRAY, bdc->reuse_list);
 }
 
 /* Clean all the bgp_damp_info stored in reuse_list. */
 void
-bgp_damp_info_clean (void)
+bgp_damp_info_clean (struct bgp *bgp, afi_t afi, safi_t safi)
 {
+  struct bgp_damp_config *bdc = bgp->damp[afi][safi];
   unsigned int i;
   struct bgp_damp_info *bdi, *next;
 
-  damp->reuse_offset = 0;
+  if (! bdc)
+    return;
+
+  bdc->reuse_offset = 0;
 
-  for (i = 0; i < damp->reuse_list_size; i++)
+  for (i = 0; i <= bdc->reuse_list_size; i++)
     {
-      if (! damp->reuse_list[i])
+      if (! bdc->reuse_list[i])
 	continue;
 
-      for (bdi = damp->reuse_list[i]; bdi; bdi = next)
+      for (bdi = bdc->reuse_list[i]; bdi; bdi = next)
 	{
 	  next = bdi->next;
 	  bgp_damp_info_free (bdi, 1);
 	}
-      damp->reuse_list[i] = NULL;
+      bdc->reuse_list[i] = NULL;
     }
+  bdc->reuse_count = 0;
 
-  for (bdi = damp->no_reuse_list; bdi; bdi = next)
+  for (bdi = bdc->no_reuse_list; bdi; bdi = next)
     {
       next = bdi->next;
       bgp_damp_info_free (bdi, 1);
     }
-  damp->no_reuse_list = NULL;
+  bdc->no_reuse_list = NULL;
 }
 
 int
 bgp_damp_disable (struct bgp *bgp, afi_t afi, safi_t safi)
 {
+  struct bgp_damp_config *bdc = bgp->damp[afi][safi];
+
   /* If it wasn't enabled, there's nothing to do. */
   if (! CHECK_FLAG (bgp->af_flags[afi][safi], BGP_CONFIG_DAMPENING))
     return 0;
 
-  /* Cancel reuse thread. */
-  if (damp->t_reuse )
-    thread_cancel (damp->t_reuse);
-  damp->t_reuse = NULL;
+  /* Cancel reuse threads. */
+  THREAD_OFF (bdc->t_reuse);
+  THREAD_OFF (bdc->t_reuse_batch);
 
   /* Clean BGP dampening information.  */
-  bgp_damp_info_clean ();
+  bgp_damp_info_clean (bgp, afi, safi);
 
   /* Clear configuration */
-  bgp_damp_config_clean (&bgp_damp_cfg);
+  bgp_damp_config_clean (bdc);
+  XFREE (MTYPE_BGP_DAMP_CONFIG, bdc);
+  bgp->damp[afi][safi] = NULL;
 
   UNSET_FLAG (bgp->af_flags[afi][safi], BGP_CONFIG_DAMPENING);
   return 0;
 }
 
 void
-bgp_config_write_damp (struct vty *vty)
+bgp_config_write_damp (struct vty *vty, struct bgp *bgp, afi_t afi,
+		       safi_t safi)
 {
-  if (bgp_damp_cfg.half_life == DEFAULT_HALF_LIFE*60
-      && bgp_damp_cfg.reuse_limit == DEFAULT_REUSE
-      && bgp_damp_cfg.suppress_value == DEFAULT_SUPPRESS
-      && bgp_damp_cfg.max_suppress_time == bgp_damp_cfg.half_life*4)
-    vty_out (vty, " bgp dampening%s", VTY_NEWLINE);
-  else if (bgp_damp_cfg.half_life != DEFAULT_HALF_LIFE*60
-	   && bgp_damp_cfg.reuse_limit == DEFAULT_REUSE
-	   && bgp_damp_cfg.suppress_value == DEFAULT_SUPPRESS
-	   && bgp_damp_cfg.max_suppress_time == bgp_damp_cfg.half_life*4)
-    vty_out (vty, " bgp dampening %lld%s",
-	     bgp_damp_cfg.half_life/60LL,
+  struct bgp_damp_config *bdc = bgp->damp[afi][safi];
+  const char *indent = (afi == AFI_IP && safi == SAFI_UNICAST) ? " " : "  ";
+
+  if (bdc->half_life == DEFAULT_HALF_LIFE*60
+      && bdc->reuse_limit == DEFAULT_REUSE
+      && bdc->suppress_value == DEFAULT_SUPPRESS
+      && bdc->max_suppress_time == bdc->half_life*4)
+    vty_out (vty, "%sbgp dampening%s", indent, VTY_NEWLINE);
+  else if (bdc->half_life != DEFAULT_HALF_LIFE*60
+	   && bdc->reuse_limit == DEFAULT_REUSE
+	   && bdc->suppress_value == DEFAULT_SUPPRESS
+	   && bdc->max_suppress_time == bdc->half_life*4)
+    vty_out (vty, "%sbgp dampening %lld%s", indent,
+	     bdc->half_life/60LL,
 	     VTY_NEWLINE);
   else
-    vty_out (vty, " bgp dampening %lld %d %d %lld%s",
-	     bgp_damp_cfg.half_life/60LL,
-	     bgp_damp_cfg.reuse_limit,
-	     bgp_damp_cfg.suppress_value,
-	     bgp_damp_cfg.max_suppress_time/60LL,
+    vty_out (vty, "%sbgp dampening %lld %d %d %lld%s", indent,
+	     bdc->half_life/60LL,
+	     bdc->reuse_limit,
+	     bdc->suppress_value,
+	     bdc->max_suppress_time/60LL,
 	     VTY_NEWLINE);
 }
 
 static const char *
-bgp_get_reuse_time (unsigned int penalty, char *buf, size_t len, u_char use_json, json_object *json)
+bgp_get_reuse_time (struct bgp_damp_config *bdc, unsigned int penalty,
+		    char *buf, size_t len, u_char use_json, json_object *json)
 {
   time_t reuse_time = 0;
   struct tm *tm = NULL;
   int time_store = 0;
 
-  if (penalty > damp->reuse_limit)
+  if (penalty > bdc->reuse_limit)
     {
-      reuse_time = (int) (DELTA_T * ((log((double)damp->reuse_limit/penalty))/(log(damp->decay_array[1])))); 
+      reuse_time = (int) (DELTA_T * ((log((double)bdc->reuse_limit/penalty))/(log(bdc->decay_array[1])))); 
 
-      if (reuse_time > damp->max_suppress_time)
-	reuse_time = damp->max_suppress_time;
+      if (reuse_time > bdc->max_suppress_time)
+	reuse_time = bdc->max_suppress_time;
 
       tm = gmtime (&reuse_time);
     }
@@ -626,13 +693,13 @@ bgp_damp_info_vty (struct vty *vty, struct bgp_info *binfo,
 
   /* If dampening is not enabled or there is no dampening information,
      return immediately.  */
-  if (! damp || ! bdi)
+  if (! bdi)
     return;
 
   /* Calculate new penalty.  */
   t_now = bgp_clock ();
   t_diff = t_now - bdi->t_updated;
-  penalty = bgp_damp_decay (t_diff, bdi->penalty);
+  penalty = bgp_damp_decay (t_diff, bdi->penalty, bdi->config);
 
   if (json_path)
     {
@@ -642,7 +709,7 @@ bgp_damp_info_vty (struct vty *vty, struct bgp_info *binfo,
 
       if (CHECK_FLAG (binfo->flags, BGP_INFO_DAMPED)
           && ! CHECK_FLAG (binfo->flags, BGP_INFO_HISTORY))
-        bgp_get_reuse_time (penalty, timebuf, BGP_UPTIME_LEN, 1, json_path);
+        bgp_get_reuse_time (bdi->config, penalty, timebuf, BGP_UPTIME_LEN, 1, json_path);
     }
   else
     {
@@ -653,7 +720,7 @@ bgp_damp_info_vty (struct vty *vty, struct bgp_info *binfo,
       if (CHECK_FLAG (binfo->flags, BGP_INFO_DAMPED)
           && ! CHECK_FLAG (binfo->flags, BGP_INFO_HISTORY))
         vty_out (vty, ", reuse in %s",
-	       bgp_get_reuse_time (penalty, timebuf, BGP_UPTIME_LEN, 0, json_path));
+	       bgp_get_reuse_time (bdi->config, penalty, timebuf, BGP_UPTIME_LEN, 0, json_path));
 
       vty_out (vty, "%s", VTY_NEWLINE);
     }
@@ -675,21 +742,22 @@ bgp_damp_reuse_time_vty (struct vty *vty, struct bgp_info *binfo,
 
   /* If dampening is not enabled or there is no dampening information,
      return immediately.  */
-  if (! damp || ! bdi)
+  if (! bdi)
     return NULL;
 
   /* Calculate new penalty.  */
   t_now = bgp_clock ();
   t_diff = t_now - bdi->t_updated;
-  penalty = bgp_damp_decay (t_diff, bdi->penalty);
+  penalty = bgp_damp_decay (t_diff, bdi->penalty, bdi->config);
 
-  return  bgp_get_reuse_time (penalty, timebuf, len, use_json, json);
+  return  bgp_get_reuse_time (bdi->config, penalty, timebuf, len, use_json, json);
 }
 
 int
 bgp_show_dampening_parameters (struct vty *vty, afi_t afi, safi_t safi)
 {
   struct bgp *bgp;
+  struct bgp_damp_config *bdc;
   bgp = bgp_get_default();
 
   if (bgp == NULL)
@@ -700,16 +768,17 @@ bgp_show_dampening_parameters (struct vty *vty, afi_t afi, safi_t safi)
 
   if (CHECK_FLAG (bgp->af_flags[afi][safi], BGP_CONFIG_DAMPENING))
     {
+      bdc = bgp->damp[afi][safi];
       vty_out (vty, "Half-life time: %ld min%s",
-                    damp->half_life / 60, VTY_NEWLINE);
+                    bdc->half_life / 60, VTY_NEWLINE);
       vty_out (vty, "Reuse penalty: %d%s",
-                    damp->reuse_limit, VTY_NEWLINE);
+                    bdc->reuse_limit, VTY_NEWLINE);
       vty_out (vty, "Suppress penalty: %d%s",
-                    damp->suppress_value, VTY_NEWLINE);
+                    bdc->suppress_value, VTY_NEWLINE);
       vty_out (vty, "Max suppress time: %ld min%s",
-                    damp->max_suppress_time / 60, VTY_NEWLINE);
+                    bdc->max_suppress_time / 60, VTY_NEWLINE);
       vty_out (vty, "Max supress penalty: %u%s",
-                    damp->ceiling, VTY_NEWLINE);
+                    bdc->ceiling, VTY_NEWLINE);
       vty_out (vty, "%s", VTY_NEWLINE);
     }
   else
@@ -60,6 +60,9 @@ struct bgp_damp_info
 
   afi_t afi;
   safi_t safi;
+
+  /* Dampening configuration of the route's bgp, afi and safi. */
+  struct bgp_damp_config *config;
 };
 
 /* Specified parameter set configuration. */
@@ -82,7 +85,6 @@ struct bgp_damp_config
    */
   time_t tmax;			 /* Max time previous instability retained */
   unsigned int reuse_list_size;	 /* Number of reuse lists */
-  unsigned int reuse_index_size; /* Size of reuse index array */
 
   /* Non-configurable parameters.  Most of these are calculated from
    * the configurable parameters above.
@@ -90,24 +92,30 @@ struct bgp_damp_config
   unsigned int ceiling;			/* Max value a penalty can attain */
   unsigned int decay_rate_per_tick;	/* Calculated from half-life */
   unsigned int decay_array_size; /* Calculated using config parameters */
-  double scale_factor;
-  unsigned int reuse_scale_factor; 
          
   /* Decay array per-set based. */ 
   double *decay_array;	
 
-  /* Reuse index array per-set based. */ 
-  int *reuse_index;
-
-  /* Reuse list array per-set based. */  
+  /* Reuse lists: a timer wheel of reuse_list_size slots, DELTA_REUSE
+   * seconds apart, the current one at reuse_offset.  The extra slot at
+   * reuse_list_size holds routes due for reuse but not yet processed.
+   */
   struct bgp_damp_info **reuse_list;
   int reuse_offset;
+  unsigned long reuse_count;	 /* Routes on the wheel proper */
         
   /* All dampening information which is not on reuse list.  */
   struct bgp_damp_info *no_reuse_list;
 
-  /* Reuse timer thread per-set base. */
+  /* Reuse timer thread, running while the wheel is not empty, and
+     the thread working through due routes in batches. */
   struct thread* t_reuse;
+  struct thread* t_reuse_batch;
+
+  /* Owner. */
+  struct bgp *bgp;
+  afi_t afi;
+  safi_t safi;
 };
 
 #define BGP_DAMP_NONE           0
@@ -127,7 +135,9 @@ struct bgp_damp_config
 #define DEFAULT_SUPPRESS 	2000
 
 #define REUSE_LIST_SIZE          256
-#define REUSE_ARRAY_SIZE        1024
+
+/* Routes reused per run of the reuse batch thread */
+#define BGP_DAMP_REUSE_BATCH	1000
 
 extern int bgp_damp_enable (struct bgp *, afi_t, safi_t, time_t, unsigned int, 
                      unsigned int, time_t);
@@ -137,9 +147,10 @@ extern int bgp_damp_withdraw (struct bgp_info *, struct bgp_node *,
 extern int bgp_damp_update (struct bgp_info *, struct bgp_node *, afi_t, safi_t);
 extern int bgp_damp_scan (struct bgp_info *, afi_t, safi_t);
 extern void bgp_damp_info_free (struct bgp_damp_info *, int);
-extern void bgp_damp_info_clean (void);
-extern int bgp_damp_decay (time_t, int);
-extern void bgp_config_write_damp (struct vty *);
+extern void bgp_damp_info_clean (struct bgp *, afi_t, safi_t);
+extern int bgp_damp_decay (time_t, int, struct bgp_damp_config *);
+extern void bgp_damp_reuse_tick (struct bgp_damp_config *);
+extern void bgp_config_write_damp (struct vty *, struct bgp *, afi_t, safi_t);
 extern void bgp_damp_info_vty (struct vty *, struct bgp_info *, json_object *json_path);
 extern const char * bgp_damp_reuse_time_vty (struct vty *, struct bgp_info *,
                                              char *, size_t, u_char, json_object *);
@@ -19,6 +19,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 02111-1307, USA.  */
 
 #include <zebra.h>
+#include <sys/wait.h>
 
 #include "log.h"
 #include "stream.h"
@@ -59,23 +60,6 @@ static const struct bgp_dump_type_map {
     {0, NULL},
   };
 
-enum MRT_MSG_TYPES {
-   MSG_NULL,
-   MSG_START,                   /* sender is starting up */
-   MSG_DIE,                     /* receiver should shut down */
-   MSG_I_AM_DEAD,               /* sender is shutting down */
-   MSG_PEER_DOWN,               /* sender's peer is down */
-   MSG_PROTOCOL_BGP,            /* msg is a BGP packet */
-   MSG_PROTOCOL_RIP,            /* msg is a RIP packet */
-   MSG_PROTOCOL_IDRP,           /* msg is an IDRP packet */
-   MSG_PROTOCOL_RIPNG,          /* msg is a RIPNG packet */
-   MSG_PROTOCOL_BGP4PLUS,       /* msg is a BGP4+ packet */
-   MSG_PROTOCOL_BGP4PLUS_01,    /* msg is a BGP4+ (draft 01) packet */
-   MSG_PROTOCOL_OSPF,           /* msg is an OSPF packet */
-   MSG_TABLE_DUMP,              /* routing table dump */
-   MSG_TABLE_DUMP_V2            /* routing table dump, version 2 */
-};
-
 struct bgp_dump
 {
   enum bgp_dump_type type;
@@ -89,6 +73,27 @@ struct bgp_dump
   char *interval_str;
 
   struct thread *t_interval;
+
+  /* Compressor writing the file, when its name ends in ".gz". */
+  pid_t pid;
+
+  /* Bytes written to the current file. */
+  unsigned long bytes;
+
+  /* Table dump in progress, see bgp_dump_routes_walk. */
+  struct thread *t_walk;
+  struct bgp *walk_bgp;
+  afi_t walk_afi;
+  bgp_table_iter_t walk_iter;
+  struct timeval walk_start;
+  unsigned int seq;
+  u_int32_t gen;
+
+  /* Last completed table dump. */
+  time_t last_time;
+  unsigned long last_msecs;
+  unsigned long last_bytes;
+  unsigned int last_records;
 };
 
 static int bgp_dump_unset (struct vty *vty, struct bgp_dump *bgp_dump);
@@ -106,6 +111,93 @@ struct bgp_dump bgp_dump_updates;
 /* BGP dump structure for 'dump bgp routes' */
 struct bgp_dump bgp_dump_routes;
 
+/* Start gzip writing to PATH, and return a stream into it. */
+static FILE *
+bgp_dump_open_compressed (struct bgp_dump *bgp_dump, const char *path)
+{
+  int fd, fds[2];
+  long i, maxfd;
+  pid_t pid;
+  FILE *fp;
+
+  fd = open (path, O_WRONLY | O_CREAT | O_TRUNC, LOGFILE_MASK);
+  if (fd < 0)
+    return NULL;
+
+  if (pipe (fds) < 0)
+    {
+      close (fd);
+      return NULL;
+    }
+
+  pid = fork ();
+  if (pid < 0)
+    {
+      close (fd);
+      close (fds[0]);
+      close (fds[1]);
+      return NULL;
+    }
+
+  if (pid == 0)
+    {
+      dup2 (fds[0], STDIN_FILENO);
+      dup2 (fd, STDOUT_FILENO);
+
+      /* Don't hold on to bgpd's sockets. */
+      maxfd = sysconf (_SC_OPEN_MAX);
+      for (i = STDERR_FILENO + 1; i < maxfd; i++)
+        close (i);
+
+      execlp ("gzip", "gzip", "-c", NULL);
+      _exit (127);
+    }
+
+  close (fd);
+  close (fds[0]);
+
+  fp = fdopen (fds[1], "w");
+  if (fp == NULL)
+    {
+      /* bgp_dump_reap collects it. */
+      close (fds[1]);
+      kill (pid, SIGTERM);
+      return NULL;
+    }
+  bgp_dump->pid = pid;
+
+  return fp;
+}
+
+static void
+bgp_dump_close_file (struct bgp_dump *bgp_dump)
+{
+  if (bgp_dump->fp)
+    {
+      fclose (bgp_dump->fp);
+      bgp_dump->fp = NULL;
+    }
+
+  /* The compressor finishes the file once it sees the end of its
+     input, and bgp_dump_reap collects it then. */
+  bgp_dump->pid = 0;
+}
+
+/* Collect compressors that have exited, on SIGCHLD. */
+void
+bgp_dump_reap (void)
+{
+  while (waitpid (-1, NULL, WNOHANG) > 0)
+    ;
+}
+
+static void
+bgp_dump_write (struct bgp_dump *bgp_dump, struct stream *obuf)
+{
+  fwrite (STREAM_DATA (obuf), stream_get_endp (obuf), 1, bgp_dump->fp);
+  bgp_dump->bytes += stream_get_endp (obuf);
+}
+
 static FILE *
 bgp_dump_open_file (struct bgp_dump *bgp_dump)
 {
@@ -115,6 +207,7 @@ bgp_dump_open_file (struct bgp_dump *bgp_dump)
   char fullpath[MAXPATHLEN];
   char realpath[MAXPATHLEN];
   mode_t oldumask;
+  size_t len;
 
   time (&clock);
   tm = localtime (&clock);
@@ -133,12 +226,15 @@ bgp_dump_open_file (struct bgp_dump *bgp_dump)
       return NULL;
     }
 
-  if (bgp_dump->fp)
-    fclose (bgp_dump->fp);
-
+  bgp_dump_close_file (bgp_dump);
+  bgp_dump->bytes = 0;
 
   oldumask = umask(0777 & ~LOGFILE_MASK);
-  bgp_dump->fp = fopen (realpath, "w");
+  len = strlen (realpath);
+  if (len > 3 && strcmp (realpath + len - 3, ".gz") == 0)
+    bgp_dump->fp = bgp_dump_open_compressed (bgp_dump, realpath);
+  else
+    bgp_dump->fp = fopen (realpath, "w");
 
   if (bgp_dump->fp == NULL)
     {
@@ -224,7 +320,7 @@ bgp_dump_set_size (struct stream *s, int type)
 }
 
 static void
-bgp_dump_routes_index_table(struct bgp *bgp)
+bgp_dump_routes_index_table(struct bgp_dump *bgp_dump, struct bgp *bgp)
 {
   struct peer *peer;
   struct listnode *node;
@@ -265,6 +361,12 @@ bgp_dump_routes_index_table(struct bgp *bgp)
   /* Peer ASN (0) */
   stream_putl (obuf, 0);
 
+  if (bgp->peer_self)
+    {
+      bgp->peer_self->table_dump_index = 0;
+      bgp->peer_self->table_dump_gen = bgp_dump->gen;
+    }
+
   /* Walk down all peers */
   for(ALL_LIST_ELEMENTS_RO (bgp->peer, node, peer))
     {
@@ -299,19 +401,19 @@ bgp_dump_routes_index_table(struct bgp *bgp)
 
       /* Store the peer number for this peer */
       peer->table_dump_index = peerno;
+      peer->table_dump_gen = bgp_dump->gen;
       peerno++;
     }
 
   bgp_dump_set_size(obuf, MSG_TABLE_DUMP_V2);
 
-  fwrite (STREAM_DATA (obuf), stream_get_endp (obuf), 1, bgp_dump_routes.fp);
-  fflush (bgp_dump_routes.fp);
+  bgp_dump_write (bgp_dump, obuf);
 }
 
 
 static struct bgp_info *
-bgp_dump_route_node_record (int afi, struct bgp_node *rn,
-			    struct bgp_info *info, unsigned int seq)
+bgp_dump_route_node_record (struct bgp_dump *bgp_dump, afi_t afi,
+			    struct bgp_node *rn, struct bgp_info *info)
 {
   struct stream *obuf;
   size_t sizep;
@@ -329,7 +431,7 @@ bgp_dump_route_node_record (int afi, struct bgp_node *rn,
                      BGP_DUMP_ROUTES);
 
   /* Sequence number */
-  stream_putl (obuf, seq);
+  stream_putl (obuf, bgp_dump->seq);
 
   /* Prefix length */
   stream_putc (obuf, rn->p.prefixlen);
@@ -360,6 +462,10 @@ bgp_dump_route_node_record (int afi, struct bgp_node *rn,
   {
     size_t cur_endp;
 
+    /* Skip peers which came up after the index table was written */
+    if (info->peer->table_dump_gen != bgp_dump->gen)
+      continue;
+
     /* Peer index */
     stream_putw (obuf, info->peer->table_dump_index);
 
@@ -386,54 +492,121 @@ bgp_dump_route_node_record (int afi, struct bgp_node *rn,
     endp = cur_endp;
   }
 
+  if (entry_count == 0)
+    return info;
+
   /* Overwrite the entry count, now that we know the right number */
   stream_putw_at (obuf, sizep, entry_count);
 
   bgp_dump_set_size (obuf, MSG_TABLE_DUMP_V2);
-  fwrite (STREAM_DATA (obuf), stream_get_endp (obuf), 1, bgp_dump_routes.fp);
+  bgp_dump_write (bgp_dump, obuf);
+  bgp_dump->seq++;
 
   return info;
 }
 
 
-/* Runs under child process. */
-static unsigned int
-bgp_dump_routes_func (int afi, int first_run, unsigned int seq)
+/* End a table dump, complete or not, and close its file.  */
+static void
+bgp_dump_routes_stop (struct bgp_dump *bgp_dump)
 {
-  struct bgp_info *info;
-  struct bgp_node *rn;
-  struct bgp *bgp;
-  struct bgp_table *table;
+  THREAD_OFF (bgp_dump->t_walk);
 
-  bgp = bgp_get_default ();
-  if (!bgp)
-    return seq;
+  if (bgp_dump->walk_iter.table)
+    bgp_table_iter_cleanup (&bgp_dump->walk_iter);
+
+  if (bgp_dump->walk_bgp)
+    {
+      bgp_unlock (bgp_dump->walk_bgp);
+      bgp_dump->walk_bgp = NULL;
+    }
 
-  if (bgp_dump_routes.fp == NULL)
-    return seq;
+  bgp_dump_close_file (bgp_dump);
+}
 
-  /* Note that bgp_dump_routes_index_table will do ipv4 and ipv6 peers,
-     so this should only be done on the first call to bgp_dump_routes_func.
-     ( this function will be called once for ipv4 and once for ipv6 ) */
-  if (first_run)
-    bgp_dump_routes_index_table(bgp);
+/* Write out the RIB a slice at a time, yielding to the rest of bgpd
+   in between.  Nodes may come and go while the dump is paused; the
+   iterator carries on from the prefix it stopped at.  */
+static int
+bgp_dump_routes_walk (struct thread *t)
+{
+  struct bgp_dump *bgp_dump;
+  struct bgp_node *rn;
+  struct bgp_info *info;
+  struct timeval now;
 
-  /* Walk down each BGP route. */
-  table = bgp->rib[afi][SAFI_UNICAST];
+  bgp_dump = THREAD_ARG (t);
+  bgp_dump->t_walk = NULL;
 
-  for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
+  for (;;)
     {
+      rn = bgp_table_iter_next (&bgp_dump->walk_iter);
+      if (rn == NULL)
+	{
+	  bgp_table_iter_cleanup (&bgp_dump->walk_iter);
+	  if (bgp_dump->walk_afi == AFI_IP)
+	    {
+	      bgp_dump->walk_afi = AFI_IP6;
+	      bgp_table_iter_init (&bgp_dump->walk_iter,
+				   bgp_dump->walk_bgp->rib[AFI_IP6][SAFI_UNICAST]);
+	      continue;
+	    }
+	  break;
+	}
+
       info = rn->info;
       while (info)
-      {
-        info = bgp_dump_route_node_record (afi, rn, info, seq);
-        seq++;
-      }
+	info = bgp_dump_route_node_record (bgp_dump, bgp_dump->walk_afi,
+					   rn, info);
+
+      if (thread_should_yield (t))
+	{
+	  bgp_table_iter_pause (&bgp_dump->walk_iter);
+	  bgp_dump->t_walk = thread_add_background (bm->master,
+						    bgp_dump_routes_walk,
+						    bgp_dump, 0);
+	  return 0;
+	}
     }
 
-  fflush (bgp_dump_routes.fp);
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &now);
+  bgp_dump->last_time = time (NULL);
+  bgp_dump->last_msecs = timeval_elapsed (now, bgp_dump->walk_start) / 1000;
+  bgp_dump->last_bytes = bgp_dump->bytes;
+  bgp_dump->last_records = bgp_dump->seq;
+
+  /* Close the file now. For a RIB dump there's no point in leaving
+   * it open until the next scheduled dump starts. */
+  bgp_dump_routes_stop (bgp_dump);
 
-  return seq;
+  return 0;
+}
+
+static void
+bgp_dump_routes_start (struct bgp_dump *bgp_dump)
+{
+  struct bgp *bgp;
+
+  bgp = bgp_get_default ();
+  if (!bgp)
+    {
+      bgp_dump_close_file (bgp_dump);
+      return;
+    }
+
+  bgp_lock (bgp);
+  bgp_dump->walk_bgp = bgp;
+  bgp_dump->seq = 0;
+  bgp_dump->gen++;
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &bgp_dump->walk_start);
+
+  /* Note that bgp_dump_routes_index_table will do ipv4 and ipv6 peers */
+  bgp_dump_routes_index_table (bgp_dump, bgp);
+
+  bgp_dump->walk_afi = AFI_IP;
+  bgp_table_iter_init (&bgp_dump->walk_iter, bgp->rib[AFI_IP][SAFI_UNICAST]);
+  bgp_dump->t_walk = thread_add_background (bm->master, bgp_dump_routes_walk,
+					    bgp_dump, 0);
 }
 
 static int
@@ -443,18 +616,17 @@ bgp_dump_interval_func (struct thread *t)
   bgp_dump = THREAD_ARG (t);
   bgp_dump->t_interval = NULL;
 
+  /* A table dump still being written is left to finish. */
+  if (bgp_dump->walk_bgp)
+    zlog_warn ("bgp_dump_interval_func: %s: previous dump still in progress,"
+	       " skipped", bgp_dump->filename);
+
   /* Reschedule dump even if file couldn't be opened this time... */
-  if (bgp_dump_open_file (bgp_dump) != NULL)
+  else if (bgp_dump_open_file (bgp_dump) != NULL)
     {
       /* In case of bgp_dump_routes, we need special route dump function. */
       if (bgp_dump->type == BGP_DUMP_ROUTES)
-	{
-	  unsigned int seq = bgp_dump_routes_func (AFI_IP, 1, 0);
-	  bgp_dump_routes_func (AFI_IP6, 0, seq);
-	  /* Close the file now. For a RIB dump there's no point in leaving
-	   * it open until the next scheduled dump starts. */
-	  fclose(bgp_dump->fp); bgp_dump->fp = NULL;
-	}
+	bgp_dump_routes_start (bgp_dump);
     }
 
   /* if interval is set reschedule */
@@ -535,7 +707,7 @@ bgp_dump_state (struct peer *peer, int status_old, int status_new)
   bgp_dump_set_size (obuf, MSG_PROTOCOL_BGP4MP);
 
   /* Write to the stream. */
-  fwrite (STREAM_DATA (obuf), stream_get_endp (obuf), 1, bgp_dump_all.fp);
+  bgp_dump_write (&bgp_dump_all, obuf);
   fflush (bgp_dump_all.fp);
 }
 
@@ -573,7 +745,7 @@ bgp_dump_packet_func (struct bgp_dump *bgp_dump, struct peer *peer,
   bgp_dump_set_size (obuf, MSG_PROTOCOL_BGP4MP);
 
   /* Write to the stream. */
-  fwrite (STREAM_DATA (obuf), stream_get_endp (obuf), 1, bgp_dump->fp);
+  bgp_dump_write (bgp_dump, obuf);
   fflush (bgp_dump->fp);
 }
 
@@ -709,12 +881,8 @@ bgp_dump_unset (struct vty *vty, struct bgp_dump *bgp_dump)
       bgp_dump->filename = NULL;
     }
 
-  /* Closing file. */
-  if (bgp_dump->fp)
-    {
-      fclose (bgp_dump->fp);
-      bgp_dump->fp = NULL;
-    }
+  /* Stopping any table dump and closing file. */
+  bgp_dump_routes_stop (bgp_dump);
 
   /* Removing interval thread. */
   if (bgp_dump->t_interval)
@@ -724,6 +892,7 @@ bgp_dump_unset (struct vty *vty, struct bgp_dump *bgp_dump)
     }
 
   bgp_dump->interval = 0;
+  bgp_dump->last_time = 0;
 
   /* Removing interval string. */
   if (bgp_dump->interval_str)
@@ -818,6 +987,56 @@ DEFUN (no_dump_bgp_all,
   return bgp_dump_unset (vty, bgp_dump_struct);
 }
 
+static void
+bgp_dump_show (struct vty *vty, struct bgp_dump *bgp_dump)
+{
+  const struct bgp_dump_type_map *map;
+  const char *type_str = "";
+
+  if (! bgp_dump->filename)
+    return;
+
+  for (map = bgp_dump_type_map; map->str; map++)
+    if (map->type == bgp_dump->type)
+      type_str = map->str;
+
+  vty_out (vty, "dump bgp %s %s%s%s%s", type_str, bgp_dump->filename,
+	   bgp_dump->interval_str ? " " : "",
+	   bgp_dump->interval_str ? bgp_dump->interval_str : "", VTY_NEWLINE);
+
+  if (bgp_dump->type != BGP_DUMP_ROUTES)
+    {
+      if (bgp_dump->fp)
+	vty_out (vty, "  %lu bytes written to current file%s%s",
+		 bgp_dump->bytes, bgp_dump->pid ? " (compressed)" : "",
+		 VTY_NEWLINE);
+      return;
+    }
+
+  if (bgp_dump->walk_bgp)
+    vty_out (vty, "  Table dump in progress: %u entries, %lu bytes so far%s",
+	     bgp_dump->seq, bgp_dump->bytes, VTY_NEWLINE);
+
+  if (bgp_dump->last_time)
+    vty_out (vty, "  Last table dump: %u entries, %lu bytes in %lu.%03lu"
+	     " seconds, %ld seconds ago%s",
+	     bgp_dump->last_records, bgp_dump->last_bytes,
+	     bgp_dump->last_msecs / 1000, bgp_dump->last_msecs % 1000,
+	     (long) (time (NULL) - bgp_dump->last_time), VTY_NEWLINE);
+}
+
+DEFUN (show_dump,
+       show_dump_cmd,
+       "show dump",
+       SHOW_STR
+       "Packet and table dump status\n")
+{
+  bgp_dump_show (vty, &bgp_dump_all);
+  bgp_dump_show (vty, &bgp_dump_updates);
+  bgp_dump_show (vty, &bgp_dump_routes);
+  return CMD_SUCCESS;
+}
+
 /* BGP node structure. */
 static struct cmd_node bgp_dump_node =
 {
@@ -901,18 +1120,23 @@ bgp_dump_init (void)
   memset (&bgp_dump_updates, 0, sizeof (struct bgp_dump));
   memset (&bgp_dump_routes, 0, sizeof (struct bgp_dump));
 
-  bgp_dump_obuf = stream_new ((BGP_MAX_PACKET_SIZE << 1)
+  /* Big enough for an extended message, and for a RIB dump entry
+     running past BGP_MAX_PACKET_SIZE.  */
+  bgp_dump_obuf = stream_new (BGP_EXTENDED_MESSAGE_MAX_PACKET_SIZE
                               + BGP_DUMP_MSG_HEADER + BGP_DUMP_HEADER_SIZE);
 
   install_node (&bgp_dump_node, config_write_bgp_dump);
 
   install_element (CONFIG_NODE, &dump_bgp_all_cmd);
   install_element (CONFIG_NODE, &no_dump_bgp_all_cmd);
+
+  install_element (VIEW_NODE, &show_dump_cmd);
 }
 
 void
 bgp_dump_finish (void)
 {
+  bgp_dump_routes_stop (&bgp_dump_routes);
   stream_free (bgp_dump_obuf);
   bgp_dump_obuf = NULL;
 }
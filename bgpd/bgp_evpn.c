@@ -54,6 +54,28 @@ extern struct zclient *zclient;
 
 DEFINE_QOBJ_TYPE(bgpevpn)
 
+/* Largest entry for zebra, a remote IPv6 VTEP: VNI, flags, family,
+ * prefix length and address. */
+#define EVPN_ZEBRA_ENTRY_MAX     (4 + 1 + 2 + 1 + IPV6_MAX_BYTELEN)
+
+/* Remote MACs and VTEPs waiting to be sent to zebra. */
+static struct
+{
+  struct stream *s;
+  struct thread *t_flush;
+  int command;
+  vrf_id_t vrf_id;
+  u_int32_t count;
+} evpn_batch;
+
+/* How well remote MACs and VTEPs are batched. */
+static struct
+{
+  u_int32_t entries;
+  u_int32_t msgs;
+  u_int32_t max;
+} evpn_stats;
+
 
 /*
  * Private functions.
@@ -315,6 +337,49 @@ free_vni_entry (struct hash_backet *backet, struct bgp *bgp)
   bgp_evpn_free(bgp, vpn);
 }
 
+static int
+evpn_batch_timer (struct thread *thread)
+{
+  evpn_batch.t_flush = NULL;
+  bgp_evpn_zebra_flush ();
+  return 0;
+}
+
+/*
+ * Start a remote MAC or VTEP entry in the batch for zebra. Consecutive
+ * entries with the same command and VRF share one message, sent when it
+ * is full, when the command changes, or once the current event is done.
+ */
+static struct stream *
+evpn_batch_entry (struct bgp *bgp, int command)
+{
+  struct stream *s;
+
+  if (evpn_batch.count
+      && (evpn_batch.command != command || evpn_batch.vrf_id != bgp->vrf_id
+          || STREAM_WRITEABLE (evpn_batch.s) < EVPN_ZEBRA_ENTRY_MAX))
+    bgp_evpn_zebra_flush ();
+
+  if (!evpn_batch.s)
+    evpn_batch.s = stream_new (ZEBRA_MAX_PACKET_SIZ);
+  s = evpn_batch.s;
+
+  if (!evpn_batch.count)
+    {
+      stream_reset (s);
+      zclient_create_header (s, command, bgp->vrf_id);
+      evpn_batch.command = command;
+      evpn_batch.vrf_id = bgp->vrf_id;
+      if (!evpn_batch.t_flush)
+        evpn_batch.t_flush = thread_add_event (bm->master, evpn_batch_timer,
+                                               NULL, 0);
+    }
+
+  evpn_batch.count++;
+  evpn_stats.entries++;
+  return s;
+}
+
 /*
  * Add (update) or delete MAC from zebra.
  */
@@ -335,25 +400,20 @@ bgp_zebra_send_remote_mac (struct bgp *bgp, struct bgpevpn *vpn,
   if (!IS_BGP_INST_KNOWN_TO_ZEBRA(bgp))
     return 0;
 
-  s = zclient->obuf;
-  stream_reset (s);
-
-  zclient_create_header (s, add ? ZEBRA_REMOTE_MACIP_ADD : ZEBRA_REMOTE_MACIP_DEL,
-                         bgp->vrf_id);
+  s = evpn_batch_entry (bgp, add ? ZEBRA_REMOTE_MACIP_ADD
+                                 : ZEBRA_REMOTE_MACIP_DEL);
   stream_putl(s, vpn->vni);
   stream_put (s, &p->prefix.mac.octet, ETHER_ADDR_LEN); /* Mac Addr */
   stream_putl(s, 0); /* IP address length. */
   stream_put_in_addr(s, &remote_vtep_ip);
 
-  stream_putw_at (s, 0, stream_get_endp (s));
-
   if (bgp_debug_zebra (NULL))
     zlog_debug("Tx %s MAC, VNI %u MAC %s remote VTEP %s",
                add ? "ADD" : "DEL", vpn->vni,
                mac2str (&p->prefix.mac, buf1, sizeof(buf1)),
                inet_ntop(AF_INET, &remote_vtep_ip, buf2, sizeof(buf2)));
 
-  return zclient_send_message(zclient);
+  return 0;
 }
 
 /*
@@ -375,42 +435,39 @@ bgp_zebra_send_remote_vtep (struct bgp *bgp, struct bgpevpn *vpn,
   if (!IS_BGP_INST_KNOWN_TO_ZEBRA(bgp))
     return 0;
 
-  s = zclient->obuf;
-  stream_reset (s);
+  if (IS_EVPN_PREFIX_IPADDR_V4(p))
+    family = AF_INET;
+  else if (IS_EVPN_PREFIX_IPADDR_V6(p))
+    family = AF_INET6;
+  else
+    {
+      zlog_err ("Bad remote IP when trying to %s remote VTEP for VNI %u",
+                add ? "ADD" : "DEL", vpn->vni);
+      return -1;
+    }
 
-  zclient_create_header (s, add ? ZEBRA_REMOTE_VTEP_ADD : ZEBRA_REMOTE_VTEP_DEL,
-                         bgp->vrf_id);
+  s = evpn_batch_entry (bgp, add ? ZEBRA_REMOTE_VTEP_ADD
+                                 : ZEBRA_REMOTE_VTEP_DEL);
   stream_putl(s, vpn->vni);
   stream_putc(s, 0); // flags - unused
-  if (IS_EVPN_PREFIX_IPADDR_V4(p))
+  stream_putw(s, family);
+  if (family == AF_INET)
     {
-      family = AF_INET;
-      stream_putw(s, family);
       stream_putc(s, IPV4_MAX_BITLEN);
       stream_put_in_addr(s, &p->prefix.ip.v4_addr);
     }
-  else if (IS_EVPN_PREFIX_IPADDR_V6(p))
+  else
     {
-      family = AF_INET6;
-      stream_putw(s, AF_INET6);
       stream_putc(s, IPV6_MAX_BITLEN);
       stream_put(s, &p->prefix.ip.v6_addr, IPV6_MAX_BYTELEN);
     }
-  else
-    {
-      zlog_err ("Bad remote IP when trying to %s remote VTEP for VNI %u",
-                add ? "ADD" : "DEL", vpn->vni);
-      return -1;
-    }
-
-  stream_putw_at (s, 0, stream_get_endp (s));
 
   if (bgp_debug_zebra (NULL))
     zlog_debug("Tx %s Remote VTEP, VNI %u remote VTEP %s",
                add ? "ADD" : "DEL", vpn->vni,
                inet_ntop(family, &p->prefix.ip, buf, sizeof(buf)));
 
-  return zclient_send_message(zclient);
+  return 0;
 }
 
 /*
@@ -604,15 +661,21 @@ update_all_type2_routes (struct bgp *bgp, struct bgpevpn *vpn)
   (bgp_attr_extra_get (&attr))->ecommunity = ecommunity_dup (vpn->export_rtl);
   attr.flag |= ATTR_FLAG_BIT (BGP_ATTR_EXT_COMMUNITIES);
 
+  /* Intern once, so that routes already up to date only need a pointer
+   * compare.
+   */
+  attr_new = bgp_attr_intern (&attr);
+  aspath_unintern (&attr.aspath);
+  bgp_attr_extra_free (&attr);
+
   /* TODO: We're walking entire table for this VNI, this should be optimized later. */
   /* EVPN routes are a 2-level table, first get the RD table. */
   rdrn = bgp_node_lookup (bgp->rib[afi][safi], (struct prefix *) &vpn->prd);
-  if (!rdrn)
-    return -1;
-
-  if (rdrn->info == NULL)
+  if (!rdrn || rdrn->info == NULL)
     {
-      bgp_unlock_node (rdrn);
+      if (rdrn)
+        bgp_unlock_node (rdrn);
+      bgp_attr_unintern (&attr_new);
       return -1;
     }
 
@@ -632,16 +695,8 @@ update_all_type2_routes (struct bgp *bgp, struct bgpevpn *vpn)
 
       if (ri)
         {
-          /* Add/update attribute in hash - for each route. */
-          attr_new = bgp_attr_intern (&attr);
-
-          if (attrhash_cmp (ri->attr, attr_new) &&
-              !CHECK_FLAG(ri->flags, BGP_INFO_REMOVED))
-            {
-              /* Unintern newly created. */
-              bgp_attr_unintern (&attr_new);
-            }
-          else
+          if (ri->attr != attr_new ||
+              CHECK_FLAG(ri->flags, BGP_INFO_REMOVED))
             {
               /* The attribute is changed. */
               bgp_info_set_flag (rn, ri, BGP_INFO_ATTR_CHANGED);
@@ -652,7 +707,7 @@ update_all_type2_routes (struct bgp *bgp, struct bgpevpn *vpn)
 
               /* Unintern existing, set to new. */
               bgp_attr_unintern (&ri->attr);
-              ri->attr = attr_new;
+              ri->attr = bgp_attr_intern (attr_new);
               ri->uptime = bgp_clock ();
 
               /* Schedule for processing. */
@@ -661,9 +716,7 @@ update_all_type2_routes (struct bgp *bgp, struct bgpevpn *vpn)
         }
     }
 
-  /* Unintern temporary. */
-  aspath_unintern (&attr.aspath);
-  bgp_attr_extra_free (&attr);
+  bgp_attr_unintern (&attr_new);
 
   /* unlock - for the lookup */
   bgp_unlock_node (rdrn);
@@ -930,6 +983,8 @@ install_uninstall_routes_for_vni (struct bgp *bgp, struct bgpevpn *vpn,
   struct bgp_node *rd_rn, *rn;
   struct bgp_table *table;
   struct bgp_info *ri;
+  struct attr *last_attr = NULL;
+  int last_match = 0;
   int ret;
 
   afi = AFI_L2VPN;
@@ -960,7 +1015,15 @@ install_uninstall_routes_for_vni (struct bgp *bgp, struct bgpevpn *vpn,
                     && ri->sub_type == BGP_ROUTE_NORMAL))
                 continue;
 
-              if (is_route_matching_for_vni (bgp, vpn, ri))
+              /* Routes from the same VTEP mostly share one interned
+               * attribute, match its RTs only once. */
+              if (ri->attr != last_attr)
+                {
+                  last_attr = ri->attr;
+                  last_match = is_route_matching_for_vni (bgp, vpn, ri);
+                }
+
+              if (last_match)
                 {
                   if (rtype == BGP_EVPN_MAC_IP_ROUTE)
                     ret = bgp_zebra_send_remote_mac (bgp, vpn, evp,
@@ -1688,6 +1751,44 @@ bgp_evpn_uninstall_routes (struct bgp *bgp, struct bgpevpn *vpn)
   return uninstall_routes_for_vni (bgp, vpn);
 }
 
+/*
+ * Send the batched remote MACs and VTEPs to zebra.
+ */
+void
+bgp_evpn_zebra_flush (void)
+{
+  struct stream *s;
+
+  if (!evpn_batch.count)
+    return;
+
+  evpn_stats.msgs++;
+  if (evpn_batch.count > evpn_stats.max)
+    evpn_stats.max = evpn_batch.count;
+  evpn_batch.count = 0;
+
+  if (!zclient || zclient->sock < 0)
+    return;
+
+  stream_putw_at (evpn_batch.s, 0, stream_get_endp (evpn_batch.s));
+  s = zclient->obuf;
+  stream_reset (s);
+  stream_put (s, STREAM_DATA (evpn_batch.s), stream_get_endp (evpn_batch.s));
+
+  if (zclient_send_message (zclient) < 0)
+    zlog_warn ("%s: zclient_send_message() failed", __func__);
+}
+
+/*
+ * Show how remote MACs and VTEPs are batched in messages to zebra.
+ */
+void
+bgp_evpn_show_zebra_stats (struct vty *vty)
+{
+  vty_out (vty, "Zebra remote MAC/VTEP updates: %u in %u messages, largest %u%s",
+           evpn_stats.entries, evpn_stats.msgs, evpn_stats.max, VTY_NEWLINE);
+}
+
 /*
  * Handle change to export RT - update and advertise local routes.
  */
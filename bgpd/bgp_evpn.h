@@ -195,6 +195,10 @@ extern void
 bgp_evpn_cleanup_on_disable (struct bgp *bgp);
 extern void
 bgp_evpn_cleanup (struct bgp *bgp);
+extern void
+bgp_evpn_zebra_flush (void);
+extern void
+bgp_evpn_show_zebra_stats (struct vty *vty);
 
 
 /* UI functions */
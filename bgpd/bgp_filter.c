@@ -65,6 +65,9 @@ struct as_filter
 
   regex_t *reg;
   char *reg_str;
+
+  /* Whole-AS form of reg, if it has one.  */
+  struct bgp_regex_fast *fast;
 };
 
 /* AS path filter list. */
@@ -81,6 +84,27 @@ struct as_list
   struct as_filter *tail;
 };
 
+/* Results of as_list_apply are remembered on interned AS paths, which
+   never change.  Any change to any as-path access-list bumps the
+   generation, which invalidates all remembered results at once.  */
+#define AS_LIST_MEMO_MAX 32
+
+struct as_list_memo_entry
+{
+  struct as_list *aslist;
+  enum as_filter_type type;
+};
+
+struct as_list_memo
+{
+  unsigned int gen;
+  unsigned short count;
+  unsigned short size;
+  struct as_list_memo_entry entries[];
+};
+
+static unsigned int as_list_gen = 1;
+
 /* ip as-path access-list 10 permit AS1. */
 
 static struct as_list_master as_list_master =
@@ -104,6 +128,8 @@ as_filter_free (struct as_filter *asfilter)
 {
   if (asfilter->reg)
     bgp_regex_free (asfilter->reg);
+  if (asfilter->fast)
+    bgp_regex_fast_free (asfilter->fast);
   if (asfilter->reg_str)
     XFREE (MTYPE_AS_FILTER_STR, asfilter->reg_str);
   XFREE (MTYPE_AS_FILTER, asfilter);
@@ -119,6 +145,7 @@ as_filter_make (regex_t *reg, const char *reg_str, enum as_filter_type type)
   asfilter->reg = reg;
   asfilter->type = type;
   asfilter->reg_str = XSTRDUP (MTYPE_AS_FILTER_STR, reg_str);
+  asfilter->fast = bgp_regcomp_fast (reg_str);
 
   return asfilter;
 }
@@ -146,6 +173,7 @@ as_list_filter_add (struct as_list *aslist, struct as_filter *asfilter)
   else
     aslist->head = asfilter;
   aslist->tail = asfilter;
+  as_list_gen++;
 
   /* Run hook function. */
   if (as_list_master.add_hook)
@@ -331,6 +359,7 @@ as_list_delete (struct as_list *aslist)
     list->head = aslist->next;
 
   as_list_free (aslist);
+  as_list_gen++;
 }
 
 static int
@@ -358,6 +387,7 @@ as_list_filter_delete (struct as_list *aslist, struct as_filter *asfilter)
     aslist->head = asfilter->next;
 
   as_filter_free (asfilter);
+  as_list_gen++;
 
   /* If access_list becomes empty delete it from access_master. */
   if (as_list_empty (aslist))
@@ -373,29 +403,94 @@ as_list_filter_delete (struct as_list *aslist, struct as_filter *asfilter)
 static int
 as_filter_match (struct as_filter *asfilter, struct aspath *aspath)
 {
+  int ret;
+
+  if (asfilter->fast
+      && (ret = bgp_regexec_fast (asfilter->fast, aspath)) >= 0)
+    return ret;
+
   if (bgp_regexec (asfilter->reg, aspath) != REG_NOMATCH)
     return 1;
   return 0;
 }
 
+static enum as_filter_type
+as_list_match (struct as_list *aslist, struct aspath *aspath)
+{
+  struct as_filter *asfilter;
+
+  for (asfilter = aslist->head; asfilter; asfilter = asfilter->next)
+    {
+      if (as_filter_match (asfilter, aspath))
+	return asfilter->type;
+    }
+  return AS_FILTER_DENY;
+}
+
+static void
+as_list_memo_add (struct aspath *aspath, struct as_list *aslist,
+                  enum as_filter_type type)
+{
+  struct as_list_memo *memo = aspath->filter_memo;
+  unsigned short size;
+
+  if (memo && memo->gen != as_list_gen)
+    memo->count = 0;
+
+  if (! memo || memo->count == memo->size)
+    {
+      size = memo ? memo->size * 2 : 2;
+      if (size > AS_LIST_MEMO_MAX)
+	return;
+      memo = XREALLOC (MTYPE_AS_LIST_MEMO, memo,
+                       sizeof (struct as_list_memo)
+                       + size * sizeof (struct as_list_memo_entry));
+      if (! aspath->filter_memo)
+	memo->count = 0;
+      memo->size = size;
+      aspath->filter_memo = memo;
+    }
+
+  memo->gen = as_list_gen;
+  memo->entries[memo->count].aslist = aslist;
+  memo->entries[memo->count].type = type;
+  memo->count++;
+}
+
+void
+as_list_memo_free (struct as_list_memo *memo)
+{
+  XFREE (MTYPE_AS_LIST_MEMO, memo);
+}
+
 /* Apply AS path filter to AS. */
 enum as_filter_type
 as_list_apply (struct as_list *aslist, void *object)
 {
-  struct as_filter *asfilter;
   struct aspath *aspath;
+  struct as_list_memo *memo;
+  enum as_filter_type type;
+  unsigned int i;
 
   aspath = (struct aspath *) object;
 
   if (aslist == NULL)
     return AS_FILTER_DENY;
 
-  for (asfilter = aslist->head; asfilter; asfilter = asfilter->next)
-    {
-      if (as_filter_match (asfilter, aspath))
-	return asfilter->type;
-    }
-  return AS_FILTER_DENY;
+  /* Only interned paths are immutable and worth remembering. */
+  if (! aspath->refcnt)
+    return as_list_match (aslist, aspath);
+
+  memo = aspath->filter_memo;
+  if (memo && memo->gen == as_list_gen)
+    for (i = 0; i < memo->count; i++)
+      if (memo->entries[i].aslist == aslist)
+	return memo->entries[i].type;
+
+  type = as_list_match (aslist, aspath);
+  as_list_memo_add (aspath, aslist, type);
+
+  return type;
 }
 
 /* Add hook function. */
@@ -30,7 +30,11 @@ enum as_filter_type
 extern void bgp_filter_init (void);
 extern void bgp_filter_reset (void);
 
+struct as_list;
+struct as_list_memo;
+
 extern enum as_filter_type as_list_apply (struct as_list *, void *);
+extern void as_list_memo_free (struct as_list_memo *);
 
 extern struct as_list *as_list_lookup (const char *);
 extern void as_list_add_hook (void (*func) (char *));
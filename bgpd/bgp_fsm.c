@@ -149,6 +149,7 @@ peer_xfer_conn(struct peer *from_peer)
   peer->v_routeadv = from_peer->v_routeadv;
   peer->v_gr_restart = from_peer->v_gr_restart;
   peer->cap = from_peer->cap;
+  peer->max_packet_size = from_peer->max_packet_size;
   status = peer->status;
   pstatus = peer->ostatus;
   last_evt = peer->last_event;
@@ -942,7 +943,7 @@ bgp_fsm_change_status (struct peer *peer, int status)
        * the state change that happens below, so peer will be in Clearing
        * (or Deleted).
        */
-      if (!work_queue_is_scheduled (peer->clear_node_queue))
+      if (!peer->clear_pending)
         BGP_EVENT_ADD (peer, Clearing_Completed);
     }
   
@@ -1093,6 +1094,9 @@ bgp_stop (struct peer *peer)
   /* Stream reset. */
   peer->packet_size = 0;
 
+  /* Attributes cached under this session's capabilities. */
+  bgp_attr_cache_flush (peer);
+
   /* Clear input and output buffer.  */
   if (peer->ibuf)
     stream_reset (peer->ibuf);
@@ -1317,6 +1321,7 @@ bgp_start (struct peer *peer)
 
   /* Clear peer capability flag. */
   peer->cap = 0;
+  peer->max_packet_size = BGP_MAX_PACKET_SIZE;
     
   /* If the peer is passive mode, force to move to Active mode. */
   if (CHECK_FLAG (peer->flags, PEER_FLAG_PASSIVE))
@@ -86,6 +86,7 @@ static const struct option longopts[] =
 void sighup (void);
 void sigint (void);
 void sigusr1 (void);
+void sigchild (void);
 
 static void bgp_exit (int);
 static void bgp_vrf_terminate (void);
@@ -108,6 +109,10 @@ static struct quagga_signal_t bgp_signals[] =
     .signal = SIGTERM,
     .handler = &sigint,
   },
+  {
+    .signal = SIGCHLD,
+    .handler = &sigchild,
+  },
 };
 
 /* Configuration file and directory. */
@@ -228,6 +233,13 @@ sigusr1 (void)
   zlog_rotate (NULL);
 }
 
+/* SIGCHLD handler. */
+void
+sigchild (void)
+{
+  bgp_dump_reap ();
+}
+
 /*
   Try to free up allocations we know about so that diagnostic tools such as
   valgrind are able to better illuminate leaks.
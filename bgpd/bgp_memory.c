@@ -45,6 +45,8 @@ DEFINE_MTYPE(BGPD, BGP_UPD_SUBGRP,	"BGP update subgroup")
 DEFINE_MTYPE(BGPD, BGP_PACKET, 	        "BGP packet")
 DEFINE_MTYPE(BGPD, ATTR,			"BGP attribute")
 DEFINE_MTYPE(BGPD, ATTR_EXTRA,		"BGP extra attributes")
+DEFINE_MTYPE(BGPD, BGP_ATTR_CACHE,	"BGP attribute cache")
+DEFINE_MTYPE(BGPD, BGP_ATTR_CACHE_DATA,	"BGP attribute cache data")
 DEFINE_MTYPE(BGPD, AS_PATH,		"BGP aspath")
 DEFINE_MTYPE(BGPD, AS_SEG,			"BGP aspath seg")
 DEFINE_MTYPE(BGPD, AS_SEG_DATA,		"BGP aspath segment data")
@@ -60,12 +62,15 @@ DEFINE_MTYPE(BGPD, BGP_ADVERTISE_ATTR,	"BGP adv attr")
 DEFINE_MTYPE(BGPD, BGP_ADVERTISE,		"BGP adv")
 DEFINE_MTYPE(BGPD, BGP_SYNCHRONISE,	"BGP synchronise")
 DEFINE_MTYPE(BGPD, BGP_ADJ_IN,		"BGP adj in")
+DEFINE_MTYPE(BGPD, BGP_ADJ_IN_POOL,	"BGP adj in pool")
 DEFINE_MTYPE(BGPD, BGP_ADJ_OUT,		"BGP adj out")
 DEFINE_MTYPE(BGPD, BGP_MPATH_INFO,		"BGP multipath info")
 
 DEFINE_MTYPE(BGPD, AS_LIST,		"BGP AS list")
 DEFINE_MTYPE(BGPD, AS_FILTER,		"BGP AS filter")
 DEFINE_MTYPE(BGPD, AS_FILTER_STR,		"BGP AS filter str")
+DEFINE_MTYPE(BGPD, AS_LIST_MEMO,		"BGP AS filter results")
+DEFINE_MTYPE(BGPD, BGP_RMAP_CACHE,	"BGP route-map results")
 
 DEFINE_MTYPE(BGPD, COMMUNITY,		"community")
 DEFINE_MTYPE(BGPD, COMMUNITY_VAL,		"community val")
@@ -80,6 +85,7 @@ DEFINE_MTYPE(BGPD, COMMUNITY_LIST_NAME,	"community-list name")
 DEFINE_MTYPE(BGPD, COMMUNITY_LIST_ENTRY,	"community-list entry")
 DEFINE_MTYPE(BGPD, COMMUNITY_LIST_CONFIG,	"community-list config")
 DEFINE_MTYPE(BGPD, COMMUNITY_LIST_HANDLER,	"community-list handler")
+DEFINE_MTYPE(BGPD, COMMUNITY_LIST_CACHE,	"community-list cache")
 
 DEFINE_MTYPE(BGPD, CLUSTER,		"Cluster list")
 DEFINE_MTYPE(BGPD, CLUSTER_VAL,		"Cluster list val")
@@ -100,6 +106,7 @@ DEFINE_MTYPE(BGPD, PEER_UPDATE_SOURCE,	"BGP peer update interface")
 DEFINE_MTYPE(BGPD, PEER_CONF_IF,	"BGP peer config interface")
 DEFINE_MTYPE(BGPD, BGP_DAMP_INFO,		"Dampening info")
 DEFINE_MTYPE(BGPD, BGP_DAMP_ARRAY,		"BGP Dampening array")
+DEFINE_MTYPE(BGPD, BGP_DAMP_CONFIG,		"BGP Dampening config")
 DEFINE_MTYPE(BGPD, BGP_REGEXP,		"BGP regexp")
 DEFINE_MTYPE(BGPD, BGP_AGGREGATE,		"BGP aggregate")
 DEFINE_MTYPE(BGPD, BGP_ADDR,		"BGP own address")
@@ -107,6 +114,7 @@ DEFINE_MTYPE(BGPD, BGP_ADDR,		"BGP own address")
 DEFINE_MTYPE(BGPD, BGP_REDIST,		"BGP redistribution")
 DEFINE_MTYPE(BGPD, BGP_FILTER_NAME,	"BGP Filter Information")
 DEFINE_MTYPE(BGPD, BGP_DUMP_STR,	"BGP Dump String Information")
+DEFINE_MTYPE(BGPD, BGP_SHOW_WALK,	"BGP show walk")
 DEFINE_MTYPE(BGPD, ENCAP_TLV,		"ENCAP TLV")
 
 DEFINE_MTYPE(BGPD, BGP_TEA_OPTIONS,	  "BGP TEA Options")
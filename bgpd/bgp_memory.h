@@ -41,6 +41,8 @@ DECLARE_MTYPE(BGP_UPD_SUBGRP)
 DECLARE_MTYPE(BGP_PACKET)
 DECLARE_MTYPE(ATTR)
 DECLARE_MTYPE(ATTR_EXTRA)
+DECLARE_MTYPE(BGP_ATTR_CACHE)
+DECLARE_MTYPE(BGP_ATTR_CACHE_DATA)
 DECLARE_MTYPE(AS_PATH)
 DECLARE_MTYPE(AS_SEG)
 DECLARE_MTYPE(AS_SEG_DATA)
@@ -56,12 +58,15 @@ DECLARE_MTYPE(BGP_ADVERTISE_ATTR)
 DECLARE_MTYPE(BGP_ADVERTISE)
 DECLARE_MTYPE(BGP_SYNCHRONISE)
 DECLARE_MTYPE(BGP_ADJ_IN)
+DECLARE_MTYPE(BGP_ADJ_IN_POOL)
 DECLARE_MTYPE(BGP_ADJ_OUT)
 DECLARE_MTYPE(BGP_MPATH_INFO)
 
 DECLARE_MTYPE(AS_LIST)
 DECLARE_MTYPE(AS_FILTER)
 DECLARE_MTYPE(AS_FILTER_STR)
+DECLARE_MTYPE(AS_LIST_MEMO)
+DECLARE_MTYPE(BGP_RMAP_CACHE)
 
 DECLARE_MTYPE(COMMUNITY)
 DECLARE_MTYPE(COMMUNITY_VAL)
@@ -76,6 +81,7 @@ DECLARE_MTYPE(COMMUNITY_LIST_NAME)
 DECLARE_MTYPE(COMMUNITY_LIST_ENTRY)
 DECLARE_MTYPE(COMMUNITY_LIST_CONFIG)
 DECLARE_MTYPE(COMMUNITY_LIST_HANDLER)
+DECLARE_MTYPE(COMMUNITY_LIST_CACHE)
 
 DECLARE_MTYPE(CLUSTER)
 DECLARE_MTYPE(CLUSTER_VAL)
@@ -96,6 +102,7 @@ DECLARE_MTYPE(PEER_UPDATE_SOURCE)
 DECLARE_MTYPE(PEER_CONF_IF)
 DECLARE_MTYPE(BGP_DAMP_INFO)
 DECLARE_MTYPE(BGP_DAMP_ARRAY)
+DECLARE_MTYPE(BGP_DAMP_CONFIG)
 DECLARE_MTYPE(BGP_REGEXP)
 DECLARE_MTYPE(BGP_AGGREGATE)
 DECLARE_MTYPE(BGP_ADDR)
@@ -103,6 +110,7 @@ DECLARE_MTYPE(BGP_ADDR)
 DECLARE_MTYPE(BGP_REDIST)
 DECLARE_MTYPE(BGP_FILTER_NAME)
 DECLARE_MTYPE(BGP_DUMP_STR)
+DECLARE_MTYPE(BGP_SHOW_WALK)
 DECLARE_MTYPE(ENCAP_TLV)
 
 DECLARE_MTYPE(BGP_TEA_OPTIONS)
@@ -314,7 +314,7 @@ bgp_info_mpath_enqueue (struct bgp_info *prev_info, struct bgp_info *binfo)
     prev->mp_next->mp_prev = mpath;
   prev->mp_next = mpath;
 
-  SET_FLAG (binfo->flags, BGP_INFO_MULTIPATH);
+  bgp_info_set_flag (binfo->net, binfo, BGP_INFO_MULTIPATH);
 }
 
 /*
@@ -333,7 +333,7 @@ bgp_info_mpath_dequeue (struct bgp_info *binfo)
   if (mpath->mp_next)
     mpath->mp_next->mp_prev = mpath->mp_prev;
   mpath->mp_next = mpath->mp_prev = NULL;
-  UNSET_FLAG (binfo->flags, BGP_INFO_MULTIPATH);
+  bgp_info_unset_flag (binfo->net, binfo, BGP_INFO_MULTIPATH);
 }
 
 /*
@@ -472,6 +472,8 @@ show_ip_bgp_nexthop_table (struct vty *vty, const char *name, int detail)
     }
 
   bgp_show_nexthops (vty, bgp, detail);
+  if (detail)
+    bgp_nht_show_stats (vty);
 
   return CMD_SUCCESS;
 }
@@ -490,6 +492,8 @@ bgp_show_all_instances_nexthops_vty (struct vty *vty)
                VTY_NEWLINE);
       bgp_show_nexthops (vty, bgp, 0);
     }
+  vty_out (vty, "%s", VTY_NEWLINE);
+  bgp_nht_show_stats (vty);
 }
 
 DEFUN (show_ip_bgp_nexthop,
@@ -54,6 +54,7 @@ struct bgp_nexthop_cache
 #define BGP_NEXTHOP_PEER_NOTIFIED     (1 << 3)
 #define BGP_STATIC_ROUTE              (1 << 4)
 #define BGP_STATIC_ROUTE_EXACT_MATCH  (1 << 5)
+#define BGP_NEXTHOP_EVAL_PENDING      (1 << 6)
 
   u_int16_t change_flags;
 
@@ -62,6 +63,7 @@ struct bgp_nexthop_cache
 #define BGP_NEXTHOP_CONNECTED_CHANGED (1 << 2)
 
   struct bgp_node *node;
+  struct bgp_nexthop_cache *eval_next;	/* Updated by the same message */
   void *nht_info;		/* In BGP, peer session */
   LIST_HEAD(path_list, bgp_info) paths;
   unsigned int path_count;
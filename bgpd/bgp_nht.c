@@ -54,6 +54,31 @@ static int make_prefix(int afi, struct bgp_info *ri, struct prefix *p);
 static void path_nh_map(struct bgp_info *path, struct bgp_nexthop_cache *bnc,
 			int keep);
 
+/* Largest (un)registration entry: flags, family, length and address. */
+#define BGP_NHT_ENTRY_MAX	(1 + 2 + 1 + IPV6_MAX_BYTELEN)
+
+/* (Un)registrations waiting to be sent to zebra. */
+static struct
+{
+  struct stream *s;
+  struct thread *t_flush;
+  int command;
+  vrf_id_t vrf_id;
+  u_int32_t count;
+} nht_batch;
+
+/* How well messages to and from zebra are batched. */
+static struct
+{
+  u_int32_t reg;
+  u_int32_t reg_msgs;
+  u_int32_t reg_max;
+  u_int32_t upd;
+  u_int32_t upd_msgs;
+  u_int32_t upd_max;
+  u_int32_t paths;
+} nht_stats;
+
 static int
 bgp_isvalid_nexthop (struct bgp_nexthop_cache *bnc)
 {
@@ -351,12 +376,15 @@ bgp_delete_connected_nexthop (afi_t afi, struct peer *peer)
     }
 }
 
-void
-bgp_parse_nexthop_update (int command, vrf_id_t vrf_id)
+/* Parse one nexthop entry of an update from zebra, and bring the cache
+ * entry for it, if any, up to date.  Paths are evaluated by the caller.
+ */
+static int
+bgp_parse_nexthop_entry (struct bgp *bgp, int command, struct stream *s,
+                         struct bgp_nexthop_cache **bncp)
 {
-  struct stream *s;
   struct bgp_node *rn = NULL;
-  struct bgp_nexthop_cache *bnc;
+  struct bgp_nexthop_cache *bnc = NULL;
   struct nexthop *nexthop;
   struct nexthop *oldnh;
   struct nexthop *nhlist_head = NULL;
@@ -365,16 +393,8 @@ bgp_parse_nexthop_update (int command, vrf_id_t vrf_id)
   u_char nexthop_num;
   struct prefix p;
   int i;
-  struct bgp *bgp;
-
-  bgp = bgp_lookup_by_vrf_id (vrf_id);
-  if (!bgp)
-    {
-      zlog_err("parse nexthop update: instance not found for vrf_id %d", vrf_id);
-      return;
-    }
 
-  s = zclient->ibuf;
+  *bncp = NULL;
 
   memset(&p, 0, sizeof(struct prefix));
   p.family = stream_getw(s);
@@ -388,118 +408,128 @@ bgp_parse_nexthop_update (int command, vrf_id_t vrf_id)
       stream_get(&p.u.prefix6, s, 16);
       break;
     default:
-      break;
+      zlog_err("parse nexthop update: unknown family %d", p.family);
+      return -1;
     }
+  metric = stream_getl (s);
+  nexthop_num = stream_getc (s);
 
   if (command == ZEBRA_NEXTHOP_UPDATE)
     rn = bgp_node_lookup(bgp->nexthop_cache_table[family2afi(p.family)], &p);
   else if (command == ZEBRA_IMPORT_CHECK_UPDATE)
     rn = bgp_node_lookup(bgp->import_check_table[family2afi(p.family)], &p);
 
-  if (!rn || !rn->info)
+  if (rn && rn->info)
+    bnc = rn->info;
+  else if (BGP_DEBUG(nht, NHT))
     {
-      if (BGP_DEBUG(nht, NHT))
-	{
-	  char buf[PREFIX2STR_BUFFER];
-	  prefix2str(&p, buf, sizeof(buf));
-	  zlog_debug("parse nexthop update(%s): rn not found", buf);
-	}
-      if (rn)
-        bgp_unlock_node (rn);
-      return;
+      char buf[PREFIX2STR_BUFFER];
+      prefix2str(&p, buf, sizeof(buf));
+      zlog_debug("parse nexthop update(%s): rn not found", buf);
     }
+  if (rn)
+    bgp_unlock_node (rn);
 
-  bnc = rn->info;
-  bgp_unlock_node (rn);
-  bnc->last_update = bgp_clock();
-  bnc->change_flags = 0;
-  metric = stream_getl (s);
-  nexthop_num = stream_getc (s);
-
-  /* debug print the input */
-  if (BGP_DEBUG(nht, NHT))
+  if (bnc)
     {
-      char buf[PREFIX2STR_BUFFER];
-      prefix2str(&p, buf, sizeof (buf));
-      zlog_debug("%d: NH update for %s - metric %d (cur %d) #nhops %d (cur %d)",
-                 vrf_id, buf, metric, bnc->metric, nexthop_num, bnc->nexthop_num);
+      /* Changes seen earlier in the same message still count. */
+      if (!CHECK_FLAG(bnc->flags, BGP_NEXTHOP_EVAL_PENDING))
+        bnc->change_flags = 0;
+      bnc->last_update = bgp_clock();
+
+      /* debug print the input */
+      if (BGP_DEBUG(nht, NHT))
+        {
+          char buf[PREFIX2STR_BUFFER];
+          prefix2str(&p, buf, sizeof (buf));
+          zlog_debug("%d: NH update for %s - metric %d (cur %d) #nhops %d (cur %d)",
+                     bgp->vrf_id, buf, metric, bnc->metric, nexthop_num,
+                     bnc->nexthop_num);
+        }
+
+      if (metric != bnc->metric)
+        bnc->change_flags |= BGP_NEXTHOP_METRIC_CHANGED;
+
+      if(nexthop_num != bnc->nexthop_num)
+        bnc->change_flags |= BGP_NEXTHOP_CHANGED;
     }
 
-  if (metric != bnc->metric)
-    bnc->change_flags |= BGP_NEXTHOP_METRIC_CHANGED;
+  /* The nexthops are read even for an unknown entry, to get to the next. */
+  for (i = 0; i < nexthop_num; i++)
+    {
+      nexthop = nexthop_new();
+      nexthop->type = stream_getc (s);
+      switch (nexthop->type)
+        {
+        case NEXTHOP_TYPE_IPV4:
+          nexthop->gate.ipv4.s_addr = stream_get_ipv4 (s);
+          break;
+        case NEXTHOP_TYPE_IFINDEX:
+          nexthop->ifindex = stream_getl (s);
+          break;
+        case NEXTHOP_TYPE_IPV4_IFINDEX:
+          nexthop->gate.ipv4.s_addr = stream_get_ipv4 (s);
+          nexthop->ifindex = stream_getl (s);
+          break;
+        case NEXTHOP_TYPE_IPV6:
+          stream_get (&nexthop->gate.ipv6, s, 16);
+          break;
+        case NEXTHOP_TYPE_IPV6_IFINDEX:
+          stream_get (&nexthop->gate.ipv6, s, 16);
+          nexthop->ifindex = stream_getl (s);
+          break;
+        default:
+          /* do nothing */
+          break;
+        }
+
+      if (BGP_DEBUG(nht, NHT))
+        {
+          char buf[NEXTHOP_STRLEN];
+          zlog_debug("    nhop via %s",
+                     nexthop2str (nexthop, buf, sizeof (buf)));
+        }
 
-  if(nexthop_num != bnc->nexthop_num)
-    bnc->change_flags |= BGP_NEXTHOP_CHANGED;
+      if (nhlist_tail)
+        {
+          nhlist_tail->next = nexthop;
+          nhlist_tail = nexthop;
+        }
+      else
+        {
+          nhlist_tail = nexthop;
+          nhlist_head = nexthop;
+        }
+
+      /* No need to evaluate the nexthop if we have already determined
+       * that there has been a change.
+       */
+      if (!bnc || (bnc->change_flags & BGP_NEXTHOP_CHANGED))
+        continue;
+
+      for (oldnh = bnc->nexthop; oldnh; oldnh = oldnh->next)
+        if (nexthop_same_no_recurse(oldnh, nexthop))
+          break;
+
+      if (!oldnh)
+        bnc->change_flags |= BGP_NEXTHOP_CHANGED;
+    }
+
+  if (!bnc)
+    {
+      nexthops_free (nhlist_head);
+      return 0;
+    }
 
   if (nexthop_num)
     {
       /* notify bgp fsm if nbr ip goes from invalid->valid */
       if (!bnc->nexthop_num)
-	UNSET_FLAG(bnc->flags, BGP_NEXTHOP_PEER_NOTIFIED);
+        UNSET_FLAG(bnc->flags, BGP_NEXTHOP_PEER_NOTIFIED);
 
       bnc->flags |= BGP_NEXTHOP_VALID;
       bnc->metric = metric;
       bnc->nexthop_num = nexthop_num;
-
-      for (i = 0; i < nexthop_num; i++)
-	{
-	  nexthop = nexthop_new();
-	  nexthop->type = stream_getc (s);
-	  switch (nexthop->type)
-	    {
-	    case NEXTHOP_TYPE_IPV4:
-	      nexthop->gate.ipv4.s_addr = stream_get_ipv4 (s);
-	      break;
-	    case NEXTHOP_TYPE_IFINDEX:
-	      nexthop->ifindex = stream_getl (s);
-	      break;
-            case NEXTHOP_TYPE_IPV4_IFINDEX:
-	      nexthop->gate.ipv4.s_addr = stream_get_ipv4 (s);
-	      nexthop->ifindex = stream_getl (s);
-	      break;
-            case NEXTHOP_TYPE_IPV6:
-	      stream_get (&nexthop->gate.ipv6, s, 16);
-	      break;
-            case NEXTHOP_TYPE_IPV6_IFINDEX:
-	      stream_get (&nexthop->gate.ipv6, s, 16);
-	      nexthop->ifindex = stream_getl (s);
-	      break;
-            default:
-              /* do nothing */
-              break;
-	    }
-
-          if (BGP_DEBUG(nht, NHT))
-            {
-              char buf[NEXTHOP_STRLEN];
-              zlog_debug("    nhop via %s",
-                         nexthop2str (nexthop, buf, sizeof (buf)));
-            }
-
-	  if (nhlist_tail)
-	    {
-	      nhlist_tail->next = nexthop;
-	      nhlist_tail = nexthop;
-	    }
-	  else
-	    {
-	      nhlist_tail = nexthop;
-	      nhlist_head = nexthop;
-	    }
-
-	  /* No need to evaluate the nexthop if we have already determined
-	   * that there has been a change.
-	   */
-	  if (bnc->change_flags & BGP_NEXTHOP_CHANGED)
-	    continue;
-
-	  for (oldnh = bnc->nexthop; oldnh; oldnh = oldnh->next)
-	      if (nexthop_same_no_recurse(oldnh, nexthop))
-		  break;
-
-	  if (!oldnh)
-	    bnc->change_flags |= BGP_NEXTHOP_CHANGED;
-	}
       bnc_nexthop_free(bnc);
       bnc->nexthop = nhlist_head;
     }
@@ -515,7 +545,62 @@ bgp_parse_nexthop_update (int command, vrf_id_t vrf_id)
       bnc->nexthop = NULL;
     }
 
-  evaluate_paths(bnc);
+  *bncp = bnc;
+  return 0;
+}
+
+/* An update from zebra carries any number of nexthop entries.  All of
+ * them are parsed before any path is looked at, so that a node whose
+ * paths go through several of the changed nexthops is still queued for
+ * processing only once.
+ */
+void
+bgp_parse_nexthop_update (int command, vrf_id_t vrf_id)
+{
+  struct stream *s;
+  struct bgp_nexthop_cache *bnc;
+  struct bgp_nexthop_cache *pending = NULL;
+  struct bgp *bgp;
+  u_int32_t count = 0;
+
+  bgp = bgp_lookup_by_vrf_id (vrf_id);
+  if (!bgp)
+    {
+      zlog_err("parse nexthop update: instance not found for vrf_id %d", vrf_id);
+      return;
+    }
+
+  s = zclient->ibuf;
+
+  while (STREAM_READABLE (s) > 0)
+    {
+      if (bgp_parse_nexthop_entry (bgp, command, s, &bnc) < 0)
+        break;
+      count++;
+
+      if (bnc && !CHECK_FLAG(bnc->flags, BGP_NEXTHOP_EVAL_PENDING))
+        {
+          SET_FLAG(bnc->flags, BGP_NEXTHOP_EVAL_PENDING);
+          bnc->eval_next = pending;
+          pending = bnc;
+        }
+    }
+
+  nht_stats.upd += count;
+  nht_stats.upd_msgs++;
+  if (count > nht_stats.upd_max)
+    nht_stats.upd_max = count;
+
+  if (BGP_DEBUG(nht, NHT))
+    zlog_debug("%d: NH update message with %u entries", vrf_id, count);
+
+  while ((bnc = pending) != NULL)
+    {
+      pending = bnc->eval_next;
+      bnc->eval_next = NULL;
+      UNSET_FLAG(bnc->flags, BGP_NEXTHOP_EVAL_PENDING);
+      evaluate_paths(bnc);
+    }
 }
 
 /**
@@ -577,9 +662,48 @@ make_prefix (int afi, struct bgp_info *ri, struct prefix *p)
   return 0;
 }
 
+/* Send the batched nexthop (un)registrations to zebra. */
+static void
+bgp_nht_batch_flush (void)
+{
+  struct stream *s;
+  int ret;
+
+  if (!nht_batch.count)
+    return;
+
+  nht_stats.reg_msgs++;
+  if (nht_batch.count > nht_stats.reg_max)
+    nht_stats.reg_max = nht_batch.count;
+  nht_batch.count = 0;
+
+  if (!zclient || zclient->sock < 0)
+    return;
+
+  stream_putw_at (nht_batch.s, 0, stream_get_endp (nht_batch.s));
+  s = zclient->obuf;
+  stream_reset (s);
+  stream_put (s, STREAM_DATA (nht_batch.s), stream_get_endp (nht_batch.s));
+
+  ret = zclient_send_message(zclient);
+  /* TBD: handle the failure */
+  if (ret < 0)
+    zlog_warn("sendmsg_nexthop: zclient_send_message() failed");
+}
+
+static int
+bgp_nht_batch_timer (struct thread *thread)
+{
+  nht_batch.t_flush = NULL;
+  bgp_nht_batch_flush ();
+  return 0;
+}
+
 /**
  * sendmsg_zebra_rnh -- Format and send a nexthop register/Unregister
- *   command to Zebra.
+ *   command to Zebra.  Consecutive (un)registrations for the same VRF
+ *   share one message, sent when it is full, when the command changes,
+ *   or once the current event is done.
  * ARGUMENTS:
  *   struct bgp_nexthop_cache *bnc -- the nexthop structure.
  *   int command -- command to send to zebra
@@ -591,7 +715,6 @@ sendmsg_zebra_rnh (struct bgp_nexthop_cache *bnc, int command)
 {
   struct stream *s;
   struct prefix *p;
-  int ret;
 
   /* Check socket. */
   if (!zclient || zclient->sock < 0)
@@ -601,10 +724,27 @@ sendmsg_zebra_rnh (struct bgp_nexthop_cache *bnc, int command)
   if (!IS_BGP_INST_KNOWN_TO_ZEBRA(bnc->bgp))
     return;
 
+  if (nht_batch.count
+      && (nht_batch.command != command || nht_batch.vrf_id != bnc->bgp->vrf_id
+          || STREAM_WRITEABLE (nht_batch.s) < BGP_NHT_ENTRY_MAX))
+    bgp_nht_batch_flush ();
+
+  if (!nht_batch.s)
+    nht_batch.s = stream_new (ZEBRA_MAX_PACKET_SIZ);
+  s = nht_batch.s;
+
+  if (!nht_batch.count)
+    {
+      stream_reset (s);
+      zclient_create_header (s, command, bnc->bgp->vrf_id);
+      nht_batch.command = command;
+      nht_batch.vrf_id = bnc->bgp->vrf_id;
+      if (!nht_batch.t_flush)
+        nht_batch.t_flush = thread_add_event (bm->master, bgp_nht_batch_timer,
+                                              NULL, 0);
+    }
+
   p = &(bnc->node->p);
-  s = zclient->obuf;
-  stream_reset (s);
-  zclient_create_header (s, command, bnc->bgp->vrf_id);
   if (CHECK_FLAG(bnc->flags, BGP_NEXTHOP_CONNECTED) ||
       CHECK_FLAG(bnc->flags, BGP_STATIC_ROUTE_EXACT_MATCH))
     stream_putc(s, 1);
@@ -626,12 +766,8 @@ sendmsg_zebra_rnh (struct bgp_nexthop_cache *bnc, int command)
     default:
       break;
     }
-  stream_putw_at (s, 0, stream_get_endp (s));
-
-  ret = zclient_send_message(zclient);
-  /* TBD: handle the failure */
-  if (ret < 0)
-    zlog_warn("sendmsg_nexthop: zclient_send_message() failed");
+  nht_batch.count++;
+  nht_stats.reg++;
 
   if ((command == ZEBRA_NEXTHOP_REGISTER) ||
       (command == ZEBRA_IMPORT_ROUTE_REGISTER))
@@ -747,6 +883,7 @@ evaluate_paths (struct bgp_nexthop_cache *bnc)
 	SET_FLAG(path->flags, BGP_INFO_IGP_CHANGED);
 
       bgp_process(bgp, rn, afi, SAFI_UNICAST);
+      nht_stats.paths++;
     }
 
   if (peer && !CHECK_FLAG(bnc->flags, BGP_NEXTHOP_PEER_NOTIFIED))
@@ -784,3 +921,13 @@ path_nh_map (struct bgp_info *path, struct bgp_nexthop_cache *bnc, int make)
       path->nexthop->path_count++;
     }
 }
+
+void
+bgp_nht_show_stats (struct vty *vty)
+{
+  vty_out (vty, "Zebra registrations: %u in %u messages, largest %u%s",
+           nht_stats.reg, nht_stats.reg_msgs, nht_stats.reg_max, VTY_NEWLINE);
+  vty_out (vty, "Zebra updates: %u in %u messages, largest %u, %u paths evaluated%s",
+           nht_stats.upd, nht_stats.upd_msgs, nht_stats.upd_max,
+           nht_stats.paths, VTY_NEWLINE);
+}
@@ -67,4 +67,10 @@ void bgp_unlink_nexthop_by_peer (struct peer *);
  */
 extern void bgp_delete_connected_nexthop (afi_t afi, struct peer *peer);
 
+/**
+ * bgp_nht_show_stats() - Show how nexthop registrations and updates are
+ * batched in the messages exchanged with zebra.
+ */
+extern void bgp_nht_show_stats (struct vty *vty);
+
 #endif /* _BGP_NHT_H */
@@ -706,6 +706,7 @@ bgp_capability_hostname (struct peer *peer, struct capability_header *hdr)
   { CAPABILITY_CODE_ADDPATH,            "AddPath"                       },
   { CAPABILITY_CODE_DYNAMIC,		"Dynamic"			},
   { CAPABILITY_CODE_ENHE,               "Extended Next Hop Encoding"    },
+  { CAPABILITY_CODE_EXT_MESSAGE,        "Extended Message"              },
   { CAPABILITY_CODE_DYNAMIC_OLD,	"Dynamic (Old)"			},
   { CAPABILITY_CODE_REFRESH_OLD,	"Route Refresh (Old)"		},
   { CAPABILITY_CODE_ORF_OLD,		"ORF (Old)"			},
@@ -725,6 +726,7 @@ static const size_t cap_minsizes[] =
   [CAPABILITY_CODE_DYNAMIC]	= CAPABILITY_CODE_DYNAMIC_LEN,
   [CAPABILITY_CODE_DYNAMIC_OLD]	= CAPABILITY_CODE_DYNAMIC_LEN,
   [CAPABILITY_CODE_ENHE]        = CAPABILITY_CODE_ENHE_LEN,
+  [CAPABILITY_CODE_EXT_MESSAGE] = CAPABILITY_CODE_EXT_MESSAGE_LEN,
   [CAPABILITY_CODE_REFRESH_OLD]	= CAPABILITY_CODE_REFRESH_LEN,
   [CAPABILITY_CODE_ORF_OLD]	= CAPABILITY_CODE_ORF_LEN,
   [CAPABILITY_CODE_FQDN]        = CAPABILITY_CODE_MIN_FQDN_LEN,
@@ -746,6 +748,7 @@ static const size_t cap_modsizes[] =
   [CAPABILITY_CODE_DYNAMIC]     = 1,
   [CAPABILITY_CODE_DYNAMIC_OLD] = 1,
   [CAPABILITY_CODE_ENHE]        = 6,
+  [CAPABILITY_CODE_EXT_MESSAGE] = 1,
   [CAPABILITY_CODE_REFRESH_OLD] = 1,
   [CAPABILITY_CODE_ORF_OLD]     = 1,
   [CAPABILITY_CODE_FQDN]        = 1,
@@ -815,6 +818,7 @@ bgp_capability_parse (struct peer *peer, size_t length, int *mp_capability,
           case CAPABILITY_CODE_DYNAMIC:
           case CAPABILITY_CODE_DYNAMIC_OLD:
           case CAPABILITY_CODE_ENHE:
+          case CAPABILITY_CODE_EXT_MESSAGE:
 	  case CAPABILITY_CODE_FQDN:
               /* Check length. */
               if (caphdr.length < cap_minsizes[caphdr.code])
@@ -904,6 +908,9 @@ bgp_capability_parse (struct peer *peer, size_t length, int *mp_capability,
           case CAPABILITY_CODE_ENHE:
             ret = bgp_capability_enhe (peer, &caphdr);
             break;
+          case CAPABILITY_CODE_EXT_MESSAGE:
+            SET_FLAG (peer->cap, PEER_CAP_EXT_MESSAGE_RCV);
+            break;
 	  case CAPABILITY_CODE_FQDN:
 	    ret = bgp_capability_hostname (peer, &caphdr);
 	    break;
@@ -1318,6 +1325,16 @@ bgp_open_capability (struct stream *s, struct peer *peer)
   stream_putc (s, CAPABILITY_CODE_REFRESH);
   stream_putc (s, CAPABILITY_CODE_REFRESH_LEN);
 
+  /* Extended messages, RFC 8654. */
+  if (! CHECK_FLAG (peer->flags, PEER_FLAG_DISABLE_EXT_MESSAGE))
+    {
+      SET_FLAG (peer->cap, PEER_CAP_EXT_MESSAGE_ADV);
+      stream_putc (s, BGP_OPEN_OPT_CAP);
+      stream_putc (s, CAPABILITY_CODE_EXT_MESSAGE_LEN + 2);
+      stream_putc (s, CAPABILITY_CODE_EXT_MESSAGE);
+      stream_putc (s, CAPABILITY_CODE_EXT_MESSAGE_LEN);
+    }
+
   /* AS4 */
   SET_FLAG (peer->cap, PEER_CAP_AS4_ADV);
   stream_putc (s, BGP_OPEN_OPT_CAP);
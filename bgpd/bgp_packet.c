@@ -239,13 +239,14 @@ bgp_write_packet (struct peer *peer)
 	 * the next AFI, SAFI.
 	 * Don't send the EOR prematurely... if the subgroup's coalesce
 	 * timer is running, the adjacency-out structure is not created
-	 * yet.
+	 * yet, and if its pack timer is, UPDATEs are being held back.
 	 */
         if (!next_pkt || !next_pkt->buffer)
           {
 	    if (CHECK_FLAG (peer->cap, PEER_CAP_RESTART_RCV))
 	      {
 		if (!(PAF_SUBGRP(paf))->t_coalesce &&
+		    !(PAF_SUBGRP(paf))->t_pack &&
 		    peer->afc_nego[afi][safi] && peer->synctime
 		    && ! CHECK_FLAG (peer->af_sflags[afi][safi],
 				     PEER_STATUS_EOR_SEND)
@@ -317,11 +318,14 @@ bgp_write_proceed_actions (struct peer *peer)
             BGP_WRITE_ON (peer->t_write, bgp_write, peer->fd);
             return;
           }
+        else if (subgroup_pack_held (subgrp))
+          subgroup_pack_start (subgrp);
 
         /* No packets to send, see if EOR is pending */
         if (CHECK_FLAG (peer->cap, PEER_CAP_RESTART_RCV))
           {
             if (!subgrp->t_coalesce &&
+                !subgrp->t_pack &&
                 peer->afc_nego[afi][safi] &&
                 peer->synctime &&
                 !CHECK_FLAG(peer->af_sflags[afi][safi],
@@ -598,7 +602,7 @@ bgp_notify_send_with_data (struct peer *peer, u_char code, u_char sub_code,
   int length;
 
   /* Allocate new stream. */
-  s = stream_new (BGP_MAX_PACKET_SIZE);
+  s = stream_new (peer->max_packet_size);
 
   /* Make nitify packet. */
   bgp_packet_set_marker (s, BGP_MSG_NOTIFY);
@@ -607,9 +611,10 @@ bgp_notify_send_with_data (struct peer *peer, u_char code, u_char sub_code,
   stream_putc (s, code);        /* BGP notify code */
   stream_putc (s, sub_code);	/* BGP notify sub_code */
 
-  /* If notify data is present. */
+  /* If notify data is present.  It may quote an extended message that
+     does not fit.  */
   if (data)
-    stream_write (s, data, datalen);
+    stream_write (s, data, MIN (datalen, STREAM_WRITEABLE (s)));
   
   /* Set BGP packet length. */
   length = bgp_packet_set_size (s);
@@ -1199,6 +1204,12 @@ bgp_open_receive (struct peer *peer, bgp_size_t size)
     }
   peer->rtt = sockopt_tcp_rtt (peer->fd);
 
+  if (CHECK_FLAG (peer->cap, PEER_CAP_EXT_MESSAGE_ADV)
+      && CHECK_FLAG (peer->cap, PEER_CAP_EXT_MESSAGE_RCV))
+    peer->max_packet_size = BGP_EXTENDED_MESSAGE_MAX_PACKET_SIZE;
+  else
+    peer->max_packet_size = BGP_MAX_PACKET_SIZE;
+
   if ((ret = bgp_event_update(peer, Receive_OPEN_message)) < 0)
     {
       zlog_err("%s: BGP event update failed for peer: %s", __FUNCTION__,
@@ -1351,7 +1362,7 @@ bgp_afi_safi_valid_indices (afi_t afi, safi_t safi)
 }
 
 /* Parse BGP Update packet and make attribute object. */
-static int
+int
 bgp_update_receive (struct peer *peer, bgp_size_t size)
 {
   int ret, nlri_ret;
@@ -1471,12 +1482,21 @@ bgp_update_receive (struct peer *peer, bgp_size_t size)
   /* Parse attribute when it exists. */
   if (attribute_len)
     {
-      attr_parse_ret = bgp_attr_parse (peer, &attr, attribute_len, 
-			    &nlris[NLRI_MP_UPDATE], &nlris[NLRI_MP_WITHDRAW]);
-      if (attr_parse_ret == BGP_ATTR_PARSE_ERROR)
+      u_char *attrp = stream_pnt (s);
+
+      if (! bgp_attr_cache_get (peer, attribute_len, &attr,
+				&nlris[NLRI_MP_UPDATE]))
 	{
-	  bgp_attr_unintern_sub (&attr);
-	  return -1;
+	  attr_parse_ret = bgp_attr_parse (peer, &attr, attribute_len,
+				&nlris[NLRI_MP_UPDATE], &nlris[NLRI_MP_WITHDRAW]);
+	  if (attr_parse_ret == BGP_ATTR_PARSE_ERROR)
+	    {
+	      bgp_attr_unintern_sub (&attr);
+	      return -1;
+	    }
+	  if (attr_parse_ret == BGP_ATTR_PARSE_PROCEED)
+	    bgp_attr_cache_put (peer, attrp, attribute_len, &attr,
+				&nlris[NLRI_MP_UPDATE]);
 	}
     }
   
@@ -2276,7 +2296,8 @@ bgp_read (struct thread *thread)
 	}
       /* Mimimum packet length check. */
       if ((size < BGP_HEADER_SIZE)
-	  || (size > BGP_MAX_PACKET_SIZE)
+	  || (size > peer->max_packet_size)
+	  || (type == BGP_MSG_OPEN && size > BGP_MAX_PACKET_SIZE)
 	  || (type == BGP_MSG_OPEN && size < BGP_MSG_OPEN_MIN_SIZE)
 	  || (type == BGP_MSG_UPDATE && size < BGP_MSG_UPDATE_MIN_SIZE)
 	  || (type == BGP_MSG_NOTIFY && size < BGP_MSG_NOTIFY_MIN_SIZE)
@@ -2297,8 +2318,11 @@ bgp_read (struct thread *thread)
 	  goto done;
 	}
 
-      /* Adjust size to message length. */
+      /* Adjust size to message length.  The input buffer is only grown
+	 once an extended message actually comes in.  */
       peer->packet_size = size;
+      if (size > STREAM_SIZE (peer->ibuf))
+	stream_resize (peer->ibuf, peer->max_packet_size);
     }
 
   ret = bgp_read_packet (peer);
@@ -2348,8 +2372,10 @@ bgp_read (struct thread *thread)
    */
   if (notify_out < peer->notify_out)
     {
-      memcpy(peer->last_reset_cause, peer->ibuf->data, peer->packet_size);
-      peer->last_reset_cause_size = peer->packet_size;
+      peer->last_reset_cause_size = MIN (peer->packet_size,
+                                         sizeof (peer->last_reset_cause));
+      memcpy (peer->last_reset_cause, peer->ibuf->data,
+              peer->last_reset_cause_size);
       notify_out = peer->notify_out;
     }
 
@@ -2364,8 +2390,10 @@ bgp_read (struct thread *thread)
    */
   if (notify_out < peer->notify_out)
     {
-      memcpy(peer->last_reset_cause, peer->ibuf->data, peer->packet_size);
-      peer->last_reset_cause_size = peer->packet_size;
+      peer->last_reset_cause_size = MIN (peer->packet_size,
+                                         sizeof (peer->last_reset_cause));
+      memcpy (peer->last_reset_cause, peer->ibuf->data,
+              peer->last_reset_cause_size);
     }
 
   return 0;
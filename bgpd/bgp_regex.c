@@ -81,10 +81,26 @@ bgp_regcomp (const char *regstr)
   return regex;
 }
 
+/* Match against the cached AS path string when there is one.
+   Otherwise render a temporary copy rather than keeping a string for
+   every path that a filter looks at. */
 int
 bgp_regexec (regex_t *regex, struct aspath *aspath)
 {
-  return regexec (regex, aspath->str, 0, NULL, 0);
+  char *str;
+  int ret;
+
+  if (aspath->str)
+    return regexec (regex, aspath->str, 0, NULL, 0);
+
+  str = aspath_str_render (aspath);
+  if (!str)
+    return REG_NOMATCH;
+
+  ret = regexec (regex, str, 0, NULL, 0);
+  XFREE (MTYPE_AS_STR, str);
+
+  return ret;
 }
 
 void
@@ -93,3 +109,151 @@ bgp_regex_free (regex_t *regex)
   regfree (regex);
   XFREE (MTYPE_BGP_REGEXP, regex);
 }
+
+/* Most AS path filters name whole AS numbers only, e.g. "_65001_",
+   "^65001_" or "_65001$".  Those are compiled into a list of AS numbers
+   and matched against the path segments directly, without rendering
+   or scanning the AS path string.  Anything else returns NULL and is
+   left to bgp_regcomp/bgp_regexec. */
+struct bgp_regex_fast *
+bgp_regcomp_fast (const char *regstr)
+{
+  struct bgp_regex_fast *fast;
+  as_t asns[BGP_REGEX_FAST_MAX];
+  unsigned int count = 0;
+  int start;
+  int end;
+  unsigned long val;
+  const char *p = regstr;
+  char *endp;
+
+  if (strcmp (regstr, ".*") == 0)
+    {
+      fast = XCALLOC (MTYPE_BGP_REGEXP, sizeof (struct bgp_regex_fast));
+      fast->any = 1;
+      return fast;
+    }
+
+  if (*p == '^')
+    start = 1;
+  else if (*p == '_')
+    start = 0;
+  else
+    return NULL;
+  p++;
+
+  if (start && strcmp (p, "$") == 0)
+    end = 1;
+  else
+    for (;;)
+      {
+	/* A leading zero would never match the rendered path. */
+	if (! isdigit ((int) *p) || (*p == '0' && isdigit ((int) p[1])))
+	  return NULL;
+	if (count == BGP_REGEX_FAST_MAX)
+	  return NULL;
+
+	errno = 0;
+	val = strtoul (p, &endp, 10);
+	if (errno || val > UINT32_MAX)
+	  return NULL;
+	asns[count++] = val;
+	p = endp;
+
+	if (*p == '_')
+	  {
+	    if (*++p == '\0')
+	      {
+		end = 0;
+		break;
+	      }
+	  }
+	else if (strcmp (p, "$") == 0)
+	  {
+	    end = 1;
+	    break;
+	  }
+	else
+	  return NULL;
+      }
+
+  fast = XCALLOC (MTYPE_BGP_REGEXP, sizeof (struct bgp_regex_fast)
+                                    + count * sizeof (as_t));
+  fast->start = start;
+  fast->end = end;
+  fast->count = count;
+  memcpy (fast->asns, asns, count * sizeof (as_t));
+
+  return fast;
+}
+
+/* Return 1 if the path matches, 0 if not, and -1 if the path contains
+   AS_SET or confederation segments, whose delimiters the pattern may
+   match on and which are therefore left to bgp_regexec.  */
+int
+bgp_regexec_fast (struct bgp_regex_fast *fast, struct aspath *aspath)
+{
+  struct assegment *seg;
+  struct assegment *s;
+  unsigned int total = 0;
+  unsigned int pos = 0;
+  unsigned int first;
+  unsigned int last;
+  unsigned int i;
+  unsigned int j;
+  unsigned int k;
+
+  if (fast->any)
+    return 1;
+
+  for (seg = aspath->segments; seg; seg = seg->next)
+    {
+      if (seg->type != AS_SEQUENCE)
+	return -1;
+      total += seg->length;
+    }
+
+  if (total < fast->count)
+    return 0;
+
+  first = 0;
+  last = total - fast->count;
+  if (fast->start)
+    last = 0;
+  if (fast->end)
+    first = total - fast->count;
+  if (first > last)
+    return 0;
+
+  /* Try each candidate position, walking segments in step. */
+  for (seg = aspath->segments, i = 0; seg; seg = seg->next, i = 0)
+    for (; i < seg->length; i++, pos++)
+      {
+	if (pos < first)
+	  continue;
+	if (pos > last)
+	  return 0;
+
+	for (s = seg, j = i, k = 0; k < fast->count; k++, j++)
+	  {
+	    while (j == s->length)
+	      {
+		s = s->next;
+		j = 0;
+	      }
+	    if (s->as[j] != fast->asns[k])
+	      break;
+	  }
+	if (k == fast->count)
+	  return 1;
+      }
+
+  /* Only the empty path is left, for "^$". */
+  return (fast->count == 0 && total == 0);
+}
+
+void
+bgp_regex_fast_free (struct bgp_regex_fast *fast)
+{
+  XFREE (MTYPE_BGP_REGEXP, fast);
+}
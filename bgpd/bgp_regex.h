@@ -33,8 +33,31 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 # endif /* HAVE_GNU_REGEX */
 #endif /* HAVE_LIBPCREPOSIX */
 
+struct aspath;
+
+#define BGP_REGEX_FAST_MAX 16
+
+/* AS path regular expression naming whole AS numbers only, see
+   bgp_regcomp_fast.  */
+struct bgp_regex_fast
+{
+  /* Matches anything, ".*".  */
+  u_char any;
+
+  /* Anchored at the first/last AS of the path.  */
+  u_char start;
+  u_char end;
+
+  /* Consecutive AS numbers to look for.  */
+  unsigned int count;
+  as_t asns[];
+};
+
 extern void bgp_regex_free (regex_t *regex);
 extern regex_t *bgp_regcomp (const char *str);
 extern int bgp_regexec (regex_t *regex, struct aspath *aspath);
+extern struct bgp_regex_fast *bgp_regcomp_fast (const char *);
+extern int bgp_regexec_fast (struct bgp_regex_fast *, struct aspath *);
+extern void bgp_regex_fast_free (struct bgp_regex_fast *);
 
 #endif /* _QUAGGA_BGP_REGEX_H */
@@ -170,6 +170,72 @@ bgp_info_extra_get (struct bgp_info *ri)
   return ri->extra;
 }
 
+/* Keep the peer's list of its paths in sync with the RIB.  */
+static void
+bgp_info_peer_link (struct bgp_node *rn, struct bgp_info *ri)
+{
+  struct bgp_table *table = bgp_node_table (rn);
+  struct bgp_info **head = &ri->peer->paths[table->afi][table->safi];
+
+  ri->peer_next = *head;
+  ri->peer_prev = NULL;
+  if (*head)
+    (*head)->peer_prev = ri;
+  *head = ri;
+}
+
+static void
+bgp_info_peer_unlink (struct bgp_node *rn, struct bgp_info *ri)
+{
+  struct bgp_table *table = bgp_node_table (rn);
+
+  if (ri->peer_next)
+    ri->peer_next->peer_prev = ri->peer_prev;
+  if (ri->peer_prev)
+    ri->peer_prev->peer_next = ri->peer_next;
+  else
+    ri->peer->paths[table->afi][table->safi] = ri->peer_next;
+  ri->peer_next = ri->peer_prev = NULL;
+}
+
+static int
+bgp_info_peer_linked (struct bgp_node *rn, struct bgp_info *ri)
+{
+  struct bgp_table *table = bgp_node_table (rn);
+
+  return ri->peer_prev || ri->peer->paths[table->afi][table->safi] == ri;
+}
+
+/* Add a path's share to, or with a negative dir take it away from, the
+   counts of its peer.  */
+static void
+bgp_info_pcount_tally (struct bgp_node *rn, struct bgp_info *ri, int dir)
+{
+  struct bgp_table *table = bgp_node_table (rn);
+  unsigned long *count = ri->peer->pcounts[table->afi][table->safi];
+  unsigned long n = dir > 0 ? 1 : -1UL;
+
+  count[PCOUNT_ALL] += n;
+  if (CHECK_FLAG (ri->flags, BGP_INFO_DAMPED))
+    count[PCOUNT_DAMPED] += n;
+  if (CHECK_FLAG (ri->flags, BGP_INFO_HISTORY))
+    count[PCOUNT_HISTORY] += n;
+  if (CHECK_FLAG (ri->flags, BGP_INFO_REMOVED))
+    count[PCOUNT_REMOVED] += n;
+  if (CHECK_FLAG (ri->flags, BGP_INFO_STALE))
+    count[PCOUNT_STALE] += n;
+  if (CHECK_FLAG (ri->flags, BGP_INFO_VALID))
+    count[PCOUNT_VALID] += n;
+  if (CHECK_FLAG (ri->flags, BGP_INFO_SELECTED))
+    count[PCOUNT_BEST] += n;
+  if (CHECK_FLAG (ri->flags, BGP_INFO_MULTIPATH))
+    count[PCOUNT_MULTIPATH] += n;
+  if (CHECK_FLAG (ri->flags, BGP_INFO_COUNTED))
+    count[PCOUNT_COUNTED] += n;
+  if (!CHECK_FLAG (ri->flags, BGP_INFO_UNUSEABLE))
+    count[PCOUNT_PFCNT] += n;
+}
+
 /* Allocate new bgp info structure. */
 struct bgp_info *
 bgp_info_new (void)
@@ -230,10 +296,12 @@ bgp_info_unlock (struct bgp_info *binfo)
 void
 bgp_info_add (struct bgp_node *rn, struct bgp_info *ri)
 {
+  struct bgp_table *table;
   struct bgp_info *top;
 
   top = rn->info;
   
+  ri->net = rn;
   ri->next = rn->info;
   ri->prev = NULL;
   if (top)
@@ -243,6 +311,26 @@ bgp_info_add (struct bgp_node *rn, struct bgp_info *ri)
   bgp_info_lock (ri);
   bgp_lock_node (rn);
   peer_lock (ri->peer); /* bgp_info peer reference */
+
+  bgp_info_peer_link (rn, ri);
+  bgp_info_pcount_tally (rn, ri, 1);
+
+  table = bgp_node_table (rn);
+  if (!top)
+    {
+      table->prefix_count++;
+      table->prefix_len_total += rn->p.prefixlen;
+    }
+  table->path_count++;
+}
+
+static void
+bgp_clear_node_complete (struct peer *peer)
+{
+  /* Tickle FSM to start moving again */
+  BGP_EVENT_ADD (peer, Clearing_Completed);
+
+  peer_unlock (peer); /* bgp_clear_route */
 }
 
 /* Do the actual removal of info from RIB, for use by bgp_process 
@@ -250,6 +338,8 @@ bgp_info_add (struct bgp_node *rn, struct bgp_info *ri)
 static void
 bgp_info_reap (struct bgp_node *rn, struct bgp_info *ri)
 {
+  struct bgp_table *table = bgp_node_table (rn);
+
   if (ri->next)
     ri->next->prev = ri->prev;
   if (ri->prev)
@@ -257,7 +347,25 @@ bgp_info_reap (struct bgp_node *rn, struct bgp_info *ri)
   else
     rn->info = ri->next;
   
+  if (!rn->info)
+    {
+      table->prefix_count--;
+      table->prefix_len_total -= rn->p.prefixlen;
+    }
+  table->path_count--;
+
+  bgp_info_pcount_tally (rn, ri, -1);
+  bgp_info_peer_unlink (rn, ri);
   bgp_info_mpath_dequeue (ri);
+
+  /* Reaped before the clear queue got to it: nothing is left to clear. */
+  if (CHECK_FLAG (ri->flags, BGP_INFO_CLEAR_PENDING))
+    {
+      UNSET_FLAG (ri->flags, BGP_INFO_CLEAR_PENDING);
+      if (--ri->peer->clear_pending == 0)
+        bgp_clear_node_complete (ri->peer);
+    }
+
   bgp_info_unlock (ri);
   bgp_unlock_node (rn);
 }
@@ -266,8 +374,9 @@ void
 bgp_info_delete (struct bgp_node *rn, struct bgp_info *ri)
 {
   bgp_info_set_flag (rn, ri, BGP_INFO_REMOVED);
-  /* set of previous already took care of pcount */
-  UNSET_FLAG (ri->flags, BGP_INFO_VALID);
+  /* set of previous already took care of pcount, going through
+     unset here keeps the per-peer path counts */
+  bgp_info_unset_flag (rn, ri, BGP_INFO_VALID);
 }
 
 /* undo the effects of a previous call to bgp_info_delete; typically
@@ -277,8 +386,9 @@ void
 bgp_info_restore (struct bgp_node *rn, struct bgp_info *ri)
 {
   bgp_info_unset_flag (rn, ri, BGP_INFO_REMOVED);
-  /* unset of previous already took care of pcount */
-  SET_FLAG (ri->flags, BGP_INFO_VALID);
+  /* unset of previous already took care of pcount, going through
+     set here keeps the per-peer path counts */
+  bgp_info_set_flag (rn, ri, BGP_INFO_VALID);
 }
 
 /* Adjust pcount as required */   
@@ -321,31 +431,53 @@ bgp_pcount_adjust (struct bgp_node *rn, struct bgp_info *ri)
 }
 
 
+/* Flags the per-peer path counts are kept by.  */
+#define BGP_INFO_PCOUNT_FLAGS \
+  (BGP_INFO_DAMPED|BGP_INFO_HISTORY|BGP_INFO_SELECTED|BGP_INFO_VALID \
+   |BGP_INFO_STALE|BGP_INFO_REMOVED|BGP_INFO_MULTIPATH)
+
 /* Set/unset bgp_info flags, adjusting any other state as needed.
  * This is here primarily to keep prefix-count in check.
  */
 void
 bgp_info_set_flag (struct bgp_node *rn, struct bgp_info *ri, u_int32_t flag)
 {
+  int tally;
+
+  /* Paths not yet added are counted by bgp_info_add.  */
+  tally = CHECK_FLAG (flag, BGP_INFO_PCOUNT_FLAGS)
+          && bgp_info_peer_linked (rn, ri);
+  if (tally)
+    bgp_info_pcount_tally (rn, ri, -1);
+
   SET_FLAG (ri->flags, flag);
   
-  /* early bath if we know it's not a flag that changes countability state */
-  if (!CHECK_FLAG (flag, BGP_INFO_VALID|BGP_INFO_HISTORY|BGP_INFO_REMOVED))
-    return;
-  
-  bgp_pcount_adjust (rn, ri);
+  /* only these flags change countability state */
+  if (CHECK_FLAG (flag, BGP_INFO_VALID|BGP_INFO_HISTORY|BGP_INFO_REMOVED))
+    bgp_pcount_adjust (rn, ri);
+
+  if (tally)
+    bgp_info_pcount_tally (rn, ri, 1);
 }
 
 void
 bgp_info_unset_flag (struct bgp_node *rn, struct bgp_info *ri, u_int32_t flag)
 {
+  int tally;
+
+  tally = CHECK_FLAG (flag, BGP_INFO_PCOUNT_FLAGS)
+          && bgp_info_peer_linked (rn, ri);
+  if (tally)
+    bgp_info_pcount_tally (rn, ri, -1);
+
   UNSET_FLAG (ri->flags, flag);
   
-  /* early bath if we know it's not a flag that changes countability state */
-  if (!CHECK_FLAG (flag, BGP_INFO_VALID|BGP_INFO_HISTORY|BGP_INFO_REMOVED))
-    return;
-  
-  bgp_pcount_adjust (rn, ri);
+  /* only these flags change countability state */
+  if (CHECK_FLAG (flag, BGP_INFO_VALID|BGP_INFO_HISTORY|BGP_INFO_REMOVED))
+    bgp_pcount_adjust (rn, ri);
+
+  if (tally)
+    bgp_info_pcount_tally (rn, ri, 1);
 }
 
 /* Get MED value.  If MED value is missing and "bgp bestpath
@@ -1081,7 +1213,7 @@ bgp_input_modifier (struct peer *peer, struct prefix *p, struct attr *attr,
       SET_FLAG (peer->rmap_type, PEER_RMAP_TYPE_IN); 
 
       /* Apply BGP route map to the attribute. */
-      ret = route_map_apply (rmap, p, RMAP_BGP, &info);
+      ret = bgp_route_map_apply (rmap, p, &info);
 
       peer->rmap_type = 0;
 
@@ -1138,7 +1270,7 @@ bgp_output_modifier (struct peer *peer, struct prefix *p, struct attr *attr,
       SET_FLAG (peer->rmap_type, PEER_RMAP_TYPE_OUT);
 
       /* Apply BGP route map to the attribute. */
-      ret = route_map_apply (rmap, p, RMAP_BGP, &info);
+      ret = bgp_route_map_apply (rmap, p, &info);
 
       peer->rmap_type = 0;
 
@@ -1525,9 +1657,9 @@ subgroup_announce_check (struct bgp_info *ri, struct update_subgroup *subgrp,
       SET_FLAG (peer->rmap_type, PEER_RMAP_TYPE_OUT);
 
       if (ri->extra && ri->extra->suppress)
-	ret = route_map_apply (UNSUPPRESS_MAP (filter), p, RMAP_BGP, &info);
+	ret = bgp_route_map_apply (UNSUPPRESS_MAP (filter), p, &info);
       else
-	ret = route_map_apply (ROUTE_MAP_OUT (filter), p, RMAP_BGP, &info);
+	ret = bgp_route_map_apply (ROUTE_MAP_OUT (filter), p, &info);
 
       peer->rmap_type = 0;
 
@@ -1900,50 +2032,33 @@ bgp_zebra_has_route_changed (struct bgp_node *rn, struct bgp_info *selected)
   return 0;
 }
 
-struct bgp_process_queue
+/* Maximum number of nodes taken off a bgp_process_queue per work queue
+ * run.  Best-path selection is run over the whole batch before any of the
+ * side effects are applied.
+ */
+#define BGP_PROCESS_BATCH_MAX 64
+
+/* End-of-initial-update mark.  It runs once every node that was already
+ * scheduled when the mark was added has been processed.
+ */
+struct bgp_process_eoiu
 {
-  struct bgp *bgp;
-  struct bgp_node *rn;
-  afi_t afi;
-  safi_t safi;
+  struct bgp_process_queue pq;
+  u_int64_t wait[AFI_MAX][SAFI_MAX];
 };
 
-static wq_item_status
-bgp_process_main (struct work_queue *wq, void *data)
+/*
+ * Apply the outcome of best-path selection for a node: flag updates,
+ * update-group announcement, VNC import and FIB install/withdraw.
+ * Must be called in the order the nodes were selected.
+ */
+static void
+bgp_process_apply (struct bgp *bgp, struct bgp_node *rn, afi_t afi,
+                   safi_t safi, struct bgp_info_pair *old_and_new)
 {
-  struct bgp_process_queue *pq = data;
-  struct bgp *bgp = pq->bgp;
-  struct bgp_node *rn = pq->rn;
-  afi_t afi = pq->afi;
-  safi_t safi = pq->safi;
   struct prefix *p = &rn->p;
-  struct bgp_info *new_select;
-  struct bgp_info *old_select;
-  struct bgp_info_pair old_and_new;
-
-  /* Is it end of initial update? (after startup) */
-  if (!rn)
-    {
-      quagga_timestamp(3, bgp->update_delay_zebra_resume_time,
-                       sizeof(bgp->update_delay_zebra_resume_time));
-
-      bgp->main_zebra_update_hold = 0;
-      for (afi = AFI_IP; afi < AFI_MAX; afi++)
-        for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
-          {
-            if (is_bgp_zebra_rib_route (bgp, afi, safi))
-              bgp_install_routes_for_afi_safi (bgp, afi, safi);
-          }
-      bgp->main_peers_update_hold = 0;
-
-      bgp_start_routeadv(bgp);
-      return WQ_SUCCESS;
-    }
-
-  /* Best path selection. */
-  bgp_best_selection (bgp, rn, &bgp->maxpaths[afi][safi], &old_and_new);
-  old_select = old_and_new.old;
-  new_select = old_and_new.new;
+  struct bgp_info *new_select = old_and_new->new;
+  struct bgp_info *old_select = old_and_new->old;
 
   /* Nothing to do. */
   if (old_select && old_select == new_select &&
@@ -1964,7 +2079,7 @@ bgp_process_main (struct work_queue *wq, void *data)
       UNSET_FLAG (old_select->flags, BGP_INFO_MULTIPATH_CHG);
       bgp_zebra_clear_route_change_flags (rn);
       UNSET_FLAG (rn->flags, BGP_NODE_PROCESS_SCHEDULED);
-      return WQ_SUCCESS;
+      return;
     }
 
   /* If the user did "clear ip bgp prefix x.x.x.x" this flag will be set */
@@ -2039,23 +2154,119 @@ bgp_process_main (struct work_queue *wq, void *data)
     bgp_info_reap (rn, old_select);
   
   UNSET_FLAG (rn->flags, BGP_NODE_PROCESS_SCHEDULED);
-  return WQ_SUCCESS;
+}
+
+static void
+bgp_process_eoiu (struct bgp *bgp)
+{
+  afi_t afi;
+  safi_t safi;
+
+  quagga_timestamp(3, bgp->update_delay_zebra_resume_time,
+                   sizeof(bgp->update_delay_zebra_resume_time));
+
+  bgp->main_zebra_update_hold = 0;
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
+      {
+        if (is_bgp_zebra_rib_route (bgp, afi, safi))
+          bgp_install_routes_for_afi_safi (bgp, afi, safi);
+      }
+  bgp->main_peers_update_hold = 0;
+
+  bgp_start_routeadv(bgp);
+}
+
+/*
+ * Process a batch of nodes off a bgp_process_queue in two stages.
+ * Best-path and multipath selection only look at the paths hanging off
+ * each node, so they are run back to back for the whole batch first.
+ * The zebra, update-group and VNC side effects are then applied in the
+ * order the nodes were scheduled.  The queue is requeued on the work
+ * queue for as long as it has nodes left.
+ */
+static wq_item_status
+bgp_process_main (struct work_queue *wq, void *data)
+{
+  struct bgp_process_queue *pq = data;
+  struct bgp *bgp = pq->bgp;
+  afi_t afi = pq->afi;
+  safi_t safi = pq->safi;
+  struct bgp_node *batch[BGP_PROCESS_BATCH_MAX];
+  struct bgp_info_pair old_and_new[BGP_PROCESS_BATCH_MAX];
+  struct bgp_node *rn;
+  unsigned int count, i;
+
+  /* Is it end of initial update? (after startup) */
+  if (CHECK_FLAG (pq->flags, BGP_PROCESS_QUEUE_EOIU))
+    {
+      struct bgp_process_eoiu *eoiu = (struct bgp_process_eoiu *) pq;
+
+      FOREACH_AFI_SAFI (afi, safi)
+        if (bgp->process_queue[afi][safi].processed < eoiu->wait[afi][safi])
+          return WQ_REQUEUE;
+
+      bgp_process_eoiu (bgp);
+      return WQ_SUCCESS;
+    }
+
+  /* Unlink the batch.  Nodes scheduled while it is being processed go on
+   * the tail of the queue as usual.
+   */
+  for (count = 0; count < BGP_PROCESS_BATCH_MAX && pq->head; count++)
+    {
+      rn = pq->head;
+      pq->head = rn->process_next;
+      rn->process_next = NULL;
+      batch[count] = rn;
+    }
+  if (!pq->head)
+    pq->tail = NULL;
+  pq->count -= count;
+
+  /* Best path selection. */
+  for (i = 0; i < count; i++)
+    bgp_best_selection (bgp, batch[i], &bgp->maxpaths[afi][safi],
+                        &old_and_new[i]);
+
+  for (i = 0; i < count; i++)
+    {
+      rn = batch[i];
+      bgp_process_apply (bgp, rn, afi, safi, &old_and_new[i]);
+
+      /* Nodes outside the instance's main RIB (e.g. per-RD tables) also
+       * hold a table lock, see bgp_process.
+       */
+      if (bgp_node_table (rn) != bgp->rib[afi][safi])
+        {
+          struct bgp_table *table = bgp_node_table (rn);
+
+          bgp_unlock_node (rn);
+          bgp_table_unlock (table);
+        }
+      else
+        bgp_unlock_node (rn);
+    }
+  pq->processed += count;
+
+  return pq->head ? WQ_REQUEUE : WQ_SUCCESS;
 }
 
 static void
 bgp_processq_del (struct work_queue *wq, void *data)
 {
   struct bgp_process_queue *pq = data;
-  struct bgp_table *table;
 
-  bgp_unlock (pq->bgp);
-  if (pq->rn)
+  /* The EOIU mark is the only item allocated, see bgp_add_eoiu_mark */
+  if (CHECK_FLAG (pq->flags, BGP_PROCESS_QUEUE_EOIU))
     {
-      table = bgp_node_table (pq->rn);
-      bgp_unlock_node (pq->rn);
-      bgp_table_unlock (table);
+      bgp_unlock (pq->bgp);
+      XFREE (MTYPE_BGP_PROCESS_QUEUE, pq);
+      return;
     }
-  XFREE (MTYPE_BGP_PROCESS_QUEUE, pq);
+
+  UNSET_FLAG (pq->flags, BGP_PROCESS_QUEUE_SCHEDULED);
+  bgp_unlock (pq->bgp);
 }
 
 void
@@ -2084,7 +2295,7 @@ bgp_process_queue_init (void)
 void
 bgp_process (struct bgp *bgp, struct bgp_node *rn, afi_t afi, safi_t safi)
 {
-  struct bgp_process_queue *pqnode;
+  struct bgp_process_queue *pq;
   
   /* already scheduled for processing? */
   if (CHECK_FLAG (rn->flags, BGP_NODE_PROCESS_SCHEDULED))
@@ -2093,40 +2304,57 @@ bgp_process (struct bgp *bgp, struct bgp_node *rn, afi_t afi, safi_t safi)
   if (bm->process_main_queue == NULL)
     bgp_process_queue_init ();
 
-  pqnode = XCALLOC (MTYPE_BGP_PROCESS_QUEUE, 
-                    sizeof (struct bgp_process_queue));
-  if (!pqnode)
-    return;
+  pq = &bgp->process_queue[afi][safi];
 
-  /* all unlocked in bgp_processq_del */
-  bgp_table_lock (bgp_node_table (rn));
-  pqnode->rn = bgp_lock_node (rn);
-  pqnode->bgp = bgp;
-  bgp_lock (bgp);
-  pqnode->afi = afi;
-  pqnode->safi = safi;
-  work_queue_add (bm->process_main_queue, pqnode);
+  /* The queue holds one bgp lock for as long as it is on the work queue,
+   * which in turn keeps bgp->rib alive.  Only nodes of other tables need
+   * a table lock of their own.  All unlocked in bgp_process_main.
+   */
+  if (bgp_node_table (rn) != bgp->rib[afi][safi])
+    bgp_table_lock (bgp_node_table (rn));
+  bgp_lock_node (rn);
+
+  rn->process_next = NULL;
+  if (pq->tail)
+    pq->tail->process_next = rn;
+  else
+    pq->head = rn;
+  pq->tail = rn;
+  pq->count++;
+  pq->enqueued++;
   SET_FLAG (rn->flags, BGP_NODE_PROCESS_SCHEDULED);
-  return;
+
+  if (!CHECK_FLAG (pq->flags, BGP_PROCESS_QUEUE_SCHEDULED))
+    {
+      /* unlocked in bgp_processq_del */
+      bgp_lock (bgp);
+      SET_FLAG (pq->flags, BGP_PROCESS_QUEUE_SCHEDULED);
+      work_queue_add (bm->process_main_queue, pq);
+    }
 }
 
 void
 bgp_add_eoiu_mark (struct bgp *bgp)
 {
-  struct bgp_process_queue *pqnode;
+  struct bgp_process_eoiu *eoiu;
+  afi_t afi;
+  safi_t safi;
 
   if (bm->process_main_queue == NULL)
     bgp_process_queue_init ();
 
-  pqnode = XCALLOC (MTYPE_BGP_PROCESS_QUEUE,
-                    sizeof (struct bgp_process_queue));
-  if (!pqnode)
+  eoiu = XCALLOC (MTYPE_BGP_PROCESS_QUEUE,
+                  sizeof (struct bgp_process_eoiu));
+  if (!eoiu)
     return;
 
-  pqnode->rn = NULL;
-  pqnode->bgp = bgp;
+  eoiu->pq.bgp = bgp;
+  SET_FLAG (eoiu->pq.flags, BGP_PROCESS_QUEUE_EOIU);
+  FOREACH_AFI_SAFI (afi, safi)
+    eoiu->wait[afi][safi] = bgp->process_queue[afi][safi].enqueued;
+
   bgp_lock (bgp);
-  work_queue_add (bm->process_main_queue, pqnode);
+  work_queue_add (bm->process_main_queue, eoiu);
 }
 
 static int
@@ -2362,15 +2590,16 @@ bgp_update_martian_nexthop (struct bgp *bgp, afi_t afi, safi_t safi, struct attr
   return ret;
 }
 
-int
-bgp_update (struct peer *peer, struct prefix *p, u_int32_t addpath_id,
-            struct attr *attr, afi_t afi, safi_t safi, int type,
-            int sub_type, struct prefix_rd *prd, u_char *tag,
-            int soft_reconfig)
+/* Process a received route for node RN, which the caller has looked
+   up and locked; the lock is consumed.  */
+static int
+bgp_update_node (struct peer *peer, struct bgp_node *rn, struct prefix *p,
+                 u_int32_t addpath_id, struct attr *attr, afi_t afi,
+                 safi_t safi, int type, int sub_type, struct prefix_rd *prd,
+                 u_char *tag, int soft_reconfig)
 {
   int ret;
   int aspath_loop_count = 0;
-  struct bgp_node *rn;
   struct bgp *bgp;
   struct attr new_attr;
   struct attr_extra new_extra;
@@ -2391,8 +2620,7 @@ bgp_update (struct peer *peer, struct prefix *p, u_int32_t addpath_id,
   memset (&new_extra, 0, sizeof(struct attr_extra));
 
   bgp = peer->bgp;
-  rn = bgp_afi_node_get (bgp->rib[afi][safi], afi, safi, p, prd);
-  
+
   /* When peer's soft reconfiguration enabled.  Record input packet in
      Adj-RIBs-In.  */
   if (! soft_reconfig && CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_SOFT_RECONFIG)
@@ -2843,20 +3071,33 @@ bgp_update (struct peer *peer, struct prefix *p, u_int32_t addpath_id,
 }
 
 int
-bgp_withdraw (struct peer *peer, struct prefix *p, u_int32_t addpath_id,
-              struct attr *attr, afi_t afi, safi_t safi, int type, int sub_type,
-	      struct prefix_rd *prd, u_char *tag)
+bgp_update (struct peer *peer, struct prefix *p, u_int32_t addpath_id,
+            struct attr *attr, afi_t afi, safi_t safi, int type,
+            int sub_type, struct prefix_rd *prd, u_char *tag,
+            int soft_reconfig)
+{
+  struct bgp_node *rn;
+
+  rn = bgp_afi_node_get (peer->bgp->rib[afi][safi], afi, safi, p, prd);
+
+  return bgp_update_node (peer, rn, p, addpath_id, attr, afi, safi, type,
+                          sub_type, prd, tag, soft_reconfig);
+}
+
+/* Process a withdrawn route for node RN, which the caller has looked
+   up and locked; the lock is consumed.  */
+static int
+bgp_withdraw_node (struct peer *peer, struct bgp_node *rn, struct prefix *p,
+                   u_int32_t addpath_id, struct attr *attr, afi_t afi,
+                   safi_t safi, int type, int sub_type,
+                   struct prefix_rd *prd, u_char *tag)
 {
   struct bgp *bgp;
   char pfx_buf[BGP_PRD_PATH_STRLEN];
-  struct bgp_node *rn;
   struct bgp_info *ri;
 
   bgp = peer->bgp;
 
-  /* Lookup node. */
-  rn = bgp_afi_node_get (bgp->rib[afi][safi], afi, safi, p, prd);
-
   /* If peer is soft reconfiguration enabled.  Record input packet for
    * further calculation.
    *
@@ -2909,6 +3150,20 @@ bgp_withdraw (struct peer *peer, struct prefix *p, u_int32_t addpath_id,
   return 0;
 }
 
+int
+bgp_withdraw (struct peer *peer, struct prefix *p, u_int32_t addpath_id,
+              struct attr *attr, afi_t afi, safi_t safi, int type, int sub_type,
+	      struct prefix_rd *prd, u_char *tag)
+{
+  struct bgp_node *rn;
+
+  /* Lookup node. */
+  rn = bgp_afi_node_get (peer->bgp->rib[afi][safi], afi, safi, p, prd);
+
+  return bgp_withdraw_node (peer, rn, p, addpath_id, attr, afi, safi, type,
+                            sub_type, prd, tag);
+}
+
 void
 bgp_default_originate (struct peer *peer, afi_t afi, safi_t safi, int withdraw)
 {
@@ -3014,64 +3269,66 @@ bgp_announce_route_all (struct peer *peer)
       bgp_announce_route (peer, afi, safi);
 }
 
-static void
-bgp_soft_reconfig_table (struct peer *peer, afi_t afi, safi_t safi,
-			 struct bgp_table *table, struct prefix_rd *prd)
+/* Replay a peer's Adj-RIB-In through bgp_update, in table order.  The
+   walk covers only the peer's own entries, per-RD tables included, so
+   its cost no longer depends on how many other peers keep soft
+   reconfiguration.  */
+void
+bgp_soft_reconfig_in (struct peer *peer, afi_t afi, safi_t safi)
 {
   int ret;
-  struct bgp_node *rn;
+  struct bgp_adj_in **walk;
   struct bgp_adj_in *ain;
+  struct bgp_node *rn;
+  struct prefix_rd prd;
+  struct prefix_rd *prdp;
+  unsigned long count, i;
 
-  if (! table)
-    table = peer->bgp->rib[afi][safi];
-
-  for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
-    for (ain = rn->adj_in; ain; ain = ain->next)
-      {
-	if (ain->peer == peer)
-	  {
-	    struct bgp_info *ri = rn->info;
-	    u_char *tag = (ri && ri->extra) ? ri->extra->tag : NULL;
+  if (peer->status != Established)
+    return;
 
-	    ret = bgp_update (peer, &rn->p, ain->addpath_rx_id, ain->attr,
-                              afi, safi, ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL,
-			      prd, tag, 1);
+  walk = bgp_adj_in_walk_start (peer, afi, safi, &count);
 
-	    if (ret < 0)
-	      {
-		bgp_unlock_node (rn);
-		return;
-	      }
-	  }
-      }
-}
+  for (i = 0; i < count; i++)
+    {
+      struct bgp_info *ri;
+      u_char *tag;
 
-void
-bgp_soft_reconfig_in (struct peer *peer, afi_t afi, safi_t safi)
-{
-  struct bgp_node *rn;
-  struct bgp_table *table;
+      /* Removed from under the walk.  */
+      ain = walk[i];
+      if (! ain->attr)
+        continue;
 
-  if (peer->status != Established)
-    return;
+      rn = ain->rn;
+      ri = rn->info;
+      tag = (ri && ri->extra) ? ri->extra->tag : NULL;
 
-  if ((safi != SAFI_MPLS_VPN) && (safi != SAFI_ENCAP) && (safi != SAFI_EVPN))
-    bgp_soft_reconfig_table (peer, afi, safi, NULL, NULL);
-  else
-    for (rn = bgp_table_top (peer->bgp->rib[afi][safi]); rn;
-	 rn = bgp_route_next (rn))
-      if ((table = rn->info) != NULL)
+      prdp = NULL;
+      if ((safi == SAFI_MPLS_VPN || safi == SAFI_ENCAP || safi == SAFI_EVPN)
+          && rn->prn)
         {
-          struct prefix_rd prd;
           prd.family = AF_UNSPEC;
           prd.prefixlen = 64;
-          memcpy(&prd.val, rn->p.u.val, 8);
-
-          bgp_soft_reconfig_table (peer, afi, safi, table, &prd);
+          memcpy (&prd.val, rn->prn->p.u.val, 8);
+          prdp = &prd;
         }
-}
 
+      ret = bgp_update (peer, &rn->p, ain->addpath_rx_id, ain->attr,
+                        afi, safi, ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL,
+                        prdp, tag, 1);
 
+      if (ret < 0)
+        break;
+    }
+
+  bgp_adj_in_walk_end (peer, afi, safi, walk);
+}
+
+/* Clearing is shared by all peers: a node goes on bm->clear_node_queue
+ * once, however many peers being cleared have paths in it, and the paths
+ * to clear are flagged BGP_INFO_CLEAR_PENDING.  Each peer counts its
+ * flagged paths in clear_pending, and is done clearing once none is left.
+ */
 struct bgp_clear_node_queue
 {
   struct bgp_node *rn;
@@ -3082,19 +3339,23 @@ bgp_clear_route_node (struct work_queue *wq, void *data)
 {
   struct bgp_clear_node_queue *cnq = data;
   struct bgp_node *rn = cnq->rn;
-  struct peer *peer = wq->spec.data;
+  struct peer *peer;
   struct bgp_info *ri;
   afi_t afi = bgp_node_table (rn)->afi;
   safi_t safi = bgp_node_table (rn)->safi;
   
-  assert (rn && peer);
+  assert (rn);
+  UNSET_FLAG (rn->flags, BGP_NODE_CLEAR_SCHEDULED);
   
   /* It is possible that we have multiple paths for a prefix from a peer
    * if that peer is using AddPath.
    */
   for (ri = rn->info; ri; ri = ri->next)
-    if (ri->peer == peer)
+    if (CHECK_FLAG (ri->flags, BGP_INFO_CLEAR_PENDING))
       {
+        UNSET_FLAG (ri->flags, BGP_INFO_CLEAR_PENDING);
+        peer = ri->peer;
+
         /* graceful restart STALE flag set. */
         if (CHECK_FLAG (peer->sflags, PEER_STATUS_NSF_WAIT)
             && peer->nsf[afi][safi]
@@ -3103,6 +3364,10 @@ bgp_clear_route_node (struct work_queue *wq, void *data)
           bgp_info_set_flag (rn, ri, BGP_INFO_STALE);
         else
           bgp_rib_remove (rn, ri, peer, afi, safi);
+
+        /* The path still holds a reference on the peer.  */
+        if (--peer->clear_pending == 0)
+          bgp_clear_node_complete (peer);
       }
   return WQ_SUCCESS;
 }
@@ -3120,133 +3385,84 @@ bgp_clear_node_queue_del (struct work_queue *wq, void *data)
 }
 
 static void
-bgp_clear_node_complete (struct work_queue *wq)
+bgp_clear_node_queue_init (void)
 {
-  struct peer *peer = wq->spec.data;
-  
-  /* Tickle FSM to start moving again */
-  BGP_EVENT_ADD (peer, Clearing_Completed);
-
-  peer_unlock (peer); /* bgp_clear_route */
-}
-
-static void
-bgp_clear_node_queue_init (struct peer *peer)
-{
-  char wname[sizeof("clear xxxx:xxxx:xxxx:xxxx:xxxx:xxxx:xxxx:xxxx")];
-  
-  snprintf (wname, sizeof(wname), "clear %s", peer->host);
-#undef CLEAR_QUEUE_NAME_LEN
-
-  if ( (peer->clear_node_queue = work_queue_new (bm->master, wname)) == NULL)
+  if ( (bm->clear_node_queue = work_queue_new (bm->master, "clear")) == NULL)
     {
       zlog_err ("%s: Failed to allocate work queue", __func__);
       exit (1);
     }
-  peer->clear_node_queue->spec.hold = 10;
-  peer->clear_node_queue->spec.workfunc = &bgp_clear_route_node;
-  peer->clear_node_queue->spec.del_item_data = &bgp_clear_node_queue_del;
-  peer->clear_node_queue->spec.completion_func = &bgp_clear_node_complete;
-  peer->clear_node_queue->spec.max_retries = 0;
-  
-  /* we only 'lock' this peer reference when the queue is actually active */
-  peer->clear_node_queue->spec.data = peer;
+  bm->clear_node_queue->spec.hold = 10;
+  bm->clear_node_queue->spec.workfunc = &bgp_clear_route_node;
+  bm->clear_node_queue->spec.del_item_data = &bgp_clear_node_queue_del;
+  bm->clear_node_queue->spec.max_retries = 0;
+}
+
+/* Is this path of the peer one of its routes in bgp->rib[afi][safi]?
+ * Paths in other tables, such as the EVPN per-VNI ones, are not for the
+ * session to clear.
+ */
+static int
+bgp_clear_path_in_rib (struct peer *peer, struct bgp_info *ri,
+                       afi_t afi, safi_t safi)
+{
+  struct bgp_node *rn = ri->net;
+  struct bgp_table *rib = peer->bgp->rib[afi][safi];
+
+  if (safi == SAFI_MPLS_VPN || safi == SAFI_ENCAP || safi == SAFI_EVPN)
+    return rn->prn && bgp_node_table (rn->prn) == rib;
+  return bgp_node_table (rn) == rib;
 }
 
+/* Flag the peer's paths for clearing, and queue the nodes they are in
+ * unless already queued for another peer.  Only the peer's own paths
+ * are visited, through peer->paths, so that clearing a peer which sent
+ * few routes does not walk the whole table.  Paths already REMOVED are
+ * left to bgp_process, which reaps them anyway.
+ *
+ * The peer's adj-in is scrubbed up front from its own pool by
+ * bgp_clear_route, and its adj-out at leisure by the update groups.
+ */
 static void
-bgp_clear_route_table (struct peer *peer, afi_t afi, safi_t safi,
-                       struct bgp_table *table)
+bgp_clear_route_table (struct peer *peer, afi_t afi, safi_t safi)
 {
+  struct bgp_clear_node_queue *cnq;
+  struct bgp_info *ri;
   struct bgp_node *rn;
-  
-  
-  if (! table)
-    table = peer->bgp->rib[afi][safi];
-  
-  /* If still no table => afi/safi isn't configured at all or smth. */
-  if (! table)
+
+  /* If no table => afi/safi isn't configured at all or smth. */
+  if (! peer->bgp->rib[afi][safi])
     return;
-  
-  for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
+
+  for (ri = peer->paths[afi][safi]; ri; ri = ri->peer_next)
     {
-      struct bgp_info *ri;
-      struct bgp_adj_in *ain;
-      struct bgp_adj_in *ain_next;
-
-      /* XXX:TODO: This is suboptimal, every non-empty route_node is
-       * queued for every clearing peer, regardless of whether it is
-       * relevant to the peer at hand.
-       *
-       * Overview: There are 3 different indices which need to be
-       * scrubbed, potentially, when a peer is removed:
-       *
-       * 1 peer's routes visible via the RIB (ie accepted routes)
-       * 2 peer's routes visible by the (optional) peer's adj-in index
-       * 3 other routes visible by the peer's adj-out index
-       *
-       * 3 there is no hurry in scrubbing, once the struct peer is
-       * removed from bgp->peer, we could just GC such deleted peer's
-       * adj-outs at our leisure.
-       *
-       * 1 and 2 must be 'scrubbed' in some way, at least made
-       * invisible via RIB index before peer session is allowed to be
-       * brought back up. So one needs to know when such a 'search' is
-       * complete.
-       *
-       * Ideally:
-       *
-       * - there'd be a single global queue or a single RIB walker
-       * - rather than tracking which route_nodes still need to be
-       *   examined on a peer basis, we'd track which peers still
-       *   aren't cleared
-       *
-       * Given that our per-peer prefix-counts now should be reliable,
-       * this may actually be achievable. It doesn't seem to be a huge
-       * problem at this time,
-       *
-       * It is possible that we have multiple paths for a prefix from a peer
-       * if that peer is using AddPath.
-       */
-      ain = rn->adj_in;
-      while (ain)
-        {
-          ain_next = ain->next;
+      if (CHECK_FLAG (ri->flags, BGP_INFO_CLEAR_PENDING | BGP_INFO_REMOVED)
+          || !bgp_clear_path_in_rib (peer, ri, afi, safi))
+        continue;
 
-          if (ain->peer == peer)
-            {
-              bgp_adj_in_remove (rn, ain);
-              bgp_unlock_node (rn);
-            }
+      SET_FLAG (ri->flags, BGP_INFO_CLEAR_PENDING);
+      peer->clear_pending++;
 
-          ain = ain_next;
-        }
+      rn = ri->net;
+      if (CHECK_FLAG (rn->flags, BGP_NODE_CLEAR_SCHEDULED))
+        continue;
+      SET_FLAG (rn->flags, BGP_NODE_CLEAR_SCHEDULED);
 
-      for (ri = rn->info; ri; ri = ri->next)
-        if (ri->peer == peer)
-          {
-            struct bgp_clear_node_queue *cnq;
-
-            /* both unlocked in bgp_clear_node_queue_del */
-            bgp_table_lock (bgp_node_table (rn));
-            bgp_lock_node (rn);
-            cnq = XCALLOC (MTYPE_BGP_CLEAR_NODE_QUEUE,
-                           sizeof (struct bgp_clear_node_queue));
-            cnq->rn = rn;
-            work_queue_add (peer->clear_node_queue, cnq);
-            break;
-          }
+      /* both unlocked in bgp_clear_node_queue_del */
+      bgp_table_lock (bgp_node_table (rn));
+      bgp_lock_node (rn);
+      cnq = XCALLOC (MTYPE_BGP_CLEAR_NODE_QUEUE,
+                     sizeof (struct bgp_clear_node_queue));
+      cnq->rn = rn;
+      work_queue_add (bm->clear_node_queue, cnq);
     }
-  return;
 }
 
 void
 bgp_clear_route (struct peer *peer, afi_t afi, safi_t safi)
 {
-  struct bgp_node *rn;
-  struct bgp_table *table;
-
-  if (peer->clear_node_queue == NULL)
-    bgp_clear_node_queue_init (peer);
+  if (bm->clear_node_queue == NULL)
+    bgp_clear_node_queue_init ();
   
   /* bgp_fsm.c keeps sessions in state Clearing, not transitioning to
    * Idle until it receives a Clearing_Completed event. This protects
@@ -3261,23 +3477,19 @@ bgp_clear_route (struct peer *peer, afi_t afi, safi_t safi)
    *    to grow and grow.
    */
 
-  /* lock peer in assumption that clear-node-queue will get nodes; if so,
-   * the unlock will happen upon work-queue completion; other wise, the
-   * unlock happens at the end of this function.
+  /* lock peer in assumption that paths will get queued for clearing; if
+   * so, the unlock will happen once the last of them is cleared; other
+   * wise, the unlock happens at the end of this function.
    */
-  if (!peer->clear_node_queue->thread)
+  if (!peer->clear_pending)
     peer_lock (peer);
 
-  if (safi != SAFI_MPLS_VPN && safi != SAFI_ENCAP && safi != SAFI_EVPN)
-    bgp_clear_route_table (peer, afi, safi, NULL);
-  else
-    for (rn = bgp_table_top (peer->bgp->rib[afi][safi]); rn;
-         rn = bgp_route_next (rn))
-      if ((table = rn->info) != NULL)
-        bgp_clear_route_table (peer, afi, safi, table);
+  bgp_adj_in_clear (peer, afi, safi);
+
+  bgp_clear_route_table (peer, afi, safi);
 
-  /* unlock if no nodes got added to the clear-node-queue. */
-  if (!peer->clear_node_queue->thread)
+  /* unlock if no paths got queued for clearing. */
+  if (!peer->clear_pending)
     peer_unlock (peer);
 
 }
@@ -3300,54 +3512,20 @@ bgp_clear_route_all (struct peer *peer)
 void
 bgp_clear_adj_in (struct peer *peer, afi_t afi, safi_t safi)
 {
-  struct bgp_table *table;
-  struct bgp_node *rn;
-  struct bgp_adj_in *ain;
-  struct bgp_adj_in *ain_next;
-
-  table = peer->bgp->rib[afi][safi];
-
-  /* It is possible that we have multiple paths for a prefix from a peer
-   * if that peer is using AddPath.
-   */
-  for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
-    {
-      ain = rn->adj_in;
-
-      while (ain)
-        {
-          ain_next = ain->next;
-
-          if (ain->peer == peer)
-            {
-              bgp_adj_in_remove (rn, ain);
-              bgp_unlock_node (rn);
-	    }
-
-          ain = ain_next;
-        }
-    }
+  bgp_adj_in_clear (peer, afi, safi);
 }
 
 void
 bgp_clear_stale_route (struct peer *peer, afi_t afi, safi_t safi)
 {
-  struct bgp_node *rn;
   struct bgp_info *ri;
-  struct bgp_table *table;
-
-  table = peer->bgp->rib[afi][safi];
 
-  for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
-    {
-      for (ri = rn->info; ri; ri = ri->next)
-	if (ri->peer == peer)
-	  {
-	    if (CHECK_FLAG (ri->flags, BGP_INFO_STALE))
-	      bgp_rib_remove (rn, ri, peer, afi, safi);
-	    break;
-	  }
-    }
+  /* Removal only flags the path, it stays on the peer's list until
+     the node is processed.  */
+  for (ri = peer->paths[afi][safi]; ri; ri = ri->peer_next)
+    if (bgp_node_table (ri->net) == peer->bgp->rib[afi][safi]
+        && CHECK_FLAG (ri->flags, BGP_INFO_STALE))
+      bgp_rib_remove (ri->net, ri, peer, afi, safi);
 }
 
 static void
@@ -3487,8 +3665,44 @@ bgp_addpath_encode_rx (struct peer *peer, afi_t afi, safi_t safi)
           CHECK_FLAG (peer->af_cap[afi][safi], PEER_CAP_ADDPATH_AF_TX_RCV));
 }
 
+/* One decoded NLRI of an UPDATE, see bgp_nlri_parse_ip.  */
+struct bgp_nlri_entry
+{
+  struct prefix p;
+  u_int32_t addpath_id;
+
+  /* Position in the message, keeps the sort stable.  */
+  unsigned int seq;
+};
+
+static int
+bgp_nlri_entry_cmp (const void *a, const void *b)
+{
+  const struct bgp_nlri_entry *e1 = a;
+  const struct bgp_nlri_entry *e2 = b;
+  int ret;
+
+  ret = memcmp (&e1->p.u.prefix, &e2->p.u.prefix, prefix_blen (&e1->p));
+  if (ret)
+    return ret;
+  if (e1->p.prefixlen != e2->p.prefixlen)
+    return e1->p.prefixlen < e2->p.prefixlen ? -1 : 1;
+  return e1->seq < e2->seq ? -1 : (e1->seq > e2->seq);
+}
+
+/* Decoded NLRI of the UPDATE being parsed.  Kept from one UPDATE to the
+   next and grown as needed, so it is as large as the most NLRI seen in
+   one UPDATE.  */
+static struct bgp_nlri_entry *bgp_nlri_entries;
+static unsigned int bgp_nlri_entries_max;
+
 /* Parse NLRI stream.  Withdraw NLRI is recognized by NULL attr
-   value. */
+   value.
+
+   The whole NLRI field is decoded and checked before any route is
+   touched.  The prefixes are then applied in table order, so that each
+   node lookup can start from the previous node rather than from the
+   top of the table. */
 int
 bgp_nlri_parse_ip (struct peer *peer, struct attr *attr,
                    struct bgp_nlri *packet)
@@ -3502,6 +3716,12 @@ bgp_nlri_parse_ip (struct peer *peer, struct attr *attr,
   safi_t safi;
   int addpath_encoded;
   u_int32_t addpath_id;
+  struct bgp_nlri_entry *entries;
+  unsigned int count;
+  unsigned int i;
+  struct bgp_table *table;
+  struct bgp_node *rn;
+  struct bgp_node *hint;
 
   /* Check peer status. */
   if (peer->status != Established)
@@ -3514,6 +3734,12 @@ bgp_nlri_parse_ip (struct peer *peer, struct attr *attr,
   addpath_id = 0;
   addpath_encoded = bgp_addpath_encode_rx (peer, afi, safi);
 
+  if (packet->length == 0)
+    return 0;
+
+  entries = bgp_nlri_entries;
+  count = 0;
+
   /* RFC4771 6.3 The NLRI field in the UPDATE message is checked for
      syntactic validity.  If the field is syntactically incorrect,
      then the Error Subcode is set to Invalid Network Field. */
@@ -3527,7 +3753,7 @@ bgp_nlri_parse_ip (struct peer *peer, struct attr *attr,
 
           /* When packet overflow occurs return immediately. */
           if (pnt + BGP_ADDPATH_ID_LEN > lim)
-            return -1;
+            goto malformed;
 
           addpath_id = ntohl(*((uint32_t*) pnt));
           pnt += BGP_ADDPATH_ID_LEN;
@@ -3543,7 +3769,7 @@ bgp_nlri_parse_ip (struct peer *peer, struct attr *attr,
         {
           zlog_err("%s [Error] Update packet error (wrong perfix length %d for afi %u)",
                    peer->host, p.prefixlen, packet->afi);
-          return -1;
+          goto malformed;
         }
 
       /* Packet size overflow check. */
@@ -3554,7 +3780,7 @@ bgp_nlri_parse_ip (struct peer *peer, struct attr *attr,
         {
           zlog_err("%s [Error] Update packet error (prefix length %d overflows packet)",
                    peer->host, p.prefixlen);
-          return -1;
+          goto malformed;
         }
 
       /* Defensive coding, double-check the psize fits in a struct prefix */
@@ -3562,7 +3788,7 @@ bgp_nlri_parse_ip (struct peer *peer, struct attr *attr,
         {
           zlog_err("%s [Error] Update packet error (prefix length %d too large for prefix storage %zu)",
                    peer->host, p.prefixlen, sizeof(p.u));
-          return -1;
+          goto malformed;
         }
 
       /* Fetch prefix from NLRI packet. */
@@ -3610,18 +3836,18 @@ bgp_nlri_parse_ip (struct peer *peer, struct attr *attr,
 	}
 #endif /* HAVE_IPV6 */
 
-      /* Normal process. */
-      if (attr)
-	ret = bgp_update (peer, &p, addpath_id, attr, afi, safi,
-			  ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, NULL, NULL, 0);
-      else
-	ret = bgp_withdraw (peer, &p, addpath_id, attr, afi, safi,
-			    ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, NULL, NULL);
-
-      /* Address family configuration mismatch or maximum-prefix count
-         overflow. */
-      if (ret < 0)
-	return -1;
+      if (count == bgp_nlri_entries_max)
+        {
+          bgp_nlri_entries_max = count ? count * 2 : 256;
+          bgp_nlri_entries = XREALLOC (MTYPE_TMP, bgp_nlri_entries,
+                                       bgp_nlri_entries_max
+                                       * sizeof (struct bgp_nlri_entry));
+          entries = bgp_nlri_entries;
+        }
+      entries[count].p = p;
+      entries[count].addpath_id = addpath_id;
+      entries[count].seq = count;
+      count++;
     }
 
   /* Packet length consistency check. */
@@ -3629,10 +3855,47 @@ bgp_nlri_parse_ip (struct peer *peer, struct attr *attr,
     {
       zlog_err ("%s [Error] Update packet error (prefix length mismatch with total length)",
                 peer->host);
-      return -1;
+      goto malformed;
     }
 
-  return 0;
+  if (count > 1)
+    qsort (entries, count, sizeof (struct bgp_nlri_entry), bgp_nlri_entry_cmp);
+
+  /* Normal process.  The hint is kept locked so that it survives the
+     route changes made in between lookups. */
+  table = peer->bgp->rib[afi][safi];
+  hint = NULL;
+  ret = 0;
+  for (i = 0; i < count; i++)
+    {
+      rn = bgp_node_get_hint (table, hint, &entries[i].p);
+      bgp_lock_node (rn);
+      if (hint)
+        bgp_unlock_node (hint);
+      hint = rn;
+
+      if (attr)
+	ret = bgp_update_node (peer, rn, &entries[i].p, entries[i].addpath_id,
+	                       attr, afi, safi, ZEBRA_ROUTE_BGP,
+	                       BGP_ROUTE_NORMAL, NULL, NULL, 0);
+      else
+	ret = bgp_withdraw_node (peer, rn, &entries[i].p,
+	                         entries[i].addpath_id, attr, afi, safi,
+	                         ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, NULL, NULL);
+
+      /* Address family configuration mismatch or maximum-prefix count
+         overflow. */
+      if (ret < 0)
+	break;
+    }
+
+  if (hint)
+    bgp_unlock_node (hint);
+
+  return ret < 0 ? -1 : 0;
+
+ malformed:
+  return -1;
 }
 
 static struct bgp_static *
@@ -6394,7 +6657,7 @@ route_vty_out (struct vty *vty, struct prefix *p,
       if (attr->aspath)
         {
           if (json_paths)
-            json_object_string_add(json_path, "aspath", attr->aspath->str);
+            json_object_string_add(json_path, "aspath", aspath_print (attr->aspath));
           else
             aspath_print_vty (vty, "%s", attr->aspath, " ");
         }
@@ -6506,7 +6769,7 @@ route_vty_out_tmp (struct vty *vty, struct prefix *p, struct attr *attr, safi_t
 
           /* Print aspath */
           if (attr->aspath)
-            json_object_string_add(json_net, "asPath", attr->aspath->str);
+            json_object_string_add(json_net, "asPath", aspath_print (attr->aspath));
 
           /* Print origin */
           json_object_string_add(json_net, "bgpOriginCode", bgp_origin_str[attr->origin]);
@@ -6726,7 +6989,7 @@ damp_route_vty_out (struct vty *vty, struct prefix *p, struct bgp_info *binfo,
       if (attr->aspath)
         {
           if (use_json)
-            json_object_string_add(json, "asPath", attr->aspath->str);
+            json_object_string_add(json, "asPath", aspath_print (attr->aspath));
           else
             aspath_print_vty (vty, "%s", attr->aspath, " ");
         }
@@ -6826,7 +7089,7 @@ flap_route_vty_out (struct vty *vty, struct prefix *p, struct bgp_info *binfo,
       if (attr->aspath)
         {
           if (use_json)
-            json_object_string_add(json, "asPath", attr->aspath->str);
+            json_object_string_add(json, "asPath", aspath_print (attr->aspath));
           else
             aspath_print_vty (vty, "%s", attr->aspath, " ");
         }
@@ -6943,8 +7206,10 @@ route_vty_out_detail (struct vty *vty, struct bgp *bgp, struct prefix *p,
 	{
           if (json_paths)
            {
-            json_object_lock(attr->aspath->json);
-            json_object_object_add(json_path, "aspath", attr->aspath->json);
+            json_object *json_aspath = aspath_json (attr->aspath);
+
+            json_object_lock(json_aspath);
+            json_object_object_add(json_path, "aspath", json_aspath);
            }
           else
             {
@@ -7546,15 +7811,16 @@ route_vty_out_detail (struct vty *vty, struct bgp *bgp, struct prefix *p,
       else
         vty_out (vty, "      Last update: %s", ctime(&tbuf));
 #else
+      tbuf = binfo->uptime;
       if (json_paths)
         {
           json_last_update = json_object_new_object();
           json_object_int_add(json_last_update, "epoch", tbuf);
-          json_object_string_add(json_last_update, "string", ctime(&binfo->uptime));
+          json_object_string_add(json_last_update, "string", ctime(&tbuf));
           json_object_object_add(json_path, "lastUpdate", json_last_update);
         }
       else
-        vty_out (vty, "      Last update: %s", ctime(&binfo->uptime));
+        vty_out (vty, "      Last update: %s", ctime(&tbuf));
 #endif /* HAVE_CLOCK_MONOTONIC */
     }
 
@@ -7637,282 +7903,433 @@ bgp_show_prefix_longer (struct vty *vty, const char *name,
                         const char *prefix, afi_t afi,
                         safi_t safi, enum bgp_show_type type);
 
-static int
-bgp_show_table (struct vty *vty, struct bgp *bgp, struct bgp_table *table,
-                enum bgp_show_type type, void *output_arg, u_char use_json)
+/* A "show bgp" walk of a table, which can show it a part at a time;
+   see vty_output_suspend. */
+struct bgp_show_walk
 {
-  struct bgp_info *ri;
+  struct bgp *bgp;
+  struct bgp_table *table;
+  enum bgp_show_type type;
+  void *output_arg;
+  u_char use_json;
+
+  /* Next node to show, locked, or NULL at the end of the table. */
   struct bgp_node *rn;
-  int header = 1;
-  int display;
+
+  /* Prefixes to show before stopping, or 0 for all of them. */
+  unsigned long limit;
+
+  int header;
+  int first;
   unsigned long output_count;
   unsigned long total_count;
-  struct prefix *p;
-  char buf[BUFSIZ];
-  char buf2[BUFSIZ];
-  json_object *json_paths = NULL;
-  int first = 1;
+
+  /* Copy of the filter output_arg points to, if the walk owns it. */
+  union
+  {
+    struct prefix p;
+    union sockunion su;
+  } arg;
+};
+
+/* Nodes looked at in each part of the output of a walk. */
+#define BGP_SHOW_WALK_NODES	1000
+
+static struct bgp_show_walk *
+bgp_show_walk_new (struct vty *vty, struct bgp *bgp, struct bgp_table *table,
+                   enum bgp_show_type type, void *output_arg,
+                   u_char use_json)
+{
+  struct bgp_show_walk *walk;
+
+  walk = XCALLOC (MTYPE_BGP_SHOW_WALK, sizeof (struct bgp_show_walk));
+  bgp_lock (bgp);
+  walk->bgp = bgp;
+  bgp_table_lock (table);
+  walk->table = table;
+  walk->type = type;
+  walk->output_arg = output_arg;
+  walk->use_json = use_json;
+  walk->rn = bgp_table_top (table);
+  walk->header = 1;
+  walk->first = 1;
 
   if (use_json)
-    {
-      vty_out (vty, "{ \"vrfId\": %d, \"vrfName\": \"%s\", \"tableVersion\": %" PRId64 ", \"routerId\": \"%s\", \"routes\": { ",
-	       bgp->vrf_id == VRF_UNKNOWN ? -1 : bgp->vrf_id,
-	       bgp->inst_type == BGP_INSTANCE_TYPE_DEFAULT ? "Default" : bgp->name,
-	       table->version, inet_ntoa (bgp->router_id));
-      json_paths = json_object_new_object();
-    }
+    vty_out (vty, "{ \"vrfId\": %d, \"vrfName\": \"%s\", \"tableVersion\": %" PRId64 ", \"routerId\": \"%s\", \"routes\": { ",
+             bgp->vrf_id == VRF_UNKNOWN ? -1 : bgp->vrf_id,
+             bgp->inst_type == BGP_INSTANCE_TYPE_DEFAULT ? "Default" : bgp->name,
+             table->version, inet_ntoa (bgp->router_id));
+  return walk;
+}
 
-  /* This is first entry point, so reset total line. */
-  output_count = 0;
-  total_count  = 0;
+static void
+bgp_show_walk_free (void *arg)
+{
+  struct bgp_show_walk *walk = arg;
 
-  /* Start processing of routes. */
-  for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn)) 
-    if (rn->info != NULL)
-      {
-        display = 0;
-	if (!first && use_json)
-	  {
-	    vty_out (vty, ",");
-	  }
-        if (use_json)
-          json_paths = json_object_new_array();
-        else
-          json_paths = NULL;
+  if (walk->rn)
+    bgp_unlock_node (walk->rn);
+  bgp_table_unlock (walk->table);
+  bgp_unlock (walk->bgp);
+  XFREE (MTYPE_BGP_SHOW_WALK, walk);
+}
+
+/* Take a copy of the filter of a walk, where it is small enough.
+   Returns TRUE if the walk no longer depends on its caller's
+   output_arg, and so may outlive the command. */
+static int
+bgp_show_walk_own_arg (struct bgp_show_walk *walk)
+{
+  switch (walk->type)
+    {
+    case bgp_show_type_neighbor:
+    case bgp_show_type_flap_neighbor:
+    case bgp_show_type_damp_neighbor:
+      walk->arg.su = *(union sockunion *) walk->output_arg;
+      walk->output_arg = &walk->arg.su;
+      return 1;
+    case bgp_show_type_prefix_longer:
+    case bgp_show_type_flap_prefix_longer:
+    case bgp_show_type_flap_address:
+    case bgp_show_type_flap_prefix:
+      prefix_copy (&walk->arg.p, walk->output_arg);
+      walk->output_arg = &walk->arg.p;
+      return 1;
+    default:
+      return walk->output_arg == NULL;
+    }
+}
 
-        for (ri = rn->info; ri; ri = ri->next)
-          {
-            total_count++;
-            if (type == bgp_show_type_flap_statistics
-                || type == bgp_show_type_flap_address
-                || type == bgp_show_type_flap_prefix
-                || type == bgp_show_type_flap_cidr_only
-                || type == bgp_show_type_flap_regexp
-                || type == bgp_show_type_flap_filter_list
-                || type == bgp_show_type_flap_prefix_list
-                || type == bgp_show_type_flap_prefix_longer
-                || type == bgp_show_type_flap_route_map
-                || type == bgp_show_type_flap_neighbor
-                || type == bgp_show_type_dampend_paths
-                || type == bgp_show_type_damp_neighbor)
-              {
-                if (!(ri->extra && ri->extra->damp_info))
-                  continue;
-              }
-            if (type == bgp_show_type_regexp
-                || type == bgp_show_type_flap_regexp)
-              {
-                regex_t *regex = output_arg;
+/* Show the paths of a node that pass the filter of the walk. */
+static void
+bgp_show_node (struct vty *vty, struct bgp_show_walk *walk,
+               struct bgp_node *rn)
+{
+  enum bgp_show_type type = walk->type;
+  void *output_arg = walk->output_arg;
+  u_char use_json = walk->use_json;
+  struct bgp_info *ri;
+  int display = 0;
+  json_object *json_paths = NULL;
+  char buf[BUFSIZ];
 
-                if (bgp_regexec (regex, ri->attr->aspath) == REG_NOMATCH)
-                  continue;
-              }
-            if (type == bgp_show_type_prefix_list
-                || type == bgp_show_type_flap_prefix_list)
-              {
-                struct prefix_list *plist = output_arg;
+  if (use_json)
+    json_paths = json_object_new_array();
 
-                if (prefix_list_apply (plist, &rn->p) != PREFIX_PERMIT)
-                  continue;
-              }
-            if (type == bgp_show_type_filter_list
-                || type == bgp_show_type_flap_filter_list)
-              {
-                struct as_list *as_list = output_arg;
+  for (ri = rn->info; ri; ri = ri->next)
+    {
+      walk->total_count++;
+      if (type == bgp_show_type_flap_statistics
+          || type == bgp_show_type_flap_address
+          || type == bgp_show_type_flap_prefix
+          || type == bgp_show_type_flap_cidr_only
+          || type == bgp_show_type_flap_regexp
+          || type == bgp_show_type_flap_filter_list
+          || type == bgp_show_type_flap_prefix_list
+          || type == bgp_show_type_flap_prefix_longer
+          || type == bgp_show_type_flap_route_map
+          || type == bgp_show_type_flap_neighbor
+          || type == bgp_show_type_dampend_paths
+          || type == bgp_show_type_damp_neighbor)
+        {
+          if (!(ri->extra && ri->extra->damp_info))
+            continue;
+        }
+      if (type == bgp_show_type_regexp
+          || type == bgp_show_type_flap_regexp)
+        {
+          regex_t *regex = output_arg;
 
-                if (as_list_apply (as_list, ri->attr->aspath) != AS_FILTER_PERMIT)
-                  continue;
-              }
-            if (type == bgp_show_type_route_map
-                || type == bgp_show_type_flap_route_map)
-              {
-                struct route_map *rmap = output_arg;
-                struct bgp_info binfo;
-                struct attr dummy_attr;
-                struct attr_extra dummy_extra;
-                int ret;
+          if (bgp_regexec (regex, ri->attr->aspath) == REG_NOMATCH)
+            continue;
+        }
+      if (type == bgp_show_type_prefix_list
+          || type == bgp_show_type_flap_prefix_list)
+        {
+          struct prefix_list *plist = output_arg;
 
-                dummy_attr.extra = &dummy_extra;
-                bgp_attr_dup (&dummy_attr, ri->attr);
+          if (prefix_list_apply (plist, &rn->p) != PREFIX_PERMIT)
+            continue;
+        }
+      if (type == bgp_show_type_filter_list
+          || type == bgp_show_type_flap_filter_list)
+        {
+          struct as_list *as_list = output_arg;
 
-                binfo.peer = ri->peer;
-                binfo.attr = &dummy_attr;
+          if (as_list_apply (as_list, ri->attr->aspath) != AS_FILTER_PERMIT)
+            continue;
+        }
+      if (type == bgp_show_type_route_map
+          || type == bgp_show_type_flap_route_map)
+        {
+          struct route_map *rmap = output_arg;
+          struct bgp_info binfo;
+          struct attr dummy_attr;
+          struct attr_extra dummy_extra;
+          int ret;
 
-                ret = route_map_apply (rmap, &rn->p, RMAP_BGP, &binfo);
-                if (ret == RMAP_DENYMATCH)
-                  continue;
-              }
-            if (type == bgp_show_type_neighbor
-                || type == bgp_show_type_flap_neighbor
-                || type == bgp_show_type_damp_neighbor)
-              {
-                union sockunion *su = output_arg;
+          dummy_attr.extra = &dummy_extra;
+          bgp_attr_dup (&dummy_attr, ri->attr);
 
-                if (ri->peer->su_remote == NULL || ! sockunion_same(ri->peer->su_remote, su))
-                  continue;
-              }
-            if (type == bgp_show_type_cidr_only
-                || type == bgp_show_type_flap_cidr_only)
-              {
-                u_int32_t destination;
-
-                destination = ntohl (rn->p.u.prefix4.s_addr);
-                if (IN_CLASSC (destination) && rn->p.prefixlen == 24)
-                  continue;
-                if (IN_CLASSB (destination) && rn->p.prefixlen == 16)
-                  continue;
-                if (IN_CLASSA (destination) && rn->p.prefixlen == 8)
-                  continue;
-              }
-            if (type == bgp_show_type_prefix_longer
-                || type == bgp_show_type_flap_prefix_longer)
-              {
-                struct prefix *p = output_arg;
+          binfo.peer = ri->peer;
+          binfo.attr = &dummy_attr;
 
-                if (! prefix_match (p, &rn->p))
-                  continue;
-              }
-            if (type == bgp_show_type_community_all)
-              {
-                if (! ri->attr->community)
-                  continue;
-              }
-            if (type == bgp_show_type_community)
-              {
-                struct community *com = output_arg;
+          ret = route_map_apply (rmap, &rn->p, RMAP_BGP, &binfo);
+          if (ret == RMAP_DENYMATCH)
+            continue;
+        }
+      if (type == bgp_show_type_neighbor
+          || type == bgp_show_type_flap_neighbor
+          || type == bgp_show_type_damp_neighbor)
+        {
+          union sockunion *su = output_arg;
 
-                if (! ri->attr->community ||
-                    ! community_match (ri->attr->community, com))
-                  continue;
-              }
-            if (type == bgp_show_type_community_exact)
-              {
-                struct community *com = output_arg;
+          if (ri->peer->su_remote == NULL || ! sockunion_same(ri->peer->su_remote, su))
+            continue;
+        }
+      if (type == bgp_show_type_cidr_only
+          || type == bgp_show_type_flap_cidr_only)
+        {
+          u_int32_t destination;
 
-                if (! ri->attr->community ||
-                    ! community_cmp (ri->attr->community, com))
-                  continue;
-              }
-            if (type == bgp_show_type_community_list)
-              {
-                struct community_list *list = output_arg;
+          destination = ntohl (rn->p.u.prefix4.s_addr);
+          if (IN_CLASSC (destination) && rn->p.prefixlen == 24)
+            continue;
+          if (IN_CLASSB (destination) && rn->p.prefixlen == 16)
+            continue;
+          if (IN_CLASSA (destination) && rn->p.prefixlen == 8)
+            continue;
+        }
+      if (type == bgp_show_type_prefix_longer
+          || type == bgp_show_type_flap_prefix_longer)
+        {
+          struct prefix *p = output_arg;
 
-                if (! community_list_match (ri->attr->community, list))
-                  continue;
-              }
-            if (type == bgp_show_type_community_list_exact)
-              {
-                struct community_list *list = output_arg;
+          if (! prefix_match (p, &rn->p))
+            continue;
+        }
+      if (type == bgp_show_type_community_all)
+        {
+          if (! ri->attr->community)
+            continue;
+        }
+      if (type == bgp_show_type_community)
+        {
+          struct community *com = output_arg;
 
-                if (! community_list_exact_match (ri->attr->community, list))
-                  continue;
-              }
-            if (type == bgp_show_type_flap_address
-                || type == bgp_show_type_flap_prefix)
-              {
-                struct prefix *p = output_arg;
+          if (! ri->attr->community ||
+              ! community_match (ri->attr->community, com))
+            continue;
+        }
+      if (type == bgp_show_type_community_exact)
+        {
+          struct community *com = output_arg;
 
-                if (! prefix_match (&rn->p, p))
-                  continue;
+          if (! ri->attr->community ||
+              ! community_cmp (ri->attr->community, com))
+            continue;
+        }
+      if (type == bgp_show_type_community_list)
+        {
+          struct community_list *list = output_arg;
 
-                if (type == bgp_show_type_flap_prefix)
-                  if (p->prefixlen != rn->p.prefixlen)
-                    continue;
-              }
-            if (type == bgp_show_type_dampend_paths
-                || type == bgp_show_type_damp_neighbor)
-              {
-                if (! CHECK_FLAG (ri->flags, BGP_INFO_DAMPED)
-                    || CHECK_FLAG (ri->flags, BGP_INFO_HISTORY))
-                  continue;
-              }
+          if (! community_list_match (ri->attr->community, list))
+            continue;
+        }
+      if (type == bgp_show_type_community_list_exact)
+        {
+          struct community_list *list = output_arg;
 
-            if (!use_json && header)
-              {
-                vty_out (vty, "BGP table version is %" PRIu64 ", local router ID is %s%s", table->version, inet_ntoa (bgp->router_id), VTY_NEWLINE);
-                vty_out (vty, BGP_SHOW_SCODE_HEADER, VTY_NEWLINE, VTY_NEWLINE);
-                vty_out (vty, BGP_SHOW_OCODE_HEADER, VTY_NEWLINE, VTY_NEWLINE);
-                if (type == bgp_show_type_dampend_paths
-                    || type == bgp_show_type_damp_neighbor)
-                  vty_out (vty, BGP_SHOW_DAMP_HEADER, VTY_NEWLINE);
-                else if (type == bgp_show_type_flap_statistics
-                         || type == bgp_show_type_flap_address
-                         || type == bgp_show_type_flap_prefix
-                         || type == bgp_show_type_flap_cidr_only
-                         || type == bgp_show_type_flap_regexp
-                         || type == bgp_show_type_flap_filter_list
-                         || type == bgp_show_type_flap_prefix_list
-                         || type == bgp_show_type_flap_prefix_longer
-                         || type == bgp_show_type_flap_route_map
-                         || type == bgp_show_type_flap_neighbor)
-                  vty_out (vty, BGP_SHOW_FLAP_HEADER, VTY_NEWLINE);
-                else
-                  vty_out (vty, BGP_SHOW_HEADER, VTY_NEWLINE);
-                header = 0;
-              }
+          if (! community_list_exact_match (ri->attr->community, list))
+            continue;
+        }
+      if (type == bgp_show_type_flap_address
+          || type == bgp_show_type_flap_prefix)
+        {
+          struct prefix *p = output_arg;
 
-            if (type == bgp_show_type_dampend_paths
-                || type == bgp_show_type_damp_neighbor)
-              damp_route_vty_out (vty, &rn->p, ri, display, SAFI_UNICAST, use_json, json_paths);
-            else if (type == bgp_show_type_flap_statistics
-                     || type == bgp_show_type_flap_address
-                     || type == bgp_show_type_flap_prefix
-                     || type == bgp_show_type_flap_cidr_only
-                     || type == bgp_show_type_flap_regexp
-                     || type == bgp_show_type_flap_filter_list
-                     || type == bgp_show_type_flap_prefix_list
-                     || type == bgp_show_type_flap_prefix_longer
-                     || type == bgp_show_type_flap_route_map
-                     || type == bgp_show_type_flap_neighbor)
-              flap_route_vty_out (vty, &rn->p, ri, display, SAFI_UNICAST, use_json, json_paths);
-            else
-              route_vty_out (vty, &rn->p, ri, display, SAFI_UNICAST, json_paths);
-            display++;
-          }
+          if (! prefix_match (&rn->p, p))
+            continue;
 
-        if (display)
-          {
-            output_count++;
-            if (use_json)
-              {
-                p = &rn->p;
-                sprintf(buf2, "%s/%d", inet_ntop (p->family, &p->u.prefix, buf, BUFSIZ), p->prefixlen);
-		vty_out (vty, "\"%s\": ", buf2);
-		vty_out (vty, "%s", json_object_to_json_string (json_paths));
-		json_object_free (json_paths);
-		first = 0;
+          if (type == bgp_show_type_flap_prefix)
+            if (p->prefixlen != rn->p.prefixlen)
+              continue;
+        }
+      if (type == bgp_show_type_dampend_paths
+          || type == bgp_show_type_damp_neighbor)
+        {
+          if (! CHECK_FLAG (ri->flags, BGP_INFO_DAMPED)
+              || CHECK_FLAG (ri->flags, BGP_INFO_HISTORY))
+            continue;
+        }
 
-              }
-          }
+      if (!use_json && walk->header)
+        {
+          vty_out (vty, "BGP table version is %" PRIu64 ", local router ID is %s%s", walk->table->version, inet_ntoa (walk->bgp->router_id), VTY_NEWLINE);
+          vty_out (vty, BGP_SHOW_SCODE_HEADER, VTY_NEWLINE, VTY_NEWLINE);
+          vty_out (vty, BGP_SHOW_OCODE_HEADER, VTY_NEWLINE, VTY_NEWLINE);
+          if (type == bgp_show_type_dampend_paths
+              || type == bgp_show_type_damp_neighbor)
+            vty_out (vty, BGP_SHOW_DAMP_HEADER, VTY_NEWLINE);
+          else if (type == bgp_show_type_flap_statistics
+                   || type == bgp_show_type_flap_address
+                   || type == bgp_show_type_flap_prefix
+                   || type == bgp_show_type_flap_cidr_only
+                   || type == bgp_show_type_flap_regexp
+                   || type == bgp_show_type_flap_filter_list
+                   || type == bgp_show_type_flap_prefix_list
+                   || type == bgp_show_type_flap_prefix_longer
+                   || type == bgp_show_type_flap_route_map
+                   || type == bgp_show_type_flap_neighbor)
+            vty_out (vty, BGP_SHOW_FLAP_HEADER, VTY_NEWLINE);
+          else
+            vty_out (vty, BGP_SHOW_HEADER, VTY_NEWLINE);
+          walk->header = 0;
+        }
+
+      if (type == bgp_show_type_dampend_paths
+          || type == bgp_show_type_damp_neighbor)
+        damp_route_vty_out (vty, &rn->p, ri, display, SAFI_UNICAST, use_json, json_paths);
+      else if (type == bgp_show_type_flap_statistics
+               || type == bgp_show_type_flap_address
+               || type == bgp_show_type_flap_prefix
+               || type == bgp_show_type_flap_cidr_only
+               || type == bgp_show_type_flap_regexp
+               || type == bgp_show_type_flap_filter_list
+               || type == bgp_show_type_flap_prefix_list
+               || type == bgp_show_type_flap_prefix_longer
+               || type == bgp_show_type_flap_route_map
+               || type == bgp_show_type_flap_neighbor)
+        flap_route_vty_out (vty, &rn->p, ri, display, SAFI_UNICAST, use_json, json_paths);
+      else
+        route_vty_out (vty, &rn->p, ri, display, SAFI_UNICAST, json_paths);
+      display++;
+    }
+
+  if (display)
+    {
+      walk->output_count++;
+      if (use_json)
+        {
+          vty_out (vty, "%s\"%s\": %s", walk->first ? "" : ",",
+                   prefix2str (&rn->p, buf, sizeof (buf)),
+                   json_object_to_json_string (json_paths));
+          walk->first = 0;
         }
+    }
 
   if (use_json)
+    json_object_free (json_paths);
+}
+
+static void
+bgp_show_walk_end (struct vty *vty, struct bgp_show_walk *walk)
+{
+  char buf[BUFSIZ];
+
+  if (walk->use_json)
     {
-      json_object_free (json_paths);
-      vty_out (vty, " } }%s", VTY_NEWLINE);
+      vty_out (vty, " }");
+      if (walk->rn)
+        vty_out (vty, ", \"nextPrefix\": \"%s\"",
+                 prefix2str (&walk->rn->p, buf, sizeof (buf)));
+      vty_out (vty, " }%s", VTY_NEWLINE);
     }
   else
     {
+      /* A page walks only part of the table, so has no total to give. */
+      if (walk->limit)
+        {
+          if (walk->output_count == 0)
+            vty_out (vty, "No BGP prefixes displayed%s", VTY_NEWLINE);
+          else
+            vty_out (vty, "%sDisplayed  %ld prefixes%s",
+                     VTY_NEWLINE, walk->output_count, VTY_NEWLINE);
+        }
       /* No route is displayed */
-      if (output_count == 0)
+      else if (walk->output_count == 0)
         {
-          if (type == bgp_show_type_normal)
-            vty_out (vty, "No BGP prefixes displayed, %ld exist%s", total_count, VTY_NEWLINE);
+          if (walk->type == bgp_show_type_normal)
+            vty_out (vty, "No BGP prefixes displayed, %ld exist%s",
+                     walk->total_count, VTY_NEWLINE);
         }
       else
         vty_out (vty, "%sDisplayed  %ld out of %ld total prefixes%s",
-                 VTY_NEWLINE, output_count, total_count, VTY_NEWLINE);
+                 VTY_NEWLINE, walk->output_count, walk->total_count,
+                 VTY_NEWLINE);
+      if (walk->rn)
+        vty_out (vty, "Next prefix: %s%s",
+                 prefix2str (&walk->rn->p, buf, sizeof (buf)), VTY_NEWLINE);
+    }
+}
+
+/* Show the next part of a walk.  Returns CMD_SUSPEND while there is
+   more of it to show. */
+static int
+bgp_show_walk_next (struct vty *vty, void *arg)
+{
+  struct bgp_show_walk *walk = arg;
+  struct bgp_node *rn;
+  unsigned int nodes = 0;
+
+  for (rn = walk->rn; rn; rn = bgp_route_next (rn))
+    {
+      if (nodes++ == BGP_SHOW_WALK_NODES)
+        {
+          walk->rn = rn;
+          return CMD_SUSPEND;
+        }
+      if (rn->info == NULL)
+        continue;
+      if (walk->limit && walk->output_count == walk->limit)
+        break;
+      bgp_show_node (vty, walk, rn);
     }
 
+  /* Where a page stops, the node the next one starts at is left
+     locked, until the walk is freed. */
+  walk->rn = rn;
+  bgp_show_walk_end (vty, walk);
   return CMD_SUCCESS;
 }
 
+/* Run a walk to the end, without waiting for the vty. */
+static int
+bgp_show_walk_run (struct vty *vty, struct bgp_show_walk *walk)
+{
+  int ret;
+
+  while ((ret = bgp_show_walk_next (vty, walk)) == CMD_SUSPEND)
+    ;
+  bgp_show_walk_free (walk);
+  return ret;
+}
+
+/* Show a walk a part at a time, as the vty writes out what has been
+   shown so far, if the walk can outlive the command that started it;
+   else in one go. */
+static int
+bgp_show_walk_output (struct vty *vty, struct bgp_show_walk *walk)
+{
+  if (!bgp_show_walk_own_arg (walk))
+    return bgp_show_walk_run (vty, walk);
+
+  return vty_output_suspend (vty, bgp_show_walk_next, bgp_show_walk_free,
+                             walk);
+}
+
+static int
+bgp_show_table (struct vty *vty, struct bgp *bgp, struct bgp_table *table,
+                enum bgp_show_type type, void *output_arg, u_char use_json)
+{
+  return bgp_show_walk_run (vty, bgp_show_walk_new (vty, bgp, table, type,
+                                                    output_arg, use_json));
+}
+
 static int
 bgp_show (struct vty *vty, struct bgp *bgp, afi_t afi, safi_t safi,
           enum bgp_show_type type, void *output_arg, u_char use_json)
 {
-  struct bgp_table *table;
-
   if (bgp == NULL)
     {
       bgp = bgp_get_default ();
@@ -7925,10 +8342,10 @@ bgp_show (struct vty *vty, struct bgp *bgp, afi_t afi, safi_t safi,
       return CMD_WARNING;
     }
 
-  table = bgp->rib[afi][safi];
-
-  return bgp_show_table (vty, bgp, table, type, output_arg,
-                         use_json);
+  return bgp_show_walk_output (vty, bgp_show_walk_new (vty, bgp,
+                                                       bgp->rib[afi][safi],
+                                                       type, output_arg,
+                                                       use_json));
 }
 
 static void
@@ -8816,6 +9233,74 @@ DEFUN (show_bgp_ipv6_safi,
   return bgp_show (vty, NULL, AFI_IP6, SAFI_UNICAST, bgp_show_type_normal, NULL, uj);
 }
 
+/* Show a page of a table: up to LIMIT prefixes, from START, or the
+   first one after it, on.  The page ends with the prefix to start the
+   next one at, so a client can fetch a large table a page at a time. */
+static int
+bgp_show_page (struct vty *vty, afi_t afi, safi_t safi, struct prefix *start,
+               unsigned long limit, u_char use_json)
+{
+  struct bgp *bgp;
+  struct bgp_table *table;
+  struct bgp_show_walk *walk;
+
+  bgp = bgp_get_default ();
+  if (bgp == NULL)
+    {
+      if (!use_json)
+        vty_out (vty, "No BGP process is configured%s", VTY_NEWLINE);
+      return CMD_WARNING;
+    }
+
+  table = bgp->rib[afi][safi];
+  walk = bgp_show_walk_new (vty, bgp, table, bgp_show_type_normal, NULL,
+                            use_json);
+  if (walk->rn)
+    bgp_unlock_node (walk->rn);
+  walk->rn = bgp_node_lookup (table, start);
+  if (walk->rn == NULL)
+    walk->rn = bgp_table_get_next (table, start);
+  walk->limit = limit;
+
+  return bgp_show_walk_output (vty, walk);
+}
+
+DEFUN (show_bgp_afi_safi_page,
+       show_bgp_afi_safi_page_cmd,
+       "show bgp (ipv4|ipv6) (unicast|multicast) start (A.B.C.D/M|X:X::X:X/M) limit <1-4294967295> {json}",
+       SHOW_STR
+       BGP_STR
+       "Address family\n"
+       "Address family\n"
+       "Address Family modifier\n"
+       "Address Family modifier\n"
+       "Show the table from a prefix on\n"
+       "IPv4 prefix, 0.0.0.0/0 for the start of the table\n"
+       "IPv6 prefix, ::/0 for the start of the table\n"
+       "Show a page of this many prefixes\n"
+       "Number of prefixes\n"
+       "JavaScript Object Notation\n")
+{
+  afi_t afi;
+  safi_t safi;
+  struct prefix start;
+  unsigned long limit;
+
+  afi = (strncmp (argv[0], "ipv4", 4) == 0) ? AFI_IP : AFI_IP6;
+  safi = (strncmp (argv[1], "m", 1) == 0) ? SAFI_MULTICAST : SAFI_UNICAST;
+
+  if (! str2prefix (argv[2], &start) || start.family != afi2family (afi))
+    {
+      vty_out (vty, "%% Malformed prefix%s", VTY_NEWLINE);
+      return CMD_WARNING;
+    }
+  apply_mask (&start);
+
+  VTY_GET_INTEGER_RANGE ("limit", limit, argv[3], 1, UINT32_MAX);
+
+  return bgp_show_page (vty, afi, safi, &start, limit, use_json (argc, argv));
+}
+
 static void
 bgp_show_ipv6_bgp_deprecate_warning (struct vty *vty)
 {
@@ -11835,34 +12320,23 @@ ravg_tally (unsigned long count, unsigned long oldavg, unsigned long newval)
 }
 #endif
 
+/* Figures that depend on the shape of the tree, or on the paths'
+   attributes, are not kept as the table changes; they need a walk.  */
 static int
 bgp_table_stats_walker (struct thread *t)
 {
   struct bgp_node *rn;
   struct bgp_node *top;
   struct bgp_table_stats *ts = THREAD_ARG (t);
-  unsigned int space = 0;
+  unsigned int space = ts->counts[BGP_STATS_MAXBITLEN];
   
   if (!(top = bgp_table_top (ts->table)))
     return 0;
 
-  switch (top->p.family)
-    {
-      case AF_INET:
-        space = IPV4_MAX_BITLEN;
-        break;
-      case AF_INET6:
-        space = IPV6_MAX_BITLEN;
-        break;
-    }
-    
-  ts->counts[BGP_STATS_MAXBITLEN] = space;
-
   for (rn = top; rn; rn = bgp_route_next (rn))
     {
       struct bgp_info *ri;
       struct bgp_node *prn = bgp_node_parent_nolock (rn);
-      unsigned int rinum = 0;
       
       if (rn == top)
         continue;
@@ -11870,16 +12344,6 @@ bgp_table_stats_walker (struct thread *t)
       if (!rn->info)
         continue;
       
-      ts->counts[BGP_STATS_PREFIXES]++;
-      ts->counts[BGP_STATS_TOTPLEN] += rn->p.prefixlen;
-
-#if 0
-      ts->counts[BGP_STATS_AVGPLEN]
-        = ravg_tally (ts->counts[BGP_STATS_PREFIXES],
-                      ts->counts[BGP_STATS_AVGPLEN],
-                      rn->p.prefixlen);
-#endif
-      
       /* check if the prefix is included by any other announcements */
       while (prn && !prn->info)
         prn = bgp_node_parent_nolock (prn);
@@ -11896,9 +12360,6 @@ bgp_table_stats_walker (struct thread *t)
       
       for (ri = rn->info; ri; ri = ri->next)
         {
-          rinum++;
-          ts->counts[BGP_STATS_RIB]++;
-          
           if (ri->attr &&
               (CHECK_FLAG (ri->attr->flag,
                            ATTR_FLAG_BIT (BGP_ATTR_ATOMIC_AGGREGATE))))
@@ -11921,16 +12382,6 @@ bgp_table_stats_walker (struct thread *t)
               
               ts->counts[BGP_STATS_ASPATH_TOTHOPS] += hops;
               ts->counts[BGP_STATS_ASPATH_TOTSIZE] += size;
-#if 0
-              ts->counts[BGP_STATS_ASPATH_AVGHOPS] 
-                = ravg_tally (ts->counts[BGP_STATS_ASPATH_COUNT],
-                              ts->counts[BGP_STATS_ASPATH_AVGHOPS],
-                              hops);
-              ts->counts[BGP_STATS_ASPATH_AVGSIZE]
-                = ravg_tally (ts->counts[BGP_STATS_ASPATH_COUNT],
-                              ts->counts[BGP_STATS_ASPATH_AVGSIZE],
-                              size);
-#endif
               if (highest > ts->counts[BGP_STATS_ASN_HIGHEST])
                 ts->counts[BGP_STATS_ASN_HIGHEST] = highest;
             }
@@ -11939,10 +12390,31 @@ bgp_table_stats_walker (struct thread *t)
   return 0;
 }
 
+/* Take the counts kept by the table, and if asked, walk it for the
+   rest.  */
+static void
+bgp_table_stats_add (struct bgp_table_stats *ts, struct bgp_table *table,
+                     int detail)
+{
+  ts->counts[BGP_STATS_PREFIXES] += table->prefix_count;
+  ts->counts[BGP_STATS_TOTPLEN] += table->prefix_len_total;
+  ts->counts[BGP_STATS_RIB] += table->path_count;
+
+  if (!detail)
+    return;
+
+  /* in-place call via thread subsystem so as to record execution time
+     stats for the thread-walk */
+  ts->table = table;
+  thread_execute (bm->master, bgp_table_stats_walker, ts, 0);
+}
+
 static int
-bgp_table_stats (struct vty *vty, struct bgp *bgp, afi_t afi, safi_t safi)
+bgp_table_stats (struct vty *vty, struct bgp *bgp, afi_t afi, safi_t safi,
+                 int detail)
 {
   struct bgp_table_stats ts;
+  struct bgp_node *rn;
   unsigned int i;
   
   if (!bgp->rib[afi][safi])
@@ -11953,8 +12425,29 @@ bgp_table_stats (struct vty *vty, struct bgp *bgp, afi_t afi, safi_t safi)
     }
   
   memset (&ts, 0, sizeof (ts));
-  ts.table = bgp->rib[afi][safi];
-  thread_execute (bm->master, bgp_table_stats_walker, &ts, 0);
+  switch (afi)
+    {
+      case AFI_IP:
+        ts.counts[BGP_STATS_MAXBITLEN] = IPV4_MAX_BITLEN;
+        break;
+      case AFI_IP6:
+        ts.counts[BGP_STATS_MAXBITLEN] = IPV6_MAX_BITLEN;
+        break;
+      default:
+        /* No address space to report, see BGP_STATS_SPACE below. */
+        break;
+    }
+
+  /* VPN and encap paths live in per-RD tables. */
+  if (safi == SAFI_MPLS_VPN || safi == SAFI_ENCAP || safi == SAFI_EVPN)
+    {
+      for (rn = bgp_table_top (bgp->rib[afi][safi]); rn;
+           rn = bgp_route_next (rn))
+        if (rn->info)
+          bgp_table_stats_add (&ts, rn->info, detail);
+    }
+  else
+    bgp_table_stats_add (&ts, bgp->rib[afi][safi], detail);
 
   vty_out (vty, "BGP %s RIB statistics%s%s",
            afi_safi_print (afi, safi), VTY_NEWLINE, VTY_NEWLINE);
@@ -11964,17 +12457,12 @@ bgp_table_stats (struct vty *vty, struct bgp *bgp, afi_t afi, safi_t safi)
       if (!table_stats_strs[i])
         continue;
       
+      if (!detail && i != BGP_STATS_PREFIXES && i != BGP_STATS_TOTPLEN
+          && i != BGP_STATS_RIB)
+        continue;
+
       switch (i)
         {
-#if 0
-          case BGP_STATS_ASPATH_AVGHOPS:
-          case BGP_STATS_ASPATH_AVGSIZE:
-          case BGP_STATS_AVGPLEN:
-            vty_out (vty, "%-30s: ", table_stats_strs[i]);
-            vty_out (vty, "%12.2f",
-                     (float)ts.counts[i] / (float)TALLY_SIGFIG);
-            break;
-#endif
           case BGP_STATS_ASPATH_TOTHOPS:
           case BGP_STATS_ASPATH_TOTSIZE:
             vty_out (vty, "%-30s: ", table_stats_strs[i]);
@@ -12026,7 +12514,8 @@ bgp_table_stats (struct vty *vty, struct bgp *bgp, afi_t afi, safi_t safi)
 
 static int
 bgp_table_stats_vty (struct vty *vty, const char *name,
-                     const char *afi_str, const char *safi_str)
+                     const char *afi_str, const char *safi_str,
+                     const char *detail_str)
 {
   struct bgp *bgp;
   afi_t afi;
@@ -12076,12 +12565,12 @@ bgp_table_stats_vty (struct vty *vty, const char *name,
       return CMD_WARNING;
     }
 
-  return bgp_table_stats (vty, bgp, afi, safi);
+  return bgp_table_stats (vty, bgp, afi, safi, detail_str != NULL);
 }
 
 DEFUN (show_bgp_statistics,
        show_bgp_statistics_cmd,
-       "show bgp (ipv4|ipv6) (encap|multicast|unicast|vpn) statistics",
+       "show bgp (ipv4|ipv6) (encap|multicast|unicast|vpn) statistics {detail}",
        SHOW_STR
        BGP_STR
        "Address family\n"
@@ -12090,14 +12579,15 @@ DEFUN (show_bgp_statistics,
        "Address Family modifier\n"
        "Address Family modifier\n"
        "Address Family modifier\n"
-       "BGP RIB advertisement statistics\n")
+       "BGP RIB advertisement statistics\n"
+       "Walk the table for aggregation and AS-path statistics\n")
 {
-  return bgp_table_stats_vty (vty, NULL, argv[0], argv[1]);
+  return bgp_table_stats_vty (vty, NULL, argv[0], argv[1], argv[2]);
 }
 
 DEFUN (show_bgp_statistics_view,
        show_bgp_statistics_view_cmd,
-       "show bgp " BGP_INSTANCE_CMD " (ipv4|ipv6) (unicast|multicast|vpn|encap) statistics",
+       "show bgp " BGP_INSTANCE_CMD " (ipv4|ipv6) (unicast|multicast|vpn|encap) statistics {detail}",
        SHOW_STR
        BGP_STR
        BGP_INSTANCE_HELP_STR
@@ -12107,46 +12597,37 @@ DEFUN (show_bgp_statistics_view,
        "Address Family modifier\n"
        "Address Family modifier\n"
        "Address Family modifier\n"
-       "BGP RIB advertisement statistics\n")
+       "BGP RIB advertisement statistics\n"
+       "Walk the table for aggregation and AS-path statistics\n")
 {
-  return bgp_table_stats_vty (vty, NULL, argv[1], argv[2]);
+  return bgp_table_stats_vty (vty, argv[1], argv[2], argv[3], argv[4]);
 }
 
-enum bgp_pcounts
-{
-  PCOUNT_ADJ_IN = 0,
-  PCOUNT_DAMPED,
-  PCOUNT_REMOVED,
-  PCOUNT_HISTORY,
-  PCOUNT_STALE,
-  PCOUNT_VALID,
-  PCOUNT_ALL,
-  PCOUNT_COUNTED,
-  PCOUNT_PFCNT, /* the figure we display to users */
-  PCOUNT_MAX,
-};
-
 static const char *pcount_strs[] =
 {
-  [PCOUNT_ADJ_IN]  = "Adj-in",
-  [PCOUNT_DAMPED]  = "Damped",
-  [PCOUNT_REMOVED] = "Removed",
-  [PCOUNT_HISTORY] = "History",
-  [PCOUNT_STALE]   = "Stale",
-  [PCOUNT_VALID]   = "Valid",
-  [PCOUNT_ALL]     = "All RIB",
-  [PCOUNT_COUNTED] = "PfxCt counted",
-  [PCOUNT_PFCNT]   = "Useable",
-  [PCOUNT_MAX]     = NULL,
+  [PCOUNT_ADJ_IN]    = "Adj-in",
+  [PCOUNT_DAMPED]    = "Damped",
+  [PCOUNT_REMOVED]   = "Removed",
+  [PCOUNT_HISTORY]   = "History",
+  [PCOUNT_STALE]     = "Stale",
+  [PCOUNT_VALID]     = "Valid",
+  [PCOUNT_BEST]      = "Best",
+  [PCOUNT_MULTIPATH] = "Multipath",
+  [PCOUNT_ALL]       = "All RIB",
+  [PCOUNT_COUNTED]   = "PfxCt counted",
+  [PCOUNT_PFCNT]     = "Useable",
+  [PCOUNT_MAX]       = NULL,
 };
 
 struct peer_pcounts
 {
-  unsigned int count[PCOUNT_MAX];
+  unsigned long count[PCOUNT_MAX];
   const struct peer *peer;
   const struct bgp_table *table;
 };
 
+/* Count the peer's paths by walking the table, to check the counts kept
+   as paths come and go against.  */
 static int
 bgp_peer_count_walker (struct thread *t)
 {
@@ -12160,7 +12641,7 @@ bgp_peer_count_walker (struct thread *t)
       struct bgp_info *ri;
       
       for (ain = rn->adj_in; ain; ain = ain->next)
-        if (ain->peer == peer)
+        if (BGP_ADJ_IN_PEER (ain) == peer)
           pc->count[PCOUNT_ADJ_IN]++;
 
       for (ri = rn->info; ri; ri = ri->next)
@@ -12182,6 +12663,10 @@ bgp_peer_count_walker (struct thread *t)
             pc->count[PCOUNT_STALE]++;
           if (CHECK_FLAG (ri->flags, BGP_INFO_VALID))
             pc->count[PCOUNT_VALID]++;
+          if (CHECK_FLAG (ri->flags, BGP_INFO_SELECTED))
+            pc->count[PCOUNT_BEST]++;
+          if (CHECK_FLAG (ri->flags, BGP_INFO_MULTIPATH))
+            pc->count[PCOUNT_MULTIPATH]++;
           if (!CHECK_FLAG (ri->flags, BGP_INFO_UNUSEABLE))
             pc->count[PCOUNT_PFCNT]++;
           
@@ -12211,13 +12696,27 @@ bgp_peer_count_walker (struct thread *t)
   return 0;
 }
 
+static void
+bgp_peer_count_walk (struct peer_pcounts *pc, struct bgp_table *table)
+{
+  /* in-place call via thread subsystem so as to record execution time
+     stats for the thread-walk */
+  pc->table = table;
+  thread_execute (bm->master, bgp_peer_count_walker, pc, 0);
+}
+
 static int
-bgp_peer_counts (struct vty *vty, struct peer *peer, afi_t afi, safi_t safi, u_char use_json)
+bgp_peer_counts (struct vty *vty, struct peer *peer, afi_t afi, safi_t safi,
+                 int detail, u_char use_json)
 {
+  unsigned long count[PCOUNT_MAX];
   struct peer_pcounts pcounts = { .peer = peer };
+  struct bgp_node *rn;
   unsigned int i;
+  int drift = 0;
   json_object *json = NULL;
   json_object *json_loop = NULL;
+  json_object *json_walk = NULL;
 
   if (use_json)
     {
@@ -12233,6 +12732,7 @@ bgp_peer_counts (struct vty *vty, struct peer *peer, afi_t afi, safi_t safi, u_c
           json_object_string_add(json, "warning", "No such neighbor or address family");
           vty_out (vty, "%s%s", json_object_to_json_string_ext(json, JSON_C_TO_STRING_PRETTY), VTY_NEWLINE);
           json_object_free(json);
+          json_object_free(json_loop);
         }
       else
         vty_out (vty, "%% No such neighbor or address family%s", VTY_NEWLINE);
@@ -12240,15 +12740,32 @@ bgp_peer_counts (struct vty *vty, struct peer *peer, afi_t afi, safi_t safi, u_c
       return CMD_WARNING;
     }
   
-  memset (&pcounts, 0, sizeof(pcounts));
-  pcounts.peer = peer;
-  pcounts.table = peer->bgp->rib[afi][safi];
-  
-  /* in-place call via thread subsystem so as to record execution time
- *    * stats for the thread-walk (i.e. ensure this can't be blamed on
- *       * on just vty_read()).
- *          */
-  thread_execute (bm->master, bgp_peer_count_walker, &pcounts, 0);
+  memcpy (count, peer->pcounts[afi][safi], sizeof (count));
+  count[PCOUNT_ADJ_IN] = peer->adj_in_pool[afi][safi] ?
+                         peer->adj_in_pool[afi][safi]->count : 0;
+
+  /* The counts above are kept up to date as paths change, so checking
+     them against the table takes a walk of it, which is left to be
+     asked for.  */
+  if (detail)
+    {
+      if (safi == SAFI_MPLS_VPN || safi == SAFI_ENCAP || safi == SAFI_EVPN)
+        {
+          for (rn = bgp_table_top (peer->bgp->rib[afi][safi]); rn;
+               rn = bgp_route_next (rn))
+            if (rn->info)
+              bgp_peer_count_walk (&pcounts, rn->info);
+        }
+      else
+        bgp_peer_count_walk (&pcounts, peer->bgp->rib[afi][safi]);
+
+      for (i = 0; i < PCOUNT_MAX; i++)
+        if (pcounts.count[i] != count[i])
+          drift = 1;
+      if (pcounts.count[PCOUNT_PFCNT] != peer->pcount[afi][safi]
+          || pcounts.count[PCOUNT_COUNTED] != peer->pcount[afi][safi])
+        drift = 1;
+    }
 
   if (use_json)
     {
@@ -12257,11 +12774,19 @@ bgp_peer_counts (struct vty *vty, struct peer *peer, afi_t afi, safi_t safi, u_c
       json_object_int_add(json, "pfxCounter", peer->pcount[afi][safi]);
 
       for (i = 0; i < PCOUNT_MAX; i++)
-        json_object_int_add(json_loop, pcount_strs[i], pcounts.count[i]);
+        json_object_int_add(json_loop, pcount_strs[i], count[i]);
 
       json_object_object_add(json, "ribTableWalkCounters", json_loop);
 
-      if (pcounts.count[PCOUNT_PFCNT] != peer->pcount[afi][safi])
+      if (detail)
+        {
+          json_walk = json_object_new_object();
+          for (i = 0; i < PCOUNT_MAX; i++)
+            json_object_int_add(json_walk, pcount_strs[i], pcounts.count[i]);
+          json_object_object_add(json, "ribTableWalkCheck", json_walk);
+        }
+
+      if (drift)
         {
           json_object_string_add(json, "pfxctDriftFor", peer->host);
           json_object_string_add(json, "recommended", "Please report this bug, with the above command output");
@@ -12285,13 +12810,18 @@ bgp_peer_counts (struct vty *vty, struct peer *peer, afi_t afi, safi_t safi, u_c
         }
 
       vty_out (vty, "PfxCt: %ld%s", peer->pcount[afi][safi], VTY_NEWLINE);
-      vty_out (vty, "%sCounts from RIB table walk:%s%s",
+      vty_out (vty, "%sCounts of paths in the RIB:%s%s",
                VTY_NEWLINE, VTY_NEWLINE, VTY_NEWLINE);
 
       for (i = 0; i < PCOUNT_MAX; i++)
-        vty_out (vty, "%20s: %-10d%s", pcount_strs[i], pcounts.count[i], VTY_NEWLINE);
+        if (detail)
+          vty_out (vty, "%20s: %-10lu (walk: %lu)%s", pcount_strs[i],
+                   count[i], pcounts.count[i], VTY_NEWLINE);
+        else
+          vty_out (vty, "%20s: %-10lu%s", pcount_strs[i], count[i],
+                   VTY_NEWLINE);
 
-      if (pcounts.count[PCOUNT_PFCNT] != peer->pcount[afi][safi])
+      if (drift)
         {
           vty_out (vty, "%s [pcount] PfxCt drift!%s",
                    peer->host, VTY_NEWLINE);
@@ -12305,7 +12835,7 @@ bgp_peer_counts (struct vty *vty, struct peer *peer, afi_t afi, safi_t safi, u_c
 
 DEFUN (show_ip_bgp_neighbor_prefix_counts,
        show_ip_bgp_neighbor_prefix_counts_cmd,
-       "show ip bgp neighbors (A.B.C.D|X:X::X:X|WORD) prefix-counts {json}",
+       "show ip bgp neighbors (A.B.C.D|X:X::X:X|WORD) prefix-counts {detail|json}",
        SHOW_STR
        IP_STR
        BGP_STR
@@ -12314,6 +12844,7 @@ DEFUN (show_ip_bgp_neighbor_prefix_counts,
        "Neighbor to display information about\n"
        "Neighbor on bgp configured interface\n"
        "Display detailed prefix count information\n"
+       "Walk the table to check the counts\n"
        "JavaScript Object Notation\n")
 {
   struct peer *peer;
@@ -12323,12 +12854,13 @@ DEFUN (show_ip_bgp_neighbor_prefix_counts,
   if (! peer) 
     return CMD_WARNING;
  
-  return bgp_peer_counts (vty, peer, AFI_IP, SAFI_UNICAST, uj);
+  return bgp_peer_counts (vty, peer, AFI_IP, SAFI_UNICAST,
+                          argv[argc-2] != NULL, uj);
 }
 
 DEFUN (show_ip_bgp_instance_neighbor_prefix_counts,
        show_ip_bgp_instance_neighbor_prefix_counts_cmd,
-       "show ip bgp " BGP_INSTANCE_CMD " neighbors (A.B.C.D|X:X::X:X|WORD) prefix-counts {json}",
+       "show ip bgp " BGP_INSTANCE_CMD " neighbors (A.B.C.D|X:X::X:X|WORD) prefix-counts {detail|json}",
        SHOW_STR
        IP_STR
        BGP_STR
@@ -12338,6 +12870,7 @@ DEFUN (show_ip_bgp_instance_neighbor_prefix_counts,
        "Neighbor to display information about\n"
        "Neighbor on bgp configured interface\n"
        "Display detailed prefix count information\n"
+       "Walk the table to check the counts\n"
        "JavaScript Object Notation\n")
 {
   struct peer *peer;
@@ -12347,12 +12880,13 @@ DEFUN (show_ip_bgp_instance_neighbor_prefix_counts,
   if (! peer)
     return CMD_WARNING;
 
-  return bgp_peer_counts (vty, peer, AFI_IP, SAFI_UNICAST, uj);
+  return bgp_peer_counts (vty, peer, AFI_IP, SAFI_UNICAST,
+                          argv[argc-2] != NULL, uj);
 }
 
 DEFUN (show_bgp_ipv6_neighbor_prefix_counts,
        show_bgp_ipv6_neighbor_prefix_counts_cmd,
-       "show bgp ipv6 neighbors (A.B.C.D|X:X::X:X|WORD) prefix-counts {json}",
+       "show bgp ipv6 neighbors (A.B.C.D|X:X::X:X|WORD) prefix-counts {detail|json}",
        SHOW_STR
        BGP_STR
        "Address family\n"
@@ -12361,6 +12895,7 @@ DEFUN (show_bgp_ipv6_neighbor_prefix_counts,
        "Neighbor to display information about\n"
        "Neighbor on bgp configured interface\n"
        "Display detailed prefix count information\n"
+       "Walk the table to check the counts\n"
        "JavaScript Object Notation\n")
 {
   struct peer *peer;
@@ -12370,12 +12905,13 @@ DEFUN (show_bgp_ipv6_neighbor_prefix_counts,
   if (! peer) 
     return CMD_WARNING;
  
-  return bgp_peer_counts (vty, peer, AFI_IP6, SAFI_UNICAST, uj);
+  return bgp_peer_counts (vty, peer, AFI_IP6, SAFI_UNICAST,
+                          argv[argc-2] != NULL, uj);
 }
 
 DEFUN (show_bgp_instance_ipv6_neighbor_prefix_counts,
        show_bgp_instance_ipv6_neighbor_prefix_counts_cmd,
-       "show bgp " BGP_INSTANCE_CMD " ipv6 neighbors (A.B.C.D|X:X::X:X|WORD) prefix-counts {json}",
+       "show bgp " BGP_INSTANCE_CMD " ipv6 neighbors (A.B.C.D|X:X::X:X|WORD) prefix-counts {detail|json}",
        SHOW_STR
        BGP_STR
        BGP_INSTANCE_HELP_STR
@@ -12385,6 +12921,7 @@ DEFUN (show_bgp_instance_ipv6_neighbor_prefix_counts,
        "Neighbor to display information about\n"
        "Neighbor on bgp configured interface\n"
        "Display detailed prefix count information\n"
+       "Walk the table to check the counts\n"
        "JavaScript Object Notation\n")
 {
   struct peer *peer;
@@ -12394,12 +12931,13 @@ DEFUN (show_bgp_instance_ipv6_neighbor_prefix_counts,
   if (! peer)
     return CMD_WARNING;
 
-  return bgp_peer_counts (vty, peer, AFI_IP6, SAFI_UNICAST, uj);
+  return bgp_peer_counts (vty, peer, AFI_IP6, SAFI_UNICAST,
+                          argv[argc-2] != NULL, uj);
 }
 
 DEFUN (show_ip_bgp_ipv4_neighbor_prefix_counts,
        show_ip_bgp_ipv4_neighbor_prefix_counts_cmd,
-       "show ip bgp ipv4 (unicast|multicast) neighbors (A.B.C.D|X:X::X:X|WORD) prefix-counts {json}",
+       "show ip bgp ipv4 (unicast|multicast) neighbors (A.B.C.D|X:X::X:X|WORD) prefix-counts {detail|json}",
        SHOW_STR
        IP_STR
        BGP_STR
@@ -12411,6 +12949,7 @@ DEFUN (show_ip_bgp_ipv4_neighbor_prefix_counts,
        "Neighbor to display information about\n"
        "Neighbor on bgp configured interface\n"
        "Display detailed prefix count information\n"
+       "Walk the table to check the counts\n"
        "JavaScript Object Notation\n")
 {
   struct peer *peer;
@@ -12421,14 +12960,16 @@ DEFUN (show_ip_bgp_ipv4_neighbor_prefix_counts,
     return CMD_WARNING;
 
   if (strncmp (argv[0], "m", 1) == 0)
-    return bgp_peer_counts (vty, peer, AFI_IP, SAFI_MULTICAST, uj);
+    return bgp_peer_counts (vty, peer, AFI_IP, SAFI_MULTICAST,
+                          argv[argc-2] != NULL, uj);
 
-  return bgp_peer_counts (vty, peer, AFI_IP, SAFI_UNICAST, uj);
+  return bgp_peer_counts (vty, peer, AFI_IP, SAFI_UNICAST,
+                          argv[argc-2] != NULL, uj);
 }
 
 DEFUN (show_ip_bgp_vpnv4_neighbor_prefix_counts,
        show_ip_bgp_vpnv4_neighbor_prefix_counts_cmd,
-       "show ip bgp vpnv4 all neighbors (A.B.C.D|X:X::X:X|WORD) prefix-counts {json}",
+       "show ip bgp vpnv4 all neighbors (A.B.C.D|X:X::X:X|WORD) prefix-counts {detail|json}",
        SHOW_STR
        IP_STR
        BGP_STR
@@ -12440,6 +12981,7 @@ DEFUN (show_ip_bgp_vpnv4_neighbor_prefix_counts,
        "Neighbor to display information about\n"
        "Neighbor on bgp configured interface\n"
        "Display detailed prefix count information\n"
+       "Walk the table to check the counts\n"
        "JavaScript Object Notation\n")
 {
   struct peer *peer;
@@ -12449,7 +12991,8 @@ DEFUN (show_ip_bgp_vpnv4_neighbor_prefix_counts,
   if (! peer)
     return CMD_WARNING;
   
-  return bgp_peer_counts (vty, peer, AFI_IP, SAFI_MPLS_VPN, uj);
+  return bgp_peer_counts (vty, peer, AFI_IP, SAFI_MPLS_VPN,
+                          argv[argc-2] != NULL, uj);
 }
 
 static void
@@ -12545,7 +13088,7 @@ show_adj_route (struct vty *vty, struct peer *peer, afi_t afi, safi_t safi,
         {
           for (ain = rn->adj_in; ain; ain = ain->next)
             {
-              if (ain->peer == peer)
+              if (BGP_ADJ_IN_PEER (ain) == peer)
                 {
                   if (header1)
                     {
@@ -14624,7 +15167,11 @@ DEFUN (clear_ip_bgp_dampening,
        BGP_STR
        "Clear route flap dampening information\n")
 {
-  bgp_damp_info_clean ();
+  struct bgp *bgp;
+
+  bgp = bgp_get_default ();
+  if (bgp)
+    bgp_damp_info_clean (bgp, AFI_IP, SAFI_UNICAST);
   return CMD_SUCCESS;
 }
 
@@ -15145,6 +15692,7 @@ bgp_route_init (void)
   install_element (VIEW_NODE, &show_bgp_cmd);
   install_element (VIEW_NODE, &show_bgp_ipv6_cmd);
   install_element (VIEW_NODE, &show_bgp_ipv6_safi_cmd);
+  install_element (VIEW_NODE, &show_bgp_afi_safi_page_cmd);
   install_element (VIEW_NODE, &show_bgp_route_cmd);
   install_element (VIEW_NODE, &show_bgp_ipv6_route_cmd);
   install_element (VIEW_NODE, &show_bgp_ipv6_safi_route_cmd);
@@ -15347,6 +15895,22 @@ bgp_route_init (void)
   install_element (BGP_IPV4M_NODE, &bgp_damp_set3_cmd);
   install_element (BGP_IPV4M_NODE, &bgp_damp_unset_cmd);
   install_element (BGP_IPV4M_NODE, &bgp_damp_unset2_cmd);
+
+#ifdef HAVE_IPV6
+  /* IPv6 Unicast and Multicast Mode */
+  install_element (BGP_IPV6_NODE, &bgp_damp_set_cmd);
+  install_element (BGP_IPV6_NODE, &bgp_damp_set2_cmd);
+  install_element (BGP_IPV6_NODE, &bgp_damp_set3_cmd);
+  install_element (BGP_IPV6_NODE, &bgp_damp_unset_cmd);
+  install_element (BGP_IPV6_NODE, &bgp_damp_unset2_cmd);
+  install_element (BGP_IPV6_NODE, &bgp_damp_unset3_cmd);
+  install_element (BGP_IPV6M_NODE, &bgp_damp_set_cmd);
+  install_element (BGP_IPV6M_NODE, &bgp_damp_set2_cmd);
+  install_element (BGP_IPV6M_NODE, &bgp_damp_set3_cmd);
+  install_element (BGP_IPV6M_NODE, &bgp_damp_unset_cmd);
+  install_element (BGP_IPV6M_NODE, &bgp_damp_unset2_cmd);
+  install_element (BGP_IPV6M_NODE, &bgp_damp_unset3_cmd);
+#endif /* HAVE_IPV6 */
 }
 
 void
@@ -15361,4 +15925,7 @@ bgp_route_finish (void)
 	bgp_table_unlock (bgp_distance_table[afi][safi]);
 	bgp_distance_table[afi][safi] = NULL;
       }
+
+  XFREE (MTYPE_TMP, bgp_nlri_entries);
+  bgp_nlri_entries_max = 0;
 }
@@ -40,6 +40,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 #include "buffer.h"
 #include "sockunion.h"
 #include "hash.h"
+#include "jhash.h"
 #include "queue.h"
 
 #include "bgpd/bgpd.h"
@@ -126,6 +127,92 @@ struct rmap_value
   u_int32_t value;
 };
 
+/* func_cacheable for rules that look at nothing but the attributes. */
+static int
+route_rule_cacheable (void *rule)
+{
+  return 1;
+}
+
+/* A value taken from the peer's round-trip time is not cacheable. */
+static int
+route_value_cacheable (void *rule)
+{
+  struct rmap_value *rv = rule;
+
+  return rv->variable == 0;
+}
+
+/* Compiled value of rules naming a filter list.  func_resolve looks the
+   list up whenever the route-map is compiled, rather than on every route;
+   adding or deleting any list makes the route-map compile again. */
+struct rmap_list_ref
+{
+  char *name;
+  void *list;
+};
+
+static void *
+route_list_ref_compile (const char *arg)
+{
+  struct rmap_list_ref *ref;
+
+  ref = XCALLOC (MTYPE_ROUTE_MAP_COMPILED, sizeof (struct rmap_list_ref));
+  ref->name = XSTRDUP (MTYPE_ROUTE_MAP_COMPILED, arg);
+  return ref;
+}
+
+static void
+route_list_ref_free (void *rule)
+{
+  struct rmap_list_ref *ref = rule;
+
+  XFREE (MTYPE_ROUTE_MAP_COMPILED, ref->name);
+  XFREE (MTYPE_ROUTE_MAP_COMPILED, ref);
+}
+
+static void
+route_access_list_resolve (void *rule)
+{
+  struct rmap_list_ref *ref = rule;
+
+  ref->list = access_list_lookup (AFI_IP, ref->name);
+}
+
+static void
+route_prefix_list_resolve (void *rule)
+{
+  struct rmap_list_ref *ref = rule;
+
+  ref->list = prefix_list_lookup (AFI_IP, ref->name);
+}
+
+static void
+route_as_list_resolve (void *rule)
+{
+  struct rmap_list_ref *ref = rule;
+
+  ref->list = as_list_lookup (ref->name);
+}
+
+static void
+route_community_list_resolve (void *rule)
+{
+  struct rmap_list_ref *ref = rule;
+
+  ref->list = community_list_lookup (bgp_clist, ref->name,
+				     COMMUNITY_LIST_MASTER);
+}
+
+static void
+route_ecommunity_list_resolve (void *rule)
+{
+  struct rmap_list_ref *ref = rule;
+
+  ref->list = community_list_lookup (bgp_clist, ref->name,
+				     EXTCOMMUNITY_LIST_MASTER);
+}
+
 static int
 route_value_match (struct rmap_value *rv, u_int32_t value)
 {
@@ -341,7 +428,7 @@ route_match_ip_address (void *rule, struct prefix *prefix,
 
   if (type == RMAP_BGP)
     {
-      alist = access_list_lookup (AFI_IP, (char *) rule);
+      alist = ((struct rmap_list_ref *) rule)->list;
       if (alist == NULL)
 	return RMAP_NOMATCH;
     
@@ -351,28 +438,15 @@ route_match_ip_address (void *rule, struct prefix *prefix,
   return RMAP_NOMATCH;
 }
 
-/* Route map `ip address' match statement.  `arg' should be
-   access-list name. */
-static void *
-route_match_ip_address_compile (const char *arg)
-{
-  return XSTRDUP (MTYPE_ROUTE_MAP_COMPILED, arg);
-}
-
-/* Free route map's compiled `ip address' value. */
-static void
-route_match_ip_address_free (void *rule)
-{
-  XFREE (MTYPE_ROUTE_MAP_COMPILED, rule);
-}
-
 /* Route map commands for ip address matching. */
 struct route_map_rule_cmd route_match_ip_address_cmd =
 {
   "ip address",
   route_match_ip_address,
-  route_match_ip_address_compile,
-  route_match_ip_address_free
+  route_list_ref_compile,
+  route_list_ref_free,
+  NULL,
+  route_access_list_resolve
 };
 
 /* `match ip next-hop IP_ADDRESS' */
@@ -393,7 +467,7 @@ route_match_ip_next_hop (void *rule, struct prefix *prefix,
       p.prefix = bgp_info->attr->nexthop;
       p.prefixlen = IPV4_MAX_BITLEN;
 
-      alist = access_list_lookup (AFI_IP, (char *) rule);
+      alist = ((struct rmap_list_ref *) rule)->list;
       if (alist == NULL)
 	return RMAP_NOMATCH;
 
@@ -403,28 +477,15 @@ route_match_ip_next_hop (void *rule, struct prefix *prefix,
   return RMAP_NOMATCH;
 }
 
-/* Route map `ip next-hop' match statement. `arg' is
-   access-list name. */
-static void *
-route_match_ip_next_hop_compile (const char *arg)
-{
-  return XSTRDUP (MTYPE_ROUTE_MAP_COMPILED, arg);
-}
-
-/* Free route map's compiled `ip address' value. */
-static void
-route_match_ip_next_hop_free (void *rule)
-{
-  XFREE (MTYPE_ROUTE_MAP_COMPILED, rule);
-}
-
 /* Route map commands for ip next-hop matching. */
 struct route_map_rule_cmd route_match_ip_next_hop_cmd =
 {
   "ip next-hop",
   route_match_ip_next_hop,
-  route_match_ip_next_hop_compile,
-  route_match_ip_next_hop_free
+  route_list_ref_compile,
+  route_list_ref_free,
+  route_rule_cacheable,
+  route_access_list_resolve
 };
 
 /* `match ip route-source ACCESS-LIST' */
@@ -451,7 +512,7 @@ route_match_ip_route_source (void *rule, struct prefix *prefix,
       p.prefix = peer->su.sin.sin_addr;
       p.prefixlen = IPV4_MAX_BITLEN;
 
-      alist = access_list_lookup (AFI_IP, (char *) rule);
+      alist = ((struct rmap_list_ref *) rule)->list;
       if (alist == NULL)
 	return RMAP_NOMATCH;
 
@@ -461,28 +522,15 @@ route_match_ip_route_source (void *rule, struct prefix *prefix,
   return RMAP_NOMATCH;
 }
 
-/* Route map `ip route-source' match statement. `arg' is
-   access-list name. */
-static void *
-route_match_ip_route_source_compile (const char *arg)
-{
-  return XSTRDUP (MTYPE_ROUTE_MAP_COMPILED, arg);
-}
-
-/* Free route map's compiled `ip address' value. */
-static void
-route_match_ip_route_source_free (void *rule)
-{
-  XFREE (MTYPE_ROUTE_MAP_COMPILED, rule);
-}
-
 /* Route map commands for ip route-source matching. */
 struct route_map_rule_cmd route_match_ip_route_source_cmd =
 {
   "ip route-source",
   route_match_ip_route_source,
-  route_match_ip_route_source_compile,
-  route_match_ip_route_source_free
+  route_list_ref_compile,
+  route_list_ref_free,
+  NULL,
+  route_access_list_resolve
 };
 
 /* `match ip address prefix-list PREFIX_LIST' */
@@ -495,7 +543,7 @@ route_match_ip_address_prefix_list (void *rule, struct prefix *prefix,
 
   if (type == RMAP_BGP)
     {
-      plist = prefix_list_lookup (AFI_IP, (char *) rule);
+      plist = ((struct rmap_list_ref *) rule)->list;
       if (plist == NULL)
 	return RMAP_NOMATCH;
     
@@ -505,24 +553,14 @@ route_match_ip_address_prefix_list (void *rule, struct prefix *prefix,
   return RMAP_NOMATCH;
 }
 
-static void *
-route_match_ip_address_prefix_list_compile (const char *arg)
-{
-  return XSTRDUP (MTYPE_ROUTE_MAP_COMPILED, arg);
-}
-
-static void
-route_match_ip_address_prefix_list_free (void *rule)
-{
-  XFREE (MTYPE_ROUTE_MAP_COMPILED, rule);
-}
-
 struct route_map_rule_cmd route_match_ip_address_prefix_list_cmd =
 {
   "ip address prefix-list",
   route_match_ip_address_prefix_list,
-  route_match_ip_address_prefix_list_compile,
-  route_match_ip_address_prefix_list_free
+  route_list_ref_compile,
+  route_list_ref_free,
+  NULL,
+  route_prefix_list_resolve
 };
 
 /* `match ip next-hop prefix-list PREFIX_LIST' */
@@ -542,7 +580,7 @@ route_match_ip_next_hop_prefix_list (void *rule, struct prefix *prefix,
       p.prefix = bgp_info->attr->nexthop;
       p.prefixlen = IPV4_MAX_BITLEN;
 
-      plist = prefix_list_lookup (AFI_IP, (char *) rule);
+      plist = ((struct rmap_list_ref *) rule)->list;
       if (plist == NULL)
         return RMAP_NOMATCH;
 
@@ -552,24 +590,14 @@ route_match_ip_next_hop_prefix_list (void *rule, struct prefix *prefix,
   return RMAP_NOMATCH;
 }
 
-static void *
-route_match_ip_next_hop_prefix_list_compile (const char *arg)
-{
-  return XSTRDUP (MTYPE_ROUTE_MAP_COMPILED, arg);
-}
-
-static void
-route_match_ip_next_hop_prefix_list_free (void *rule)
-{
-  XFREE (MTYPE_ROUTE_MAP_COMPILED, rule);
-}
-
 struct route_map_rule_cmd route_match_ip_next_hop_prefix_list_cmd =
 {
   "ip next-hop prefix-list",
   route_match_ip_next_hop_prefix_list,
-  route_match_ip_next_hop_prefix_list_compile,
-  route_match_ip_next_hop_prefix_list_free
+  route_list_ref_compile,
+  route_list_ref_free,
+  route_rule_cacheable,
+  route_prefix_list_resolve
 };
 
 /* `match ip route-source prefix-list PREFIX_LIST' */
@@ -595,7 +623,7 @@ route_match_ip_route_source_prefix_list (void *rule, struct prefix *prefix,
       p.prefix = peer->su.sin.sin_addr;
       p.prefixlen = IPV4_MAX_BITLEN;
 
-      plist = prefix_list_lookup (AFI_IP, (char *) rule);
+      plist = ((struct rmap_list_ref *) rule)->list;
       if (plist == NULL)
         return RMAP_NOMATCH;
 
@@ -605,24 +633,14 @@ route_match_ip_route_source_prefix_list (void *rule, struct prefix *prefix,
   return RMAP_NOMATCH;
 }
 
-static void *
-route_match_ip_route_source_prefix_list_compile (const char *arg)
-{
-  return XSTRDUP (MTYPE_ROUTE_MAP_COMPILED, arg);
-}
-
-static void
-route_match_ip_route_source_prefix_list_free (void *rule)
-{
-  XFREE (MTYPE_ROUTE_MAP_COMPILED, rule);
-}
-
 struct route_map_rule_cmd route_match_ip_route_source_prefix_list_cmd =
 {
   "ip route-source prefix-list",
   route_match_ip_route_source_prefix_list,
-  route_match_ip_route_source_prefix_list_compile,
-  route_match_ip_route_source_prefix_list_free
+  route_list_ref_compile,
+  route_list_ref_free,
+  NULL,
+  route_prefix_list_resolve
 };
 
 /* `match local-preference LOCAL-PREF' */
@@ -688,7 +706,8 @@ struct route_map_rule_cmd route_match_local_pref_cmd =
   "local-preference",
   route_match_local_pref,
   route_match_local_pref_compile,
-  route_match_local_pref_free
+  route_match_local_pref_free,
+  route_rule_cacheable
 };
 
 /* `match metric METRIC' */
@@ -717,6 +736,7 @@ struct route_map_rule_cmd route_match_metric_cmd =
   route_match_metric,
   route_value_compile,
   route_value_free,
+  route_value_cacheable
 };
 
 /* `match as-path ASPATH' */
@@ -732,7 +752,7 @@ route_match_aspath (void *rule, struct prefix *prefix,
 
   if (type == RMAP_BGP)
     {
-      as_list = as_list_lookup ((char *) rule);
+      as_list = ((struct rmap_list_ref *) rule)->list;
       if (as_list == NULL)
 	return RMAP_NOMATCH;
 
@@ -744,27 +764,15 @@ route_match_aspath (void *rule, struct prefix *prefix,
   return RMAP_NOMATCH;
 }
 
-/* Compile function for as-path match. */
-static void *
-route_match_aspath_compile (const char *arg)
-{
-  return XSTRDUP (MTYPE_ROUTE_MAP_COMPILED, arg);
-}
-
-/* Compile function for as-path match. */
-static void
-route_match_aspath_free (void *rule)
-{
-  XFREE (MTYPE_ROUTE_MAP_COMPILED, rule);
-}
-
 /* Route map commands for aspath matching. */
 struct route_map_rule_cmd route_match_aspath_cmd = 
 {
   "as-path",
   route_match_aspath,
-  route_match_aspath_compile,
-  route_match_aspath_free
+  route_list_ref_compile,
+  route_list_ref_free,
+  route_rule_cacheable,
+  route_as_list_resolve
 };
 
 /* `match community COMMUNIY' */
@@ -772,6 +780,7 @@ struct rmap_community
 {
   char *name;
   int exact;
+  struct community_list *list;
 };
 
 /* Match function for community match. */
@@ -788,7 +797,7 @@ route_match_community (void *rule, struct prefix *prefix,
       bgp_info = object;
       rcom = rule;
 
-      list = community_list_lookup (bgp_clist, rcom->name, COMMUNITY_LIST_MASTER);
+      list = rcom->list;
       if (! list)
 	return RMAP_NOMATCH;
 
@@ -842,13 +851,24 @@ route_match_community_free (void *rule)
   XFREE (MTYPE_ROUTE_MAP_COMPILED, rcom);
 }
 
+static void
+route_match_community_resolve (void *rule)
+{
+  struct rmap_community *rcom = rule;
+
+  rcom->list = community_list_lookup (bgp_clist, rcom->name,
+				      COMMUNITY_LIST_MASTER);
+}
+
 /* Route map commands for community matching. */
 struct route_map_rule_cmd route_match_community_cmd = 
 {
   "community",
   route_match_community,
   route_match_community_compile,
-  route_match_community_free
+  route_match_community_free,
+  route_rule_cacheable,
+  route_match_community_resolve
 };
 
 /* Match function for extcommunity match. */
@@ -866,8 +886,7 @@ route_match_ecommunity (void *rule, struct prefix *prefix,
       if (!bgp_info->attr->extra)
         return RMAP_NOMATCH;
       
-      list = community_list_lookup (bgp_clist, (char *) rule,
-				    EXTCOMMUNITY_LIST_MASTER);
+      list = ((struct rmap_list_ref *) rule)->list;
       if (! list)
 	return RMAP_NOMATCH;
 
@@ -877,27 +896,15 @@ route_match_ecommunity (void *rule, struct prefix *prefix,
   return RMAP_NOMATCH;
 }
 
-/* Compile function for extcommunity match. */
-static void *
-route_match_ecommunity_compile (const char *arg)
-{
-  return XSTRDUP (MTYPE_ROUTE_MAP_COMPILED, arg);
-}
-
-/* Compile function for extcommunity match. */
-static void
-route_match_ecommunity_free (void *rule)
-{
-  XFREE (MTYPE_ROUTE_MAP_COMPILED, rule);
-}
-
 /* Route map commands for community matching. */
 struct route_map_rule_cmd route_match_ecommunity_cmd = 
 {
   "extcommunity",
   route_match_ecommunity,
-  route_match_ecommunity_compile,
-  route_match_ecommunity_free
+  route_list_ref_compile,
+  route_list_ref_free,
+  route_rule_cacheable,
+  route_ecommunity_list_resolve
 };
 
 /* `match nlri` and `set nlri` are replaced by `address-family ipv4`
@@ -953,7 +960,8 @@ struct route_map_rule_cmd route_match_origin_cmd =
   "origin",
   route_match_origin,
   route_match_origin_compile,
-  route_match_origin_free
+  route_match_origin_free,
+  route_rule_cacheable
 };
 
 /* match probability  { */
@@ -1096,6 +1104,7 @@ static struct route_map_rule_cmd route_match_tag_cmd =
   route_match_tag,
   route_map_rule_tag_compile,
   route_map_rule_tag_free,
+  route_rule_cacheable
 };
 
 
@@ -1195,6 +1204,15 @@ route_set_ip_nexthop_compile (const char *arg)
   return rins;
 }
 
+/* 'peer-address' depends on who the route is from or to. */
+static int
+route_set_ip_nexthop_cacheable (void *rule)
+{
+  struct rmap_ip_nexthop_set *rins = rule;
+
+  return ! rins->peer_address;
+}
+
 /* Free route map's compiled `ip nexthop' value. */
 static void
 route_set_ip_nexthop_free (void *rule)
@@ -1213,7 +1231,8 @@ struct route_map_rule_cmd route_set_ip_nexthop_cmd =
   "ip next-hop",
   route_set_ip_nexthop,
   route_set_ip_nexthop_compile,
-  route_set_ip_nexthop_free
+  route_set_ip_nexthop_free,
+  route_set_ip_nexthop_cacheable
 };
 
 /* `set local-preference LOCAL_PREF' */
@@ -1251,6 +1270,7 @@ struct route_map_rule_cmd route_set_local_pref_cmd =
   route_set_local_pref,
   route_value_compile,
   route_value_free,
+  route_value_cacheable
 };
 
 /* `set weight WEIGHT' */
@@ -1288,6 +1308,7 @@ struct route_map_rule_cmd route_set_weight_cmd =
   route_set_weight,
   route_value_compile,
   route_value_free,
+  route_value_cacheable
 };
 
 /* `set metric METRIC' */
@@ -1323,15 +1344,24 @@ struct route_map_rule_cmd route_set_metric_cmd =
   route_set_metric,
   route_value_compile,
   route_value_free,
+  route_value_cacheable
 };
 
 /* `set as-path prepend ASPATH' */
 
+/* Compiled value: the AS path to prepend, or for 'last-as N' the number
+   of times to prepend the leftmost AS. */
+struct rmap_aspath_prepend
+{
+  struct aspath *aspath;
+  unsigned int last_as;
+};
+
 /* For AS path prepend mechanism. */
 static route_map_result_t
 route_set_aspath_prepend (void *rule, struct prefix *prefix, route_map_object_t type, void *object)
 {
-  struct aspath *aspath;
+  struct rmap_aspath_prepend *rap = rule;
   struct aspath *new;
   struct bgp_info *binfo;
 
@@ -1344,16 +1374,13 @@ route_set_aspath_prepend (void *rule, struct prefix *prefix, route_map_object_t
       else
 	new = binfo->attr->aspath;
 
-      if ((uintptr_t)rule > 10)
-      {
-	aspath = rule;
-	aspath_prepend (aspath, new);
-      }
+      if (! rap->last_as)
+	aspath_prepend (rap->aspath, new);
       else
       {
 	as_t as = aspath_leftmost(new);
 	if (!as) as = binfo->peer->as;
-	new = aspath_add_seq_n (new, as, (uintptr_t) rule);
+	new = aspath_add_seq_n (new, as, rap->last_as);
       }
 
       binfo->attr->aspath = new;
@@ -1365,19 +1392,41 @@ route_set_aspath_prepend (void *rule, struct prefix *prefix, route_map_object_t
 static void *
 route_set_aspath_prepend_compile (const char *arg)
 {
+  struct rmap_aspath_prepend *rap;
+  struct aspath *aspath = NULL;
   unsigned int num;
 
-  if (sscanf(arg, "last-as %u", &num) == 1 && num > 0 && num < 10)
-    return (void*)(uintptr_t)num;
+  if (sscanf(arg, "last-as %u", &num) != 1 || num == 0 || num >= 10)
+    {
+      num = 0;
+      aspath = route_aspath_compile (arg);
+      if (! aspath)
+	return NULL;
+    }
+
+  rap = XCALLOC (MTYPE_ROUTE_MAP_COMPILED, sizeof (struct rmap_aspath_prepend));
+  rap->aspath = aspath;
+  rap->last_as = num;
+  return rap;
+}
+
+/* 'last-as' may fall back to the peer's AS. */
+static int
+route_set_aspath_prepend_cacheable (void *rule)
+{
+  struct rmap_aspath_prepend *rap = rule;
 
-  return route_aspath_compile(arg);
+  return ! rap->last_as;
 }
 
 static void
 route_set_aspath_prepend_free (void *rule)
 {
-  if ((uintptr_t)rule > 10)
-    route_aspath_free(rule);
+  struct rmap_aspath_prepend *rap = rule;
+
+  if (rap->aspath)
+    route_aspath_free (rap->aspath);
+  XFREE (MTYPE_ROUTE_MAP_COMPILED, rap);
 }
 
 
@@ -1388,6 +1437,7 @@ struct route_map_rule_cmd route_set_aspath_prepend_cmd =
   route_set_aspath_prepend,
   route_set_aspath_prepend_compile,
   route_set_aspath_prepend_free,
+  route_set_aspath_prepend_cacheable
 };
 
 /* `set as-path exclude ASn' */
@@ -1422,6 +1472,7 @@ struct route_map_rule_cmd route_set_aspath_exclude_cmd =
   route_set_aspath_exclude,
   route_aspath_compile,
   route_aspath_free,
+  route_rule_cacheable
 };
 
 /* `set community COMMUNITY' */
@@ -1546,6 +1597,7 @@ struct route_map_rule_cmd route_set_community_cmd =
   route_set_community,
   route_set_community_compile,
   route_set_community_free,
+  route_rule_cacheable
 };
 
 /* `set comm-list (<1-99>|<100-500>|WORD) delete' */
@@ -1567,7 +1619,7 @@ route_set_community_delete (void *rule, struct prefix *prefix,
 	return RMAP_OKAY;
 
       binfo = object;
-      list = community_list_lookup (bgp_clist, rule, COMMUNITY_LIST_MASTER);
+      list = ((struct rmap_list_ref *) rule)->list;
       old = binfo->attr->community;
 
       if (list && old)
@@ -1604,28 +1656,19 @@ route_set_community_delete (void *rule, struct prefix *prefix,
 static void *
 route_set_community_delete_compile (const char *arg)
 {
+  struct rmap_list_ref *ref;
   char *p;
-  char *str;
   int len;
 
   p = strchr (arg, ' ');
-  if (p)
-    {
-      len = p - arg;
-      str = XCALLOC (MTYPE_ROUTE_MAP_COMPILED, len + 1);
-      memcpy (str, arg, len);
-    }
-  else
-    str = NULL;
+  if (! p)
+    return NULL;
 
-  return str;
-}
-
-/* Free function for set community. */
-static void
-route_set_community_delete_free (void *rule)
-{
-  XFREE (MTYPE_ROUTE_MAP_COMPILED, rule);
+  len = p - arg;
+  ref = XCALLOC (MTYPE_ROUTE_MAP_COMPILED, sizeof (struct rmap_list_ref));
+  ref->name = XCALLOC (MTYPE_ROUTE_MAP_COMPILED, len + 1);
+  memcpy (ref->name, arg, len);
+  return ref;
 }
 
 /* Set community rule structure. */
@@ -1634,7 +1677,9 @@ struct route_map_rule_cmd route_set_community_delete_cmd =
   "comm-list",
   route_set_community_delete,
   route_set_community_delete_compile,
-  route_set_community_delete_free,
+  route_list_ref_free,
+  route_rule_cacheable,
+  route_community_list_resolve
 };
 
 /* `set extcommunity rt COMMUNITY' */
@@ -1707,6 +1752,7 @@ struct route_map_rule_cmd route_set_ecommunity_rt_cmd =
   route_set_ecommunity,
   route_set_ecommunity_rt_compile,
   route_set_ecommunity_free,
+  route_rule_cacheable
 };
 
 /* `set extcommunity soo COMMUNITY' */
@@ -1731,6 +1777,7 @@ struct route_map_rule_cmd route_set_ecommunity_soo_cmd =
   route_set_ecommunity,
   route_set_ecommunity_soo_compile,
   route_set_ecommunity_free,
+  route_rule_cacheable
 };
 
 /* `set origin ORIGIN' */
@@ -1785,6 +1832,7 @@ struct route_map_rule_cmd route_set_origin_cmd =
   route_set_origin,
   route_set_origin_compile,
   route_set_origin_free,
+  route_rule_cacheable
 };
 
 /* `set atomic-aggregate' */
@@ -1826,6 +1874,7 @@ struct route_map_rule_cmd route_set_atomic_aggregate_cmd =
   route_set_atomic_aggregate,
   route_set_atomic_aggregate_compile,
   route_set_atomic_aggregate_free,
+  route_rule_cacheable
 };
 
 /* `set aggregator as AS A.B.C.D' */
@@ -1885,6 +1934,7 @@ struct route_map_rule_cmd route_set_aggregator_as_cmd =
   route_set_aggregator_as,
   route_set_aggregator_as_compile,
   route_set_aggregator_as_free,
+  route_rule_cacheable
 };
 
 /* Set tag to object. object must be pointer to struct bgp_info */
@@ -1917,10 +1967,27 @@ static struct route_map_rule_cmd route_set_tag_cmd =
   route_set_tag,
   route_map_rule_tag_compile,
   route_map_rule_tag_free,
+  route_rule_cacheable
 };
 
 
 #ifdef HAVE_IPV6
+static void
+route_access_list6_resolve (void *rule)
+{
+  struct rmap_list_ref *ref = rule;
+
+  ref->list = access_list_lookup (AFI_IP6, ref->name);
+}
+
+static void
+route_prefix_list6_resolve (void *rule)
+{
+  struct rmap_list_ref *ref = rule;
+
+  ref->list = prefix_list_lookup (AFI_IP6, ref->name);
+}
+
 /* `match ipv6 address IP_ACCESS_LIST' */
 
 static route_map_result_t
@@ -1931,7 +1998,7 @@ route_match_ipv6_address (void *rule, struct prefix *prefix,
 
   if (type == RMAP_BGP)
     {
-      alist = access_list_lookup (AFI_IP6, (char *) rule);
+      alist = ((struct rmap_list_ref *) rule)->list;
       if (alist == NULL)
 	return RMAP_NOMATCH;
     
@@ -1941,25 +2008,15 @@ route_match_ipv6_address (void *rule, struct prefix *prefix,
   return RMAP_NOMATCH;
 }
 
-static void *
-route_match_ipv6_address_compile (const char *arg)
-{
-  return XSTRDUP (MTYPE_ROUTE_MAP_COMPILED, arg);
-}
-
-static void
-route_match_ipv6_address_free (void *rule)
-{
-  XFREE (MTYPE_ROUTE_MAP_COMPILED, rule);
-}
-
 /* Route map commands for ip address matching. */
 struct route_map_rule_cmd route_match_ipv6_address_cmd =
 {
   "ipv6 address",
   route_match_ipv6_address,
-  route_match_ipv6_address_compile,
-  route_match_ipv6_address_free
+  route_list_ref_compile,
+  route_list_ref_free,
+  NULL,
+  route_access_list6_resolve
 };
 
 /* `match ipv6 next-hop IP_ADDRESS' */
@@ -2020,7 +2077,8 @@ struct route_map_rule_cmd route_match_ipv6_next_hop_cmd =
   "ipv6 next-hop",
   route_match_ipv6_next_hop,
   route_match_ipv6_next_hop_compile,
-  route_match_ipv6_next_hop_free
+  route_match_ipv6_next_hop_free,
+  route_rule_cacheable
 };
 
 /* `match ipv6 address prefix-list PREFIX_LIST' */
@@ -2033,7 +2091,7 @@ route_match_ipv6_address_prefix_list (void *rule, struct prefix *prefix,
 
   if (type == RMAP_BGP)
     {
-      plist = prefix_list_lookup (AFI_IP6, (char *) rule);
+      plist = ((struct rmap_list_ref *) rule)->list;
       if (plist == NULL)
 	return RMAP_NOMATCH;
     
@@ -2043,24 +2101,14 @@ route_match_ipv6_address_prefix_list (void *rule, struct prefix *prefix,
   return RMAP_NOMATCH;
 }
 
-static void *
-route_match_ipv6_address_prefix_list_compile (const char *arg)
-{
-  return XSTRDUP (MTYPE_ROUTE_MAP_COMPILED, arg);
-}
-
-static void
-route_match_ipv6_address_prefix_list_free (void *rule)
-{
-  XFREE (MTYPE_ROUTE_MAP_COMPILED, rule);
-}
-
 struct route_map_rule_cmd route_match_ipv6_address_prefix_list_cmd =
 {
   "ipv6 address prefix-list",
   route_match_ipv6_address_prefix_list,
-  route_match_ipv6_address_prefix_list_compile,
-  route_match_ipv6_address_prefix_list_free
+  route_list_ref_compile,
+  route_list_ref_free,
+  NULL,
+  route_prefix_list6_resolve
 };
 
 /* `set ipv6 nexthop global IP_ADDRESS' */
@@ -2127,7 +2175,8 @@ struct route_map_rule_cmd route_set_ipv6_nexthop_global_cmd =
   "ipv6 next-hop global",
   route_set_ipv6_nexthop_global,
   route_set_ipv6_nexthop_global_compile,
-  route_set_ipv6_nexthop_global_free
+  route_set_ipv6_nexthop_global_free,
+  route_rule_cacheable
 };
 
 /* Set next-hop preference value. */
@@ -2255,7 +2304,8 @@ struct route_map_rule_cmd route_set_ipv6_nexthop_local_cmd =
   "ipv6 next-hop local",
   route_set_ipv6_nexthop_local,
   route_set_ipv6_nexthop_local_compile,
-  route_set_ipv6_nexthop_local_free
+  route_set_ipv6_nexthop_local_free,
+  route_rule_cacheable
 };
 
 /* `set ipv6 nexthop peer-address' */
@@ -2401,7 +2451,8 @@ struct route_map_rule_cmd route_set_vpnv4_nexthop_cmd =
   "vpnv4 next-hop",
   route_set_vpnv4_nexthop,
   route_set_vpnv4_nexthop_compile,
-  route_set_vpnv4_nexthop_free
+  route_set_vpnv4_nexthop_free,
+  route_rule_cacheable
 };
 
 /* `set originator-id' */
@@ -2459,6 +2510,7 @@ struct route_map_rule_cmd route_set_originator_id_cmd =
   route_set_originator_id,
   route_set_originator_id_compile,
   route_set_originator_id_free,
+  route_rule_cacheable
 };
 
 /* Add bgp route map rule. */
@@ -2865,6 +2917,186 @@ bgp_route_map_process_update_cb (char *rmap_name)
   return 0;
 }
 
+/* Results of route_map_apply() for maps whose rules only look at the
+   attributes, see route_map_cacheable().  Entries are keyed by map and
+   input attributes and hold references on the interned input and output
+   attributes; they go stale as soon as route_map_version() moves on,
+   which covers edits to the maps themselves and to the lists they use. */
+#define BGP_RMAP_CACHE_SIZE 4096
+
+struct bgp_rmap_cache_entry
+{
+  struct route_map *map;
+  struct attr *in;
+  struct attr *out;		/* NULL when denied */
+  route_map_result_t ret;
+};
+
+static struct bgp_rmap_cache_entry *bgp_rmap_cache;
+static unsigned long bgp_rmap_cache_version;
+static unsigned long bgp_rmap_cache_count;
+static unsigned long bgp_rmap_cache_hits;
+static unsigned long bgp_rmap_cache_misses;
+
+static void
+bgp_rmap_cache_entry_release (struct bgp_rmap_cache_entry *entry)
+{
+  if (! entry->map)
+    return;
+  bgp_attr_unintern (&entry->in);
+  if (entry->out)
+    bgp_attr_unintern (&entry->out);
+  memset (entry, 0, sizeof (struct bgp_rmap_cache_entry));
+  bgp_rmap_cache_count--;
+}
+
+static void
+bgp_rmap_cache_flush (void)
+{
+  int i;
+
+  if (! bgp_rmap_cache)
+    return;
+  for (i = 0; i < BGP_RMAP_CACHE_SIZE; i++)
+    bgp_rmap_cache_entry_release (&bgp_rmap_cache[i]);
+}
+
+/* attrhash_cmp() compares the parts by pointer, so they must be interned
+   for the attributes to be usable as a key. */
+static int
+bgp_rmap_cache_attr_interned (struct attr *attr)
+{
+  if (attr->aspath && ! attr->aspath->refcnt)
+    return 0;
+  if (attr->community && ! attr->community->refcnt)
+    return 0;
+  if (attr->extra)
+    {
+      struct attr_extra *attre = attr->extra;
+
+      if (attre->ecommunity && ! attre->ecommunity->refcnt)
+	return 0;
+      if (attre->cluster && ! attre->cluster->refcnt)
+	return 0;
+      if (attre->transit && ! attre->transit->refcnt)
+	return 0;
+    }
+  return 1;
+}
+
+/* Overwrite attr with the cached result, the way the set rules would
+   have.  Parts the map left alone are the input's, which attr already
+   holds.  Those it set are copied, as the entry may be evicted before
+   the caller interns attr, and the caller then owns them just as it
+   would own those made by the set rules.  Route-maps do not set the
+   cluster list or unknown transitive attributes. */
+static void
+bgp_rmap_cache_copy_out (struct attr *attr, struct attr *in, struct attr *out)
+{
+  struct attr_extra *extra = attr->extra;
+  unsigned long refcnt = attr->refcnt;
+  ifindex_t nh_ifindex = attr->nh_ifindex;
+  struct bgp_attr_encap_subtlv *encap_subtlvs = NULL;
+#if ENABLE_BGP_VNC
+  struct bgp_attr_encap_subtlv *vnc_subtlvs = NULL;
+#endif
+
+  /* Route-maps do not touch the sub-TLVs, keep the caller's own. */
+  if (extra)
+    {
+      encap_subtlvs = extra->encap_subtlvs;
+#if ENABLE_BGP_VNC
+      vnc_subtlvs = extra->vnc_subtlvs;
+#endif
+    }
+
+  *attr = *out;
+  attr->extra = extra;
+  attr->refcnt = refcnt;
+  attr->nh_ifindex = nh_ifindex;
+
+  if (out->aspath && out->aspath != in->aspath)
+    attr->aspath = aspath_dup (out->aspath);
+  if (out->community && out->community != in->community)
+    attr->community = community_dup (out->community);
+
+  if (out->extra)
+    {
+      extra = bgp_attr_extra_get (attr);
+      *extra = *out->extra;
+      extra->encap_subtlvs = encap_subtlvs;
+#if ENABLE_BGP_VNC
+      extra->vnc_subtlvs = vnc_subtlvs;
+#endif
+      if (extra->ecommunity
+	  && extra->ecommunity != (in->extra ? in->extra->ecommunity : NULL))
+	extra->ecommunity = ecommunity_dup (extra->ecommunity);
+    }
+}
+
+/* route_map_apply() for BGP routes, answered from the result cache when
+   the map allows it. */
+route_map_result_t
+bgp_route_map_apply (struct route_map *map, struct prefix *p,
+		     struct bgp_info *info)
+{
+  struct bgp_rmap_cache_entry *entry;
+  route_map_result_t ret;
+  u_int32_t key;
+
+  if (! map
+      || ! route_map_cacheable (map)
+      || ! bgp_rmap_cache_attr_interned (info->attr))
+    return route_map_apply (map, p, RMAP_BGP, info);
+
+  if (bgp_rmap_cache_version != route_map_version ())
+    {
+      bgp_rmap_cache_flush ();
+      bgp_rmap_cache_version = route_map_version ();
+    }
+  if (! bgp_rmap_cache)
+    bgp_rmap_cache = XCALLOC (MTYPE_BGP_RMAP_CACHE,
+			      BGP_RMAP_CACHE_SIZE
+			      * sizeof (struct bgp_rmap_cache_entry));
+
+  key = jhash_1word ((uintptr_t) map, attrhash_key_make (info->attr));
+  entry = &bgp_rmap_cache[key % BGP_RMAP_CACHE_SIZE];
+
+  if (entry->map == map && attrhash_cmp (info->attr, entry->in))
+    {
+      bgp_rmap_cache_hits++;
+      if (entry->out)
+	bgp_rmap_cache_copy_out (info->attr, entry->in, entry->out);
+      return entry->ret;
+    }
+
+  bgp_rmap_cache_misses++;
+  bgp_rmap_cache_entry_release (entry);
+  entry->in = bgp_attr_intern (info->attr);
+
+  ret = route_map_apply (map, p, RMAP_BGP, info);
+
+  entry->map = map;
+  entry->ret = ret;
+  if (ret != RMAP_DENYMATCH)
+    {
+      /* Interning puts the cache's parts in info->attr: give the
+         caller its own copies, as on a hit. */
+      entry->out = bgp_attr_intern (info->attr);
+      bgp_rmap_cache_copy_out (info->attr, entry->in, entry->out);
+    }
+  bgp_rmap_cache_count++;
+  return ret;
+}
+
+unsigned long
+bgp_route_map_cache_count (unsigned long *hits, unsigned long *misses)
+{
+  *hits = bgp_rmap_cache_hits;
+  *misses = bgp_rmap_cache_misses;
+  return bgp_rmap_cache_count;
+}
+
 int
 bgp_route_map_update_timer(struct thread *thread)
 {
@@ -4762,6 +4994,9 @@ bgp_route_map_terminate (void)
   route_map_add_hook (NULL);
   route_map_delete_hook (NULL);
   route_map_event_hook (NULL);
+  bgp_rmap_cache_flush ();
+  if (bgp_rmap_cache)
+    XFREE (MTYPE_BGP_RMAP_CACHE, bgp_rmap_cache);
   route_map_finish();
 
 }
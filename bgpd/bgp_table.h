@@ -36,6 +36,12 @@ struct bgp_table
 
   struct route_table *route_table;
   uint64_t version;
+
+  /* Prefixes that have paths, the sum of their lengths, and paths,
+     kept up to date by bgp_info_add and bgp_info_reap.  */
+  unsigned long prefix_count;
+  unsigned long prefix_len_total;
+  unsigned long path_count;
 };
 
 struct bgp_node
@@ -56,10 +62,14 @@ struct bgp_node
 
   struct bgp_node *prn;
 
+  /* Next node on the bgp_process_queue this node is scheduled on */
+  struct bgp_node *process_next;
+
   uint64_t version;
   u_char flags;
 #define BGP_NODE_PROCESS_SCHEDULED	(1 << 0)
 #define BGP_NODE_USER_CLEAR             (1 << 1)
+#define BGP_NODE_CLEAR_SCHEDULED        (1 << 2)
 };
 
 /*
@@ -185,6 +195,18 @@ bgp_node_get (struct bgp_table *const table, struct prefix *p)
   return bgp_node_from_rnode (route_node_get (table->route_table, p));
 }
 
+/*
+ * bgp_node_get_hint
+ */
+static inline struct bgp_node *
+bgp_node_get_hint (struct bgp_table *const table, struct bgp_node *hint,
+                   struct prefix *p)
+{
+  return bgp_node_from_rnode (route_node_get_hint (table->route_table,
+                                                   bgp_node_to_rnode (hint),
+                                                   p));
+}
+
 /*
  * bgp_node_lookup
  */
@@ -82,7 +82,7 @@ update_subgroup_checkin (struct update_subgroup *subgrp,
 }
 
 static void
-sync_init (struct update_subgroup *subgrp)
+sync_init (struct update_subgroup *subgrp, bgp_size_t max_packet_size)
 {
   subgrp->sync = XCALLOC (MTYPE_BGP_SYNCHRONISE,
 			  sizeof (struct bgp_synchronize));
@@ -91,7 +91,8 @@ sync_init (struct update_subgroup *subgrp)
   BGP_ADV_FIFO_INIT (&subgrp->sync->withdraw_low);
   subgrp->hash = hash_create (baa_hash_key, baa_hash_cmp);
 
-  /* We use a larger buffer for subgrp->work in the event that:
+  /* Packets are built up to the size the update group's peers accept.
+   * We use a larger buffer for subgrp->work in the event that:
    * - We RX a BGP_UPDATE where the attributes alone are just
    *   under BGP_MAX_PACKET_SIZE
    * - The user configures an outbound route-map that does many as-path
@@ -102,8 +103,8 @@ sync_init (struct update_subgroup *subgrp)
    * Having a buffer with BGP_MAX_PACKET_SIZE_OVERFLOW allows us to avoid bounds
    * checking for every single attribute as we construct an UPDATE.
    */
-  subgrp->work = stream_new (BGP_MAX_PACKET_SIZE + BGP_MAX_PACKET_SIZE_OVERFLOW);
-  subgrp->scratch = stream_new (BGP_MAX_PACKET_SIZE);
+  subgrp->work = stream_new (max_packet_size + BGP_MAX_PACKET_SIZE_OVERFLOW);
+  subgrp->scratch = stream_new (max_packet_size);
 }
 
 static void
@@ -148,6 +149,7 @@ conf_copy (struct peer *dst, struct peer *src, afi_t afi, safi_t safi)
 
   dst->host = XSTRDUP(MTYPE_BGP_PEER_HOST, src->host);
   dst->cap = src->cap;
+  dst->max_packet_size = src->max_packet_size;
   dst->af_cap[afi][safi] = src->af_cap[afi][safi];
   dst->afc_nego[afi][safi] = src->afc_nego[afi][safi];
   dst->orf_plist[afi][safi] = src->orf_plist[afi][safi];
@@ -613,6 +615,8 @@ update_group_show_walkcb (struct update_group *updgrp, void *arg)
 	     subgrp->peer_refreshes_combined, VTY_NEWLINE);
     vty_out (vty, "    Merge checks triggered: %u%s",
 	     subgrp->merge_checks_triggered, VTY_NEWLINE);
+    vty_out (vty, "    Adj-out syncs: %u%s",
+	     subgrp->sync_events, VTY_NEWLINE);
     vty_out (vty, "    Version: %" PRIu64 "%s", subgrp->version, VTY_NEWLINE);
     vty_out (vty, "    Packet queue length: %d%s",
 	     bpacket_queue_length (SUBGRP_PKTQ (subgrp)), VTY_NEWLINE);
@@ -780,7 +784,7 @@ update_subgroup_create (struct update_group *updgrp)
   subgrp = XCALLOC (MTYPE_BGP_UPD_SUBGRP, sizeof (struct update_subgroup));
   update_subgroup_checkin (subgrp, updgrp);
   subgrp->v_coalesce = (UPDGRP_INST (updgrp))->coalesce_time;
-  sync_init (subgrp);
+  sync_init (subgrp, UPDGRP_PEER (updgrp)->max_packet_size);
   bpacket_queue_init (SUBGRP_PKTQ (subgrp));
   bpacket_queue_add (SUBGRP_PKTQ (subgrp), NULL, NULL);
   TAILQ_INIT (&(subgrp->adjq));
@@ -810,6 +814,9 @@ update_subgroup_delete (struct update_subgroup *subgrp)
   if (subgrp->t_coalesce)
     THREAD_TIMER_OFF (subgrp->t_coalesce);
 
+  subgroup_pack_reset (subgrp);
+  subgroup_announce_cancel (subgrp);
+
   bpacket_queue_cleanup (SUBGRP_PKTQ (subgrp));
   subgroup_clear_table (subgrp);
 
@@ -834,6 +841,10 @@ update_subgroup_inherit_info (struct update_subgroup *to,
     return;
 
   to->sflags = from->sflags;
+
+  /* A refresh still to come for the old subgroup is owed to the new. */
+  if (CHECK_FLAG (from->flags, SUBGRP_FLAG_ANNOUNCE_PENDING))
+    subgroup_announce_route (to);
 }
 
 /*
@@ -1022,6 +1033,12 @@ update_subgroup_ready_for_merge (struct update_subgroup *subgrp)
   if (update_subgroup_needs_refresh (subgrp))
     return 0;
 
+  /*
+   * Nor one whose routes are about to be refreshed.
+   */
+  if (CHECK_FLAG (subgrp->flags, SUBGRP_FLAG_ANNOUNCE_PENDING))
+    return 0;
+
   return 1;
 }
 
@@ -1463,23 +1480,85 @@ update_group_policy_update (struct bgp *bgp, bgp_policy_type_e ptype,
   update_group_walk (bgp, updgrp_policy_update_walkcb, &ctx);
 }
 
+/*
+ * update_subgroup_sync_from_group
+ *
+ * A peer has moved, with what it was advertised, into a subgroup of its
+ * own in another update group. If that group has a settled subgroup,
+ * sync the adj-out from it: only the routes that the change of policy
+ * affects are then sent, and no walk of the table is needed.
+ *
+ * Returns TRUE if the subgroup is consistent with its update group.
+ */
+static int
+update_subgroup_sync_from_group (struct update_subgroup *subgrp,
+				 struct peer_af *paf)
+{
+  struct update_subgroup *source;
+  struct peer *peer = PAF_PEER (paf);
+  int changed;
+
+  if (CHECK_FLAG (subgrp->sflags, SUBGRP_STATUS_DEFAULT_ORIGINATE)
+      || CHECK_FLAG (peer->af_flags[paf->afi][paf->safi],
+		     PEER_FLAG_DEFAULT_ORIGINATE)
+      || CHECK_FLAG (peer->af_sflags[paf->afi][paf->safi],
+		     PEER_STATUS_ORF_WAIT_REFRESH))
+    return 0;
+
+  UPDGRP_FOREACH_SUBGRP (subgrp->update_group, source)
+  {
+    if (source == subgrp || !source->peer_count)
+      continue;
+
+    if (!advertise_list_is_empty (source)
+	|| update_subgroup_needs_refresh (source)
+	|| CHECK_FLAG (source->flags, SUBGRP_FLAG_ANNOUNCE_PENDING)
+	|| CHECK_FLAG (source->sflags, SUBGRP_STATUS_DEFAULT_ORIGINATE))
+      continue;
+
+    break;
+  }
+
+  if (!source)
+    return 0;
+
+  changed = subgroup_sync_adj_out (subgrp, source);
+  if (changed < 0)
+    return 0;
+
+  SUBGRP_INCR_STAT (subgrp, sync_events);
+  UPDGRP_GLOBAL_STAT (subgrp->update_group, sync_routes) += changed;
+
+  if (BGP_DEBUG (update_groups, UPDATE_GROUPS))
+    zlog_debug ("u%" PRIu64 ":s%" PRIu64 " peer %s synced from s%" PRIu64
+		", %d routes changed", subgrp->update_group->id, subgrp->id,
+		peer->host, source->id, changed);
+  return 1;
+}
+
 /*
  * update_subgroup_split_peer
  *
  * Ensure that the given peer is in a subgroup of its own in the
  * specified update group.
+ *
+ * Returns TRUE if the peer moved to another update group, and what it
+ * was advertised could be brought in line with that group without a
+ * refresh.
  */
-void
+int
 update_subgroup_split_peer (struct peer_af *paf, struct update_group *updgrp)
 {
   struct update_subgroup *old_subgrp, *subgrp;
   uint64_t old_id;
+  int moved;
 
 
   old_subgrp = paf->subgroup;
 
   if (!updgrp)
     updgrp = old_subgrp->update_group;
+  moved = (updgrp != old_subgrp->update_group);
 
   /*
    * If the peer is alone in its subgroup, reuse the existing
@@ -1487,8 +1566,8 @@ update_subgroup_split_peer (struct peer_af *paf, struct update_group *updgrp)
    */
   if (old_subgrp->peer_count == 1)
     {
-      if (updgrp == old_subgrp->update_group)
-	return;
+      if (!moved)
+	return 0;
 
       subgrp = old_subgrp;
       old_id = old_subgrp->update_group->id;
@@ -1509,17 +1588,20 @@ update_subgroup_split_peer (struct peer_af *paf, struct update_group *updgrp)
         zlog_debug ("u%" PRIu64 ":s%" PRIu64 " peer %s moved to u%" PRIu64 ":s%" PRIu64,
                   old_id, subgrp->id, paf->peer->host, updgrp->id, subgrp->id);
 
+      SUBGRP_INCR_STAT (subgrp, updgrp_switch_events);
+
       /*
        * The state of the subgroup (adj_out, advs, packet queue etc)
        * is consistent internally, but may not be identical to other
        * subgroups in the new update group even if the version number
-       * matches up. Make sure a full refresh is done before the
-       * subgroup is merged with another.
+       * matches up. Make sure it is synced, or a full refresh is done,
+       * before the subgroup is merged with another.
        */
-      update_subgroup_set_needs_refresh (subgrp, 1);
+      if (update_subgroup_sync_from_group (subgrp, paf))
+	return 1;
 
-      SUBGRP_INCR_STAT (subgrp, updgrp_switch_events);
-      return;
+      update_subgroup_set_needs_refresh (subgrp, 1);
+      return 0;
     }
 
   /*
@@ -1545,18 +1627,22 @@ update_subgroup_split_peer (struct peer_af *paf, struct update_group *updgrp)
 
   SUBGRP_INCR_STAT (paf->subgroup, split_events);
 
-  /*
-   * Since queued advs were left behind, this new subgroup needs a
-   * refresh.
-   */
-  update_subgroup_set_needs_refresh (subgrp, 1);
-
   /*
    * Remove peer from old subgroup, and add it to the new one.
    */
   update_subgroup_remove_peer (paf->subgroup, paf);
 
   update_subgroup_add_peer (subgrp, paf, 1);
+
+  /*
+   * Since queued advs were left behind, this new subgroup needs a
+   * sync or a refresh.
+   */
+  if (moved && update_subgroup_sync_from_group (subgrp, paf))
+    return 1;
+
+  update_subgroup_set_needs_refresh (subgrp, 1);
+  return 0;
 }
 
 void
@@ -1567,6 +1653,8 @@ update_bgp_group_init (struct bgp *bgp)
   AF_FOREACH (afid)
     bgp->update_groups[afid] = hash_create (updgrp_hash_key_make,
 					    updgrp_hash_cmp);
+
+  bgp->announce_pending = list_new ();
 }
 
 void
@@ -1582,6 +1670,11 @@ update_bgp_group_free (struct bgp *bgp)
           bgp->update_groups[afid] = NULL;
         }
     }
+
+  THREAD_OFF (bgp->t_announce_walk);
+  if (bgp->announce_pending)
+    list_delete (bgp->announce_pending);
+  bgp->announce_pending = NULL;
 }
 
 void
@@ -1604,6 +1697,9 @@ update_group_show (struct bgp *bgp, afi_t afi, safi_t safi, struct vty *vty,
 void
 update_group_show_stats (struct bgp *bgp, struct vty *vty)
 {
+  char range[16];
+  int i;
+
   vty_out (vty, "Update groups created: %u%s",
 	   bgp->update_group_stats.updgrps_created, VTY_NEWLINE);
   vty_out (vty, "Update groups deleted: %u%s",
@@ -1626,12 +1722,46 @@ update_group_show_stats (struct bgp *bgp, struct vty *vty)
 	   bgp->update_group_stats.peer_refreshes_combined, VTY_NEWLINE);
   vty_out (vty, "Merge checks triggered: %u%s",
 	   bgp->update_group_stats.merge_checks_triggered, VTY_NEWLINE);
+  vty_out (vty, "Table walks to announce routes: %u, for %u subgroups%s",
+	   bgp->update_group_stats.announce_walks,
+	   bgp->update_group_stats.announce_walk_subgrps, VTY_NEWLINE);
+  vty_out (vty, "Adj-out syncs instead of table walks: %u, %u routes changed%s",
+	   bgp->update_group_stats.sync_events,
+	   bgp->update_group_stats.sync_routes, VTY_NEWLINE);
+
+  vty_out (vty, "UPDATEs built: %u, with %u prefixes%s",
+	   bgp->update_group_stats.update_packets,
+	   bgp->update_group_stats.update_prefixes, VTY_NEWLINE);
+  if (bgp->update_group_stats.update_packets)
+    vty_out (vty, "  average %.1f prefixes and %" PRIu64 " bytes each%s",
+	     (double) bgp->update_group_stats.update_prefixes
+	     / bgp->update_group_stats.update_packets,
+	     bgp->update_group_stats.update_bytes
+	     / bgp->update_group_stats.update_packets, VTY_NEWLINE);
+  vty_out (vty, "  held back for packing: %u times, for up to %u ms%s",
+	   bgp->update_group_stats.update_pack_holds, bgp->pack_window,
+	   VTY_NEWLINE);
+  vty_out (vty, "Prefixes per UPDATE:%s", VTY_NEWLINE);
+  for (i = 0; i < BGP_UPDATE_PFX_HIST_MAX; i++)
+    {
+      if (i == 0)
+	snprintf (range, sizeof (range), "1");
+      else if (i == BGP_UPDATE_PFX_HIST_MAX - 1)
+	snprintf (range, sizeof (range), "%u+", 1U << i);
+      else
+	snprintf (range, sizeof (range), "%u-%u", 1U << i, (2U << i) - 1);
+      vty_out (vty, "  %9s: %u%s", range,
+	       bgp->update_group_stats.update_pfx_hist[i], VTY_NEWLINE);
+    }
 }
 
 /*
  * update_group_adjust_peer
+ *
+ * Returns TRUE if the peer moved to another update group and needs no
+ * refresh of its routes.
  */
-void
+int
 update_group_adjust_peer (struct peer_af *paf)
 {
   struct update_group *updgrp;
@@ -1639,22 +1769,22 @@ update_group_adjust_peer (struct peer_af *paf)
   struct peer *peer;
 
   if (!paf)
-    return;
+    return 0;
 
   peer = PAF_PEER (paf);
   if (!peer_established (peer))
     {
-      return;
+      return 0;
     }
 
   if (!CHECK_FLAG (peer->flags, PEER_FLAG_CONFIG_NODE))
     {
-      return;
+      return 0;
     }
 
   if (!peer->afc_nego[paf->afi][paf->safi])
     {
-      return;
+      return 0;
     }
 
   updgrp = update_group_find (paf);
@@ -1665,7 +1795,7 @@ update_group_adjust_peer (struct peer_af *paf)
 	{
 	  zlog_err ("couldn't create update group for peer %s",
 		    paf->peer->host);
-	  return;
+	  return 0;
 	}
     }
 
@@ -1679,14 +1809,13 @@ update_group_adjust_peer (struct peer_af *paf)
        * in its existing subgroup and we're done.
        */
       if (old_subgrp->update_group == updgrp)
-	return;
+	return 0;
 
       /*
        * The peer is switching between update groups. Put it in its
        * own subgroup under the new update group.
        */
-      update_subgroup_split_peer (paf, updgrp);
-      return;
+      return update_subgroup_split_peer (paf, updgrp);
     }
 
   subgrp = update_subgroup_find (updgrp, paf);
@@ -1694,7 +1823,7 @@ update_group_adjust_peer (struct peer_af *paf)
     {
       subgrp = update_subgroup_create (updgrp);
       if (!subgrp)
-	return;
+	return 0;
     }
 
   update_subgroup_add_peer (subgrp, paf, 1);
@@ -1702,7 +1831,7 @@ update_group_adjust_peer (struct peer_af *paf)
     zlog_debug ("u%" PRIu64 ":s%" PRIu64 " add peer %s",
                  updgrp->id, subgrp->id, paf->peer->host);
 
-  return;
+  return 0;
 }
 
 int
@@ -31,6 +31,7 @@
 #include "bgp_advertise.h"
 
 #define BGP_DEFAULT_SUBGROUP_COALESCE_TIME 200
+#define BGP_DEFAULT_UPDATE_PACK_WINDOW     0
 
 #define PEER_UPDGRP_FLAGS (PEER_FLAG_LOCAL_AS_NO_PREPEND | \
 			   PEER_FLAG_LOCAL_AS_REPLACE_AS)
@@ -54,7 +55,9 @@
                               PEER_FLAG_ADDPATH_TX_BESTPATH_PER_AS | \
 			      PEER_FLAG_AS_OVERRIDE)
 
-#define PEER_UPDGRP_CAP_FLAGS (PEER_CAP_AS4_RCV)
+#define PEER_UPDGRP_CAP_FLAGS (PEER_CAP_AS4_RCV | \
+                               PEER_CAP_EXT_MESSAGE_ADV | \
+                               PEER_CAP_EXT_MESSAGE_RCV)
 
 #define PEER_UPDGRP_AF_CAP_FLAGS (PEER_CAP_ORF_PREFIX_SM_RCV | \
 				  PEER_CAP_ORF_PREFIX_SM_OLD_RCV |\
@@ -144,6 +147,7 @@ struct update_group
   u_int32_t adj_count;
   u_int32_t split_events;
   u_int32_t merge_checks_triggered;
+  u_int32_t sync_events;
 
   u_int32_t subgrps_created;
   u_int32_t subgrps_deleted;
@@ -217,6 +221,10 @@ struct update_subgroup
 
   struct thread *t_merge_check;
 
+  /* Running while part-filled UPDATEs are held back, see
+     subgroup_update_packet.  */
+  struct thread *t_pack;
+
   /* table version that the subgroup has caught up to. */
   uint64_t version;
 
@@ -247,6 +255,7 @@ struct update_subgroup
   u_int32_t adj_count;
   u_int32_t split_events;
   u_int32_t merge_checks_triggered;
+  u_int32_t sync_events;
 
   uint64_t id;
   struct zlog *log;
@@ -263,6 +272,17 @@ struct update_subgroup
  */
 #define SUBGRP_FLAG_NEEDS_REFRESH         (1 << 0)
 
+/*
+ * Queued for the RIB walker to refresh all routes out to the subgroup.
+ */
+#define SUBGRP_FLAG_ANNOUNCE_PENDING      (1 << 1)
+
+/*
+ * The packing window has closed: send UPDATEs however full they are,
+ * until the advertise queue runs dry.
+ */
+#define SUBGRP_FLAG_PACK_FLUSH            (1 << 2)
+
 #define SUBGRP_STATUS_DEFAULT_ORIGINATE   (1 << 0)
 
 /*
@@ -369,13 +389,13 @@ extern void udpate_bgp_group_free (struct bgp *);
 extern void
 update_group_show (struct bgp *bgp, afi_t afi, safi_t safi, struct vty *vty, uint64_t subgrp_id);
 extern void update_group_show_stats (struct bgp *bgp, struct vty *vty);
-extern void update_group_adjust_peer (struct peer_af *paf);
+extern int update_group_adjust_peer (struct peer_af *paf);
 extern int update_group_adjust_soloness (struct peer *peer, int set);
 
 extern void
 update_subgroup_remove_peer (struct update_subgroup *, struct peer_af *);
 extern struct bgp_table *update_subgroup_rib (struct update_subgroup *);
-extern void
+extern int
 update_subgroup_split_peer (struct peer_af *, struct update_group *);
 extern int
 update_subgroup_check_merge (struct update_subgroup *, const char *);
@@ -417,6 +437,9 @@ extern void bpacket_add_peer (struct bpacket *pkt, struct peer_af *paf);
 unsigned int bpacket_queue_virtual_length (struct peer_af *paf);
 extern void bpacket_queue_show_vty (struct bpacket_queue *q, struct vty *vty);
 int subgroup_packets_to_build (struct update_subgroup *subgrp);
+extern int subgroup_pack_held (struct update_subgroup *subgrp);
+extern void subgroup_pack_start (struct update_subgroup *subgrp);
+extern void subgroup_pack_reset (struct update_subgroup *subgrp);
 extern struct bpacket *subgroup_update_packet (struct update_subgroup *s);
 extern struct bpacket *subgroup_withdraw_packet (struct update_subgroup *s);
 extern struct stream *bpacket_reformat_for_peer (struct bpacket *pkt,
@@ -447,6 +470,7 @@ extern void update_group_show_packet_queue (struct bgp *bgp, afi_t afi,
 					    safi_t safi, struct vty *vty,
 					    uint64_t id);
 extern void subgroup_announce_route (struct update_subgroup *subgrp);
+extern void subgroup_announce_cancel (struct update_subgroup *subgrp);
 extern void subgroup_announce_all (struct update_subgroup *subgrp);
 
 extern void
@@ -476,6 +500,9 @@ bgp_adj_out_unset_subgroup (struct bgp_node *rn,
 void
 subgroup_announce_table (struct update_subgroup *subgrp,
 			 struct bgp_table *table);
+extern int
+subgroup_sync_adj_out (struct update_subgroup *subgrp,
+		       struct update_subgroup *source);
 extern void
 subgroup_trigger_write (struct update_subgroup *subgrp);
 
@@ -581,12 +581,16 @@ subgroup_clear_table (struct update_subgroup *subgrp)
 }
 
 /*
- * subgroup_announce_table
+ * subgroup_announce_tables
+ *
+ * Refresh the routes of one table out to a number of subgroups of the
+ * same afi/safi, visiting each node once for all of them.
  */
-void
-subgroup_announce_table (struct update_subgroup *subgrp,
-			 struct bgp_table *table)
+static void
+subgroup_announce_tables (struct update_subgroup **subgrps, int count,
+			  struct bgp_table *table)
 {
+  struct update_subgroup *subgrp;
   struct bgp_node *rn;
   struct bgp_info *ri;
   struct attr attr;
@@ -594,90 +598,254 @@ subgroup_announce_table (struct update_subgroup *subgrp,
   struct peer *peer;
   afi_t afi;
   safi_t safi;
-  int addpath_capable;
+  int *addpath_capable;
+  int i;
 
-  peer = SUBGRP_PEER (subgrp);
-  afi = SUBGRP_AFI (subgrp);
-  safi = SUBGRP_SAFI (subgrp);
-  addpath_capable = bgp_addpath_encode_tx (peer, afi, safi);
+  afi = SUBGRP_AFI (subgrps[0]);
+  safi = SUBGRP_SAFI (subgrps[0]);
 
   if (!table)
-    table = peer->bgp->rib[afi][safi];
+    table = SUBGRP_INST (subgrps[0])->rib[afi][safi];
 
-  if (safi != SAFI_MPLS_VPN
-      && safi != SAFI_ENCAP
-      && safi != SAFI_EVPN
-      && CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_DEFAULT_ORIGINATE))
-    subgroup_default_originate (subgrp, 0);
+  addpath_capable = XCALLOC (MTYPE_TMP, count * sizeof (int));
+  for (i = 0; i < count; i++)
+    {
+      subgrp = subgrps[i];
+      peer = SUBGRP_PEER (subgrp);
+      addpath_capable[i] = bgp_addpath_encode_tx (peer, afi, safi);
+
+      if (safi != SAFI_MPLS_VPN
+	  && safi != SAFI_ENCAP
+	  && safi != SAFI_EVPN
+	  && CHECK_FLAG (peer->af_flags[afi][safi], PEER_FLAG_DEFAULT_ORIGINATE))
+	subgroup_default_originate (subgrp, 0);
+    }
 
   /* It's initialized in bgp_announce_check() */
   attr.extra = &extra;
 
   for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
     for (ri = rn->info; ri; ri = ri->next)
-
-      if (CHECK_FLAG (ri->flags, BGP_INFO_SELECTED) ||
-          (addpath_capable && bgp_addpath_tx_path(peer, afi, safi, ri)))
+      for (i = 0; i < count; i++)
 	{
-	  if (subgroup_announce_check (ri, subgrp, &rn->p, &attr))
-	    bgp_adj_out_set_subgroup (rn, subgrp, &attr, ri);
-	  else
-	    bgp_adj_out_unset_subgroup (rn, subgrp, 1, ri->addpath_tx_id);
+	  subgrp = subgrps[i];
+	  peer = SUBGRP_PEER (subgrp);
+
+	  if (CHECK_FLAG (ri->flags, BGP_INFO_SELECTED) ||
+	      (addpath_capable[i] && bgp_addpath_tx_path(peer, afi, safi, ri)))
+	    {
+	      if (subgroup_announce_check (ri, subgrp, &rn->p, &attr))
+		bgp_adj_out_set_subgroup (rn, subgrp, &attr, ri);
+	      else
+		bgp_adj_out_unset_subgroup (rn, subgrp, 1, ri->addpath_tx_id);
+	    }
 	}
 
-  /*
-   * We walked through the whole table -- make sure our version number
-   * is consistent with the one on the table. This should allow
-   * subgroups to merge sooner if a peer comes up when the route node
-   * with the largest version is no longer in the table. This also
-   * covers the pathological case where all routes in the table have
-   * now been deleted.
-   */
-  subgrp->version = max (subgrp->version, table->version);
+  XFREE (MTYPE_TMP, addpath_capable);
 
-  /*
-   * Start a task to merge the subgroup if necessary.
-   */
-  update_subgroup_trigger_merge_check (subgrp, 0);
+  for (i = 0; i < count; i++)
+    {
+      subgrp = subgrps[i];
+
+      /*
+       * We walked through the whole table -- make sure our version number
+       * is consistent with the one on the table. This should allow
+       * subgroups to merge sooner if a peer comes up when the route node
+       * with the largest version is no longer in the table. This also
+       * covers the pathological case where all routes in the table have
+       * now been deleted.
+       */
+      subgrp->version = max (subgrp->version, table->version);
+
+      /*
+       * Start a task to merge the subgroup if necessary.
+       */
+      update_subgroup_trigger_merge_check (subgrp, 0);
+    }
+}
+
+/*
+ * subgroup_announce_table
+ */
+void
+subgroup_announce_table (struct update_subgroup *subgrp,
+			 struct bgp_table *table)
+{
+  subgroup_announce_tables (&subgrp, 1, table);
+}
+
+/*
+ * subgroup_sync_adj_out
+ *
+ * Bring the adj-out of a subgroup in line with that of another, settled,
+ * subgroup of the same update group. The outbound policy being the same,
+ * only the routes whose advertised state differs between the two need
+ * to be announced or withdrawn, rather than the whole table being run
+ * through the policy again.
+ *
+ * Returns the number of routes announced or withdrawn, or -1 if the
+ * subgroup could not be brought in line and needs a refresh.
+ */
+int
+subgroup_sync_adj_out (struct update_subgroup *subgrp,
+		       struct update_subgroup *source)
+{
+  struct bgp_adj_out *adj, *aout, *tadj;
+  struct bgp_info *ri;
+  int addpath_capable;
+  int changed = 0;
+
+  addpath_capable = bgp_addpath_encode_tx (SUBGRP_PEER (subgrp),
+					   SUBGRP_AFI (subgrp),
+					   SUBGRP_SAFI (subgrp));
+
+  /* Withdraw what the source does not advertise. */
+  SUBGRP_FOREACH_ADJ_SAFE (subgrp, adj, tadj)
+    if (!adj_lookup (adj->rn, source, adj->addpath_tx_id))
+      {
+	bgp_adj_out_unset_subgroup (adj->rn, subgrp, 1, adj->addpath_tx_id);
+	changed++;
+      }
+
+  /* Announce what it advertises differently, or that we do not. */
+  SUBGRP_FOREACH_ADJ (source, aout)
+    {
+      adj = adj_lookup (aout->rn, subgrp, aout->addpath_tx_id);
+      if (adj && !adj->adv && adj->attr == aout->attr)
+	continue;
+
+      for (ri = aout->rn->info; ri; ri = ri->next)
+	if (addpath_capable ? ri->addpath_tx_id == aout->addpath_tx_id
+			    : CHECK_FLAG (ri->flags, BGP_INFO_SELECTED))
+	  break;
+      if (!ri || !aout->attr)
+	return -1;
+
+      bgp_adj_out_set_subgroup (aout->rn, subgrp, aout->attr, ri);
+      changed++;
+    }
+
+  subgrp->version = source->version;
+  return changed;
+}
+
+/*
+ * subgroup_announce_walk
+ *
+ * The RIB walker: refresh all routes out to every subgroup queued by
+ * subgroup_announce_route(), with one walk of the table per afi/safi.
+ */
+static int
+subgroup_announce_walk (struct thread *thread)
+{
+  struct bgp *bgp;
+  struct list *pending;
+  struct listnode *node;
+  struct update_subgroup *subgrp;
+  struct update_subgroup **subgrps;
+  struct bgp_node *rn;
+  struct bgp_table *table;
+  struct peer *onlypeer;
+  afi_t afi;
+  safi_t safi;
+  int count;
+
+  bgp = THREAD_ARG (thread);
+  bgp->t_announce_walk = NULL;
+
+  pending = bgp->announce_pending;
+  bgp->announce_pending = list_new ();
+
+  subgrps = XCALLOC (MTYPE_TMP,
+		     listcount (pending) * sizeof (struct update_subgroup *));
+
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
+      {
+	count = 0;
+	for (ALL_LIST_ELEMENTS_RO (pending, node, subgrp))
+	  {
+	    if (SUBGRP_AFI (subgrp) != afi || SUBGRP_SAFI (subgrp) != safi)
+	      continue;
+
+	    UNSET_FLAG (subgrp->flags, SUBGRP_FLAG_ANNOUNCE_PENDING);
+	    if (update_subgroup_needs_refresh (subgrp))
+	      update_subgroup_set_needs_refresh (subgrp, 0);
+
+	    /*
+	     * First update is deferred until ORF or ROUTE-REFRESH is received
+	     */
+	    onlypeer = ((SUBGRP_PCOUNT (subgrp) == 1) ?
+			(SUBGRP_PFIRST (subgrp))->peer : NULL);
+	    if (onlypeer &&
+		CHECK_FLAG (onlypeer->af_sflags[afi][safi],
+			    PEER_STATUS_ORF_WAIT_REFRESH))
+	      continue;
+
+	    subgrps[count++] = subgrp;
+	  }
+
+	if (!count)
+	  continue;
+
+	bgp->update_group_stats.announce_walks++;
+	bgp->update_group_stats.announce_walk_subgrps += count;
+
+	if (safi != SAFI_MPLS_VPN &&
+	    safi != SAFI_ENCAP &&
+	    safi != SAFI_EVPN)
+	  subgroup_announce_tables (subgrps, count, NULL);
+	else
+	  for (rn = bgp_table_top (bgp->rib[afi][safi]); rn;
+	       rn = bgp_route_next (rn))
+	    if ((table = (rn->info)) != NULL)
+	      subgroup_announce_tables (subgrps, count, table);
+      }
+
+  XFREE (MTYPE_TMP, subgrps);
+  list_delete (pending);
+  return 0;
 }
 
 /*
  * subgroup_announce_route
  *
  * Refresh all routes out to a subgroup.
+ *
+ * This takes a walk of the whole table, so the subgroup is only queued
+ * here; the walk is done once the current event is over, together with
+ * that of any other subgroups queued in the meantime, such as when many
+ * sessions come up or ask for a refresh at once.
  */
 void
 subgroup_announce_route (struct update_subgroup *subgrp)
 {
-  struct bgp_node *rn;
-  struct bgp_table *table;
-  struct peer *onlypeer;
+  struct bgp *bgp = SUBGRP_INST (subgrp);
 
-  if (update_subgroup_needs_refresh (subgrp))
-    {
-      update_subgroup_set_needs_refresh (subgrp, 0);
-    }
+  if (CHECK_FLAG (subgrp->flags, SUBGRP_FLAG_ANNOUNCE_PENDING))
+    return;
 
-  /*
-   * First update is deferred until ORF or ROUTE-REFRESH is received
-   */
-  onlypeer = ((SUBGRP_PCOUNT (subgrp) == 1) ?
-	      (SUBGRP_PFIRST (subgrp))->peer : NULL);
-  if (onlypeer &&
-      CHECK_FLAG (onlypeer->
-		  af_sflags[SUBGRP_AFI (subgrp)][SUBGRP_SAFI (subgrp)],
-		  PEER_STATUS_ORF_WAIT_REFRESH))
+  SET_FLAG (subgrp->flags, SUBGRP_FLAG_ANNOUNCE_PENDING);
+  listnode_add (bgp->announce_pending, subgrp);
+
+  if (!bgp->t_announce_walk)
+    bgp->t_announce_walk = thread_add_event (bm->master,
+					     subgroup_announce_walk, bgp, 0);
+}
+
+/*
+ * subgroup_announce_cancel
+ *
+ * Take a subgroup that is going away off the walker's queue.
+ */
+void
+subgroup_announce_cancel (struct update_subgroup *subgrp)
+{
+  if (!CHECK_FLAG (subgrp->flags, SUBGRP_FLAG_ANNOUNCE_PENDING))
     return;
 
-  if (SUBGRP_SAFI (subgrp) != SAFI_MPLS_VPN &&
-      SUBGRP_SAFI (subgrp) != SAFI_ENCAP &&
-      SUBGRP_SAFI (subgrp) != SAFI_EVPN)
-    subgroup_announce_table (subgrp, NULL);
-  else
-    for (rn = bgp_table_top (update_subgroup_rib (subgrp)); rn;
-	 rn = bgp_route_next (rn))
-      if ((table = (rn->info)) != NULL)
-	subgroup_announce_table (subgrp, table);
+  UNSET_FLAG (subgrp->flags, SUBGRP_FLAG_ANNOUNCE_PENDING);
+  listnode_delete (SUBGRP_INST (subgrp)->announce_pending, subgrp);
 }
 
 void
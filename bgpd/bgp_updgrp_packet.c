@@ -604,6 +604,108 @@ bpacket_attr_vec_arr_update (struct bpacket_attr_vec_arr *vecarr, size_t pos)
     vecarr->entries[i].offset += pos;
 }
 
+static int
+subgroup_pack_timer (struct thread *thread)
+{
+  struct update_subgroup *subgrp;
+
+  subgrp = THREAD_ARG (thread);
+  subgrp->t_pack = NULL;
+  SET_FLAG (subgrp->flags, SUBGRP_FLAG_PACK_FLUSH);
+  subgroup_trigger_write (subgrp);
+  return 0;
+}
+
+/*
+ * An UPDATE carries one set of attributes, and the advertisements with
+ * the same attributes are chained off their bgp_advertise_attr, so the
+ * packet started at the head of the queue takes in the whole chain.
+ * Whether the chain fills an UPDATE of its own.
+ */
+static int
+subgroup_pack_full (struct update_subgroup *subgrp, struct bgp_advertise *adv)
+{
+  int space;
+  int needed;
+
+  space = SUBGRP_PEER (subgrp)->max_packet_size - BGP_HEADER_SIZE - 4
+          - adv->baa->attr_len;
+  needed = BGP_NLRI_LENGTH
+           + bgp_packet_mpattr_prefix_size (SUBGRP_AFI (subgrp),
+                                            SUBGRP_SAFI (subgrp), &adv->rn->p);
+  return adv->baa->refcnt * needed >= (unsigned long) space;
+}
+
+/*
+ * Whether to hold back the UPDATE that would start at adv: while routes
+ * are still being processed its chain may grow, and interleaved churn
+ * would otherwise go out as many part-filled packets.  The hold lasts
+ * the instance's pack_window at most, see subgroup_pack_start, after
+ * which the queue is flushed.
+ */
+static int
+subgroup_pack_hold (struct update_subgroup *subgrp, struct bgp_advertise *adv)
+{
+  if (!SUBGRP_INST (subgrp)->pack_window
+      || CHECK_FLAG (subgrp->flags, SUBGRP_FLAG_PACK_FLUSH))
+    return 0;
+
+  if (!bm->process_main_queue
+      || !work_queue_is_scheduled (bm->process_main_queue))
+    return 0;
+
+  return !subgroup_pack_full (subgrp, adv);
+}
+
+/* Whether the UPDATE at the head of the queue is being held back.  */
+int
+subgroup_pack_held (struct update_subgroup *subgrp)
+{
+  struct bgp_advertise *adv;
+
+  adv = BGP_ADV_FIFO_HEAD (&subgrp->sync->update);
+  return adv && subgroup_pack_hold (subgrp, adv);
+}
+
+/* Open the window for held UPDATEs, unless already open.  */
+void
+subgroup_pack_start (struct update_subgroup *subgrp)
+{
+  struct bgp *bgp = SUBGRP_INST (subgrp);
+
+  if (subgrp->t_pack)
+    return;
+
+  THREAD_TIMER_MSEC_ON (bm->master, subgrp->t_pack, subgroup_pack_timer,
+                        subgrp, bgp->pack_window);
+  bgp->update_group_stats.update_pack_holds++;
+}
+
+/* The update queue has run dry: the next burst gets a new window.  */
+void
+subgroup_pack_reset (struct update_subgroup *subgrp)
+{
+  if (subgrp->t_pack)
+    THREAD_TIMER_OFF (subgrp->t_pack);
+  UNSET_FLAG (subgrp->flags, SUBGRP_FLAG_PACK_FLUSH);
+}
+
+static void
+subgroup_pack_stat (struct update_subgroup *subgrp, int num_pfx, size_t size)
+{
+  struct bgp *bgp = SUBGRP_INST (subgrp);
+  int bucket;
+
+  for (bucket = 0; bucket < BGP_UPDATE_PFX_HIST_MAX - 1; bucket++)
+    if (num_pfx >> (bucket + 1) == 0)
+      break;
+
+  bgp->update_group_stats.update_packets++;
+  bgp->update_group_stats.update_prefixes += num_pfx;
+  bgp->update_group_stats.update_bytes += size;
+  bgp->update_group_stats.update_pfx_hist[bucket]++;
+}
+
 /*
  * Return if there are packets to build for this subgroup.
  */
@@ -620,7 +722,7 @@ subgroup_packets_to_build (struct update_subgroup *subgrp)
     return 1;
 
   adv = BGP_ADV_FIFO_HEAD (&subgrp->sync->update);
-  if (adv)
+  if (adv && !subgroup_pack_hold (subgrp, adv))
     return 1;
 
   return 0;
@@ -685,6 +787,17 @@ subgroup_update_packet (struct update_subgroup *subgrp)
   addpath_encode = bgp_addpath_encode_tx (peer, afi, safi);
 
   adv = BGP_ADV_FIFO_HEAD (&subgrp->sync->update);
+  if (!adv)
+    {
+      subgroup_pack_reset (subgrp);
+      return NULL;
+    }
+  if (subgroup_pack_hold (subgrp, adv))
+    {
+      subgroup_pack_start (subgrp);
+      return NULL;
+    }
+
   while (adv)
     {
       assert (adv->rn);
@@ -733,6 +846,7 @@ subgroup_update_packet (struct update_subgroup *subgrp)
 						 adv->baa->attr, &vecarr,
 						 NULL, afi, safi,
 						 from, NULL, NULL, 0, 0);
+	  adv->baa->attr_len = total_attr_len;
 
           space_remaining = STREAM_CONCAT_REMAIN (s, snlri, STREAM_SIZE(s)) -
                             BGP_MAX_PACKET_SIZE_OVERFLOW;
@@ -835,6 +949,7 @@ subgroup_update_packet (struct update_subgroup *subgrp)
         zlog_debug ("u%" PRIu64 ":s%" PRIu64 " UPDATE len %zd numpfx %d",
                 subgrp->update_group->id, subgrp->id,
                 (stream_get_endp(packet) - stream_get_getp(packet)), num_pfx);
+      subgroup_pack_stat (subgrp, num_pfx, stream_get_endp (packet));
       pkt = bpacket_queue_add (SUBGRP_PKTQ (subgrp), packet, &vecarr);
       stream_reset (s);
       stream_reset (snlri);
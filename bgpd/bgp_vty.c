@@ -1501,6 +1501,50 @@ DEFUN (no_bgp_coalesce_time,
   return bgp_coalesce_config_vty(vty, argv[0], 0);
 }
 
+int
+bgp_config_write_pack_window (struct vty *vty, struct bgp *bgp)
+{
+  if (bgp->pack_window != BGP_DEFAULT_UPDATE_PACK_WINDOW)
+    vty_out (vty, " update-pack-window %u%s",
+             bgp->pack_window, VTY_NEWLINE);
+
+  return 0;
+}
+
+DEFUN (bgp_update_pack_window,
+       bgp_update_pack_window_cmd,
+       "update-pack-window <0-1000>",
+       "Hold back part-filled UPDATEs while routes are processed\n"
+       "Longest hold (in ms), 0 to send at once\n")
+{
+  struct bgp *bgp;
+
+  bgp = vty->index;
+  VTY_GET_INTEGER_RANGE ("update-pack-window", bgp->pack_window, argv[0],
+                         0, 1000);
+  return CMD_SUCCESS;
+}
+
+DEFUN (no_bgp_update_pack_window,
+       no_bgp_update_pack_window_cmd,
+       "no update-pack-window",
+       NO_STR
+       "Hold back part-filled UPDATEs while routes are processed\n")
+{
+  struct bgp *bgp;
+
+  bgp = vty->index;
+  bgp->pack_window = BGP_DEFAULT_UPDATE_PACK_WINDOW;
+  return CMD_SUCCESS;
+}
+
+ALIAS (no_bgp_update_pack_window,
+       no_bgp_update_pack_window_val_cmd,
+       "no update-pack-window <0-1000>",
+       NO_STR
+       "Hold back part-filled UPDATEs while routes are processed\n"
+       "Longest hold (in ms), 0 to send at once\n")
+
 /* Maximum-paths configuration */
 DEFUN (bgp_maxpaths,
        bgp_maxpaths_cmd,
@@ -3594,7 +3638,7 @@ DEFUN (no_neighbor_set_peer_group,
 
 static int
 peer_flag_modify_vty (struct vty *vty, const char *ip_str, 
-                      u_int16_t flag, int set)
+                      u_int32_t flag, int set)
 {
   int ret;
   struct peer *peer;
@@ -3622,13 +3666,13 @@ peer_flag_modify_vty (struct vty *vty, const char *ip_str,
 }
 
 static int
-peer_flag_set_vty (struct vty *vty, const char *ip_str, u_int16_t flag)
+peer_flag_set_vty (struct vty *vty, const char *ip_str, u_int32_t flag)
 {
   return peer_flag_modify_vty (vty, ip_str, flag, 1);
 }
 
 static int
-peer_flag_unset_vty (struct vty *vty, const char *ip_str, u_int16_t flag)
+peer_flag_unset_vty (struct vty *vty, const char *ip_str, u_int32_t flag)
 {
   return peer_flag_modify_vty (vty, ip_str, flag, 0);
 }
@@ -3747,6 +3791,30 @@ DEFUN (no_neighbor_capability_enhe,
   return peer_flag_unset_vty (vty, argv[0], PEER_FLAG_CAPABILITY_ENHE);
 }
 
+/* neighbor capability extended-message, on by default */
+DEFUN (neighbor_capability_ext_message,
+       neighbor_capability_ext_message_cmd,
+       NEIGHBOR_CMD2 "capability extended-message",
+       NEIGHBOR_STR
+       NEIGHBOR_ADDR_STR2
+       "Advertise capability to the peer\n"
+       "Advertise extended message capability to the peer\n")
+{
+  return peer_flag_unset_vty (vty, argv[0], PEER_FLAG_DISABLE_EXT_MESSAGE);
+}
+
+DEFUN (no_neighbor_capability_ext_message,
+       no_neighbor_capability_ext_message_cmd,
+       NO_NEIGHBOR_CMD2 "capability extended-message",
+       NO_STR
+       NEIGHBOR_STR
+       NEIGHBOR_ADDR_STR2
+       "Advertise capability to the peer\n"
+       "Advertise extended message capability to the peer\n")
+{
+  return peer_flag_set_vty (vty, argv[0], PEER_FLAG_DISABLE_EXT_MESSAGE);
+}
+
 static int
 peer_af_flag_modify_vty (struct vty *vty, const char *peer_str, afi_t afi,
 			 safi_t safi, u_int32_t flag, int set)
@@ -10639,6 +10707,7 @@ DEFUN (show_bgp_memory,
 {
   char memstrbuf[MTYPE_MEMSTR_LEN];
   unsigned long count;
+  unsigned long paths, pathbytes;
   
   /* RIB related usage stats */
   count = mtype_stats_alloc (MTYPE_BGP_NODE);
@@ -10647,7 +10716,8 @@ DEFUN (show_bgp_memory,
                          count * sizeof (struct bgp_node)),
            VTY_NEWLINE);
   
-  count = mtype_stats_alloc (MTYPE_BGP_ROUTE);
+  paths = count = mtype_stats_alloc (MTYPE_BGP_ROUTE);
+  pathbytes = count * sizeof (struct bgp_info);
   vty_out (vty, "%ld BGP routes, using %s of memory%s", count,
            mtype_memstr (memstrbuf, sizeof (memstrbuf),
                          count * sizeof (struct bgp_info)),
@@ -10657,6 +10727,18 @@ DEFUN (show_bgp_memory,
              mtype_memstr (memstrbuf, sizeof (memstrbuf),
                            count * sizeof (struct bgp_info_extra)),
              VTY_NEWLINE);
+  pathbytes += count * sizeof (struct bgp_info_extra);
+  if ((count = mtype_stats_alloc (MTYPE_BGP_MPATH_INFO)))
+    vty_out (vty, "%ld BGP multipath entries, using %s of memory%s", count,
+             mtype_memstr (memstrbuf, sizeof (memstrbuf),
+                           count * sizeof (struct bgp_info_mpath)),
+             VTY_NEWLINE);
+  pathbytes += count * sizeof (struct bgp_info_mpath);
+  if (paths)
+    vty_out (vty, "Average of %lu bytes per BGP route including "
+             "ancillaries and multipath, %lu base%s",
+             pathbytes / paths, (unsigned long) sizeof (struct bgp_info),
+             VTY_NEWLINE);
   
   if ((count = mtype_stats_alloc (MTYPE_BGP_STATIC)))
     vty_out (vty, "%ld Static routes, using %s of memory%s", count,
@@ -10671,11 +10753,15 @@ DEFUN (show_bgp_memory,
              VTY_NEWLINE);
   
   /* Adj-In/Out */
-  if ((count = mtype_stats_alloc (MTYPE_BGP_ADJ_IN)))
-    vty_out (vty, "%ld Adj-In entries, using %s of memory%s", count,
+  if ((count = bgp_adj_in_count ()))
+    vty_out (vty, "%ld Adj-In entries, using %s of memory in %ld chunks%s",
+             count,
              mtype_memstr (memstrbuf, sizeof (memstrbuf),
-                           count * sizeof (struct bgp_adj_in)),
-             VTY_NEWLINE);
+                           mtype_stats_alloc (MTYPE_BGP_ADJ_IN)
+                           * sizeof (struct bgp_adj_in_chunk)
+                           + mtype_stats_alloc (MTYPE_BGP_ADJ_IN_POOL)
+                           * sizeof (struct bgp_adj_in_pool)),
+             mtype_stats_alloc (MTYPE_BGP_ADJ_IN), VTY_NEWLINE);
   if ((count = mtype_stats_alloc (MTYPE_BGP_ADJ_OUT)))
     vty_out (vty, "%ld Adj-Out entries, using %s of memory%s", count,
              mtype_memstr (memstrbuf, sizeof (memstrbuf),
@@ -10708,6 +10794,14 @@ DEFUN (show_bgp_memory,
   
   if ((count = attr_unknown_count()))
     vty_out (vty, "%ld unknown attributes%s", count, VTY_NEWLINE);
+
+  {
+    unsigned long hits, misses;
+
+    if ((count = bgp_route_map_cache_count (&hits, &misses)))
+      vty_out (vty, "%ld route-map results cached, %lu hits, %lu misses%s",
+               count, hits, misses, VTY_NEWLINE);
+  }
   
   /* AS_PATH attributes */
   count = aspath_count ();
@@ -10721,6 +10815,8 @@ DEFUN (show_bgp_memory,
            mtype_memstr (memstrbuf, sizeof (memstrbuf),
                          count * sizeof (struct assegment)),
            VTY_NEWLINE);
+  if ((count = mtype_stats_alloc (MTYPE_AS_STR)))
+    vty_out (vty, "%ld BGP AS-PATH strings rendered%s", count, VTY_NEWLINE);
   
   /* Other attributes */
   if ((count = community_count ()))
@@ -12496,6 +12592,18 @@ bgp_show_peer (struct vty *vty, struct peer *p, u_char use_json, json_object *js
 		    json_object_string_add(json_cap, "4byteAs", "received");
 	        }
 
+	      /* Extended message */
+	      if (CHECK_FLAG (p->cap, PEER_CAP_EXT_MESSAGE_RCV)
+	          || CHECK_FLAG (p->cap, PEER_CAP_EXT_MESSAGE_ADV))
+	        {
+	          if (CHECK_FLAG (p->cap, PEER_CAP_EXT_MESSAGE_ADV) && CHECK_FLAG (p->cap, PEER_CAP_EXT_MESSAGE_RCV))
+		    json_object_string_add(json_cap, "extendedMessage", "advertisedAndReceived");
+	          else if (CHECK_FLAG (p->cap, PEER_CAP_EXT_MESSAGE_ADV))
+		    json_object_string_add(json_cap, "extendedMessage", "advertised");
+	          else if (CHECK_FLAG (p->cap, PEER_CAP_EXT_MESSAGE_RCV))
+		    json_object_string_add(json_cap, "extendedMessage", "received");
+	        }
+
 	      /* AddPath */
 	      if (CHECK_FLAG (p->cap, PEER_CAP_ADDPATH_RCV)
 	          || CHECK_FLAG (p->cap, PEER_CAP_ADDPATH_ADV))
@@ -12701,6 +12809,19 @@ bgp_show_peer (struct vty *vty, struct peer *p, u_char use_json, json_object *js
 	          vty_out (vty, "%s", VTY_NEWLINE);
 	        }
 
+	      /* Extended message */
+	      if (CHECK_FLAG (p->cap, PEER_CAP_EXT_MESSAGE_RCV)
+	          || CHECK_FLAG (p->cap, PEER_CAP_EXT_MESSAGE_ADV))
+	        {
+	          vty_out (vty, "    Extended Message:");
+	          if (CHECK_FLAG (p->cap, PEER_CAP_EXT_MESSAGE_ADV))
+		    vty_out (vty, " advertised");
+	          if (CHECK_FLAG (p->cap, PEER_CAP_EXT_MESSAGE_RCV))
+		    vty_out (vty, " %sreceived",
+			     CHECK_FLAG (p->cap, PEER_CAP_EXT_MESSAGE_ADV) ? "and " : "");
+	          vty_out (vty, "%s", VTY_NEWLINE);
+	        }
+
 	      /* AddPath */
 	      if (CHECK_FLAG (p->cap, PEER_CAP_ADDPATH_RCV)
 	          || CHECK_FLAG (p->cap, PEER_CAP_ADDPATH_ADV))
@@ -12979,6 +13100,14 @@ bgp_show_peer (struct vty *vty, struct peer *p, u_char use_json, json_object *js
       json_object_int_add(json_stat, "totalSent", p->open_out + p->notify_out + p->update_out + p->keepalive_out + p->refresh_out + p->dynamic_cap_out);
       json_object_int_add(json_stat, "totalRecv", p->open_in + p->notify_in + p->update_in + p->keepalive_in + p->refresh_in + p->dynamic_cap_in);
       json_object_object_add(json_neigh, "messageStats", json_stat);
+
+      if (p->attr_cache)
+        {
+          json_object *json_cache = json_object_new_object();
+          json_object_int_add(json_cache, "hits", p->attr_cache->hits);
+          json_object_int_add(json_cache, "misses", p->attr_cache->misses);
+          json_object_object_add(json_neigh, "attributeCache", json_cache);
+        }
     }
   else
     {
@@ -12997,6 +13126,16 @@ bgp_show_peer (struct vty *vty, struct peer *p, u_char use_json, json_object *js
                p->update_out + p->keepalive_out + p->refresh_out + p->dynamic_cap_out,
                p->open_in + p->notify_in + p->update_in + p->keepalive_in + p->refresh_in +
                p->dynamic_cap_in, VTY_NEWLINE);
+
+      if (p->attr_cache)
+        {
+          unsigned long lookups = p->attr_cache->hits + p->attr_cache->misses;
+
+          vty_out (vty, "  Attribute cache: %lu hits, %lu misses (%lu%% hit rate)%s",
+                   p->attr_cache->hits, p->attr_cache->misses,
+                   lookups ? p->attr_cache->hits * 100 / lookups : 0,
+                   VTY_NEWLINE);
+        }
     }
 
   if (use_json)
@@ -14486,6 +14625,7 @@ DEFUN (show_bgp_evpn_vni,
 
   vty_out (vty, "Advertise VNI flag: %s%s",
            bgp->advertise_vni? "Enabled" : "Disabled", VTY_NEWLINE);
+  bgp_evpn_show_zebra_stats (vty);
 
   bgp_evpn_show_all_vnis (vty, bgp);
   return CMD_SUCCESS;
@@ -15324,6 +15464,9 @@ bgp_vty_init (void)
 
   install_element (BGP_NODE, &bgp_coalesce_time_cmd);
   install_element (BGP_NODE, &no_bgp_coalesce_time_cmd);
+  install_element (BGP_NODE, &bgp_update_pack_window_cmd);
+  install_element (BGP_NODE, &no_bgp_update_pack_window_cmd);
+  install_element (BGP_NODE, &no_bgp_update_pack_window_val_cmd);
 
   /* "maximum-paths" commands. */
   install_element (BGP_NODE, &bgp_maxpaths_cmd);
@@ -16009,6 +16152,10 @@ bgp_vty_init (void)
   install_element (BGP_NODE, &neighbor_capability_enhe_cmd);
   install_element (BGP_NODE, &no_neighbor_capability_enhe_cmd);
 
+  /* "neighbor capability extended-message" commands.*/
+  install_element (BGP_NODE, &neighbor_capability_ext_message_cmd);
+  install_element (BGP_NODE, &no_neighbor_capability_ext_message_cmd);
+
   /* "neighbor capability orf prefix-list" commands.*/
   install_element (BGP_NODE, &neighbor_capability_orf_prefix_cmd);
   install_element (BGP_NODE, &no_neighbor_capability_orf_prefix_cmd);
@@ -16759,6 +16906,8 @@ bgp_vty_init (void)
   install_element (VIEW_NODE, &show_bgp_updgrps_adj_s_cmd);
   install_element (VIEW_NODE, &show_bgp_instance_updgrps_adj_s_cmd);
   install_element (VIEW_NODE, &show_bgp_updgrps_afi_adj_s_cmd);
+  install_element (VIEW_NODE, &show_bgp_updgrps_stats_cmd);
+  install_element (VIEW_NODE, &show_bgp_instance_updgrps_stats_cmd);
   install_element (VIEW_NODE, &show_ip_bgp_instance_summary_cmd);
   install_element (VIEW_NODE, &show_ip_bgp_instance_all_summary_cmd);
   install_element (VIEW_NODE, &show_ip_bgp_ipv4_summary_cmd);
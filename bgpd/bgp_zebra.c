@@ -203,6 +203,9 @@ bgp_zebra_advertise_vni (struct bgp *bgp, int advertise_vni)
   if (!IS_BGP_INST_KNOWN_TO_ZEBRA(bgp))
     return 0;
 
+  /* Remote MACs and VTEPs queued before must reach zebra first. */
+  bgp_evpn_zebra_flush ();
+
   s = zclient->obuf;
   stream_reset (s);
 
@@ -2204,23 +2207,31 @@ bgp_zebra_process_local_macip (int command, struct zclient *zclient,
   struct bgp *bgp;
   struct ethaddr mac;
   char buf[MACADDR_STRLEN];
+  int ret = 0;
 
-  s = zclient->ibuf;
-  vni = stream_getl (s);
-  stream_get (&mac.octet, s, ETHER_ADDR_LEN);
   bgp = bgp_lookup_by_vrf_id (vrf_id);
   if (!bgp)
     return 0;
 
-  if (BGP_DEBUG (zebra, ZEBRA))
-    zlog_debug ("%u:Recv %s MAC %s VNI %u",
-                vrf_id, (command == ZEBRA_MACIP_ADD) ? "Add" : "Del",
-                mac2str (&mac, buf, sizeof (buf)), vni);
+  /* Zebra sends MACs in batches: VNI, MAC and IP address length. */
+  s = zclient->ibuf;
+  while (STREAM_READABLE (s) >= 4 + ETHER_ADDR_LEN + 4)
+    {
+      vni = stream_getl (s);
+      stream_get (&mac.octet, s, ETHER_ADDR_LEN);
+      stream_getl (s); /* IP address length, unused */
 
-  if (command == ZEBRA_MACIP_ADD)
-    return bgp_evpn_local_macip_add (bgp, vni, &mac);
-  else
-    return bgp_evpn_local_macip_del (bgp, vni, &mac);
+      if (BGP_DEBUG (zebra, ZEBRA))
+        zlog_debug ("%u:Recv %s MAC %s VNI %u",
+                    vrf_id, (command == ZEBRA_MACIP_ADD) ? "Add" : "Del",
+                    mac2str (&mac, buf, sizeof (buf)), vni);
+
+      if (command == ZEBRA_MACIP_ADD)
+        ret |= bgp_evpn_local_macip_add (bgp, vni, &mac);
+      else
+        ret |= bgp_evpn_local_macip_del (bgp, vni, &mac);
+    }
+  return ret;
 }
 
 void
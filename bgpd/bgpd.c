@@ -1078,6 +1078,8 @@ peer_free (struct peer *peer)
       XFREE (MTYPE_PEER_DESC, peer->desc);
       peer->desc = NULL;
     }
+
+  bgp_attr_cache_free (peer);
   
   /* Free allocated host character. */
   if (peer->host)
@@ -1109,12 +1111,6 @@ peer_free (struct peer *peer)
     XFREE(MTYPE_TMP, peer->notify.data);
   memset (&peer->notify, 0, sizeof (struct bgp_notify));
 
-  if (peer->clear_node_queue)
-    {
-      work_queue_free(peer->clear_node_queue);
-      peer->clear_node_queue = NULL;
-    }
-
   bgp_sync_delete (peer);
 
   if (peer->conf_if)
@@ -1213,6 +1209,7 @@ peer_new (struct bgp *bgp)
   SET_FLAG (peer->sflags, PEER_STATUS_CAPABILITY_OPEN);
 
   /* Create buffers.  */
+  peer->max_packet_size = BGP_MAX_PACKET_SIZE;
   peer->ibuf = stream_new (BGP_MAX_PACKET_SIZE);
   peer->obuf = stream_fifo_new ();
 
@@ -2944,6 +2941,9 @@ bgp_create (as_t *as, const char *name, enum bgp_instance_type inst_type)
 	bgp->route[afi][safi] = bgp_table_init (afi, safi);
 	bgp->aggregate[afi][safi] = bgp_table_init (afi, safi);
 	bgp->rib[afi][safi] = bgp_table_init (afi, safi);
+	bgp->process_queue[afi][safi].bgp = bgp;
+	bgp->process_queue[afi][safi].afi = afi;
+	bgp->process_queue[afi][safi].safi = safi;
 
         /* Enable maximum-paths  - based on (AFI,SAFI) */
         maxpaths = (afi == AFI_L2VPN && safi == SAFI_EVPN) ?
@@ -2988,6 +2988,7 @@ bgp_create (as_t *as, const char *name, enum bgp_instance_type inst_type)
 
   bgp->wpkt_quanta = BGP_WRITE_PACKET_MAX;
   bgp->coalesce_time = BGP_DEFAULT_SUBGROUP_COALESCE_TIME;
+  bgp->pack_window = BGP_DEFAULT_UPDATE_PACK_WINDOW;
 
   update_bgp_group_init(bgp);
   bgp_evpn_init(bgp);
@@ -3203,6 +3204,7 @@ bgp_delete (struct bgp *bgp)
   struct peer_group *group;
   struct listnode *node, *next;
   afi_t afi;
+  safi_t safi;
   int i;
 
   THREAD_OFF (bgp->t_startup);
@@ -3224,6 +3226,11 @@ bgp_delete (struct bgp *bgp)
       bgp_unlock(bgp);  /* TODO - This timer is started with a lock - why? */
     }
 
+  /* Stop dampening, releasing its history routes. */
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
+      bgp_damp_disable (bgp, afi, safi);
+
   /* Inform peers we're going down. */
   for (ALL_LIST_ELEMENTS (bgp->peer, node, next, peer))
     {
@@ -3747,6 +3754,7 @@ static const struct peer_flag_action peer_flag_action_list[] =
     { PEER_FLAG_DYNAMIC_CAPABILITY,       0, peer_change_reset },
     { PEER_FLAG_DISABLE_CONNECTED_CHECK,  0, peer_change_reset },
     { PEER_FLAG_CAPABILITY_ENHE,          0, peer_change_reset },
+    { PEER_FLAG_DISABLE_EXT_MESSAGE,      0, peer_change_reset },
     { 0, 0, 0 }
   };
 
@@ -4623,8 +4631,10 @@ peer_on_policy_change (struct peer *peer, afi_t afi, safi_t safi, int outbound)
 {
   if (outbound)
     {
-      update_group_adjust_peer (peer_af_find (peer, afi, safi));
-      if (peer->status == Established)
+      /* A peer moved into an update group that already advertises the
+         new policy is synced from it, and needs no walk of the table. */
+      if (!update_group_adjust_peer (peer_af_find (peer, afi, safi))
+          && peer->status == Established)
         bgp_announce_route(peer, afi, safi);
     }
   else
@@ -6831,6 +6841,17 @@ bgp_config_write_peer_global (struct vty *vty, struct bgp *bgp,
         }
     }
 
+  /* capability extended-message, advertised unless turned off */
+  if (CHECK_FLAG (peer->flags, PEER_FLAG_DISABLE_EXT_MESSAGE))
+    {
+      if (! peer_group_active (peer) ||
+          ! CHECK_FLAG (g_peer->flags, PEER_FLAG_DISABLE_EXT_MESSAGE))
+        {
+          vty_out (vty, " no neighbor %s capability extended-message%s", addr,
+                   VTY_NEWLINE);
+        }
+    }
+
   /* dont-capability-negotiation */
   if (CHECK_FLAG (peer->flags, PEER_FLAG_DONT_CAPABILITY))
     {
@@ -7295,6 +7316,14 @@ bgp_config_write_family (struct vty *vty, struct bgp *bgp, afi_t afi,
   bgp_config_write_maxpaths (vty, bgp, afi, safi, &write);
   bgp_config_write_table_map (vty, bgp, afi, safi, &write);
 
+  /* IPv4 unicast dampening is written with the router's own config. */
+  if (CHECK_FLAG (bgp->af_flags[afi][safi], BGP_CONFIG_DAMPENING)
+      && ! (afi == AFI_IP && safi == SAFI_UNICAST))
+    {
+      bgp_config_write_family_header (vty, afi, safi, &write);
+      bgp_config_write_damp (vty, bgp, afi, safi);
+    }
+
   if (safi == SAFI_EVPN)
     bgp_config_write_evpn_info (vty, bgp, afi, safi, &write);
 
@@ -7452,6 +7481,9 @@ bgp_config_write (struct vty *vty)
       /* coalesce time */
       bgp_config_write_coalesce_time(vty, bgp);
 
+      /* update pack window */
+      bgp_config_write_pack_window (vty, bgp);
+
       /* BGP graceful-restart. */
       if (bgp->stalepath_time != BGP_DEFAULT_STALEPATH_TIME)
 	vty_out (vty, " bgp graceful-restart stalepath-time %d%s",
@@ -7504,7 +7536,7 @@ bgp_config_write (struct vty *vty)
       /* BGP flag dampening. */
       if (CHECK_FLAG (bgp->af_flags[AFI_IP][SAFI_UNICAST],
 	  BGP_CONFIG_DAMPENING))
-	bgp_config_write_damp (vty);
+	bgp_config_write_damp (vty, bgp, AFI_IP, SAFI_UNICAST);
 
       /* BGP timers configuration. */
       if (bgp->default_keepalive != BGP_DEFAULT_KEEPALIVE
@@ -7713,6 +7745,12 @@ bgp_terminate (void)
       bm->process_main_queue = NULL;
     }
 
+  if (bm->clear_node_queue)
+    {
+      work_queue_free (bm->clear_node_queue);
+      bm->clear_node_queue = NULL;
+    }
+
   if (bm->t_rmap_update)
     BGP_TIMER_OFF(bm->t_rmap_update);
 }
@@ -38,6 +38,7 @@ Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
 
 struct update_subgroup;
 struct bpacket;
+struct bgp_info;
 
 /*
  * Allow the neighbor XXXX remote-as to take internal or external
@@ -94,6 +95,7 @@ struct bgp_master
 
   /* work queues */
   struct work_queue *process_main_queue;
+  struct work_queue *clear_node_queue;
   
   /* Listening sockets */
   struct list *listen_sockets;
@@ -157,6 +159,35 @@ enum bgp_instance_type
   BGP_INSTANCE_TYPE_VIEW
 };
 
+/*
+ * Nodes of one afi/safi of an instance that are scheduled for best-path
+ * processing.  The nodes are linked through bgp_node->process_next, so
+ * scheduling a node allocates nothing; the queue itself is put on
+ * bm->process_main_queue while it is non-empty and drained in batches
+ * by bgp_process_main.
+ */
+struct bgp_process_queue
+{
+  struct bgp *bgp;
+  afi_t afi;
+  safi_t safi;
+
+  struct bgp_node *head;
+  struct bgp_node *tail;
+  unsigned long count;
+
+  /* Running totals of nodes queued and processed, see bgp_add_eoiu_mark */
+  u_int64_t enqueued;
+  u_int64_t processed;
+
+  u_char flags;
+#define BGP_PROCESS_QUEUE_SCHEDULED     (1 << 0)
+#define BGP_PROCESS_QUEUE_EOIU          (1 << 1)
+};
+
+/* Buckets of the prefixes-per-UPDATE histogram: 1, 2-3, ..., 512+.  */
+#define BGP_UPDATE_PFX_HIST_MAX         10
+
 /* BGP instance structure.  */
 struct bgp 
 {
@@ -191,8 +222,13 @@ struct bgp
 
   struct hash *update_groups[BGP_AF_MAX];
 
+  /* Subgroups waiting for a walk of the RIB to refresh their routes.  */
+  struct list *announce_pending;
+  struct thread *t_announce_walk;
+
   /*
-   * Global statistics for update groups.
+   * Global statistics for update groups.  UPDATEs built are counted by
+   * prefixes in them, in power-of-two buckets.
    */
   struct {
     u_int32_t join_events;
@@ -203,6 +239,15 @@ struct bgp
     u_int32_t peer_refreshes_combined;
     u_int32_t adj_count;
     u_int32_t merge_checks_triggered;
+    u_int32_t announce_walks;
+    u_int32_t announce_walk_subgrps;
+    u_int32_t sync_events;
+    u_int32_t sync_routes;
+    u_int32_t update_packets;
+    u_int32_t update_prefixes;
+    uint64_t update_bytes;
+    u_int32_t update_pack_holds;
+    u_int32_t update_pfx_hist[BGP_UPDATE_PFX_HIST_MAX];
 
     u_int32_t updgrps_created;
     u_int32_t updgrps_deleted;
@@ -291,6 +336,9 @@ struct bgp
   u_int16_t af_flags[AFI_MAX][SAFI_MAX];
 #define BGP_CONFIG_DAMPENING              (1 << 0)
 
+  /* Route flap dampening, set while BGP_CONFIG_DAMPENING. */
+  struct bgp_damp_config *damp[AFI_MAX][SAFI_MAX];
+
   /* Route table for next-hop lookup cache. */
   struct bgp_table *nexthop_cache_table[AFI_MAX];
 
@@ -349,10 +397,14 @@ struct bgp
 
   u_int32_t wpkt_quanta;  /* per peer packet quanta to write */
   u_int32_t coalesce_time;
+  u_int32_t pack_window;  /* ms to hold part-filled UPDATEs, 0 for none */
 
   u_int32_t addpath_tx_id;
   int addpath_tx_used[AFI_MAX][SAFI_MAX];
 
+  /* Nodes waiting for best-path processing */
+  struct bgp_process_queue process_queue[AFI_MAX][SAFI_MAX];
+
   /* EVPN: vnihash for vni's */
   struct hash *vnihash;
   int advertise_vni; /* Redistribute VNIs into BGP? */
@@ -486,6 +538,10 @@ typedef enum
 #define BGP_MAX_PACKET_SIZE                   4096
 #define BGP_MAX_PACKET_SIZE_OVERFLOW          1024
 
+/* Largest message once both ends support extended messages (RFC 8654).
+   OPEN and KEEPALIVE stay within BGP_MAX_PACKET_SIZE.  */
+#define BGP_EXTENDED_MESSAGE_MAX_PACKET_SIZE  65535
+
 /*
  * Trigger delay for bgp_announce_route().
  */
@@ -518,6 +574,23 @@ struct peer_af
   int afid;
 };
 
+/* Per-peer path counts, by path state.  */
+enum bgp_pcounts
+{
+  PCOUNT_ADJ_IN = 0,
+  PCOUNT_DAMPED,
+  PCOUNT_REMOVED,
+  PCOUNT_HISTORY,
+  PCOUNT_STALE,
+  PCOUNT_VALID,
+  PCOUNT_BEST,
+  PCOUNT_MULTIPATH,
+  PCOUNT_ALL,
+  PCOUNT_COUNTED,
+  PCOUNT_PFCNT, /* the figure we display to users */
+  PCOUNT_MAX,
+};
+
 /* BGP neighbor structure. */
 struct peer
 {
@@ -581,8 +654,10 @@ struct peer
   unsigned char last_event;
   unsigned char last_major_event;
 
-  /* Peer index, used for dumping TABLE_DUMP_V2 format */
+  /* Peer index, used for dumping TABLE_DUMP_V2 format, valid for the
+     table dump of generation table_dump_gen */
   uint16_t table_dump_index;
+  u_int32_t table_dump_gen;
 
   /* Peer information */
   int fd;			/* File descriptor */
@@ -635,6 +710,8 @@ struct peer
 #define PEER_CAP_ENHE_RCV                   (1 << 14) /* Extended nexthop received */
 #define PEER_CAP_HOSTNAME_ADV               (1 << 15) /* hostname advertised */
 #define PEER_CAP_HOSTNAME_RCV               (1 << 16) /* hostname received */
+#define PEER_CAP_EXT_MESSAGE_ADV            (1 << 17) /* extended message advertised */
+#define PEER_CAP_EXT_MESSAGE_RCV            (1 << 18) /* extended message received */
 
   /* Capability flags (reset in bgp_stop) */
   u_int32_t af_cap[AFI_MAX][SAFI_MAX];
@@ -671,6 +748,7 @@ struct peer
 #define PEER_FLAG_DYNAMIC_NEIGHBOR          (1 << 12) /* dynamic neighbor */
 #define PEER_FLAG_CAPABILITY_ENHE           (1 << 13) /* Extended next-hop (rfc 5549)*/
 #define PEER_FLAG_IFPEER_V6ONLY             (1 << 14) /* if-based peer is v6 only */
+#define PEER_FLAG_DISABLE_EXT_MESSAGE       (1 << 16) /* no capability extended-message */
 #if ENABLE_BGP_VNC
 #define PEER_FLAG_IS_RFAPI_HD		    (1 << 15) /* attached to rfapi HD */
 #endif
@@ -768,8 +846,8 @@ struct peer
   struct thread *t_gr_restart;
   struct thread *t_gr_stale;
   
-  /* workqueues */
-  struct work_queue *clear_node_queue;
+  /* Paths queued on bm->clear_node_queue for clearing.  */
+  unsigned long clear_pending;
   
   /* Statistics field */
   u_int32_t open_in;		/* Open message input count */
@@ -804,12 +882,25 @@ struct peer
   /* Announcement attribute hash.  */
   struct hash *hash[AFI_MAX][SAFI_MAX];
 
+  /* Adj-RIB-In storage, allocated on first use.  */
+  struct bgp_adj_in_pool *adj_in_pool[AFI_MAX][SAFI_MAX];
+
+  /* Paths from this peer in the RIB, so that clearing need not walk
+     the whole table.  */
+  struct bgp_info *paths[AFI_MAX][SAFI_MAX];
+
+  /* Recently received attribute sections, allocated on first use.  */
+  struct bgp_attr_cache *attr_cache;
+
   /* Notify data. */
   struct bgp_notify notify;
 
   /* Whole packet size to be read. */
   unsigned long packet_size;
 
+  /* Largest message to send or accept, see BGP_MAX_PACKET_SIZE.  */
+  bgp_size_t max_packet_size;
+
   /* Filter structure. */
   struct bgp_filter filter[AFI_MAX][SAFI_MAX];
 
@@ -825,6 +916,11 @@ struct peer
   /* Prefix count. */
   unsigned long pcount[AFI_MAX][SAFI_MAX];
 
+  /* Paths in the RIB by state, kept as the paths change so that they
+     need not be counted by walking the table.  PCOUNT_ADJ_IN is not
+     kept here, the Adj-RIB-In pool has it.  */
+  unsigned long pcounts[AFI_MAX][SAFI_MAX][PCOUNT_MAX];
+
   /* Max prefix count. */
   unsigned long pmax[AFI_MAX][SAFI_MAX];
   u_char pmax_threshold[AFI_MAX][SAFI_MAX];
@@ -1216,6 +1312,11 @@ extern void bgp_master_init (void);
 
 extern void bgp_init (void);
 extern void bgp_route_map_init (void);
+extern route_map_result_t bgp_route_map_apply (struct route_map *,
+                                               struct prefix *,
+                                               struct bgp_info *);
+extern unsigned long bgp_route_map_cache_count (unsigned long *,
+                                                unsigned long *);
 extern void bgp_session_reset (struct peer *);
 
 extern int bgp_option_set (int);
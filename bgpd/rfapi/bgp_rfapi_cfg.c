@@ -60,6 +60,7 @@ DEFINE_MTYPE(RFAPI, RFAPI_RFP_GROUP_CFG,	  "RFAPI RFP Group Configuration")
 DEFINE_MTYPE(RFAPI, RFAPI,			  "RFAPI Generic")
 DEFINE_MTYPE(RFAPI, RFAPI_DESC,			  "RFAPI Descriptor")
 DEFINE_MTYPE(RFAPI, RFAPI_IMPORTTABLE,		  "RFAPI Import Table")
+DEFINE_MTYPE(RFAPI, RFAPI_IMPORT_RT,		  "RFAPI Import Table RT Index")
 DEFINE_MTYPE(RFAPI, RFAPI_MONITOR,		  "RFAPI Monitor VPN")
 DEFINE_MTYPE(RFAPI, RFAPI_MONITOR_ENCAP,	  "RFAPI Monitor Encap")
 DEFINE_MTYPE(RFAPI, RFAPI_NEXTHOP,		  "RFAPI Next Hop")
@@ -33,6 +33,7 @@
 #include "lib/memory.h"
 #include "lib/log.h"
 #include "lib/skiplist.h"
+#include "lib/linklist.h"
 #include "lib/thread.h"
 
 #include "bgpd/bgpd.h"
@@ -94,6 +95,15 @@ struct rfapi_withdraw
   int lockoffset;
 };
 
+/*
+ * Entry in the per-instance route target index of import tables
+ */
+struct rfapi_import_rt
+{
+  struct ecommunity_val rt;
+  struct list *imports;         /* of struct rfapi_import_table */
+};
+
 /* 
  * DEBUG FUNCTION
  * It's evil and fiendish. It's compiler-dependent.
@@ -1003,6 +1013,95 @@ rfapiImportTableFlush (struct rfapi_import_table *it)
     }
 }
 
+static int
+rfapiImportRtCmp (void *k1, void *k2)
+{
+  struct rfapi_import_rt *irt1 = k1;
+  struct rfapi_import_rt *irt2 = k2;
+
+  return memcmp (irt1->rt.val, irt2->rt.val, ECOMMUNITY_SIZE);
+}
+
+static void
+rfapiImportRtFree (void *val)
+{
+  struct rfapi_import_rt *irt = val;
+
+  list_delete (irt->imports);
+  XFREE (MTYPE_RFAPI_IMPORT_RT, irt);
+}
+
+static struct rfapi_import_rt *
+rfapiImportRtLookup (struct rfapi *h, const u_int8_t *rt)
+{
+  struct rfapi_import_rt key;
+  struct rfapi_import_rt *irt;
+
+  if (!h->import_rt)
+    return NULL;
+
+  memcpy (key.rt.val, rt, ECOMMUNITY_SIZE);
+  if (skiplist_search (h->import_rt, &key, (void **) &irt))
+    return NULL;
+  return irt;
+}
+
+/*
+ * Add an import table to the route target index, under each RT of
+ * its import list
+ */
+static void
+rfapiImportRtIndexAdd (struct rfapi *h, struct rfapi_import_table *it)
+{
+  struct rfapi_import_rt *irt;
+  int i;
+
+  if (!it->rt_import_list)
+    return;
+
+  if (!h->import_rt)
+    h->import_rt = skiplist_new (0, rfapiImportRtCmp, rfapiImportRtFree);
+
+  for (i = 0; i < it->rt_import_list->size; ++i)
+    {
+      u_int8_t *rt = it->rt_import_list->val + (i * ECOMMUNITY_SIZE);
+
+      irt = rfapiImportRtLookup (h, rt);
+      if (!irt)
+        {
+          irt = XCALLOC (MTYPE_RFAPI_IMPORT_RT,
+                         sizeof (struct rfapi_import_rt));
+          memcpy (irt->rt.val, rt, ECOMMUNITY_SIZE);
+          irt->imports = list_new ();
+          skiplist_insert (h->import_rt, irt, irt);
+        }
+      listnode_add (irt->imports, it);
+    }
+}
+
+static void
+rfapiImportRtIndexDel (struct rfapi *h, struct rfapi_import_table *it)
+{
+  struct rfapi_import_rt *irt;
+  int i;
+
+  if (!it->rt_import_list)
+    return;
+
+  for (i = 0; i < it->rt_import_list->size; ++i)
+    {
+      irt = rfapiImportRtLookup (h,
+                                 it->rt_import_list->val +
+                                 (i * ECOMMUNITY_SIZE));
+      if (!irt)
+        continue;
+
+      listnode_delete (irt->imports, it);
+      if (!listcount (irt->imports))
+        skiplist_delete (h->import_rt, irt, irt);
+    }
+}
+
 void
 rfapiImportTableRefDelByIt (
   struct bgp			*bgp,
@@ -1038,6 +1137,7 @@ rfapiImportTableRefDelByIt (
         {
           h->imports = it->next;
         }
+      rfapiImportRtIndexDel (h, it);
       rfapiImportTableFlush (it);
       XFREE (MTYPE_RFAPI_IMPORTTABLE, it);
     }
@@ -4058,8 +4158,12 @@ rfapiProcessUpdate (
   struct bgp			*bgp;
   struct rfapi			*h;
   struct rfapi_import_table	*it;
+  struct rfapi_import_rt	*irt;
+  struct ecommunity		*ecom;
+  struct listnode		*node, *nnode;
   int				has_ip_route = 1;
   uint32_t			lni = 0;
+  int				i;
 
   bgp = bgp_get_default ();     /* assume 1 instance for now */
   assert (bgp);
@@ -4129,24 +4233,42 @@ rfapiProcessUpdate (
     return;
 
   /*
-   * Iterate over all import tables; do a filtered import
-   * for the afi/safi combination
+   * Do a filtered import for the afi/safi combination into each
+   * import table that shares an RT with the route, looked up by
+   * RT. The other tables would not import it anyway. A table
+   * matching several of the route's RTs is visited only once.
    */
-  for (it = h->imports; it; it = it->next)
+  ecom = (attr && attr->extra) ? attr->extra->ecommunity : NULL;
+  if (ecom)
     {
-      (*rfapiBgpInfoFilteredImportFunction (safi)) (
-	it,
-	FIF_ACTION_UPDATE,
-	peer,
-	rfd,
-	p,        /* prefix */
-	NULL,
-	afi,
-	prd,
-	attr,
-	type,
-	sub_type,
-	label);
+      ++h->import_gen;
+      for (i = 0; i < ecom->size; ++i)
+        {
+          irt = rfapiImportRtLookup (h, ecom->val + (i * ECOMMUNITY_SIZE));
+          if (!irt)
+            continue;
+
+          for (ALL_LIST_ELEMENTS (irt->imports, node, nnode, it))
+            {
+              if (it->dispatch_gen == h->import_gen)
+                continue;
+              it->dispatch_gen = h->import_gen;
+
+              (*rfapiBgpInfoFilteredImportFunction (safi)) (
+		it,
+		FIF_ACTION_UPDATE,
+		peer,
+		rfd,
+		p,        /* prefix */
+		NULL,
+		afi,
+		prd,
+		attr,
+		type,
+		sub_type,
+		label);
+            }
+        }
     }
 
   if (safi == SAFI_MPLS_VPN || safi == BGP_SAFI_VPN)
@@ -4560,6 +4682,12 @@ bgp_rfapi_destroy (struct bgp *bgp, struct rfapi *h)
       h->resolve_nve_nexthop = NULL;
     }
 
+  if (h->import_rt)
+    {
+      skiplist_free (h->import_rt);
+      h->import_rt = NULL;
+    }
+
   route_table_finish (h->it_ce->imported_vpn[AFI_IP]);
   route_table_finish (h->it_ce->imported_vpn[AFI_IP6]);
   route_table_finish (h->it_ce->imported_encap[AFI_IP]);
@@ -4602,10 +4730,29 @@ rfapiImportTableRefAdd (struct bgp *bgp, struct ecommunity *rt_import_list)
   h = bgp->rfapi;
   assert (h);
 
-  for (it = h->imports; it; it = it->next)
+  /*
+   * An existing table with the same RT list is indexed under the
+   * list's first RT
+   */
+  it = NULL;
+  if (rt_import_list && rt_import_list->size)
     {
-      if (ecommunity_cmp (it->rt_import_list, rt_import_list))
-        break;
+      struct rfapi_import_rt *irt;
+      struct listnode *node;
+
+      irt = rfapiImportRtLookup (h, rt_import_list->val);
+      if (irt)
+        for (ALL_LIST_ELEMENTS_RO (irt->imports, node, it))
+          if (ecommunity_cmp (it->rt_import_list, rt_import_list))
+            break;
+    }
+  else
+    {
+      for (it = h->imports; it; it = it->next)
+        {
+          if (ecommunity_cmp (it->rt_import_list, rt_import_list))
+            break;
+        }
     }
 
   zlog_debug ("%s: matched it=%p", __func__, it);
@@ -4619,6 +4766,7 @@ rfapiImportTableRefAdd (struct bgp *bgp, struct ecommunity *rt_import_list)
       h->imports = it;
 
       it->rt_import_list = ecommunity_dup (rt_import_list);
+      rfapiImportRtIndexAdd (h, it);
       it->monitor_exterior_orphans =
         skiplist_new (0, NULL, (void (*)(void *)) prefix_free);
 
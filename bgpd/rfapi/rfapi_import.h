@@ -50,6 +50,7 @@ struct rfapi_import_table
   int remote_count[AFI_MAX];
   int holddown_count[AFI_MAX];
   int imported_count[AFI_MAX];
+  uint32_t dispatch_gen;        /* last update dispatched to this table */
 };
 
 #define RFAPI_LOCAL_BI(bi) \
@@ -189,6 +189,16 @@ struct rfapi
 {
   struct route_table		un[AFI_MAX];
   struct rfapi_import_table	*imports;	/* IPv4, IPv6 */
+
+  /*
+   * The same import tables, indexed by route target. The skiplist
+   * keys and values are pointers to struct rfapi_import_rt (see
+   * rfapi_import.c), each listing the import tables with that RT
+   * in their import list.
+   */
+  struct skiplist		*import_rt;
+  uint32_t			import_gen;	/* update being dispatched */
+
   struct list			descriptors;/* debug & resolve-nve imports */
 
   struct rfapi_global_stats	stat;
@@ -432,6 +442,7 @@ DECLARE_MTYPE(RFAPI_RFP_GROUP_CFG)
 DECLARE_MTYPE(RFAPI)
 DECLARE_MTYPE(RFAPI_DESC)
 DECLARE_MTYPE(RFAPI_IMPORTTABLE)
+DECLARE_MTYPE(RFAPI_IMPORT_RT)
 DECLARE_MTYPE(RFAPI_MONITOR)
 DECLARE_MTYPE(RFAPI_MONITOR_ENCAP)
 DECLARE_MTYPE(RFAPI_NEXTHOP)
@@ -2762,14 +2762,14 @@ cmd_execute_command (vector vline, struct vty *vty, struct cmd_element **cmd,
     return saved_ret;
 
   /* This assumes all nodes above CONFIG_NODE are childs of CONFIG_NODE */
-  while ( ret != CMD_SUCCESS && ret != CMD_WARNING 
+  while ( ret != CMD_SUCCESS && ret != CMD_WARNING && ret != CMD_SUSPEND
 	  && vty->node > CONFIG_NODE )
     {
       try_node = node_parent(try_node);
       vty->node = try_node;
       ret = cmd_execute_command_real (vline, FILTER_RELAXED, vty, cmd);
       tried = 1;
-      if (ret == CMD_SUCCESS || ret == CMD_WARNING)
+      if (ret == CMD_SUCCESS || ret == CMD_WARNING || ret == CMD_SUSPEND)
 	{
 	  /* succesfull command, leave the node as is */
 	  return ret;
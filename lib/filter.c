@@ -261,6 +261,9 @@ access_list_delete (struct access_list *access)
   else
     list->head = access->next;
 
+  /* Route-maps may hold on to the list itself, see func_resolve. */
+  route_map_notify_dependencies(access->name, RMAP_EVENT_FILTER_DELETED);
+
   if (access->name)
     XFREE (MTYPE_ACCESS_LIST_STR, access->name);
 
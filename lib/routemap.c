@@ -37,6 +37,7 @@ DEFINE_MTYPE(       LIB, ROUTE_MAP_RULE,     "Route map rule")
 DEFINE_MTYPE_STATIC(LIB, ROUTE_MAP_RULE_STR, "Route map rule str")
 DEFINE_MTYPE(       LIB, ROUTE_MAP_COMPILED, "Route map compiled")
 DEFINE_MTYPE_STATIC(LIB, ROUTE_MAP_DEP,      "Route map dependency")
+DEFINE_MTYPE_STATIC(LIB, ROUTE_MAP_PROGRAM,  "Route map program")
 
 DEFINE_QOBJ_TYPE(route_map_index)
 DEFINE_QOBJ_TYPE(route_map)
@@ -145,6 +146,11 @@ static void route_map_rule_delete (struct route_map_rule_list *,
 				   struct route_map_rule *);
 static int rmap_debug = 0;
 
+/* Bumped on every change that can alter the outcome of route_map_apply(),
+   including changes to the lists route-maps refer to.  Starts at 1 so a
+   zero cacheable_version in struct route_map means "not computed". */
+static unsigned long rmap_version = 1;
+
 static void
 route_map_index_delete (struct route_map_index *, int);
 
@@ -170,6 +176,7 @@ route_map_add (const char *name)
 
   map = route_map_new (name);
   list = &route_map_master;
+  rmap_version++;
 
   /* Add map to the hash */
   hash_get(route_map_master_hash, map, hash_alloc_intern);
@@ -215,6 +222,7 @@ route_map_free_map (struct route_map *map)
     route_map_index_delete (index, 0);
 
   list = &route_map_master;
+  rmap_version++;
 
   if (map != NULL)
     {
@@ -231,6 +239,8 @@ route_map_free_map (struct route_map *map)
 	list->head = map->next;
 
       hash_release(route_map_master_hash, map);
+      if (map->program)
+	XFREE (MTYPE_ROUTE_MAP_PROGRAM, map->program);
       XFREE (MTYPE_ROUTE_MAP_NAME, map->name);
       XFREE (MTYPE_ROUTE_MAP, map);
     }
@@ -312,6 +322,7 @@ route_map_mark_updated (const char *name, int del_later)
       map->to_be_processed = 1;
       ret = 0;
     }
+  rmap_version++;
 
   return(ret);
 }
@@ -498,6 +509,7 @@ route_map_index_delete (struct route_map_index *index, int notify)
   struct route_map_rule *rule;
 
   QOBJ_UNREG (index);
+  rmap_version++;
 
   /* Free route match. */
   while ((rule = index->match_list.head) != NULL)
@@ -559,6 +571,7 @@ route_map_index_add (struct route_map *map, enum route_map_type type,
   index->map = map;
   index->type = type;
   index->pref = pref;
+  rmap_version++;
   
   /* Compare preference. */
   for (point = map->head; point; point = point->next)
@@ -676,6 +689,7 @@ static void
 route_map_rule_add (struct route_map_rule_list *list,
 		    struct route_map_rule *rule)
 {
+  rmap_version++;
   rule->next = NULL;
   rule->prev = list->tail;
   if (list->tail)
@@ -690,6 +704,7 @@ static void
 route_map_rule_delete (struct route_map_rule_list *list,
 		       struct route_map_rule *rule)
 {
+  rmap_version++;
   if (rule->cmd->func_free)
     (*rule->cmd->func_free) (rule->value);
 
@@ -981,131 +996,271 @@ route_map_delete_set (struct route_map_index *index, const char *set_name,
    We need to make sure our route-map processing matches the above
 */
 
-static route_map_result_t
-route_map_apply_match (struct route_map_rule_list *match_list,
-                       struct prefix *prefix, route_map_object_t type,
-                       void *object)
+/* A route-map flattened for evaluation: one step per index, with its
+   match rules followed by its set rules laid out in ops[], and the
+   targets of call and on-match resolved.  Rules with a func_resolve get
+   to look up the lists they name at the same time.  The program is
+   rebuilt on first use after rmap_version has moved on. */
+struct route_map_op
 {
-  route_map_result_t ret = RMAP_NOMATCH;
-  struct route_map_rule *match;
+  route_map_result_t (*func_apply)(void *, struct prefix *,
+				   route_map_object_t, void *);
+  void *value;
+};
 
+struct route_map_step
+{
+  enum route_map_type type;
+  int op;			/* First match op, the set ops follow. */
+  int nmatch;
+  int nset;
 
-  /* Check all match rule and if there is no match rule, go to the
-     set statement. */
-  if (!match_list->head)
-    ret = RMAP_MATCH;
-  else
+  /* Map to call after the sets, if any. */
+  struct route_map *call;
+
+  /* Step to continue with after a permit match, -1 to finish there. */
+  int next;
+};
+
+struct route_map_program
+{
+  unsigned long version;
+  int nsteps;
+  struct route_map_step *steps;
+  struct route_map_op *ops;
+};
+
+static int
+route_map_compile_rules (struct route_map_rule_list *list,
+			 struct route_map_op *ops)
+{
+  struct route_map_rule *rule;
+  int n = 0;
+
+  for (rule = list->head; rule; rule = rule->next, n++)
     {
-      for (match = match_list->head; match; match = match->next)
-        {
-          /* Try each match statement in turn, If any do not return
-             RMAP_MATCH, return, otherwise continue on to next match 
-             statement. All match statements must match for end-result
-             to be a match. */
-          ret = (*match->cmd->func_apply) (match->value, prefix,
-                                           type, object);
-          if (ret != RMAP_MATCH)
-            return ret;
-        }
+      if (ops == NULL)
+	continue;
+      if (rule->cmd->func_resolve && rule->value)
+	(*rule->cmd->func_resolve) (rule->value);
+      ops[n].func_apply = rule->cmd->func_apply;
+      ops[n].value = rule->value;
     }
-  return ret;
+  return n;
 }
 
-/* Apply route map to the object. */
-route_map_result_t
-route_map_apply (struct route_map *map, struct prefix *prefix,
-                 route_map_object_t type, void *object)
+static struct route_map_program *
+route_map_compile (struct route_map *map)
 {
-  static int recursion = 0;
-  int ret = 0;
-  struct route_map_index *index;
-  struct route_map_rule *set;
+  struct route_map_program *prog;
+  struct route_map_index *index, *target;
+  struct route_map_step *step;
+  int nsteps = 0, nops = 0;
+  int i, j;
 
-  if (recursion > RMAP_RECURSION_LIMIT)
+  for (index = map->head; index; index = index->next)
+    {
+      nsteps++;
+      nops += route_map_compile_rules (&index->match_list, NULL);
+      nops += route_map_compile_rules (&index->set_list, NULL);
+    }
+
+  prog = XCALLOC (MTYPE_ROUTE_MAP_PROGRAM,
+		  sizeof (struct route_map_program)
+		  + nsteps * sizeof (struct route_map_step)
+		  + nops * sizeof (struct route_map_op));
+  prog->version = rmap_version;
+  prog->nsteps = nsteps;
+  prog->steps = (struct route_map_step *) (prog + 1);
+  prog->ops = (struct route_map_op *) (prog->steps + nsteps);
+
+  nops = 0;
+  for (i = 0, index = map->head; index; i++, index = index->next)
+    {
+      step = &prog->steps[i];
+      step->type = index->type;
+      step->op = nops;
+      step->nmatch = route_map_compile_rules (&index->match_list,
+					      &prog->ops[nops]);
+      nops += step->nmatch;
+      step->nset = route_map_compile_rules (&index->set_list,
+					    &prog->ops[nops]);
+      nops += step->nset;
+
+      if (index->nextrm)
+	step->call = route_map_lookup_by_name (index->nextrm);
+
+      switch (index->exitpolicy)
+	{
+	case RMAP_NEXT:
+	  /* Running off the end of the map denies. */
+	  step->next = i + 1;
+	  break;
+	case RMAP_GOTO:
+	  /* First later clause at or after the goto target, if any. */
+	  step->next = -1;
+	  for (j = i + 1, target = index->next; target;
+	       j++, target = target->next)
+	    if (target->pref >= index->nextpref)
+	      {
+		step->next = j;
+		break;
+	      }
+	  break;
+	case RMAP_EXIT:
+	default:
+	  step->next = -1;
+	  break;
+	}
+    }
+  return prog;
+}
+
+static struct route_map_program *
+route_map_program_get (struct route_map *map)
+{
+  if (map->program && map->program->version == rmap_version)
+    return map->program;
+
+  if (map->program)
+    XFREE (MTYPE_ROUTE_MAP_PROGRAM, map->program);
+  map->program = route_map_compile (map);
+  return map->program;
+}
+
+static route_map_result_t
+route_map_run (struct route_map *map, struct prefix *prefix,
+	       route_map_object_t type, void *object, int depth)
+{
+  struct route_map_program *prog;
+  struct route_map_step *step;
+  struct route_map_op *op, *end;
+  route_map_result_t ret;
+  int i;
+
+  if (depth > RMAP_RECURSION_LIMIT)
     {
       zlog (NULL, LOG_WARNING,
             "route-map recursion limit (%d) reached, discarding route",
             RMAP_RECURSION_LIMIT);
-      recursion = 0;
       return RMAP_DENYMATCH;
     }
 
   if (map == NULL)
     return RMAP_DENYMATCH;
 
-  for (index = map->head; index; index = index->next)
+  prog = route_map_program_get (map);
+
+  for (i = 0; i >= 0 && i < prog->nsteps; )
     {
-      /* Apply this index. */
-      ret = route_map_apply_match (&index->match_list, prefix, type, object);
-
-      /* Now we apply the matrix from above */
-      if (ret == RMAP_NOMATCH)
-        /* 'cont' from matrix - continue to next route-map sequence */
-        continue;
-      else if (ret == RMAP_MATCH)
-        {
-          if (index->type == RMAP_PERMIT)
-            /* 'action' */
-            {
-              /* permit+match must execute sets */
-              for (set = index->set_list.head; set; set = set->next)
-                ret = (*set->cmd->func_apply) (set->value, prefix,
-                                               type, object);
-
-              /* Call another route-map if available */
-              if (index->nextrm)
-                {
-                  struct route_map *nextrm =
-                                    route_map_lookup_by_name (index->nextrm);
-
-                  if (nextrm) /* Target route-map found, jump to it */
-                    {
-                      recursion++;
-                      ret = route_map_apply (nextrm, prefix, type, object);
-                      recursion--;
-                    }
-
-                  /* If nextrm returned 'deny', finish. */
-                  if (ret == RMAP_DENYMATCH)
-                    return ret;
-                }
-                
-              switch (index->exitpolicy)
-                {
-                  case RMAP_EXIT:
-                    return ret;
-                  case RMAP_NEXT:
-                    continue;
-                  case RMAP_GOTO:
-                    {
-                      /* Find the next clause to jump to */
-                      struct route_map_index *next = index->next;
-                      int nextpref = index->nextpref;
-
-                      while (next && next->pref < nextpref)
-                        {
-                          index = next;
-                          next = next->next;
-                        }
-                      if (next == NULL)
-                        {
-                          /* No clauses match! */
-                          return ret;
-                        }
-                    }
-                }
-            }
-          else if (index->type == RMAP_DENY)
-            /* 'deny' */
-            {
-                return RMAP_DENYMATCH;
-            }
-        }
+      step = &prog->steps[i];
+      op = &prog->ops[step->op];
+
+      /* All match statements must match, an empty list matches. */
+      ret = RMAP_MATCH;
+      for (end = op + step->nmatch; op < end; op++)
+	if ((ret = (*op->func_apply) (op->value, prefix, type, object))
+	    != RMAP_MATCH)
+	  break;
+
+      if (ret != RMAP_MATCH)
+	{
+	  /* 'cont' from matrix - continue to next route-map sequence */
+	  i++;
+	  continue;
+	}
+
+      if (step->type == RMAP_DENY)
+	return RMAP_DENYMATCH;
+
+      /* permit+match must execute sets */
+      for (end = op + step->nset; op < end; op++)
+	ret = (*op->func_apply) (op->value, prefix, type, object);
+
+      if (step->call)
+	{
+	  ret = route_map_run (step->call, prefix, type, object, depth + 1);
+
+	  /* If nextrm returned 'deny', finish. */
+	  if (ret == RMAP_DENYMATCH)
+	    return ret;
+	}
+
+      if (step->next < 0)
+	return ret;
+      i = step->next;
     }
+
   /* Finally route-map does not match at all. */
   return RMAP_DENYMATCH;
 }
 
+/* Apply route map to the object.  Holds no state of its own between
+   calls, so it may be re-entered, e.g. through 'call'. */
+route_map_result_t
+route_map_apply (struct route_map *map, struct prefix *prefix,
+                 route_map_object_t type, void *object)
+{
+  return route_map_run (map, prefix, type, object, 0);
+}
+
+/* Current route-map configuration version, see rmap_version. */
+unsigned long
+route_map_version (void)
+{
+  return rmap_version;
+}
+
+static int
+route_map_rule_list_cacheable (struct route_map_rule_list *list)
+{
+  struct route_map_rule *rule;
+
+  for (rule = list->head; rule; rule = rule->next)
+    if (! rule->cmd->func_cacheable
+        || ! (*rule->cmd->func_cacheable) (rule->value))
+      return 0;
+  return 1;
+}
+
+static int
+route_map_cacheable_depth (struct route_map *map, int depth)
+{
+  struct route_map_index *index;
+  struct route_map *nextrm;
+
+  if (depth > RMAP_RECURSION_LIMIT)
+    return 0;
+
+  for (index = map->head; index; index = index->next)
+    {
+      if (! route_map_rule_list_cacheable (&index->match_list)
+          || ! route_map_rule_list_cacheable (&index->set_list))
+        return 0;
+
+      if (index->nextrm
+          && (nextrm = route_map_lookup_by_name (index->nextrm)) != NULL
+          && ! route_map_cacheable_depth (nextrm, depth + 1))
+        return 0;
+    }
+  return 1;
+}
+
+/* Return 1 if every rule of the map, and of the maps it calls, says its
+   outcome depends only on the object given to route_map_apply() and not
+   on the prefix, so the daemon may cache results per object until
+   route_map_version() changes. */
+int
+route_map_cacheable (struct route_map *map)
+{
+  if (map->cacheable_version != rmap_version)
+    {
+      map->cacheable = route_map_cacheable_depth (map, 0);
+      map->cacheable_version = rmap_version;
+    }
+  return map->cacheable;
+}
+
 void
 route_map_add_hook (void (*func) (const char *))
 {
@@ -1351,6 +1506,7 @@ route_map_upd8_dependency (route_map_event_t type, const char *arg,
 {
   struct hash *upd8_hash = NULL;
 
+  rmap_version++;
   if ((upd8_hash = route_map_get_dep_hash(type)))
     route_map_dep_update (upd8_hash, arg, rmap_name, type);
 }
@@ -1365,6 +1521,7 @@ route_map_notify_dependencies (const char *affected_name, route_map_event_t even
   if (!affected_name)
     return;
 
+  rmap_version++;
   name = XSTRDUP(MTYPE_ROUTE_MAP_NAME, affected_name);
 
   if ((upd8_hash = route_map_get_dep_hash(event)) == NULL)
@@ -1544,6 +1701,7 @@ DEFUN (rmap_onmatch_next,
 	  return CMD_WARNING;
         }
       index->exitpolicy = RMAP_NEXT;
+      rmap_version++;
     }
   return CMD_SUCCESS;
 }
@@ -1558,7 +1716,10 @@ DEFUN (no_rmap_onmatch_next,
   struct route_map_index *index = VTY_GET_CONTEXT (route_map_index);
 
   if (index)
-    index->exitpolicy = RMAP_EXIT;
+    {
+      index->exitpolicy = RMAP_EXIT;
+      rmap_version++;
+    }
 
   return CMD_SUCCESS;
 }
@@ -1599,6 +1760,7 @@ DEFUN (rmap_onmatch_goto,
 	{
 	  index->exitpolicy = RMAP_GOTO;
 	  index->nextpref = d;
+	  rmap_version++;
 	}
     }
   return CMD_SUCCESS;
@@ -1614,7 +1776,10 @@ DEFUN (no_rmap_onmatch_goto,
   struct route_map_index *index = VTY_GET_CONTEXT (route_map_index);
 
   if (index)
-    index->exitpolicy = RMAP_EXIT;
+    {
+      index->exitpolicy = RMAP_EXIT;
+      rmap_version++;
+    }
   
   return CMD_SUCCESS;
 }
@@ -106,6 +106,16 @@ struct route_map_rule_cmd
 
   /* Free allocated value by func_compile (). */
   void (*func_free)(void *);
+
+  /* Optional: given the compiled value, return non-zero if the rule looks
+     at nothing but the object (not the prefix, nor any other state), so
+     that route_map_apply() results may be cached per object. */
+  int (*func_cacheable)(void *);
+
+  /* Optional: look up whatever the compiled value refers to by name
+     (filter lists and the like), called each time the route-map is
+     compiled for route_map_apply() so that applying it need not. */
+  void (*func_resolve)(void *);
 };
 
 /* Route map apply error. */
@@ -176,6 +186,14 @@ struct route_map
   int to_be_processed;	 /* True if modification isn't acted on yet */
   int deleted;		 /* If 1, then this node will be deleted */
 
+  /* route_map_cacheable() result, valid for route_map_version()
+     cacheable_version. */
+  int cacheable;
+  unsigned long cacheable_version;
+
+  /* Compiled form used by route_map_apply(), rebuilt on change. */
+  struct route_map_program *program;
+
   QOBJ_FIELDS
 };
 DECLARE_QOBJ_TYPE(route_map)
@@ -222,6 +240,9 @@ extern route_map_result_t route_map_apply (struct route_map *map,
                                            route_map_object_t object_type,
                                            void *object);
 
+extern unsigned long route_map_version (void);
+extern int route_map_cacheable (struct route_map *map);
+
 extern void route_map_add_hook (void (*func) (const char *));
 extern void route_map_delete_hook (void (*func) (const char *));
 extern void route_map_event_hook (void (*func) (route_map_event_t,
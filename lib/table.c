@@ -288,18 +288,16 @@ route_node_lookup (const struct route_table *table, const struct prefix *p)
   return NULL;
 }
 
-/* Add node to routing table. */
-struct route_node *
-route_node_get (struct route_table *const table, const struct prefix *p)
+/* Add node to routing table, descending from NODE whose parent is
+   MATCH.  NODE must cover P, or be the top of the table. */
+static struct route_node *
+route_node_get_from (struct route_table *const table, struct route_node *node,
+                     struct route_node *match, const struct prefix *p)
 {
   struct route_node *new;
-  struct route_node *node;
-  struct route_node *match;
   u_char prefixlen = p->prefixlen;
   const u_char *prefix = &p->u.prefix;
 
-  match = NULL;
-  node = table->top;
   while (node && node->p.prefixlen <= prefixlen &&
 	 prefix_match (&node->p, p))
     {
@@ -345,6 +343,32 @@ route_node_get (struct route_table *const table, const struct prefix *p)
   return new;
 }
 
+/* Add node to routing table. */
+struct route_node *
+route_node_get (struct route_table *const table, const struct prefix *p)
+{
+  return route_node_get_from (table, table->top, NULL, p);
+}
+
+/* Add node to routing table, starting the search from the closest node
+   at or above HINT that covers P instead of from the top.  When
+   prefixes are added in sorted order the previous result is usually
+   only a few levels away.  HINT may be NULL, and must otherwise be a
+   locked node of TABLE. */
+struct route_node *
+route_node_get_hint (struct route_table *const table, struct route_node *hint,
+                     const struct prefix *p)
+{
+  while (hint && ! (hint->p.prefixlen <= p->prefixlen
+                    && prefix_match (&hint->p, p)))
+    hint = hint->parent;
+
+  if (! hint)
+    return route_node_get (table, p);
+
+  return route_node_get_from (table, hint, hint->parent, p);
+}
+
 /* Delete node from the routing table. */
 static void
 route_node_delete (struct route_node *node)
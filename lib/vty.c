@@ -154,6 +154,63 @@ vty_out (struct vty *vty, const char *format, ...)
   return len;
 }
 
+/* Have the rest of the output of the command being run produced by
+   FUNC, a part at a time, each time the vty has written out what was
+   output before.  A command with a lot to show then neither builds
+   all of it up in the output buffer, nor holds up the daemon while it
+   does.  FUNC returns CMD_SUSPEND while it has more to output, and
+   then the result of the command.  CLEAN, if given, frees ARG once
+   FUNC is done, or the vty is closed before it is.
+
+   Returns what the command is to return.  Where the vty cannot wait
+   for its output to be written, FUNC is run to completion at once. */
+int
+vty_output_suspend (struct vty *vty, int (*func) (struct vty *, void *),
+		    void (*clean) (void *), void *arg)
+{
+  int ret;
+
+  if ((vty->type == VTY_TERM || vty->type == VTY_SHELL_SERV)
+      && !vty->output_func)
+    {
+      vty->output_func = func;
+      vty->output_clean = clean;
+      vty->output_arg = arg;
+      return CMD_SUSPEND;
+    }
+
+  while ((ret = func (vty, arg)) == CMD_SUSPEND)
+    ;
+  if (clean)
+    clean (arg);
+  return ret;
+}
+
+/* Give up on the suspended output of a command. */
+static void
+vty_output_clean (struct vty *vty)
+{
+  if (vty->output_clean)
+    vty->output_clean (vty->output_arg);
+  vty->output_func = NULL;
+  vty->output_clean = NULL;
+  vty->output_arg = NULL;
+}
+
+/* Produce the next part of the suspended output of a command.  Returns
+   CMD_SUSPEND while there is more to come, and then the result of the
+   command. */
+static int
+vty_output_resume (struct vty *vty)
+{
+  int ret;
+
+  ret = vty->output_func (vty, vty->output_arg);
+  if (ret != CMD_SUSPEND)
+    vty_output_clean (vty);
+  return ret;
+}
+
 static int
 vty_log_out (struct vty *vty, const char *level, const char *proto_str,
 	     const char *format, struct timestamp_control *ctl, va_list va)
@@ -1350,7 +1407,7 @@ vty_execute (struct vty *vty)
   vty->cp = vty->length = 0;
   vty_clear_buf (vty);
 
-  if (vty->status != VTY_CLOSE )
+  if (vty->status != VTY_CLOSE && !vty->output_func)
     vty_prompt (vty);
 
   return ret;
@@ -1392,6 +1449,8 @@ static void
 vty_buffer_reset (struct vty *vty)
 {
   buffer_reset (vty->obuf);
+  if (vty->output_func)
+    vty_output_clean (vty);
   vty_prompt (vty);
   vty_redraw_line (vty);
 }
@@ -1460,7 +1519,9 @@ vty_read (struct thread *thread)
 	}
 	        
 
-      if (vty->status == VTY_MORE)
+      /* While output is pending, as at --More--, input other than to
+	 quit it is dropped, not kept for after the output. */
+      if (vty->status == VTY_MORE || vty->output_func)
 	{
 	  switch (buf[i])
 	    {
@@ -1650,6 +1711,15 @@ vty_flush (struct thread *thread)
     case BUFFER_EMPTY:
       if (vty->status == VTY_CLOSE)
 	vty_close (vty);
+      else if (vty->output_func)
+	{
+	  /* On with the output of the command, once this part of it has
+	     been written. */
+	  vty->status = VTY_NORMAL;
+	  if (vty_output_resume (vty) != CMD_SUSPEND)
+	    vty_prompt (vty);
+	  vty_event (VTY_WRITE, vty_sock, vty);
+	}
       else
 	{
 	  vty->status = VTY_NORMAL;
@@ -2162,6 +2232,9 @@ vtysh_accept (struct thread *thread)
 static int
 vtysh_flush(struct vty *vty)
 {
+  u_char header[4] = {0, 0, 0, 0};
+  int ret;
+
   switch (buffer_flush_available(vty->obuf, vty->wfd))
     {
     case BUFFER_PENDING:
@@ -2175,6 +2248,19 @@ vtysh_flush(struct vty *vty)
       return -1;
       break;
     case BUFFER_EMPTY:
+      if (vty->output_func)
+	{
+	  /* On with the output of the command; its result goes out once
+	     it is done, and the next command is read after that. */
+	  ret = vty_output_resume (vty);
+	  if (ret != CMD_SUSPEND)
+	    {
+	      header[3] = ret;
+	      buffer_put(vty->obuf, header, 4);
+	      vty_event (VTYSH_READ, vty->fd, vty);
+	    }
+	  vty_event(VTYSH_WRITE, vty->wfd, vty);
+	}
       break;
     }
   return 0;
@@ -2241,7 +2327,16 @@ vtysh_read (struct thread *thread)
            * - other commands in "buf" will be ditched
            * - input during pending config-write is "unsupported" */
           if (ret == CMD_SUSPEND)
-            break;
+            {
+              /* a command's output to come a part at a time */
+              if (vty->output_func)
+                {
+                  if (!vty->t_write)
+                    vtysh_flush(vty);
+                  return 0;
+                }
+              break;
+            }
 
           /* warning: watchquagga hardcodes this result write */
 	  header[3] = ret;
@@ -2307,6 +2402,10 @@ vty_close (struct vty *vty)
   if (vty->t_timeout)
     thread_cancel (vty->t_timeout);
 
+  /* Give up on output still to come. */
+  if (vty->output_func)
+    vty_output_clean (vty);
+
   /* Flush buffer. */
   buffer_flush_all (vty->obuf, vty->wfd);
 
@@ -134,6 +134,12 @@ struct vty
   unsigned long v_timeout;
   struct thread *t_timeout;
 
+  /* Rest of the output of a command, produced a part at a time once
+     what is already in obuf has been written; see vty_output_suspend. */
+  int (*output_func) (struct vty *, void *);
+  void (*output_clean) (void *);
+  void *output_arg;
+
   /* What address is this vty comming from. */
   char address[SU_ADDRSTRLEN];
 };
@@ -344,6 +350,8 @@ extern void vty_reset (void);
 extern struct vty *vty_new (void);
 extern struct vty *vty_stdio (void (*atclose)(void));
 extern int vty_out (struct vty *, const char *, ...) PRINTF_ATTRIBUTE(2, 3);
+extern int vty_output_suspend (struct vty *, int (*) (struct vty *, void *),
+			       void (*) (void *), void *);
 extern void vty_read_config (char *, char *);
 extern void vty_time_print (struct vty *, int);
 extern void vty_serv_sock (const char *, unsigned short, const char *);
@@ -30,6 +30,7 @@
 #include "bgpd/bgpd.h"
 #include "bgpd/bgp_aspath.h"
 #include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_regex.h"
 
 #define VT100_RESET "\x1b[0m"
 #define VT100_RED "\x1b[31m"
@@ -1251,6 +1252,83 @@ cmp_test ()
     }
 }
 
+/* AS path filters that bgp_regcomp_fast() should handle.  "%u" is
+   replaced with the first, second and last AS of each test path.  */
+static const char *regex_fast_patterns[] =
+{
+  ".*",
+  "^$",
+  "_%u_",
+  "^%u_",
+  "_%u$",
+  "^%u$",
+  "_8466_3_",
+  "^8466_3_52737_",
+  "_8722_4$",
+  "_3_",
+  "_52737_",
+  NULL,
+};
+
+/* whole-AS regex matching must agree with the string regex */
+static void
+regex_fast_test (struct test_segment *t)
+{
+  struct aspath *asp;
+  struct bgp_regex_fast *fast;
+  regex_t *reg;
+  as_t asns[3];
+  char buf[64];
+  int i, j, ret;
+  int fails = 0;
+
+  printf ("regex fast %s: %s\n", t->name, t->desc);
+
+  asp = make_aspath (t->asdata, t->len, 0);
+  if (!asp)
+    {
+      printf (OK " (not parsed)\n\n");
+      return;
+    }
+
+  asns[0] = aspath_leftmost (asp);
+  asns[1] = (asp->segments && asp->segments->length > 1)
+            ? asp->segments->as[1] : asns[0];
+  asns[2] = aspath_get_last_as (asp);
+
+  for (i = 0; regex_fast_patterns[i]; i++)
+    for (j = 0; j < 3; j++)
+      {
+        snprintf (buf, sizeof (buf), regex_fast_patterns[i], asns[j]);
+
+        fast = bgp_regcomp_fast (buf);
+        reg = bgp_regcomp (buf);
+        assert (fast && reg);
+
+        ret = bgp_regexec_fast (fast, asp);
+        if (ret >= 0 && ret != (bgp_regexec (reg, asp) != REG_NOMATCH))
+          {
+            fails++;
+            printf ("%s on %s: fast %d, regexec %d\n", buf,
+                    aspath_print (asp), ret,
+                    bgp_regexec (reg, asp) != REG_NOMATCH);
+          }
+
+        bgp_regex_fast_free (fast);
+        bgp_regex_free (reg);
+      }
+
+  if (fails)
+    {
+      failed++;
+      printf (FAILED "\n\n");
+    }
+  else
+    printf (OK "\n\n");
+
+  aspath_unintern (&asp);
+}
+
 static int
 handle_attr_test (struct aspath_tests *t)
 {
@@ -1265,6 +1343,7 @@ handle_attr_test (struct aspath_tests *t)
   asp = make_aspath (t->segment->asdata, t->segment->len, 0);
     
   peer.ibuf = stream_new (BGP_MAX_PACKET_SIZE);
+  peer.max_packet_size = BGP_MAX_PACKET_SIZE;
   peer.obuf = stream_fifo_new ();
   peer.bgp = &bgp;
   peer.host = (char *)"none";
@@ -1298,17 +1377,17 @@ handle_attr_test (struct aspath_tests *t)
       printf ("aspath is NULL, but should be: %s\n", t->shouldbe);
       failed++;
     }
-  if (t->shouldbe && attr.aspath && strcmp (attr.aspath->str, t->shouldbe))
+  if (t->shouldbe && attr.aspath && strcmp (aspath_print (attr.aspath), t->shouldbe))
     {
       printf ("attr str and 'shouldbe' mismatched!\n"
               "attr str:  %s\n"
               "shouldbe:  %s\n",
-              attr.aspath->str, t->shouldbe);
+              aspath_print (attr.aspath), t->shouldbe);
       failed++;
     }
   if (!t->shouldbe && attr.aspath)
     {
-      printf ("aspath should be NULL, but is: %s\n", attr.aspath->str);
+      printf ("aspath should be NULL, but is: %s\n", aspath_print (attr.aspath));
       failed++;
     }
 
@@ -1375,6 +1454,11 @@ main (void)
   
   i = 0;
   
+  while (test_segments[i].name)
+    regex_fast_test (&test_segments[i++]);
+  
+  i = 0;
+  
   while (aspath_tests[i].desc)
     {
       printf ("aspath_attr test %d\n", i);
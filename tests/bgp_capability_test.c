@@ -423,6 +423,16 @@ static struct test_segment misc_segments[] =
     { CAPABILITY_CODE_DYNAMIC, 0x0 },
     2, SHOULD_PARSE,
   },
+  { "ExtMsg",
+    "Extended Message capability",
+    { CAPABILITY_CODE_EXT_MESSAGE, 0x0 },
+    2, SHOULD_PARSE,
+  },
+  { "ExtMsg-long",
+    "Extended Message capability, but length too long",
+    { CAPABILITY_CODE_EXT_MESSAGE, 0x2, 0x0, 0x0 },
+    4, SHOULD_PARSE,
+  },
   { NULL, NULL, {0}, 0, 0}
 };
 
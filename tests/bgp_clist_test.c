@@ -0,0 +1,271 @@
+/*
+ * BGP community-list matching test and benchmark
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "vty.h"
+#include "stream.h"
+#include "privs.h"
+#include "memory.h"
+#include "queue.h"
+#include "filter.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_community.h"
+#include "bgpd/bgp_regex.h"
+#include "bgpd/bgp_clist.h"
+
+#include "prng.h"
+
+/* need these to link in libbgp */
+struct zebra_privs_t *bgpd_privs = NULL;
+struct thread_master *master = NULL;
+
+#define COMS		1000
+#define BENCH_ROUNDS	10
+
+static int failed = 0;
+static struct community *coms[COMS];
+
+/* The entry-by-entry walk community-lists used to do, as reference.  */
+static int
+ref_match (struct community *com, struct community_list *list, int exact)
+{
+  struct community_entry *entry;
+  const char *str;
+
+  for (entry = list->head; entry; entry = entry->next)
+    {
+      if (entry->any)
+        return entry->direct == COMMUNITY_PERMIT;
+
+      if (entry->style == COMMUNITY_LIST_STANDARD)
+        {
+          if (community_include (entry->u.com, COMMUNITY_INTERNET))
+            return entry->direct == COMMUNITY_PERMIT;
+
+          if (exact ? community_cmp (com, entry->u.com)
+                    : community_match (com, entry->u.com))
+            return entry->direct == COMMUNITY_PERMIT;
+        }
+      else
+        {
+          str = (com && com->size) ? community_str (com) : "";
+          if (regexec (entry->reg, str, 0, NULL, 0) == 0)
+            return entry->direct == COMMUNITY_PERMIT;
+        }
+    }
+  return 0;
+}
+
+static struct community *
+ref_match_delete (struct community *com, struct community_list *list)
+{
+  struct community_entry *entry;
+  struct community *new;
+  u_int32_t val;
+  int i;
+
+  new = community_dup (com);
+  for (i = 0; i < com->size; i++)
+    {
+      val = community_val_get (com, i);
+      for (entry = list->head; entry; entry = entry->next)
+        if (entry->any
+            || community_include (entry->u.com, COMMUNITY_INTERNET)
+            || community_include (entry->u.com, val))
+          {
+            if (entry->direct == COMMUNITY_PERMIT)
+              community_del_val (new, &val);
+            break;
+          }
+    }
+  return new;
+}
+
+/* Interned communities of 30 to 60 values drawn from a small pool, so
+   that they overlap the lists, and a few equal to single entries.  */
+static void
+make_communities (struct prng *prng)
+{
+  struct community *com;
+  char buf[1024];
+  unsigned int j, n;
+  int i, len;
+
+  for (i = 0; i < COMS; i++)
+    {
+      if (i % 50 == 0)
+        n = 1 + i / 50 % 3;
+      else
+        n = 30 + prng_rand (prng) % 31;
+
+      for (len = 0, j = 0; j < n; j++)
+        len += snprintf (buf + len, sizeof (buf) - len, "%s6500%u:%u",
+                         j ? " " : "", prng_rand (prng) % 4,
+                         (i % 50 == 0) ? j + 1 : prng_rand (prng) % 600);
+      com = community_str2com (buf);
+      coms[i] = community_intern (com);
+    }
+}
+
+static void
+make_lists (struct community_list_handler *ch, struct prng *prng)
+{
+  char buf[64];
+  int i;
+
+  /* Mostly single values, some deny, some multi-value entries.  */
+  for (i = 0; i < 500; i++)
+    {
+      if (i % 10 == 9)
+        snprintf (buf, sizeof (buf), "65001:%u 65002:%u 65003:%u",
+                  prng_rand (prng) % 600, prng_rand (prng) % 600,
+                  prng_rand (prng) % 600);
+      else
+        snprintf (buf, sizeof (buf), "6500%u:%u", prng_rand (prng) % 4,
+                  600 + prng_rand (prng) % 2000);
+      community_list_set (ch, "STD", buf,
+                          i % 7 ? COMMUNITY_PERMIT : COMMUNITY_DENY,
+                          COMMUNITY_LIST_STANDARD);
+    }
+  community_list_set (ch, "STD", "65000:1 65001:2", COMMUNITY_DENY,
+                      COMMUNITY_LIST_STANDARD);
+  community_list_set (ch, "STD", "65000:1", COMMUNITY_PERMIT,
+                      COMMUNITY_LIST_STANDARD);
+  community_list_set (ch, "STD", "65002:1", COMMUNITY_PERMIT,
+                      COMMUNITY_LIST_STANDARD);
+
+  /* Same again, but ending in a catch-all.  */
+  community_list_set (ch, "ANY", "65000:2", COMMUNITY_DENY,
+                      COMMUNITY_LIST_STANDARD);
+  community_list_set (ch, "ANY", "65003:100 65003:101", COMMUNITY_DENY,
+                      COMMUNITY_LIST_STANDARD);
+  community_list_set (ch, "ANY", "internet", COMMUNITY_PERMIT,
+                      COMMUNITY_LIST_STANDARD);
+
+  for (i = 0; i < 100; i++)
+    {
+      snprintf (buf, sizeof (buf), "_6500%u:%u_", prng_rand (prng) % 4,
+                590 + prng_rand (prng) % 600);
+      community_list_set (ch, "EXP", buf,
+                          i % 5 ? COMMUNITY_PERMIT : COMMUNITY_DENY,
+                          COMMUNITY_LIST_EXPANDED);
+    }
+}
+
+static void
+verify (struct community_list *list)
+{
+  struct community *ref, *new;
+  int i, fails = 0;
+
+  printf ("Verifying list %s\n", list->name);
+  for (i = 0; i < COMS; i++)
+    {
+      if (community_list_match (coms[i], list) != ref_match (coms[i], list, 0)
+          || community_list_exact_match (coms[i], list)
+             != ref_match (coms[i], list, 1))
+        fails++;
+
+      if (list->head->style == COMMUNITY_LIST_STANDARD)
+        {
+          ref = ref_match_delete (coms[i], list);
+          new = community_list_match_delete (community_dup (coms[i]), list);
+          if (! community_cmp (ref, new))
+            fails++;
+          community_free (ref);
+          community_free (new);
+        }
+    }
+
+  /* No communities at all.  */
+  if (community_list_match (NULL, list) != ref_match (NULL, list, 0))
+    fails++;
+
+  failed += fails;
+  printf ("%s\n", fails ? "failed" : "OK");
+}
+
+static void
+bench (struct community_list *list)
+{
+  clock_t start, ref, new;
+  int i, round;
+  volatile int sink = 0;
+
+  start = clock ();
+  for (round = 0; round < BENCH_ROUNDS; round++)
+    for (i = 0; i < COMS; i++)
+      sink += ref_match (coms[i], list, 0);
+  ref = clock () - start;
+
+  start = clock ();
+  for (round = 0; round < BENCH_ROUNDS; round++)
+    for (i = 0; i < COMS; i++)
+      sink += community_list_match (coms[i], list);
+  new = clock () - start;
+
+  printf ("Benchmark list %s: %d matches, walk %.1f ms, indexed %.1f ms\n",
+          list->name, BENCH_ROUNDS * COMS,
+          ref * 1000.0 / CLOCKS_PER_SEC, new * 1000.0 / CLOCKS_PER_SEC);
+}
+
+int
+main (void)
+{
+  struct community_list_handler *ch;
+  struct community_list *list;
+  struct prng *prng;
+  const char *names[] = { "STD", "ANY", "EXP" };
+  unsigned int i;
+
+  community_init ();
+  ch = community_list_init ();
+  prng = prng_new (0);
+
+  make_lists (ch, prng);
+  make_communities (prng);
+
+  for (i = 0; i < array_size (names); i++)
+    {
+      list = community_list_lookup (ch, names[i], COMMUNITY_LIST_MASTER);
+      verify (list);
+      bench (list);
+    }
+
+  /* Changing the list must be seen by the next match.  */
+  printf ("Verifying list change\n");
+  list = community_list_lookup (ch, "ANY", COMMUNITY_LIST_MASTER);
+  community_list_set (ch, "ANY", "65000:1", COMMUNITY_DENY,
+                      COMMUNITY_LIST_STANDARD);
+  community_list_unset (ch, "ANY", "internet", COMMUNITY_PERMIT,
+                        COMMUNITY_LIST_STANDARD, 0);
+  verify (list);
+
+  community_list_terminate (ch);
+  for (i = 0; i < COMS; i++)
+    community_unintern (&coms[i]);
+  prng_free (prng);
+
+  printf ("failures: %d\n", failed);
+  return failed;
+}
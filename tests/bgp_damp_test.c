@@ -0,0 +1,241 @@
+/*
+ * BGP route flap dampening test
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "qobj.h"
+#include "vty.h"
+#include "stream.h"
+#include "privs.h"
+#include "linklist.h"
+#include "memory.h"
+#include "zclient.h"
+#include "queue.h"
+#include "filter.h"
+#include "workqueue.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_table.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_damp.h"
+
+/* need these to link in libbgp */
+struct thread_master *master = NULL;
+extern struct zclient *zclient;
+struct zebra_privs_t bgpd_privs =
+{
+  .user = NULL,
+  .group = NULL,
+  .vty_group = NULL,
+};
+
+#define ROUTES4		10000
+#define ROUTES6		1000
+
+static int failed = 0;
+static struct bgp_info *routes4[ROUTES4];
+static struct bgp_info *routes6[ROUTES6];
+static struct peer test_peer;
+
+static struct bgp *
+bgp_create_fake (void)
+{
+  struct bgp *bgp;
+  afi_t afi;
+  safi_t safi;
+
+  bgp = XCALLOC (MTYPE_BGP, sizeof (struct bgp));
+  bgp_lock (bgp);
+  bgp->peer = list_new ();
+  bgp->group = list_new ();
+
+  for (afi = AFI_IP; afi < AFI_MAX; afi++)
+    for (safi = SAFI_UNICAST; safi < SAFI_MAX; safi++)
+      {
+        bgp->route[afi][safi] = bgp_table_init (afi, safi);
+        bgp->aggregate[afi][safi] = bgp_table_init (afi, safi);
+        bgp->rib[afi][safi] = bgp_table_init (afi, safi);
+      }
+  return bgp;
+}
+
+static struct bgp_info *
+route_add (struct bgp *bgp, afi_t afi, unsigned int i)
+{
+  struct prefix p;
+  struct bgp_node *rn;
+  struct bgp_info *ri;
+
+  memset (&p, 0, sizeof (p));
+  if (afi == AFI_IP)
+    {
+      p.family = AF_INET;
+      p.prefixlen = 24;
+      p.u.prefix4.s_addr = htonl (0x0a000000 | (i << 8));
+    }
+  else
+    {
+      p.family = AF_INET6;
+      p.prefixlen = 48;
+      p.u.prefix6.s6_addr[0] = 0x20;
+      p.u.prefix6.s6_addr[1] = 0x01;
+      p.u.prefix6.s6_addr[4] = i >> 8;
+      p.u.prefix6.s6_addr[5] = i & 0xff;
+    }
+
+  rn = bgp_node_get (bgp->rib[afi][SAFI_UNICAST], &p);
+  ri = bgp_info_new ();
+  ri->peer = &test_peer;
+  ri->type = ZEBRA_ROUTE_BGP;
+  ri->sub_type = BGP_ROUTE_NORMAL;
+  ri->net = rn;
+  bgp_info_add (rn, ri);
+  bgp_info_set_flag (rn, ri, BGP_INFO_VALID);
+  bgp_unlock_node (rn);
+  return ri;
+}
+
+/* Withdraw and re-announce a route, as a flapping peer would.  */
+static int
+route_flap (struct bgp_info *ri, afi_t afi, int flaps)
+{
+  struct bgp_node *rn = ri->net;
+  int status = BGP_DAMP_USED;
+
+  while (flaps--)
+    {
+      bgp_damp_withdraw (ri, rn, afi, SAFI_UNICAST, 0);
+      status = bgp_damp_update (ri, rn, afi, SAFI_UNICAST);
+    }
+  return status;
+}
+
+static void
+check (const char *what, int fails)
+{
+  printf ("Verifying %s\n%s\n", what, fails ? "failed" : "OK");
+  failed += fails;
+}
+
+int
+main (void)
+{
+  struct bgp *bgp;
+  struct bgp_damp_config *bdc;
+  struct bgp_process_queue *pq;
+  struct thread thread;
+  unsigned int i, ticks, runs;
+  int fails;
+
+  qobj_init ();
+  master = thread_master_create ();
+  zclient = zclient_new (master);
+  bgp_master_init ();
+  vrf_init ();
+  bgp_option_set (BGP_OPT_NO_LISTEN);
+
+  /* Keep the route processing queue from running, only count it.  */
+  bgp_process_queue_init ();
+  bm->process_main_queue->spec.hold = 3600 * 1000;
+
+  bgp = bgp_create_fake ();
+  test_peer.bgp = bgp;
+  test_peer.host = (char *) "test";
+
+  /* Different parameters per family; 3 flaps suppress IPv4 routes,
+     but 2 flaps must not suppress IPv6 ones.  */
+  bgp_damp_enable (bgp, AFI_IP, SAFI_UNICAST, 15 * 60, 750, 2000, 60 * 60);
+  bgp_damp_enable (bgp, AFI_IP6, SAFI_UNICAST, 5 * 60, 750, 3000, 20 * 60);
+
+  for (i = 0; i < ROUTES4; i++)
+    routes4[i] = route_add (bgp, AFI_IP, i);
+  for (i = 0; i < ROUTES6; i++)
+    routes6[i] = route_add (bgp, AFI_IP6, i);
+
+  /* The flap storm.  */
+  fails = 0;
+  for (i = 0; i < ROUTES4; i++)
+    if (route_flap (routes4[i], AFI_IP, 3) != BGP_DAMP_SUPPRESSED
+        || ! CHECK_FLAG (routes4[i]->flags, BGP_INFO_DAMPED))
+      fails++;
+  for (i = 0; i < ROUTES6; i++)
+    if (route_flap (routes6[i], AFI_IP6, 2) != BGP_DAMP_USED
+        || CHECK_FLAG (routes6[i]->flags, BGP_INFO_DAMPED)
+        || routes6[i]->extra->damp_info->config != bgp->damp[AFI_IP6][SAFI_UNICAST])
+      fails++;
+  bdc = bgp->damp[AFI_IP][SAFI_UNICAST];
+  if (bdc->reuse_count != ROUTES4
+      || bgp->damp[AFI_IP6][SAFI_UNICAST]->reuse_count != 0)
+    fails++;
+  check ("suppression", fails);
+
+  /* Let two hours pass: the IPv4 routes are due for reuse once the
+     wheel comes round to them, and not before.  */
+  for (i = 0; i < ROUTES4; i++)
+    routes4[i]->extra->damp_info->t_updated -= 2 * 60 * 60;
+
+  fails = 0;
+  for (ticks = 0; bdc->reuse_count && ticks < bdc->reuse_list_size; ticks++)
+    {
+      bgp_damp_reuse_tick (bdc);
+      if (bdc->reuse_count && bdc->t_reuse_batch)
+        fails++;
+    }
+  if (bdc->reuse_count || ! bdc->t_reuse_batch)
+    fails++;
+  check ("reuse wheel", fails);
+
+  /* Reuse happens in batches, each one a separate background thread.  */
+  fails = 0;
+  pq = &bgp->process_queue[AFI_IP][SAFI_UNICAST];
+  for (runs = 0; bdc->t_reuse_batch; runs++)
+    {
+      thread_fetch (bm->master, &thread);
+      thread_call (&thread);
+    }
+  if (runs < ROUTES4 / BGP_DAMP_REUSE_BATCH)
+    fails++;
+  if (pq->enqueued != ROUTES4)
+    fails++;
+  for (i = 0; i < ROUTES4; i++)
+    if (CHECK_FLAG (routes4[i]->flags, BGP_INFO_DAMPED | BGP_INFO_HISTORY))
+      fails++;
+  check ("batched reuse", fails);
+  printf ("Reused %u routes after %u ticks in %u batches\n",
+          ROUTES4, ticks, runs);
+
+  fails = 0;
+  bgp_damp_disable (bgp, AFI_IP, SAFI_UNICAST);
+  bgp_damp_disable (bgp, AFI_IP6, SAFI_UNICAST);
+  for (i = 0; i < ROUTES4; i++)
+    if (routes4[i]->extra && routes4[i]->extra->damp_info)
+      fails++;
+  for (i = 0; i < ROUTES6; i++)
+    if (routes6[i]->extra && routes6[i]->extra->damp_info)
+      fails++;
+  if (bgp->damp[AFI_IP][SAFI_UNICAST] || bgp->damp[AFI_IP6][SAFI_UNICAST])
+    fails++;
+  check ("disable", fails);
+
+  printf ("failures: %d\n", failed);
+  return failed;
+}
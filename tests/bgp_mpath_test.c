@@ -287,12 +287,15 @@ testcase_t test_bgp_mp_list = {
  * Testcase for bgp_info_mpath_update
  */
 
+struct bgp_table *test_table;
 struct bgp_node test_rn;
 
 static int
 setup_bgp_info_mpath_update (testcase_t *t)
 {
   int i;
+  test_table = bgp_table_init (AFI_IP, SAFI_UNICAST);
+  test_rn.table = test_table->route_table;
   str2prefix ("42.1.1.0/24", &test_rn.p);
   setup_bgp_mp_list (t);
   for (i = 0; i < test_mp_list_info_count; i++)
@@ -347,6 +350,8 @@ cleanup_bgp_info_mpath_update (testcase_t *t)
 
   for (i = 0; i < test_mp_list_peer_count; i++)
     sockunion_free (test_mp_list_peer[i].su_remote);
+  test_rn.table = NULL;
+  bgp_table_unlock (test_table);
 
   return 0;
 }
@@ -0,0 +1,344 @@
+/*
+ * BGP per-peer path count and table statistics test
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "qobj.h"
+#include "vty.h"
+#include "stream.h"
+#include "privs.h"
+#include "linklist.h"
+#include "memory.h"
+#include "zclient.h"
+#include "queue.h"
+#include "filter.h"
+#include "workqueue.h"
+#include "log.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_table.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_aspath.h"
+#include "bgpd/bgp_advertise.h"
+#include "bgpd/bgp_mpath.h"
+#include "bgpd/bgp_damp.h"
+#include "bgpd/bgp_fsm.h"
+
+/* need these to link in libbgp */
+struct thread_master *master = NULL;
+extern struct zclient *zclient;
+struct zebra_privs_t bgpd_privs =
+{
+  .user = NULL,
+  .group = NULL,
+  .vty_group = NULL,
+};
+
+#define PEERS		3
+#define ROUTES		2000
+
+static int failed = 0;
+static struct bgp *bgp;
+static struct peer *peers[PEERS];
+
+/* The table walk "show bgp neighbors prefix-counts detail" does.  */
+static void
+ref_counts (struct peer *peer, unsigned long *count)
+{
+  struct bgp_node *rn;
+  struct bgp_adj_in *ain;
+  struct bgp_info *ri;
+
+  memset (count, 0, PCOUNT_MAX * sizeof (*count));
+  for (rn = bgp_table_top (bgp->rib[AFI_IP][SAFI_UNICAST]); rn;
+       rn = bgp_route_next (rn))
+    {
+      for (ain = rn->adj_in; ain; ain = ain->next)
+        if (BGP_ADJ_IN_PEER (ain) == peer)
+          count[PCOUNT_ADJ_IN]++;
+
+      for (ri = rn->info; ri; ri = ri->next)
+        {
+          if (ri->peer != peer)
+            continue;
+
+          count[PCOUNT_ALL]++;
+          if (CHECK_FLAG (ri->flags, BGP_INFO_DAMPED))
+            count[PCOUNT_DAMPED]++;
+          if (CHECK_FLAG (ri->flags, BGP_INFO_HISTORY))
+            count[PCOUNT_HISTORY]++;
+          if (CHECK_FLAG (ri->flags, BGP_INFO_REMOVED))
+            count[PCOUNT_REMOVED]++;
+          if (CHECK_FLAG (ri->flags, BGP_INFO_STALE))
+            count[PCOUNT_STALE]++;
+          if (CHECK_FLAG (ri->flags, BGP_INFO_VALID))
+            count[PCOUNT_VALID]++;
+          if (CHECK_FLAG (ri->flags, BGP_INFO_SELECTED))
+            count[PCOUNT_BEST]++;
+          if (CHECK_FLAG (ri->flags, BGP_INFO_MULTIPATH))
+            count[PCOUNT_MULTIPATH]++;
+          if (CHECK_FLAG (ri->flags, BGP_INFO_COUNTED))
+            count[PCOUNT_COUNTED]++;
+          if (!CHECK_FLAG (ri->flags, BGP_INFO_UNUSEABLE))
+            count[PCOUNT_PFCNT]++;
+        }
+    }
+}
+
+static int
+verify_peer (struct peer *peer)
+{
+  struct bgp_adj_in_pool *pool = peer->adj_in_pool[AFI_IP][SAFI_UNICAST];
+  unsigned long ref[PCOUNT_MAX];
+  unsigned int i;
+  int fails = 0;
+
+  ref_counts (peer, ref);
+  if (ref[PCOUNT_ADJ_IN] != (pool ? pool->count : 0))
+    fails++;
+  for (i = PCOUNT_ADJ_IN + 1; i < PCOUNT_MAX; i++)
+    if (ref[i] != peer->pcounts[AFI_IP][SAFI_UNICAST][i])
+      {
+        printf ("%s: %u is %lu, walk found %lu\n", peer->host, i,
+                peer->pcounts[AFI_IP][SAFI_UNICAST][i], ref[i]);
+        fails++;
+      }
+  if (ref[PCOUNT_COUNTED] != peer->pcount[AFI_IP][SAFI_UNICAST])
+    fails++;
+  return fails;
+}
+
+static int
+verify_table (struct bgp_table *table)
+{
+  struct bgp_node *rn;
+  struct bgp_info *ri;
+  unsigned long prefixes = 0, plen = 0, paths = 0;
+
+  for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
+    {
+      if (!rn->info)
+        continue;
+      prefixes++;
+      plen += rn->p.prefixlen;
+      for (ri = rn->info; ri; ri = ri->next)
+        paths++;
+    }
+  return (prefixes != table->prefix_count)
+         + (plen != table->prefix_len_total)
+         + (paths != table->path_count);
+}
+
+static void
+check (const char *what)
+{
+  unsigned int i;
+  int fails = 0;
+
+  for (i = 0; i < PEERS; i++)
+    fails += verify_peer (peers[i]);
+  fails += verify_table (bgp->rib[AFI_IP][SAFI_UNICAST]);
+
+  printf ("Verifying %s\n%s\n", what, fails ? "failed" : "OK");
+  failed += fails;
+}
+
+static void
+drain (void)
+{
+  struct thread thread;
+
+  while (work_queue_is_scheduled (bm->process_main_queue)
+         || (bm->clear_node_queue
+             && work_queue_is_scheduled (bm->clear_node_queue)))
+    {
+      if (! thread_fetch (bm->master, &thread))
+        break;
+      thread_call (&thread);
+    }
+}
+
+static void
+peer_up (struct peer *peer)
+{
+  BGP_TIMER_OFF (peer->t_start);
+  BGP_TIMER_OFF (peer->t_connect);
+
+  peer->fd = open ("/dev/null", O_WRONLY);
+  peer->remote_id = peer->su.sin.sin_addr;
+  peer->afc_adv[AFI_IP][SAFI_UNICAST] = 1;
+  peer->afc_recv[AFI_IP][SAFI_UNICAST] = 1;
+  peer->afc_nego[AFI_IP][SAFI_UNICAST] = 1;
+  SET_FLAG (peer->cap, PEER_CAP_AS4_RCV | PEER_CAP_AS4_ADV);
+  peer->nexthop.v4.s_addr = htonl (0xc0000201);
+  peer->status = Established;
+  peer->uptime = bgp_clock ();
+}
+
+static void
+route_prefix (struct prefix *p, unsigned int n)
+{
+  memset (p, 0, sizeof (*p));
+  p->family = AF_INET;
+  p->prefixlen = 16 + n % 9;
+  p->u.prefix4.s_addr = htonl (0x0a000000 | (n << 8));
+  apply_mask (p);
+}
+
+/* Every peer announces the same routes, with the same attributes, so
+   that multipath picks them all up.  */
+static void
+announce (struct peer *peer, unsigned int first, unsigned int last)
+{
+  struct attr attr;
+  struct prefix p;
+  unsigned int n;
+
+  bgp_attr_default_set (&attr, BGP_ORIGIN_IGP);
+  aspath_unintern (&attr.aspath);
+  attr.aspath = aspath_intern (aspath_str2aspath ("65002 65010"));
+  attr.nexthop = peer->su.sin.sin_addr;
+  attr.flag |= ATTR_FLAG_BIT (BGP_ATTR_NEXT_HOP);
+  attr.extra->mp_nexthop_len = BGP_ATTR_NHLEN_IPV4;
+  attr.extra->mp_nexthop_global_in = peer->su.sin.sin_addr;
+
+  for (n = first; n < last; n++)
+    {
+      route_prefix (&p, n);
+      bgp_update (peer, &p, 0, &attr, AFI_IP, SAFI_UNICAST,
+                  ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, NULL, NULL, 0);
+    }
+
+  aspath_unintern (&attr.aspath);
+  bgp_attr_extra_free (&attr);
+}
+
+static void
+withdraw (struct peer *peer, unsigned int first, unsigned int last)
+{
+  struct prefix p;
+  unsigned int n;
+
+  for (n = first; n < last; n++)
+    {
+      route_prefix (&p, n);
+      bgp_withdraw (peer, &p, 0, NULL, AFI_IP, SAFI_UNICAST,
+                    ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, NULL, NULL);
+    }
+}
+
+int
+main (void)
+{
+  union sockunion su;
+  struct bgp_info *ri;
+  as_t asn = 65000;
+  unsigned int i;
+
+  /* Keep debugs out of the report.  */
+  zlog_default = openzlog ("pcounttest", ZLOG_BGP, 0,
+                           LOG_CONS|LOG_NDELAY|LOG_PID, LOG_DAEMON);
+  zlog_set_level (NULL, ZLOG_DEST_SYSLOG, ZLOG_DISABLED);
+  zlog_set_level (NULL, ZLOG_DEST_STDOUT, ZLOG_DISABLED);
+  zlog_set_level (NULL, ZLOG_DEST_MONITOR, ZLOG_DISABLED);
+
+  qobj_init ();
+  master = thread_master_create ();
+  zclient = zclient_new (master);
+  bgp_master_init ();
+  vrf_init ();
+  bgp_option_set (BGP_OPT_NO_LISTEN);
+  bgp_attr_init ();
+  bgp_process_queue_init ();
+
+  if (bgp_get (&bgp, &asn, NULL, BGP_INSTANCE_TYPE_DEFAULT))
+    return 1;
+  bgp_maximum_paths_set (bgp, AFI_IP, SAFI_UNICAST, BGP_PEER_EBGP, PEERS, 0);
+
+  for (i = 0; i < PEERS; i++)
+    {
+      memset (&su, 0, sizeof (su));
+      su.sin.sin_family = AF_INET;
+      su.sin.sin_addr.s_addr = htonl (0xc0000202 + i);
+      peers[i] = peer_create (&su, NULL, bgp, bgp->as, 65002, AS_SPECIFIED,
+                              AFI_IP, SAFI_UNICAST, NULL);
+      if (i == 0)
+        peer_af_flag_set (peers[i], AFI_IP, SAFI_UNICAST,
+                          PEER_FLAG_SOFT_RECONFIG);
+      peer_up (peers[i]);
+    }
+
+  for (i = 0; i < PEERS; i++)
+    announce (peers[i], 0, ROUTES);
+  drain ();
+  check ("announce");
+
+  /* Replace some, withdraw others, and take them before and after the
+     withdrawals have been processed.  */
+  announce (peers[0], 0, ROUTES / 4);
+  withdraw (peers[1], 0, ROUTES / 2);
+  check ("withdraw, unprocessed");
+  announce (peers[1], ROUTES / 4, ROUTES / 2);
+  drain ();
+  check ("withdraw");
+
+  /* Flap peer 2's routes until they are suppressed.  */
+  bgp_damp_enable (bgp, AFI_IP, SAFI_UNICAST, 15 * 60, 750, 2000, 60 * 60);
+  for (i = 0; i < 3; i++)
+    {
+      withdraw (peers[2], ROUTES / 2, ROUTES);
+      announce (peers[2], ROUTES / 2, ROUTES);
+    }
+  withdraw (peers[2], 0, ROUTES / 4);
+  drain ();
+  check ("dampening");
+
+  /* Graceful restart: peer 0's paths go stale, and are swept.  */
+  for (ri = peers[0]->paths[AFI_IP][SAFI_UNICAST]; ri; ri = ri->peer_next)
+    bgp_info_set_flag (ri->net, ri, BGP_INFO_STALE);
+  check ("stale");
+  bgp_clear_stale_route (peers[0], AFI_IP, SAFI_UNICAST);
+  drain ();
+  check ("stale sweep");
+
+  /* Peer 0's swept routes come back from its Adj-RIB-In.  */
+  bgp_soft_reconfig_in (peers[0], AFI_IP, SAFI_UNICAST);
+  drain ();
+  check ("soft reconfiguration");
+  if (peers[0]->pcounts[AFI_IP][SAFI_UNICAST][PCOUNT_ALL]
+      != peers[0]->adj_in_pool[AFI_IP][SAFI_UNICAST]->count)
+    {
+      printf ("soft reconfiguration: %lu paths from %lu Adj-In entries\n",
+              peers[0]->pcounts[AFI_IP][SAFI_UNICAST][PCOUNT_ALL],
+              peers[0]->adj_in_pool[AFI_IP][SAFI_UNICAST]->count);
+      failed++;
+    }
+
+  bgp_damp_disable (bgp, AFI_IP, SAFI_UNICAST);
+  for (i = 0; i < PEERS; i++)
+    bgp_clear_route (peers[i], AFI_IP, SAFI_UNICAST);
+  drain ();
+  check ("clear");
+
+  printf ("failures: %d\n", failed);
+  return failed;
+}
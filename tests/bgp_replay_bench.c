@@ -0,0 +1,1316 @@
+/*
+ * BGP UPDATE replay benchmark
+ *
+ * Feeds an MRT file (BGP4MP messages or a TABLE_DUMP_V2 RIB dump), or
+ * a synthetic table, through the UPDATE receive path, best path
+ * selection and update-group packet generation, towards a number of
+ * simulated outbound peers, and reports where the time went.  The
+ * outbound peers may be given a route-map that prepends an AS and adds
+ * a community.
+ *
+ * Optionally, every UPDATE is then fed in again, unchanged, to time its
+ * parsing; a number of small peers then announce a few routes each
+ * and all lose their sessions at once, as when a route server loses an
+ * exchange's worth of peers, and the clearing of their routes is timed;
+ * the inbound peers' routes are replayed from their Adj-RIB-In, as for
+ * soft reconfiguration; a new outbound peer comes up and is sent the full
+ * table; all outbound peers ask for a route refresh at once; the outbound peers
+ * of one update group are moved one by one onto a new policy; and an
+ * L2VPN EVPN VNI full of remote MACs goes down and up again, as on a
+ * VxLAN interface flap, and the reinstalling of its MACs in zebra is
+ * timed.
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+#include <sys/resource.h>
+
+#include "qobj.h"
+#include "command.h"
+#include "vty.h"
+#include "stream.h"
+#include "privs.h"
+#include "linklist.h"
+#include "memory.h"
+#include "zclient.h"
+#include "queue.h"
+#include "filter.h"
+#include "thread.h"
+#include "workqueue.h"
+#include "sockunion.h"
+#include "log.h"
+#include "jhash.h"
+#include "hash.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_table.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_advertise.h"
+#include "bgpd/bgp_memory.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_aspath.h"
+#include "bgpd/bgp_packet.h"
+#include "bgpd/bgp_dump.h"
+#include "bgpd/bgp_fsm.h"
+#include "bgpd/bgp_updgrp.h"
+#include "bgpd/bgp_debug.h"
+#include "bgpd/bgp_ecommunity.h"
+#include "bgpd/bgp_mplsvpn.h"
+#include "bgpd/bgp_evpn.h"
+#include "bgpd/bgp_vty.h"
+
+/* Peer-group binds set up TCP MD5 and ask for privileges to do so.  */
+static int
+replay_privs_change (zebra_privs_ops_t op)
+{
+  return 0;
+}
+
+/* need these to link in libbgp */
+struct thread_master *master = NULL;
+extern struct zclient *zclient;
+struct zebra_privs_t bgpd_privs =
+{
+  .user = NULL,
+  .group = NULL,
+  .vty_group = NULL,
+  .change = replay_privs_change,
+};
+
+#define REPLAY_LOCAL_AS		4200000000U
+#define REPLAY_IN_AS		4200001000U
+#define REPLAY_OUT_AS		4200002000U
+#define REPLAY_DROP_AS		4200003000U
+
+#define REPLAY_MAX_IN		256
+#define REPLAY_MAX_STAGES	32
+
+/* Synthetic table: consecutive prefixes share an attribute set, so
+   they pack into one UPDATE, as they would from a real speaker.  */
+#define SYNTH_RUN		32
+#define SYNTH_PATHS		1000
+
+/* Routes announced by each of the peers dropped at the end.  */
+#define DROP_ROUTES		10
+
+/* The VNI the remote MACs are in.  */
+#define EVPN_VNI		100
+
+static struct bgp *bgp;
+static struct peer *in_peers[REPLAY_MAX_IN];
+static struct peer **out_peers;
+static unsigned int n_in = 2;
+static unsigned int n_out = 10;
+static unsigned int n_groups = 1;
+static struct peer **drop_peers;
+static unsigned int n_drop;
+static int rmap_out;
+static int reparse;
+static int soft_in;
+static int join;
+static int refresh;
+static int policy;
+static unsigned long n_macs;
+static unsigned int pack_window;
+
+/* What was fed in.  */
+static unsigned long msgs_in;
+static unsigned long prefixes_in;
+static unsigned long msgs_skipped;
+static unsigned long msgs_failed;
+
+/* Where the time went, by thread function.  */
+static struct replay_stage
+{
+  const char *name;
+  unsigned long usecs;
+  unsigned long calls;
+} stages[REPLAY_MAX_STAGES];
+static unsigned int n_stages;
+
+static struct timeval
+replay_now (void)
+{
+  struct timeval tv;
+
+  quagga_gettime (QUAGGA_CLK_MONOTONIC, &tv);
+  return tv;
+}
+
+static void
+stage_add (const char *name, struct timeval start)
+{
+  unsigned int i;
+
+  for (i = 0; i < n_stages; i++)
+    if (strcmp (stages[i].name, name) == 0)
+      break;
+
+  if (i == n_stages)
+    {
+      if (n_stages == REPLAY_MAX_STAGES)
+        i = REPLAY_MAX_STAGES - 1;
+      else
+        stages[n_stages++].name = name;
+    }
+
+  stages[i].usecs += timeval_elapsed (replay_now (), start);
+  stages[i].calls++;
+}
+
+static unsigned long
+stage_usecs (const char *name)
+{
+  unsigned int i;
+
+  for (i = 0; i < n_stages; i++)
+    if (strcmp (stages[i].name, name) == 0)
+      return stages[i].usecs;
+  return 0;
+}
+
+static unsigned long
+stages_busy (void)
+{
+  unsigned long busy = 0;
+  unsigned int i;
+
+  for (i = 0; i < n_stages; i++)
+    busy += stages[i].usecs;
+  return busy;
+}
+
+/* Bring a peer up as if the session had just reached Established,
+   without a socket: whatever bgpd writes goes to /dev/null.  */
+static void
+replay_peer_up (struct peer *peer)
+{
+  BGP_TIMER_OFF (peer->t_start);
+  BGP_TIMER_OFF (peer->t_connect);
+
+  peer->fd = open ("/dev/null", O_WRONLY);
+  if (peer->fd < 0)
+    {
+      perror ("/dev/null");
+      exit (1);
+    }
+
+  peer->remote_id = peer->su.sin.sin_addr;
+  peer->afc_adv[AFI_IP][SAFI_UNICAST] = 1;
+  peer->afc_recv[AFI_IP][SAFI_UNICAST] = 1;
+  peer->afc_nego[AFI_IP][SAFI_UNICAST] = 1;
+  peer->afc_adv[AFI_IP6][SAFI_UNICAST] = 1;
+  peer->afc_recv[AFI_IP6][SAFI_UNICAST] = 1;
+  peer->afc_nego[AFI_IP6][SAFI_UNICAST] = 1;
+  SET_FLAG (peer->cap, PEER_CAP_AS4_RCV | PEER_CAP_AS4_ADV);
+
+  peer->nexthop.v4.s_addr = htonl (0xc0000201);	/* 192.0.2.1 */
+  inet_pton (AF_INET6, "2001:db8::1", &peer->nexthop.v6_global);
+
+  peer->status = Established;
+  peer->uptime = bgp_clock ();
+}
+
+static void
+replay_peers_create (void)
+{
+  union sockunion su;
+  struct peer_group *group;
+  char name[32];
+  as_t as;
+  unsigned int i;
+
+  for (i = 0; i < n_in; i++)
+    {
+      memset (&su, 0, sizeof (su));
+      su.sin.sin_family = AF_INET;
+      su.sin.sin_addr.s_addr = htonl (0xc6120000 | (i + 1)); /* 198.18/16 */
+      in_peers[i] = peer_create (&su, NULL, bgp, bgp->as, REPLAY_IN_AS + i,
+                                 AS_SPECIFIED, AFI_IP, SAFI_UNICAST, NULL);
+      peer_activate (in_peers[i], AFI_IP6, SAFI_UNICAST);
+      if (soft_in)
+        {
+          peer_af_flag_set (in_peers[i], AFI_IP, SAFI_UNICAST,
+                            PEER_FLAG_SOFT_RECONFIG);
+          peer_af_flag_set (in_peers[i], AFI_IP6, SAFI_UNICAST,
+                            PEER_FLAG_SOFT_RECONFIG);
+        }
+      replay_peer_up (in_peers[i]);
+    }
+
+  /* One peer-group, and so one update group, per outbound AS.  */
+  out_peers = XCALLOC (MTYPE_TMP, (n_out + 1) * sizeof (struct peer *));
+  for (i = 0; i < n_groups; i++)
+    {
+      snprintf (name, sizeof (name), "OUT-%u", i);
+      peer_group_get (bgp, name);
+      group = peer_group_lookup (bgp, name);
+      as = REPLAY_OUT_AS + i;
+      peer_group_remote_as (bgp, name, &as, AS_SPECIFIED);
+      peer_activate (group->conf, AFI_IP6, SAFI_UNICAST);
+      peer_advertise_interval_set (group->conf, 0);
+    }
+
+  for (i = 0; i < n_out; i++)
+    {
+      memset (&su, 0, sizeof (su));
+      su.sin.sin_family = AF_INET;
+      su.sin.sin_addr.s_addr = htonl (0xc6130000 | (i + 1)); /* 198.19/16 */
+      snprintf (name, sizeof (name), "OUT-%u", i % n_groups);
+      group = peer_group_lookup (bgp, name);
+      as = group->conf->as;
+      peer_group_bind (bgp, &su, NULL, group, &as);
+      out_peers[i] = peer_lookup (bgp, &su);
+      replay_peer_up (out_peers[i]);
+      update_group_adjust_peer_afs (out_peers[i]);
+    }
+}
+
+/* Run a configuration command, as if read from the config file.  */
+static void
+replay_config (struct vty *vty, const char *line)
+{
+  vector vline;
+
+  vline = cmd_make_strvec (line);
+  if (cmd_execute_command (vline, vty, NULL, 0) != CMD_SUCCESS)
+    {
+      fprintf (stderr, "%s: failed\n", line);
+      exit (1);
+    }
+  cmd_free_strvec (vline);
+}
+
+/* Give every outbound peer-group the same outbound route-map.  Its
+   results depend on nothing but the attributes, so bgpd can cache them
+   across prefixes and update groups.  */
+static void
+replay_rmap_create (void)
+{
+  struct vty vty;
+  char line[64];
+  unsigned int i;
+
+  /* The route-map is in place before any route is, no need to go
+     over them again once it is changed.  */
+  bm->rmap_update_timer = 0;
+  bgp_route_map_init ();
+
+  memset (&vty, 0, sizeof (vty));
+  vty.type = VTY_SHELL;
+  vty.node = CONFIG_NODE;
+  replay_config (&vty, "route-map REPLAY-OUT permit 10");
+  snprintf (line, sizeof (line), "set as-path prepend %u %u",
+            REPLAY_LOCAL_AS, REPLAY_LOCAL_AS);
+  replay_config (&vty, line);
+  replay_config (&vty, "set community 65000:100 additive");
+
+  for (i = 0; i < n_groups; i++)
+    {
+      snprintf (line, sizeof (line), "OUT-%u", i);
+      peer_route_map_set (peer_group_lookup (bgp, line)->conf, AFI_IP,
+                          SAFI_UNICAST, RMAP_OUT, "REPLAY-OUT");
+    }
+}
+
+/* Finish the UPDATE sitting in the peer's input buffer and hand it to
+   the receive path, the way bgp_read () would.  */
+static void
+replay_receive (struct peer *peer)
+{
+  struct stream *s = peer->ibuf;
+  struct timeval start;
+
+  bgp_packet_set_size (s);
+  stream_set_getp (s, BGP_HEADER_SIZE);
+
+  start = replay_now ();
+  if (bgp_update_receive (peer, stream_get_endp (s) - BGP_HEADER_SIZE) < 0)
+    msgs_failed++;
+  stage_add ("bgp_update_receive", start);
+  msgs_in++;
+
+  if (peer->status != Established)
+    {
+      fprintf (stderr, "%s: session reset by malformed UPDATE #%lu\n",
+               peer->host, msgs_in);
+      exit (1);
+    }
+}
+
+static struct peer *
+replay_peer_by_addr (const u_char *addr, size_t len)
+{
+  return in_peers[jhash (addr, len, 0) % n_in];
+}
+
+/* BGP4MP(_ET) MESSAGE or MESSAGE_AS4: the UPDATE is there as received.  */
+static void
+replay_bgp4mp (struct stream *r, u_int16_t subtype)
+{
+  struct peer *peer;
+  struct stream *s;
+  const u_char *addr;
+  size_t aslen, iplen, len;
+  u_int16_t afi;
+
+  aslen = subtype == BGP4MP_MESSAGE_AS4 ? 4 : 2;
+  if (STREAM_READABLE (r) < 2 * aslen + 4)
+    goto skip;
+  stream_forward_getp (r, 2 * aslen + 2);	/* ASes and ifindex */
+  afi = stream_getw (r);
+  iplen = afi == AFI_IP6 ? 16 : 4;
+  if (STREAM_READABLE (r) < 2 * iplen + BGP_HEADER_SIZE)
+    goto skip;
+  addr = stream_pnt (r);
+  stream_forward_getp (r, 2 * iplen);
+
+  len = STREAM_READABLE (r);
+  if (STREAM_DATA (r)[stream_get_getp (r) + BGP_MARKER_SIZE + 2]
+      != BGP_MSG_UPDATE)
+    return;
+  if (len > BGP_MAX_PACKET_SIZE)
+    goto skip;
+
+  peer = replay_peer_by_addr (addr, iplen);
+  if (subtype == BGP4MP_MESSAGE_AS4)
+    SET_FLAG (peer->cap, PEER_CAP_AS4_RCV | PEER_CAP_AS4_ADV);
+  else
+    UNSET_FLAG (peer->cap, PEER_CAP_AS4_RCV | PEER_CAP_AS4_ADV);
+
+  s = peer->ibuf;
+  stream_reset (s);
+  stream_put (s, stream_pnt (r), len);
+  replay_receive (peer);
+  return;
+
+ skip:
+  msgs_skipped++;
+}
+
+/* One TABLE_DUMP_V2 RIB entry as an UPDATE.  RFC 6396 abbreviates the
+   MP_REACH_NLRI of IPv6 entries to just the next hop; dumps from older
+   bgpd carry it in full.  Either way the prefix goes back in.  */
+static int
+replay_rib_entry (struct peer *peer, afi_t afi, u_char plen,
+                  const u_char *prefix, const u_char *attrs, size_t alen)
+{
+  struct stream *s = peer->ibuf;
+  size_t attrlenp, psize, i, len, hlen;
+  u_char flags, type;
+
+  psize = PSIZE (plen);
+  if (alen + psize + 64 > BGP_MAX_PACKET_SIZE)
+    return -1;
+
+  stream_reset (s);
+  bgp_packet_set_marker (s, BGP_MSG_UPDATE);
+  stream_putw (s, 0);
+  attrlenp = stream_get_endp (s);
+  stream_putw (s, 0);
+
+  for (i = 0; i < alen; i += hlen + len)
+    {
+      if (i + 3 > alen)
+        return -1;
+      flags = attrs[i];
+      type = attrs[i + 1];
+      if (CHECK_FLAG (flags, BGP_ATTR_FLAG_EXTLEN))
+        {
+          if (i + 4 > alen)
+            return -1;
+          len = (attrs[i + 2] << 8) | attrs[i + 3];
+          hlen = 4;
+        }
+      else
+        {
+          len = attrs[i + 2];
+          hlen = 3;
+        }
+      if (i + hlen + len > alen)
+        return -1;
+
+      if (afi == AFI_IP6 && type == BGP_ATTR_MP_REACH_NLRI
+          && len && (size_t) attrs[i + hlen] + 1 == len)
+        {
+          stream_putc (s, BGP_ATTR_FLAG_OPTIONAL | BGP_ATTR_FLAG_EXTLEN);
+          stream_putc (s, BGP_ATTR_MP_REACH_NLRI);
+          stream_putw (s, 2 + 1 + len + 1 + 1 + psize);
+          stream_putw (s, AFI_IP6);
+          stream_putc (s, SAFI_UNICAST);
+          stream_put (s, attrs + i + hlen, len);
+          stream_putc (s, 0);
+          stream_putc (s, plen);
+          stream_put (s, prefix, psize);
+        }
+      else
+        stream_put (s, attrs + i, hlen + len);
+    }
+  stream_putw_at (s, attrlenp, stream_get_endp (s) - attrlenp - 2);
+
+  if (afi == AFI_IP)
+    {
+      stream_putc (s, plen);
+      stream_put (s, prefix, psize);
+    }
+
+  /* Paths in TABLE_DUMP_V2 are always 4-byte.  */
+  SET_FLAG (peer->cap, PEER_CAP_AS4_RCV | PEER_CAP_AS4_ADV);
+  replay_receive (peer);
+  prefixes_in++;
+  return 0;
+}
+
+static void
+replay_rib (struct stream *r, afi_t afi)
+{
+  const u_char *prefix, *attrs;
+  u_int16_t count, index, alen;
+  u_char plen;
+
+  if (STREAM_READABLE (r) < 5)
+    goto skip;
+  stream_forward_getp (r, 4);			/* sequence */
+  plen = stream_getc (r);
+  if (plen > (afi == AFI_IP ? IPV4_MAX_BITLEN : IPV6_MAX_BITLEN)
+      || STREAM_READABLE (r) < (size_t) PSIZE (plen) + 2)
+    goto skip;
+  prefix = stream_pnt (r);
+  stream_forward_getp (r, PSIZE (plen));
+
+  for (count = stream_getw (r); count; count--)
+    {
+      if (STREAM_READABLE (r) < 8)
+        goto skip;
+      index = stream_getw (r);
+      stream_forward_getp (r, 4);		/* originated */
+      alen = stream_getw (r);
+      if (STREAM_READABLE (r) < alen)
+        goto skip;
+      attrs = stream_pnt (r);
+      stream_forward_getp (r, alen);
+
+      if (replay_rib_entry (in_peers[index % n_in], afi, plen, prefix,
+                            attrs, alen) < 0)
+        msgs_skipped++;
+    }
+  return;
+
+ skip:
+  msgs_skipped++;
+}
+
+static FILE *
+replay_open (const char *file, int *piped)
+{
+  char cmd[1024];
+  size_t len = strlen (file);
+
+  *piped = len > 3 && strcmp (file + len - 3, ".gz") == 0;
+  if (! *piped)
+    return fopen (file, "r");
+
+  snprintf (cmd, sizeof (cmd), "gzip -dc '%s'", file);
+  return popen (cmd, "r");
+}
+
+static int
+replay_mrt (const char *file)
+{
+  struct stream *r;
+  struct timeval start;
+  FILE *fp;
+  u_char hdr[BGP_DUMP_HEADER_SIZE];
+  u_int16_t type, subtype;
+  u_int32_t len;
+  int piped;
+
+  fp = replay_open (file, &piped);
+  if (! fp)
+    {
+      perror (file);
+      return -1;
+    }
+
+  r = stream_new (BGP_MAX_PACKET_SIZE * 2);
+  for (;;)
+    {
+      start = replay_now ();
+      if (fread (hdr, sizeof (hdr), 1, fp) != 1)
+        break;
+      type = (hdr[4] << 8) | hdr[5];
+      subtype = (hdr[6] << 8) | hdr[7];
+      len = (hdr[8] << 24) | (hdr[9] << 16) | (hdr[10] << 8) | hdr[11];
+
+      if (len > STREAM_SIZE (r))
+        stream_resize (r, len);
+      stream_reset (r);
+      if (len && fread (STREAM_DATA (r), len, 1, fp) != 1)
+        break;
+      stream_set_endp (r, len);
+      stage_add ("mrt read", start);
+
+      switch (type)
+        {
+        case MSG_PROTOCOL_BGP4MP_ET:
+          if (len < 4)
+            break;
+          stream_forward_getp (r, 4);		/* microseconds */
+          /* fall through */
+        case MSG_PROTOCOL_BGP4MP:
+          if (subtype == BGP4MP_MESSAGE || subtype == BGP4MP_MESSAGE_AS4)
+            replay_bgp4mp (r, subtype);
+          break;
+        case MSG_TABLE_DUMP_V2:
+          if (subtype == TABLE_DUMP_V2_RIB_IPV4_UNICAST)
+            replay_rib (r, AFI_IP);
+          else if (subtype == TABLE_DUMP_V2_RIB_IPV6_UNICAST)
+            replay_rib (r, AFI_IP6);
+          break;
+        }
+    }
+
+  stream_free (r);
+  if (piped)
+    pclose (fp);
+  else
+    fclose (fp);
+  return 0;
+}
+
+/* Have the peer announce prefixes FIRST to LAST - 1, /24s from
+   10.0.0.0 upwards, with the K'th variant of attribute set SET.  */
+static void
+synth_update (struct peer *peer, unsigned int k, unsigned int set,
+              unsigned long first, unsigned long last)
+{
+  struct stream *s = peer->ibuf;
+  struct timeval start;
+  size_t attrlenp, aspathp;
+  unsigned long i;
+  unsigned int hops, j;
+
+  start = replay_now ();
+  stream_reset (s);
+  bgp_packet_set_marker (s, BGP_MSG_UPDATE);
+  stream_putw (s, 0);
+  attrlenp = stream_get_endp (s);
+  stream_putw (s, 0);
+
+  stream_putc (s, BGP_ATTR_FLAG_TRANS);
+  stream_putc (s, BGP_ATTR_ORIGIN);
+  stream_putc (s, 1);
+  stream_putc (s, BGP_ORIGIN_IGP);
+
+  hops = 2 + (set + k) % 5;
+  stream_putc (s, BGP_ATTR_FLAG_TRANS);
+  stream_putc (s, BGP_ATTR_AS_PATH);
+  aspathp = stream_get_endp (s);
+  stream_putc (s, 0);
+  stream_putc (s, AS_SEQUENCE);
+  stream_putc (s, hops);
+  stream_putl (s, peer->as);
+  for (j = 1; j < hops; j++)
+    stream_putl (s, 64512 + (set * 7 + j * 13 + k) % 1000);
+  stream_putc_at (s, aspathp, stream_get_endp (s) - aspathp - 1);
+
+  stream_putc (s, BGP_ATTR_FLAG_TRANS);
+  stream_putc (s, BGP_ATTR_NEXT_HOP);
+  stream_putc (s, 4);
+  stream_put_in_addr (s, &peer->su.sin.sin_addr);
+
+  if (set % 3 == 0)
+    {
+      stream_putc (s, BGP_ATTR_FLAG_OPTIONAL);
+      stream_putc (s, BGP_ATTR_MULTI_EXIT_DISC);
+      stream_putc (s, 4);
+      stream_putl (s, set);
+    }
+  if (set % 2 == 0)
+    {
+      stream_putc (s, BGP_ATTR_FLAG_OPTIONAL | BGP_ATTR_FLAG_TRANS);
+      stream_putc (s, BGP_ATTR_COMMUNITIES);
+      stream_putc (s, 8);
+      stream_putl (s, (65000U << 16) | set);
+      stream_putl (s, (65000U << 16) | k);
+    }
+  stream_putw_at (s, attrlenp, stream_get_endp (s) - attrlenp - 2);
+
+  for (i = first; i < last; i++)
+    {
+      stream_putc (s, 24);
+      stream_putc (s, 10 + (i >> 16));
+      stream_putc (s, (i >> 8) & 0xff);
+      stream_putc (s, i & 0xff);
+      prefixes_in++;
+    }
+  stage_add ("synthetic", start);
+
+  SET_FLAG (peer->cap, PEER_CAP_AS4_RCV | PEER_CAP_AS4_ADV);
+  replay_receive (peer);
+}
+
+/* Every inbound peer announces every prefix, each with its own path,
+   so that best path selection has something to choose between.  */
+static void
+replay_synthetic (unsigned long n)
+{
+  unsigned long run;
+  unsigned int k, set;
+
+  for (run = 0; run < n; run += SYNTH_RUN)
+    {
+      set = (run / SYNTH_RUN) % SYNTH_PATHS;
+      for (k = 0; k < n_in; k++)
+        synth_update (in_peers[k], k, set, run,
+                      run + SYNTH_RUN < n ? run + SYNTH_RUN : n);
+    }
+}
+
+static int
+replay_subgroup_busy (struct update_group *updgrp, void *arg)
+{
+  struct update_subgroup *subgrp;
+  int *busy = arg;
+
+  UPDGRP_FOREACH_SUBGRP (updgrp, subgrp)
+    if (subgrp->t_coalesce || subgrp->t_pack)
+      *busy = 1;
+  return UPDWALK_CONTINUE;
+}
+
+/* Anything left between the RIB and the outbound peers' sockets?  */
+static int
+replay_busy (void)
+{
+  unsigned int i;
+  int busy = 0;
+
+  if (bm->process_main_queue && work_queue_is_scheduled (bm->process_main_queue))
+    return 1;
+
+  if (bgp->t_announce_walk)
+    return 1;
+
+  for (i = 0; i < n_out; i++)
+    if (out_peers[i]->t_write || out_peers[i]->t_routeadv
+        || peer_af_find (out_peers[i], AFI_IP, SAFI_UNICAST)->t_announce_route)
+      return 1;
+
+  for (i = 0; drop_peers && i < n_drop; i++)
+    if (CHECK_FLAG (drop_peers[i]->flags, PEER_FLAG_SHUTDOWN)
+        && drop_peers[i]->status != Idle)
+      return 1;
+
+  update_group_walk (bgp, replay_subgroup_busy, &busy);
+  return busy;
+}
+
+static void
+replay_drain (void)
+{
+  struct thread thread;
+  struct timeval start;
+
+  while (replay_busy ())
+    {
+      if (! thread_fetch (bm->master, &thread))
+        break;
+      start = replay_now ();
+      thread_call (&thread);
+      stage_add (thread.funcname, start);
+    }
+}
+
+/* Feed the same UPDATEs in again.  Nothing changes, so the time spent
+   in bgp_update_receive is that of decoding the UPDATEs and finding
+   their routes.  */
+static void
+replay_reparse (const char *file, unsigned long n)
+{
+  unsigned long usecs, msgs, prefixes;
+
+  usecs = stage_usecs ("bgp_update_receive");
+  msgs = msgs_in;
+  prefixes = prefixes_in;
+  if (file)
+    replay_mrt (file);
+  else
+    replay_synthetic (n);
+  replay_drain ();
+  usecs = stage_usecs ("bgp_update_receive") - usecs;
+  msgs = msgs_in - msgs;
+  prefixes = prefixes_in - prefixes;
+
+  printf ("Parsed %lu UPDATEs again: %.1f ms, %.0f UPDATEs/s", msgs,
+          usecs / 1e3, usecs ? msgs * 1e6 / usecs : 0);
+  if (prefixes)
+    printf (", %.0f prefixes/s", usecs ? prefixes * 1e6 / usecs : 0);
+  printf ("\n\n");
+}
+
+/* Small peers, each with a few routes of its own, spread over the
+   table the main peers announced.  */
+static void
+replay_drop_create (unsigned long n)
+{
+  union sockunion su;
+  unsigned long first;
+  unsigned int i;
+
+  drop_peers = XCALLOC (MTYPE_TMP, n_drop * sizeof (struct peer *));
+  for (i = 0; i < n_drop; i++)
+    {
+      memset (&su, 0, sizeof (su));
+      su.sin.sin_family = AF_INET;
+      su.sin.sin_addr.s_addr = htonl (0xc6140000 | (i + 1)); /* 198.20/16 */
+      drop_peers[i] = peer_create (&su, NULL, bgp, bgp->as, REPLAY_DROP_AS + i,
+                                   AS_SPECIFIED, AFI_IP, SAFI_UNICAST, NULL);
+      replay_peer_up (drop_peers[i]);
+
+      first = n > DROP_ROUTES ? (i * 7919UL) % (n - DROP_ROUTES) : 0;
+      synth_update (drop_peers[i], i, i % SYNTH_PATHS, first,
+                    first + DROP_ROUTES);
+    }
+}
+
+/* Shut all the small peers down at once and time the clearing of their
+   routes, and what follows from it, to completion.  */
+static void
+replay_drop (void)
+{
+  struct timeval start;
+  unsigned long busy;
+  unsigned int i;
+
+  busy = stages_busy ();
+  start = replay_now ();
+  for (i = 0; i < n_drop; i++)
+    peer_flag_set (drop_peers[i], PEER_FLAG_SHUTDOWN);
+  stage_add ("peer shutdown", start);
+  replay_drain ();
+  busy = stages_busy () - busy;
+
+  for (i = 0; i < n_drop; i++)
+    if (drop_peers[i]->status != Idle
+        || drop_peers[i]->paths[AFI_IP][SAFI_UNICAST])
+      {
+        fprintf (stderr, "%s: routes not cleared (%s)\n", drop_peers[i]->host,
+                 LOOKUP (bgp_status_msg, drop_peers[i]->status));
+        exit (1);
+      }
+
+  printf ("Dropped %u sessions of %u routes each: %.1f ms busy\n\n",
+          n_drop, DROP_ROUTES, busy / 1e3);
+}
+
+/* The whole-table walk bgp_soft_reconfig_in used to do, going through
+   every peer's entries on every node.  */
+static void
+replay_soft_walk (struct peer *peer, afi_t afi, safi_t safi)
+{
+  struct bgp_node *rn;
+  struct bgp_adj_in *ain;
+
+  for (rn = bgp_table_top (bgp->rib[afi][safi]); rn; rn = bgp_route_next (rn))
+    for (ain = rn->adj_in; ain; ain = ain->next)
+      if (BGP_ADJ_IN_PEER (ain) == peer)
+        bgp_update (peer, &rn->p, ain->addpath_rx_id, ain->attr, afi, safi,
+                    ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, NULL, NULL, 1);
+}
+
+/* Replay every inbound peer's Adj-RIB-In, one peer at a time, as
+   "clear ip bgp * soft in" does, and again by walking the table.  */
+static void
+replay_soft (void)
+{
+  struct timeval start;
+  unsigned long busy, walk, entries, bytes;
+  unsigned int i;
+
+  busy = stages_busy ();
+  for (i = 0; i < n_in; i++)
+    {
+      start = replay_now ();
+      bgp_soft_reconfig_in (in_peers[i], AFI_IP, SAFI_UNICAST);
+      bgp_soft_reconfig_in (in_peers[i], AFI_IP6, SAFI_UNICAST);
+      stage_add ("bgp_soft_reconfig_in", start);
+      replay_drain ();
+    }
+  busy = stages_busy () - busy;
+
+  walk = stages_busy ();
+  for (i = 0; i < n_in; i++)
+    {
+      start = replay_now ();
+      replay_soft_walk (in_peers[i], AFI_IP, SAFI_UNICAST);
+      replay_soft_walk (in_peers[i], AFI_IP6, SAFI_UNICAST);
+      stage_add ("soft reconfig table walk", start);
+      replay_drain ();
+    }
+  walk = stages_busy () - walk;
+
+  entries = bgp_adj_in_count ();
+  bytes = mtype_stats_alloc (MTYPE_BGP_ADJ_IN)
+          * sizeof (struct bgp_adj_in_chunk)
+          + mtype_stats_alloc (MTYPE_BGP_ADJ_IN_POOL)
+          * sizeof (struct bgp_adj_in_pool);
+  printf ("Soft reconfiguration of %u peers: %.1f ms busy, %.1f ms by"
+          " walking the table\n", n_in, busy / 1e3, walk / 1e3);
+  printf ("Adj-RIB-In: %lu entries, %.1f bytes each\n\n", entries,
+          entries ? (double) bytes / entries : 0);
+}
+
+/* Bring up one more outbound peer, in the first update group, and time
+   sending it the full table to completion.  */
+static void
+replay_join (void)
+{
+  union sockunion su;
+  struct peer_group *group;
+  struct peer *peer;
+  struct timeval start;
+  unsigned long busy;
+  as_t as;
+
+  memset (&su, 0, sizeof (su));
+  su.sin.sin_family = AF_INET;
+  su.sin.sin_addr.s_addr = htonl (0xc6130000 | (n_out + 1)); /* 198.19/16 */
+  group = peer_group_lookup (bgp, "OUT-0");
+  as = group->conf->as;
+
+  busy = stages_busy ();
+  start = replay_now ();
+  peer_group_bind (bgp, &su, NULL, group, &as);
+  peer = peer_lookup (bgp, &su);
+  replay_peer_up (peer);
+  update_group_adjust_peer_afs (peer);
+  bgp_announce_peer (peer);
+  stage_add ("peer join", start);
+  out_peers[n_out++] = peer;
+  replay_drain ();
+  busy = stages_busy () - busy;
+
+  if (PAF_SUBGRP (peer_af_find (peer, AFI_IP, SAFI_UNICAST))->scount
+      != PAF_SUBGRP (peer_af_find (out_peers[0], AFI_IP, SAFI_UNICAST))
+         ->scount)
+    {
+      fprintf (stderr, "%s: full table not sent\n", peer->host);
+      exit (1);
+    }
+
+  printf ("Synced a new peer: %.1f ms busy\n\n", busy / 1e3);
+}
+
+/* Have every outbound peer ask for a route refresh at once, and time
+   the announcements to completion.  */
+static void
+replay_refresh (void)
+{
+  unsigned long busy;
+  u_int32_t walks;
+  unsigned int i;
+
+  busy = stages_busy ();
+  walks = bgp->update_group_stats.announce_walks;
+  for (i = 0; i < n_out; i++)
+    {
+      bgp_announce_route (out_peers[i], AFI_IP, SAFI_UNICAST);
+      bgp_announce_route (out_peers[i], AFI_IP6, SAFI_UNICAST);
+    }
+  replay_drain ();
+  busy = stages_busy () - busy;
+
+  printf ("Refreshed %u peers: %.1f ms busy, %u table walks\n\n",
+          n_out, busy / 1e3, bgp->update_group_stats.announce_walks - walks);
+}
+
+/* Give the outbound peers of the first update group, one at a time, an
+   outbound distribute-list that does not exist and so filters every route,
+   as an operator applying a new policy peer by peer would.  Only the
+   first peer to change should need a walk of the table.  */
+static void
+replay_policy (void)
+{
+  unsigned long busy;
+  u_int32_t walks, syncs, routes;
+  unsigned int i, n = 0;
+
+  busy = stages_busy ();
+  walks = bgp->update_group_stats.announce_walks;
+  syncs = bgp->update_group_stats.sync_events;
+  routes = bgp->update_group_stats.sync_routes;
+  for (i = 0; i < n_out; i += n_groups, n++)
+    {
+      peer_distribute_set (out_peers[i], AFI_IP, SAFI_UNICAST, FILTER_OUT,
+                           "REPLAY-POLICY");
+      replay_drain ();
+    }
+  busy = stages_busy () - busy;
+
+  for (i = 0; i < n_out; i += n_groups)
+    if (PAF_SUBGRP (peer_af_find (out_peers[i], AFI_IP, SAFI_UNICAST))
+        ->adj_count)
+      {
+        fprintf (stderr, "%s: routes not withdrawn\n", out_peers[i]->host);
+        exit (1);
+      }
+
+  printf ("Changed policy of %u peers: %.1f ms busy, %u table walks,"
+          " %u adj-out syncs of %u routes\n\n", n, busy / 1e3,
+          bgp->update_group_stats.announce_walks - walks,
+          bgp->update_group_stats.sync_events - syncs,
+          bgp->update_group_stats.sync_routes - routes);
+}
+
+/* Have the first inbound peer announce N remote MACs in the VNI, all
+   behind its own address as VTEP.  */
+static void
+replay_evpn_macs (unsigned long n)
+{
+  struct peer *peer = in_peers[0];
+  struct prefix_evpn p;
+  struct prefix_rd prd;
+  struct ecommunity *ecom;
+  struct ecommunity_val eval;
+  struct in_addr any = { .s_addr = INADDR_ANY };
+  struct attr attr;
+  struct timeval start;
+  unsigned long i;
+
+  memset (&prd, 0, sizeof (prd));
+  prd.family = AF_UNSPEC;
+  prd.prefixlen = 64;
+  prd.val[1] = RD_TYPE_IP;
+  memcpy (&prd.val[2], &peer->su.sin.sin_addr, 4);
+  prd.val[7] = EVPN_VNI;
+
+  /* An RT with the VNI in it matches the VNI's automatic one.  */
+  ecom = ecommunity_new ();
+  ecommunity_encode (ECOMMUNITY_ENCODE_AS4, ECOMMUNITY_ROUTE_TARGET, 1,
+                     peer->as, any, EVPN_VNI, &eval);
+  ecommunity_add_val (ecom, &eval);
+
+  bgp_attr_default_set (&attr, BGP_ORIGIN_IGP);
+  attr.nexthop = peer->su.sin.sin_addr;
+  attr.extra->mp_nexthop_len = BGP_ATTR_NHLEN_IPV4;
+  attr.extra->mp_nexthop_global_in = peer->su.sin.sin_addr;
+  attr.extra->ecommunity = ecommunity_intern (ecom);
+  attr.flag |= ATTR_FLAG_BIT (BGP_ATTR_EXT_COMMUNITIES);
+
+  /* MAC-only type-2 routes, as bgp_evpn.c builds them.  */
+  memset (&p, 0, sizeof (p));
+  p.family = AF_ETHERNET;
+  p.prefixlen = 192;
+  p.prefix.route_type = BGP_EVPN_MAC_IP_ROUTE;
+  p.prefix.ipa_type = IP_ADDR_NONE;
+  p.prefix.mac.octet[0] = 0x02;
+
+  start = replay_now ();
+  for (i = 0; i < n; i++)
+    {
+      p.prefix.mac.octet[3] = i >> 16;
+      p.prefix.mac.octet[4] = i >> 8;
+      p.prefix.mac.octet[5] = i;
+      bgp_update (peer, (struct prefix *) &p, 0, &attr, AFI_L2VPN, SAFI_EVPN,
+                  ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, &prd, NULL, 0);
+    }
+  stage_add ("bgp_update", start);
+
+  ecommunity_unintern (&attr.extra->ecommunity);
+  aspath_unintern (&attr.aspath);
+  bgp_attr_extra_free (&attr);
+}
+
+/* Learn the remote MACs, then take the VNI down and up again, and time
+   the MACs' reinstalling in zebra to completion.  Messages to zebra go
+   to /dev/null.  */
+static void
+replay_evpn (void)
+{
+  struct vty vty;
+  struct timeval start;
+  unsigned long busy;
+
+  memset (&vty, 0, sizeof (vty));
+  vty.type = VTY_SHELL;
+
+  zclient->sock = open ("/dev/null", O_WRONLY);
+  if (zclient->sock < 0)
+    {
+      perror ("/dev/null");
+      exit (1);
+    }
+
+  busy = stages_busy ();
+  bgp_evpn_local_vni_add (bgp, EVPN_VNI, bgp->router_id);
+  replay_evpn_macs (n_macs);
+  replay_drain ();
+  bgp_evpn_zebra_flush ();
+  busy = stages_busy () - busy;
+  printf ("Learnt %lu remote MACs in VNI %u: %.1f ms busy\n",
+          n_macs, EVPN_VNI, busy / 1e3);
+  bgp_evpn_show_zebra_stats (&vty);
+
+  busy = stages_busy ();
+  start = replay_now ();
+  bgp_evpn_local_vni_del (bgp, EVPN_VNI);
+  bgp_evpn_local_vni_add (bgp, EVPN_VNI, bgp->router_id);
+  bgp_evpn_zebra_flush ();
+  stage_add ("VNI down and up", start);
+  replay_drain ();
+  busy = stages_busy () - busy;
+  printf ("VNI %u down and up: %.1f ms busy\n", EVPN_VNI, busy / 1e3);
+  bgp_evpn_show_zebra_stats (&vty);
+  printf ("\n");
+}
+
+static int
+replay_memtype (void *arg, struct memgroup *mg, struct memtype *mt)
+{
+  if (mt && mt->n_alloc >= 1000)
+    {
+      if (mt->size == SIZE_VAR)
+        printf ("  %-32s %10zu\n", mt->name, mt->n_alloc);
+      else
+        printf ("  %-32s %10zu  %10zu kB\n", mt->name, mt->n_alloc,
+                mt->n_alloc * mt->size / 1024);
+    }
+  return 0;
+}
+
+static unsigned long
+replay_rib_count (struct bgp_table *table)
+{
+  struct bgp_node *rn;
+  unsigned long count = 0;
+
+  for (rn = bgp_table_top (table); rn; rn = bgp_route_next (rn))
+    if (rn->info)
+      count++;
+  return count;
+}
+
+static void
+replay_report (struct timeval wall)
+{
+  struct rusage ru;
+  unsigned long busy, updates_out = 0, rib4, rib6;
+  unsigned int i;
+
+  busy = stages_busy ();
+  for (i = 0; i < n_out; i++)
+    updates_out += out_peers[i]->update_out;
+  rib4 = replay_rib_count (bgp->rib[AFI_IP][SAFI_UNICAST]);
+  rib6 = replay_rib_count (bgp->rib[AFI_IP6][SAFI_UNICAST]);
+
+  printf ("Replayed %lu UPDATEs (%lu skipped, %lu rejected) from %u peers"
+          " to %u peers in %u update groups\n",
+          msgs_in, msgs_skipped, msgs_failed, n_in, n_out, n_groups);
+  printf ("RIB: %lu IPv4 and %lu IPv6 prefixes, %lu UPDATEs sent\n",
+          rib4, rib6, updates_out);
+  if (bgp->update_group_stats.update_packets)
+    printf ("Built %u UPDATEs of %.1f prefixes and %" PRIu64 " bytes"
+            " on average\n", bgp->update_group_stats.update_packets,
+            (double) bgp->update_group_stats.update_prefixes
+            / bgp->update_group_stats.update_packets,
+            bgp->update_group_stats.update_bytes
+            / bgp->update_group_stats.update_packets);
+  printf ("Time: %.3f s busy, %.3f s wall\n", busy / 1e6,
+          timeval_elapsed (replay_now (), wall) / 1e6);
+  if (busy)
+    printf ("Rate: %.0f UPDATEs/s, %.0f prefixes/s%s\n",
+            msgs_in * 1e6 / busy,
+            (prefixes_in ? prefixes_in : rib4 + rib6) * 1e6 / busy,
+            prefixes_in ? "" : " (by RIB size)");
+  if (rmap_out)
+    {
+      unsigned long hits, misses;
+
+      bgp_route_map_cache_count (&hits, &misses);
+      printf ("Route-map results: %lu from the cache, %lu evaluated\n",
+              hits, misses);
+    }
+
+  printf ("\n  %-32s %10s %10s %6s\n", "Stage", "Calls", "ms", "%");
+  for (i = 0; i < n_stages; i++)
+    printf ("  %-32s %10lu %10.1f %5.1f%%\n", stages[i].name, stages[i].calls,
+            stages[i].usecs / 1e3, busy ? stages[i].usecs * 100.0 / busy : 0);
+
+  getrusage (RUSAGE_SELF, &ru);
+  printf ("\nMemory: %ld kB max RSS; allocations by type:\n", ru.ru_maxrss);
+  qmem_walk (replay_memtype, NULL);
+}
+
+static void
+usage (const char *progname)
+{
+  fprintf (stderr,
+           "Usage: %s [-f MRT-FILE] [-n PREFIXES] [-i IN-PEERS]"
+           " [-p OUT-PEERS] [-g GROUPS] [-w MSEC] [-m] [-u]\n"
+           "       [-d DROP] [-s] [-j] [-r] [-c] [-e MACS]\n\n"
+           "Replays a BGP4MP or TABLE_DUMP_V2 file (gzip'ed if it ends in"
+           " .gz), or\nwithout -f a synthetic table of PREFIXES (100000)"
+           " from every IN-PEER (2),\nto OUT-PEERS (10) split across GROUPS"
+           " (1) update groups,\nwhich hold part-filled UPDATEs for up to MSEC"
+           " (0) ms, with -m through an\noutbound route-map.\n"
+           "With -u, the same UPDATEs are then fed in again and their parsing"
+           " timed.\nThen DROP (0) more peers each announce %u of those prefixes"
+           " and all\nlose their sessions at once.  With -s, the IN-PEERS keep"
+           " their Adj-RIB-In\nand each is soft reconfigured from it.  With -j, one more OUT-PEER"
+           " comes up and is\nsent the full table.  With -r, all OUT-PEERS"
+           " then ask for a route\nrefresh at once.  With -c, the OUT-PEERS of"
+           " the first group are given a new\noutbound policy one by one."
+           "  Finally, the first IN-PEER announces MACS (0)\nEVPN remote"
+           " MACs and their VNI goes down and up again.\n", progname,
+           DROP_ROUTES);
+  exit (1);
+}
+
+int
+main (int argc, char **argv)
+{
+  struct timeval wall;
+  const char *file = NULL;
+  unsigned long n = 100000;
+  as_t asn = REPLAY_LOCAL_AS;
+  struct in_addr id;
+  int opt;
+
+  while ((opt = getopt (argc, argv, "f:n:i:p:g:w:mud:sjrce:h")) != -1)
+    switch (opt)
+      {
+      case 'f':
+        file = optarg;
+        break;
+      case 'n':
+        n = strtoul (optarg, NULL, 10);
+        break;
+      case 'i':
+        n_in = atoi (optarg);
+        break;
+      case 'p':
+        n_out = atoi (optarg);
+        break;
+      case 'g':
+        n_groups = atoi (optarg);
+        break;
+      case 'w':
+        pack_window = strtoul (optarg, NULL, 10);
+        break;
+      case 'm':
+        rmap_out = 1;
+        break;
+      case 'u':
+        reparse = 1;
+        break;
+      case 'd':
+        n_drop = atoi (optarg);
+        break;
+      case 's':
+        soft_in = 1;
+        break;
+      case 'j':
+        join = 1;
+        break;
+      case 'r':
+        refresh = 1;
+        break;
+      case 'c':
+        policy = 1;
+        break;
+      case 'e':
+        n_macs = strtoul (optarg, NULL, 10);
+        break;
+      default:
+        usage (argv[0]);
+      }
+  if (n_in < 1 || n_in > REPLAY_MAX_IN || n_groups < 1 || n_out < n_groups
+      || n > (1UL << 24) || n_drop > 0xffff || n_macs > (1UL << 24))
+    usage (argv[0]);
+
+  /* Keep debugs out of the report, and out of the timings.  */
+  zlog_default = openzlog ("bgpreplay", ZLOG_BGP, 0,
+                           LOG_CONS|LOG_NDELAY|LOG_PID, LOG_DAEMON);
+  zlog_set_level (NULL, ZLOG_DEST_SYSLOG, ZLOG_DISABLED);
+  zlog_set_level (NULL, ZLOG_DEST_STDOUT, ZLOG_DISABLED);
+  zlog_set_level (NULL, ZLOG_DEST_MONITOR, ZLOG_DISABLED);
+
+  qobj_init ();
+  master = thread_master_create ();
+  zclient = zclient_new (master);
+  /* bgp_get installs VNC commands in BGP_NODE.  */
+  cmd_init (0);
+  bgp_master_init ();
+  bgp_vty_init ();
+  vrf_init ();
+  bgp_option_set (BGP_OPT_NO_LISTEN);
+  bgp_attr_init ();
+  bgp_process_queue_init ();
+
+  if (bgp_get (&bgp, &asn, NULL, BGP_INSTANCE_TYPE_DEFAULT))
+    return 1;
+  id.s_addr = htonl (0xc0000201);
+  bgp_router_id_static_set (bgp, id);
+  bgp->coalesce_time = 0;
+  bgp->pack_window = pack_window;
+
+  replay_peers_create ();
+  if (rmap_out)
+    replay_rmap_create ();
+  replay_drain ();
+
+  wall = replay_now ();
+  if (file)
+    {
+      if (replay_mrt (file) < 0)
+        return 1;
+    }
+  else
+    replay_synthetic (n);
+  replay_drain ();
+
+  if (reparse)
+    replay_reparse (file, n);
+
+  if (n_drop)
+    {
+      replay_drop_create (file ? 0 : n);
+      replay_drain ();
+      replay_drop ();
+    }
+
+  if (soft_in)
+    replay_soft ();
+
+  if (join)
+    replay_join ();
+
+  if (refresh)
+    replay_refresh ();
+
+  if (policy)
+    replay_policy ();
+
+  if (n_macs)
+    replay_evpn ();
+
+  replay_report (wall);
+  return 0;
+}
@@ -0,0 +1,313 @@
+/*
+ * VNC import table dispatch test and benchmark
+ *
+ * This file is part of Quagga
+ *
+ * Quagga is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2, or (at your option) any
+ * later version.
+ *
+ * Quagga is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Quagga; see the file COPYING.  If not, write to the Free
+ * Software Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <zebra.h>
+
+#include "qobj.h"
+#include "vty.h"
+#include "stream.h"
+#include "privs.h"
+#include "linklist.h"
+#include "memory.h"
+#include "zclient.h"
+#include "queue.h"
+#include "filter.h"
+#include "table.h"
+#include "skiplist.h"
+#include "sockunion.h"
+#include "log.h"
+
+#include "bgpd/bgpd.h"
+#include "bgpd/bgp_attr.h"
+#include "bgpd/bgp_route.h"
+#include "bgpd/bgp_ecommunity.h"
+#include "bgpd/bgp_mplsvpn.h"
+#include "bgpd/rfapi/rfapi.h"
+#include "bgpd/rfapi/rfapi_backend.h"
+#include "bgpd/rfapi/rfapi_import.h"
+#include "bgpd/rfapi/rfapi_private.h"
+
+/* need these to link in libbgp */
+struct thread_master *master = NULL;
+extern struct zclient *zclient;
+struct zebra_privs_t bgpd_privs =
+{
+  .user = NULL,
+  .group = NULL,
+  .vty_group = NULL,
+};
+
+/* Each table imports its own RT, and one of a few shared ones.  */
+#define TABLES		5000
+#define SHARED_RTS	100
+#define ROUTES		1000
+#define BENCH_ROUTES	200
+
+static int failed = 0;
+static struct bgp *bgp;
+static struct peer *peer;
+static struct rfapi_import_table *tables[TABLES];
+
+static void
+rt_add (struct ecommunity *ecom, u_int16_t as, u_int32_t val)
+{
+  struct ecommunity_val eval;
+
+  memset (&eval, 0, sizeof (eval));
+  eval.val[0] = ECOMMUNITY_ENCODE_AS;
+  eval.val[1] = ECOMMUNITY_ROUTE_TARGET;
+  eval.val[2] = as >> 8;
+  eval.val[3] = as & 0xff;
+  eval.val[4] = val >> 24;
+  eval.val[5] = val >> 16;
+  eval.val[6] = val >> 8;
+  eval.val[7] = val & 0xff;
+  ecommunity_add_val (ecom, &eval);
+}
+
+static struct ecommunity *
+table_rts (unsigned int i)
+{
+  struct ecommunity *ecom = ecommunity_new ();
+
+  rt_add (ecom, 65000, i);
+  rt_add (ecom, 65001, i % SHARED_RTS);
+  return ecom;
+}
+
+/* Route n carries its own table's RT, and every third one a shared RT
+   too, which may or may not be that same table's.  */
+static struct ecommunity *
+route_rts (unsigned int n)
+{
+  struct ecommunity *ecom = ecommunity_new ();
+
+  rt_add (ecom, 65000, (n * 7) % TABLES);
+  if (n % 3 == 0)
+    rt_add (ecom, 65001, n % SHARED_RTS);
+  return ecom;
+}
+
+static void
+route_prefix (struct prefix *p, unsigned int n)
+{
+  memset (p, 0, sizeof (*p));
+  p->family = AF_INET;
+  p->prefixlen = 32;
+  p->u.prefix4.s_addr = htonl (0x0a000000 | n);
+}
+
+static void
+route_update (struct rfapi_import_table *it, unsigned int n,
+              struct ecommunity *ecom)
+{
+  struct prefix p;
+  struct prefix_rd prd;
+  struct attr attr;
+  struct attr *new;
+  uint32_t label = 100;
+
+  route_prefix (&p, n);
+  memset (&prd, 0, sizeof (prd));
+  prd.family = AF_UNSPEC;
+  prd.prefixlen = 64;
+  prd.val[1] = RD_TYPE_IP;
+  prd.val[7] = 1;
+
+  bgp_attr_default_set (&attr, BGP_ORIGIN_IGP);
+  attr.extra->ecommunity = ecommunity_dup (ecom);
+  attr.flag |= ATTR_FLAG_BIT (BGP_ATTR_EXT_COMMUNITIES);
+  attr.extra->mp_nexthop_len = 4;
+  attr.extra->mp_nexthop_global_in.s_addr = htonl (0xc0000201);
+  new = bgp_attr_intern (&attr);
+  bgp_attr_extra_free (&attr);
+
+  if (it)
+    rfapiBgpInfoFilteredImportVPN (it, FIF_ACTION_UPDATE, peer, NULL, &p,
+                                   NULL, AFI_IP, &prd, new,
+                                   ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, &label);
+  else
+    rfapiProcessUpdate (peer, NULL, &p, &prd, new, AFI_IP, SAFI_MPLS_VPN,
+                        ZEBRA_ROUTE_BGP, BGP_ROUTE_NORMAL, &label);
+  bgp_attr_unintern (&new);
+}
+
+static int
+imported (struct rfapi_import_table *it, unsigned int n)
+{
+  struct prefix p;
+  struct route_node *rn;
+  int found;
+
+  route_prefix (&p, n);
+  rn = route_node_lookup (it->imported_vpn[AFI_IP], &p);
+  if (!rn)
+    return 0;
+  found = rn->info != NULL;
+  route_unlock_node (rn);
+  return found;
+}
+
+static int
+verify_routes (unsigned int first, unsigned int last)
+{
+  struct ecommunity *ecom;
+  unsigned int i, n;
+  int fails = 0;
+
+  for (n = first; n < last; n++)
+    {
+      ecom = route_rts (n);
+      for (i = 0; i < TABLES; i++)
+        if (imported (tables[i], n)
+            != rfapiEcommunitiesIntersect (tables[i]->rt_import_list, ecom))
+          fails++;
+      ecommunity_free (&ecom);
+    }
+  return fails;
+}
+
+static void
+check (const char *what, int fails)
+{
+  printf ("Verifying %s\n%s\n", what, fails ? "failed" : "OK");
+  failed += fails;
+}
+
+static void
+bench (void)
+{
+  struct rfapi_import_table *it;
+  struct ecommunity *ecom;
+  clock_t start, ref, new;
+  unsigned int n;
+
+  /* The walk over every import table the dispatch used to do.  */
+  start = clock ();
+  for (n = ROUTES; n < ROUTES + BENCH_ROUTES; n++)
+    {
+      ecom = route_rts (n);
+      for (it = bgp->rfapi->imports; it; it = it->next)
+        route_update (it, n, ecom);
+      ecommunity_free (&ecom);
+    }
+  ref = clock () - start;
+
+  start = clock ();
+  for (n = 2 * ROUTES; n < 2 * ROUTES + BENCH_ROUTES; n++)
+    {
+      ecom = route_rts (n);
+      route_update (NULL, n, ecom);
+      ecommunity_free (&ecom);
+    }
+  new = clock () - start;
+
+  printf ("Benchmark: %u updates to %u import tables, walk %.1f ms,"
+          " indexed %.1f ms\n", BENCH_ROUTES, TABLES,
+          ref * 1000.0 / CLOCKS_PER_SEC, new * 1000.0 / CLOCKS_PER_SEC);
+}
+
+int
+main (void)
+{
+  struct ecommunity *ecom;
+  struct rfapi_import_table *it;
+  union sockunion su;
+  as_t asn = 65000;
+  unsigned int i, n;
+  int fails;
+
+  /* Keep debugs out of the report, and out of the timings.  */
+  zlog_default = openzlog ("vncimporttest", ZLOG_BGP, 0,
+                           LOG_CONS|LOG_NDELAY|LOG_PID, LOG_DAEMON);
+  zlog_set_level (NULL, ZLOG_DEST_SYSLOG, ZLOG_DISABLED);
+  zlog_set_level (NULL, ZLOG_DEST_STDOUT, ZLOG_DISABLED);
+  zlog_set_level (NULL, ZLOG_DEST_MONITOR, ZLOG_DISABLED);
+
+  qobj_init ();
+  master = thread_master_create ();
+  zclient = zclient_new (master);
+  bgp_master_init ();
+  vrf_init ();
+  vnc_zebra_init (bm->master);
+  bgp_option_set (BGP_OPT_NO_LISTEN);
+  bgp_attr_init ();
+
+  if (bgp_get (&bgp, &asn, NULL, BGP_INSTANCE_TYPE_DEFAULT))
+    return 1;
+  memset (&su, 0, sizeof (su));
+  su.sin.sin_family = AF_INET;
+  su.sin.sin_addr.s_addr = htonl (0xc0000202);
+  peer = peer_create (&su, NULL, bgp, bgp->as, 65002, AS_SPECIFIED,
+                      AFI_IP, SAFI_UNICAST, NULL);
+
+  for (i = 0; i < TABLES; i++)
+    {
+      ecom = table_rts (i);
+      tables[i] = rfapiImportTableRefAdd (bgp, ecom);
+      ecommunity_free (&ecom);
+    }
+
+  /* The same RT list again must find the same table.  */
+  fails = 0;
+  for (i = 0; i < TABLES; i += 7)
+    {
+      ecom = table_rts (i);
+      if (rfapiImportTableRefAdd (bgp, ecom) != tables[i]
+          || tables[i]->refcount != 2)
+        fails++;
+      rfapiImportTableRefDelByIt (bgp, tables[i]);
+      ecommunity_free (&ecom);
+    }
+  check ("table lookup", fails);
+
+  for (n = 0; n < ROUTES; n++)
+    {
+      ecom = route_rts (n);
+      route_update (NULL, n, ecom);
+      ecommunity_free (&ecom);
+    }
+  check ("dispatch", verify_routes (0, ROUTES));
+
+  /* Give a table a new RT list, as changing an NVE group's does.  */
+  fails = 0;
+  it = tables[0];
+  ecom = table_rts (1);
+  rfapiImportTableRefDelByIt (bgp, it);
+  tables[0] = rfapiImportTableRefAdd (bgp, ecom);
+  if (tables[0] != tables[1] || tables[1]->refcount != 2)
+    fails++;
+  ecommunity_free (&ecom);
+
+  ecom = ecommunity_new ();
+  rt_add (ecom, 65000, 0);
+  route_update (NULL, 3 * ROUTES, ecom);
+  for (it = bgp->rfapi->imports; it; it = it->next)
+    if (imported (it, 3 * ROUTES))
+      fails++;
+  ecommunity_free (&ecom);
+  check ("RT list change", fails);
+
+  bench ();
+
+  printf ("failures: %d\n", failed);
+  return failed;
+}
@@ -534,6 +534,63 @@ test_iter_pause (void)
   route_table_finish (table);
 }
 
+/*
+ * test_get_hint
+ *
+ * Add random prefixes to one table with route_node_get() and to
+ * another with route_node_get_hint(), passing the previous node as the
+ * hint, and verify that both trees come out identical.
+ */
+static void
+test_get_hint (void)
+{
+  struct route_table *plain, *hinted;
+  struct route_node *rn, *rn_hinted, *hint;
+  struct prefix_ipv4 p;
+  unsigned long num_nodes;
+  int i;
+
+  printf ("\n\nTesting route_node_get_hint()\n");
+  plain = route_table_init ();
+  hinted = route_table_init ();
+  hint = NULL;
+  srandom (1);
+
+  for (i = 0; i < 4096; i++)
+    {
+      memset (&p, 0, sizeof (p));
+      p.family = AF_INET;
+      p.prefixlen = 8 + random () % 25;
+      p.prefix.s_addr = htonl (0x0a000000 | (random () & 0x00ffffff));
+      apply_mask_ipv4 (&p);
+
+      rn = route_node_get (plain, (struct prefix *) &p);
+      rn->info = rn;
+
+      rn_hinted = route_node_get_hint (hinted, hint, (struct prefix *) &p);
+      assert (prefix_same (&rn_hinted->p, (struct prefix *) &p));
+      rn_hinted->info = rn_hinted;
+      hint = rn_hinted;
+    }
+
+  assert (route_table_count (plain) == route_table_count (hinted));
+
+  num_nodes = 0;
+  for (rn = route_top (plain), rn_hinted = route_top (hinted);
+       rn && rn_hinted;
+       rn = route_next (rn), rn_hinted = route_next (rn_hinted))
+    {
+      assert (prefix_same (&rn->p, &rn_hinted->p));
+      assert ((rn->info != NULL) == (rn_hinted->info != NULL));
+      num_nodes++;
+    }
+  assert (rn == NULL && rn_hinted == NULL);
+
+  route_table_finish (plain);
+  route_table_finish (hinted);
+  printf ("Verified hinted insertion on tree with %lu nodes\n", num_nodes);
+}
+
 /*
  * run_tests
  */
@@ -543,6 +600,7 @@ run_tests (void)
   test_prefix_iter_cmp ();
   test_get_next ();
   test_iter_pause ();
+  test_get_hint ();
 }
 
 /*
@@ -835,6 +835,9 @@ compare_state (struct rib *r1, struct rib *r2)
   return 0;
 }
 
+/* Scratch stream for one nexthop update entry. */
+static struct stream *rnh_entry;
+
 static int
 send_client (struct rnh *rnh, struct zserv *client, rnh_type_t type, vrf_id_t vrf_id)
 {
@@ -850,12 +853,12 @@ send_client (struct rnh *rnh, struct zserv *client, rnh_type_t type, vrf_id_t vr
   rn = rnh->node;
   rib = rnh->state;
 
-  /* Get output stream. */
-  s = client->obuf;
+  /* Build the entry on its own, to be added to the client's batch. */
+  if (!rnh_entry)
+    rnh_entry = stream_new (ZEBRA_MAX_PACKET_SIZ);
+  s = rnh_entry;
   stream_reset (s);
 
-  zserv_create_header (s, cmd, vrf_id);
-
   stream_putw(s, rn->p.family);
   switch (rn->p.family)
     {
@@ -918,11 +921,10 @@ send_client (struct rnh *rnh, struct zserv *client, rnh_type_t type, vrf_id_t vr
       stream_putl (s, 0);
       stream_putc (s, 0);
     }
-  stream_putw_at (s, 0, stream_get_endp (s));
 
+  client->nh_upd_cnt++;
   client->nh_last_upd_time = quagga_monotime();
-  client->last_write_cmd = cmd;
-  return zebra_server_send_message(client);
+  return zserv_batch_add (client, cmd, vrf_id, s);
 }
 
 static void
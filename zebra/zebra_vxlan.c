@@ -439,6 +439,14 @@ zvni_macip_lookup (zebra_vni_t *zvni, struct ethaddr *mac)
   return pmac;
 }
 
+/* Scratch stream for one MAC-IP entry. */
+static struct stream *macip_entry;
+
+/*
+ * Inform BGP about a local MAC. Consecutive MACs share a message, so
+ * that learning or advertising a VNI's worth of them at once costs
+ * BGP a few reads rather than one per MAC.
+ */
 static int
 zvni_macip_send_msg_to_client (struct zebra_vrf *zvrf, vni_t vni,
                                struct ethaddr *mac, u_int16_t cmd)
@@ -452,17 +460,15 @@ zvni_macip_send_msg_to_client (struct zebra_vrf *zvrf, vni_t vni,
   if (!client)
     return 0;
 
-  s = client->obuf;
+  if (!macip_entry)
+    macip_entry = stream_new (ZEBRA_MAX_PACKET_SIZ);
+  s = macip_entry;
   stream_reset (s);
 
-  zserv_create_header (s, cmd, zvrf->vrf_id);
   stream_putl (s, vni);
   stream_put (s, mac->octet, ETHER_ADDR_LEN);
   stream_putl (s, 0); /* IP address length */
 
-  /* Write packet size. */
-  stream_putw_at (s, 0, stream_get_endp (s));
-
   if (IS_ZEBRA_DEBUG_VXLAN)
     zlog_debug ("%u:Send %s MAC %s VNI %u",
                 zvrf->vrf_id, (cmd == ZEBRA_MACIP_ADD) ? "Add" : "Del",
@@ -473,7 +479,7 @@ zvni_macip_send_msg_to_client (struct zebra_vrf *zvrf, vni_t vni,
   else
     client->macipdel_cnt++;
 
-  return zebra_server_send_message(client);
+  return zserv_batch_add (client, cmd, zvrf->vrf_id, s);
 }
 
 /*
@@ -106,16 +106,16 @@ zserv_flush_data(struct thread *thread)
   return 0;
 }
 
-int
-zebra_server_send_message(struct zserv *client)
+static int
+zserv_write (struct zserv *client, struct stream *s)
 {
   if (client->t_suicide)
     return -1;
 
-  stream_set_getp(client->obuf, 0);
-  client->last_write_cmd = stream_getw_from(client->obuf, 6);
-  switch (buffer_write(client->wb, client->sock, STREAM_DATA(client->obuf),
-		       stream_get_endp(client->obuf)))
+  stream_set_getp(s, 0);
+  client->last_write_cmd = stream_getw_from(s, 6);
+  switch (buffer_write(client->wb, client->sock, STREAM_DATA(s),
+		       stream_get_endp(s)))
     {
     case BUFFER_ERROR:
       zlog_warn("%s: buffer_write failed to zserv client fd %d, closing",
@@ -140,6 +140,92 @@ zebra_server_send_message(struct zserv *client)
   return 0;
 }
 
+/* Send out the updates batched up for a client. */
+int
+zserv_batch_flush (struct zserv *client)
+{
+  struct stream *b = client->batch;
+
+  if (!client->batch_count)
+    return 0;
+
+  stream_putw_at (b, 0, stream_get_endp (b));
+
+  switch (client->batch_cmd)
+    {
+    case ZEBRA_MACIP_ADD:
+    case ZEBRA_MACIP_DEL:
+      client->macip_msg_cnt++;
+      if (client->batch_count > client->macip_batch_max)
+        client->macip_batch_max = client->batch_count;
+      break;
+    default:
+      client->nh_upd_msg_cnt++;
+      if (client->batch_count > client->nh_upd_batch_max)
+        client->nh_upd_batch_max = client->batch_count;
+      break;
+    }
+  client->batch_count = 0;
+
+  return zserv_write (client, b);
+}
+
+static int
+zserv_batch_timer (struct thread *thread)
+{
+  struct zserv *client = THREAD_ARG (thread);
+
+  client->t_batch = NULL;
+  zserv_batch_flush (client);
+  return 0;
+}
+
+/* Updates for one command and VRF share a message, which goes out when
+ * it is full, before any other message to the client, or once zebra is
+ * done with the current event, so that one change affecting many
+ * nexthops or MACs costs the client one read rather than one per entry.
+ */
+int
+zserv_batch_add (struct zserv *client, int cmd, vrf_id_t vrf_id,
+                 struct stream *entry)
+{
+  size_t len = stream_get_endp (entry);
+  struct stream *b;
+
+  if (client->batch_count
+      && (client->batch_cmd != cmd || client->batch_vrf != vrf_id
+          || STREAM_WRITEABLE (client->batch) < len))
+    zserv_batch_flush (client);
+
+  if (!client->batch)
+    client->batch = stream_new (ZEBRA_MAX_PACKET_SIZ);
+  b = client->batch;
+
+  if (!client->batch_count)
+    {
+      stream_reset (b);
+      zserv_create_header (b, cmd, vrf_id);
+      client->batch_cmd = cmd;
+      client->batch_vrf = vrf_id;
+      if (!client->t_batch)
+        client->t_batch = thread_add_event (zebrad.master, zserv_batch_timer,
+                                            client, 0);
+    }
+
+  stream_put (b, STREAM_DATA (entry), len);
+  client->batch_count++;
+  return 0;
+}
+
+int
+zebra_server_send_message(struct zserv *client)
+{
+  /* Keep the order of what is sent to the client. */
+  zserv_batch_flush (client);
+
+  return zserv_write (client, client->obuf);
+}
+
 void
 zserv_create_header (struct stream *s, uint16_t cmd, vrf_id_t vrf_id)
 {
@@ -818,6 +904,7 @@ zserv_rnh_register (struct zserv *client, int sock, u_short length,
   struct prefix p;
   u_short l = 0;
   u_char flags = 0;
+  u_int32_t count = 0;
 
   if (IS_ZEBRA_DEBUG_NHT)
     zlog_debug("rnh_register msg from client %s: length=%d, type=%s\n",
@@ -827,9 +914,12 @@ zserv_rnh_register (struct zserv *client, int sock, u_short length,
   s = client->ibuf;
 
   client->nh_reg_time = quagga_monotime();
+  client->nh_reg_msg_cnt++;
 
   while (l < length)
     {
+      client->nh_reg_cnt++;
+      count++;
       flags = stream_getc(s);
       p.family = stream_getw(s);
       p.prefixlen = stream_getc(s);
@@ -870,6 +960,9 @@ zserv_rnh_register (struct zserv *client, int sock, u_short length,
       /* Anything not AF_INET/INET6 has been filtered out above */
       zebra_evaluate_rnh(zvrf->vrf_id, p.family, 1, type, &p);
     }
+
+  if (count > client->nh_reg_batch_max)
+    client->nh_reg_batch_max = count;
   return 0;
 }
 
@@ -1783,6 +1876,10 @@ zebra_client_close (struct zserv *client)
     thread_cancel (client->t_write);
   if (client->t_suicide)
     thread_cancel (client->t_suicide);
+  if (client->t_batch)
+    thread_cancel (client->t_batch);
+  if (client->batch)
+    stream_free (client->batch);
 
   /* Free client structure. */
   listnode_delete (zebrad.client_list, client);
@@ -2312,6 +2409,12 @@ zebra_show_client_detail (struct vty *vty, struct zserv *client)
 		 VTY_NEWLINE);
       else
 	vty_out (vty, "No Nexthop Update sent%s", VTY_NEWLINE);
+      vty_out (vty, "Nexthop Registrations: %u in %u msgs, largest %u%s",
+	       client->nh_reg_cnt, client->nh_reg_msg_cnt,
+	       client->nh_reg_batch_max, VTY_NEWLINE);
+      vty_out (vty, "Nexthop Updates: %u in %u msgs, largest %u%s",
+	       client->nh_upd_cnt, client->nh_upd_msg_cnt,
+	       client->nh_upd_batch_max, VTY_NEWLINE);
     }
   else
     vty_out (vty, "Not registered for Nexthop Updates%s", VTY_NEWLINE);
@@ -2356,6 +2459,8 @@ zebra_show_client_detail (struct vty *vty, struct zserv *client)
            VTY_NEWLINE);
   vty_out (vty, "MAC-IP delete notifications: %d%s", client->macipdel_cnt,
            VTY_NEWLINE);
+  vty_out (vty, "MAC-IP notification messages: %u, largest %u%s",
+           client->macip_msg_cnt, client->macip_batch_max, VTY_NEWLINE);
 
   vty_out (vty, "%s", VTY_NEWLINE);
   return;
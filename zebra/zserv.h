@@ -109,6 +109,22 @@ struct zserv
   u_int32_t vnidel_cnt;
   u_int32_t macipadd_cnt;
   u_int32_t macipdel_cnt;
+  u_int32_t macip_msg_cnt;
+  u_int32_t macip_batch_max;
+  u_int32_t nh_reg_cnt;
+  u_int32_t nh_reg_msg_cnt;
+  u_int32_t nh_reg_batch_max;
+  u_int32_t nh_upd_cnt;
+  u_int32_t nh_upd_msg_cnt;
+  u_int32_t nh_upd_batch_max;
+
+  /* Nexthop or MAC-IP updates not yet sent, all for one command and
+     VRF; see zserv_batch_add(). */
+  struct stream *batch;
+  struct thread *t_batch;
+  int batch_cmd;
+  vrf_id_t batch_vrf;
+  u_int32_t batch_count;
 
   time_t connect_time;
   time_t last_read_time;
@@ -181,6 +197,9 @@ extern pid_t pid;
 extern void zserv_create_header(struct stream *s, uint16_t cmd, vrf_id_t vrf_id);
 extern void zserv_nexthop_num_warn(const char *, const struct prefix *, const unsigned int);
 extern int zebra_server_send_message(struct zserv *client);
+extern int zserv_batch_add (struct zserv *client, int cmd, vrf_id_t vrf_id,
+                            struct stream *entry);
+extern int zserv_batch_flush (struct zserv *client);
 
 extern struct zserv *zebra_find_client (u_char proto);
 